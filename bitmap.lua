@@ -627,6 +627,43 @@ local function sub(bmp, x, y, w, h)
 				parent = bmp, x = x, y = y}
 end
 
+--native converters
+
+--row converters from csrc/bitmap for the most common format pairs. they are
+--optional: paint() falls back to the Lua converters if they're not built.
+local native = {enabled = true}
+
+native.formats = {
+	g8 = 1, ga8 = 2, rgb8 = 3, bgr8 = 4, rgba8 = 5, bgra8 = 6, argb8 = 7,
+	rgba16 = 8, rgb565 = 9, cmyk8 = 10, ycc8 = 11,
+}
+
+do
+	local ok, C = pcall(ffi.load, 'bitmap')
+	if ok then
+		ffi.cdef[[
+		int32_t bitmap_convert(
+			int32_t src_format, const uint8_t *src, int32_t src_stride,
+			int32_t dst_format, uint8_t *dst, int32_t dst_stride,
+			int32_t w, int32_t h);
+		]]
+		native.C = C
+	end
+end
+
+local u8p = ffi.typeof'uint8_t*'
+
+--data pointer and stride for walking a bitmap's rows from top to bottom,
+--for native routines whose result depends on the orientation.
+function native.top_down(bmp)
+	local data, stride = ffi.cast(u8p, bmp.data), bmp.stride
+	if bmp.bottom_up then
+		data = data + (bmp.h - 1) * stride
+		stride = -stride
+	end
+	return data, stride
+end
+
 --bitmap converter
 
 local function colortype_pixel_converter(src_colortype, dst_colortype)
@@ -706,6 +743,21 @@ local function paint(dst, src, dstx, dsty, convert_pixel, src_colortype, dst_col
 		return dst
 	end
 
+	--try to convert the bitmap with a native row converter
+	if not convert_pixel and native.C and native.enabled
+		and src.data ~= dst.data
+	then
+		local sf = native.formats[src.format]
+		local df = native.formats[dst.format]
+		if sf and df and native.C.bitmap_convert(
+				sf, ffi.cast(u8p, src_data), src_stride * ffi.sizeof(src_format.ctype),
+				df, ffi.cast(u8p, dst_data + dj), dst_stride * ffi.sizeof(dst_format.ctype),
+				src.w, src.h) == 1
+		then
+			return dst
+		end
+	end
+
 	--convert the bitmap pixel-by-pixel
 
 	if convert_pixel then
@@ -824,6 +876,8 @@ return glue.autoload({
 	--data_interface = data_interface, --publish if needed
 	pixel_interface = pixel_interface,
 	channel_interface = channel_interface,
+	--native converters
+	native = native,
 	--reflection
 	conversions = conversions,
 	dumpinfo = dumpinfo,
@@ -0,0 +1,171 @@
+--benchmark for bitmap.paint() format conversions: native vs Lua converters
+--for every pair of formats which have native converters, and for
+--bitmap.blend(): native vs Lua blend operators, and for the native
+--filtered resamplers of bitmap.resize: 24MP -> 256px and 4K -> 8K, and
+--for bitmap.dither: native vs Lua, and ordered dithering on 1..N threads.
+--usage: luajit bitmap_benchmark.lua [w h | blend [w h] | resize | dither [w h]]
+local ffi = require'ffi'
+local time = require'time'
+local glue = require'glue'
+local bitmap = require'bitmap'
+
+if ... == 'bitmap_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local blend = ... == 'blend'
+local dither = ... == 'dither'
+local small = blend or dither --the Lua path is too slow for large bitmaps
+local w = tonumber((select(small and 2 or 1, ...))) or (small and 512 or 1920)
+local h = tonumber((select(small and 3 or 2, ...))) or (small and 512 or 1080)
+
+local function bench(f)
+	local n = 0
+	local t0 = time.clock()
+	local t1
+	repeat
+		f()
+		n = n + 1
+		t1 = time.clock()
+	until t1 - t0 >= .2
+	return w * h * n / (t1 - t0) / 1e6
+end
+
+assert(bitmap.native.C, 'native converters not built (see csrc/bitmap)')
+
+local function random_fill(bmp)
+	local p = ffi.cast('uint8_t*', bmp.data)
+	for i = 0, bmp.size-1 do p[i] = i * 7 % 251 end
+end
+
+local function compare(f)
+	bitmap.native.enabled = true
+	local native = bench(f)
+	bitmap.native.enabled = false
+	local lua = bench(f)
+	bitmap.native.enabled = true
+	return native, lua
+end
+
+if dither then
+	require'bitmap_dither'
+	print(string.format('%-8s %-24s %12s %12s %8s',
+		'format', 'method', 'native', 'Lua', 'speedup'))
+	local function bench_dither(format, name, f)
+		local bmp = bitmap.new(w, h, format)
+		random_fill(bmp)
+		local native, lua = compare(function() f(bmp) end)
+		print(string.format('%-8s %-24s %7.1f Mpx/s %7.1f Mpx/s %7.1fx',
+			format, name, native, lua, native / lua))
+	end
+	for _,format in ipairs{'rgba8', 'rgb8', 'g8'} do
+		for _,method in ipairs{'fs', 'atkinson', 'sierra_lite'} do
+			bench_dither(format, method, function(bmp)
+				bitmap.dither[method](bmp, 5, 6, 5, 8)
+			end)
+		end
+		bench_dither(format, 'fs serpentine', function(bmp)
+			bitmap.dither.fs(bmp, 5, 6, 5, 8, true)
+		end)
+		for _,mapsize in ipairs{2, 4, 8} do
+			bench_dither(format, 'ordered '..mapsize, function(bmp)
+				bitmap.dither.ordered(bmp, mapsize, 5, 6, 5, 8)
+			end)
+		end
+	end
+	--ordered dithering scaling with threads on a large bitmap.
+	local ncpu = tonumber(io.popen'nproc':read'*l') or 1
+	local bmp = bitmap.new(3840, 2160, 'rgba8')
+	random_fill(bmp)
+	local threads = 1
+	while threads <= ncpu do
+		w, h = bmp.w, bmp.h
+		local mpx = bench(function()
+			bitmap.dither.ordered(bmp, 8, 5, 6, 5, 8, threads)
+		end)
+		print(string.format('ordered 8, 3840x2160 rgba8, %3d threads: %7.1f Mpx/s',
+			threads, mpx))
+		threads = threads * 2
+	end
+	return
+end
+
+if ... == 'resize' then
+	require'bitmap_resize'
+	print(string.format('%-8s %-10s %-22s %10s %12s %12s',
+		'format', 'filter', 'size', 'time', 'src', 'dst'))
+	local function bench_resize(format, sw, sh, dw, dh)
+		local src = bitmap.new(sw, sh, format)
+		local dst = bitmap.new(dw, dh, format)
+		random_fill(src)
+		for _,filter in ipairs{'box', 'bilinear', 'bicubic', 'lanczos'} do
+			local n = 0
+			local t0 = time.clock()
+			local t1
+			repeat
+				bitmap.resize[filter](src, dst)
+				n = n + 1
+				t1 = time.clock()
+			until t1 - t0 >= 1
+			local dt = (t1 - t0) / n
+			print(string.format('%-8s %-10s %-22s %7.1f ms %6.0f Mpx/s %6.0f Mpx/s',
+				format, filter, string.format('%dx%d -> %dx%d', sw, sh, dw, dh),
+				dt * 1000, sw * sh / dt / 1e6, dw * dh / dt / 1e6))
+		end
+	end
+	bench_resize('rgb8',  6000, 4000, 256, 171)
+	bench_resize('rgba8', 6000, 4000, 256, 171)
+	bench_resize('rgb8',  3840, 2160, 7680, 4320)
+	bench_resize('rgba8', 3840, 2160, 7680, 4320)
+	return
+end
+
+if blend then
+	require'bitmap_blend'
+	print(string.format('%-8s %-10s %-8s %12s %12s %8s',
+		'format', 'op', 'alpha', 'native', 'Lua', 'speedup'))
+	local function bench_blend(format, opname, alpha, const)
+		local src = bitmap.new(w, h, format)
+		local dst = bitmap.new(w, h, format)
+		random_fill(src)
+		random_fill(dst)
+		local source = const and {.2, .4, .6, .5} or src
+		local native, lua = compare(function()
+			bitmap.blend(source, dst, opname, 0, 0, alpha)
+		end)
+		print(string.format('%-8s %-10s %-8s %7.1f Mpx/s %7.1f Mpx/s %7.1fx',
+			format, opname, (alpha or 'premul') .. (const and '*' or ''),
+			native, lua, native / lua))
+	end
+	for opname in glue.sortedpairs(bitmap.blend_op) do
+		bench_blend('rgba8', opname)
+	end
+	bench_blend('rgba8',  'src_over', 'straight')
+	bench_blend('rgba8',  'src_over', nil, true)
+	bench_blend('rgba8',  'src_over', 'straight', true)
+	bench_blend('rgba16', 'src_over')
+	bench_blend('rgba16', 'src_over', 'straight')
+	print'* constant source color'
+	return
+end
+
+print(string.format('%-8s %-8s %12s %12s %8s', 'src', 'dst', 'native', 'Lua', 'speedup'))
+for sname in glue.sortedpairs(bitmap.native.formats) do
+	local src = bitmap.new(w, h, sname)
+	random_fill(src)
+	local dnames = {}
+	for dname in bitmap.conversions(sname) do
+		if dname ~= sname and bitmap.native.formats[dname] then
+			dnames[#dnames+1] = dname
+		end
+	end
+	table.sort(dnames)
+	for _,dname in ipairs(dnames) do
+		local dst = bitmap.new(w, h, dname)
+		local native, lua = compare(function()
+			bitmap.paint(dst, src)
+		end)
+		print(string.format('%-8s %-8s %7.1f Mpx/s %7.1f Mpx/s %7.1fx',
+			sname, dname, native, lua, native / lua))
+	end
+end
@@ -136,19 +136,124 @@ function op.saturate (Sr, Sg, Sb, Sa, Dr, Dg, Db, Da)
 		Da
 end
 
-function bitmap.blend(src, dst, operator, x0, y0)
+--native blending with the kernels from csrc/bitmap, if available.
+
+local ffi = require'ffi'
+local native = bitmap.native
+
+--op name -> op id in csrc/bitmap.
+local native_ops = {}
+for i,name in ipairs{
+	'clear', 'src', 'dst', 'src_over', 'dst_over', 'src_in', 'dst_in',
+	'src_out', 'dst_out', 'src_atop', 'dst_atop', 'xor', 'darken', 'lighten',
+	'modulate', 'screen', 'add', 'saturate',
+} do
+	native_ops[name] = i
+end
+
+if native.C then
+	ffi.cdef[[
+	int32_t bitmap_blend(int32_t op,
+		int32_t src_format, const uint8_t *src, int32_t src_stride, const float *color,
+		int32_t dst_format, uint8_t *dst, int32_t dst_stride,
+		int32_t w, int32_t h, int32_t flags);
+	]]
+end
+
+local u8p = ffi.typeof'uint8_t*'
+local color_buf = ffi.new'float[4]'
+
+local function native_blend(opname, src, dst, color, straight)
+	if not native.C or not native.enabled then return end
+	local op = native_ops[opname]
+	local df = native.formats[dst.format]
+	local sf = src and native.formats[src.format] or 0
+	if not op or not df or not sf then return end
+	local src_data, src_stride = nil, 0
+	if src then
+		src_data, src_stride = ffi.cast(u8p, src.data), src.stride
+		if not src.bottom_up ~= not dst.bottom_up then
+			--walk the source backwards.
+			src_data = src_data + (src.h - 1) * src_stride
+			src_stride = -src_stride
+		end
+	else
+		for i = 0, 3 do
+			color_buf[i] = color[i+1] or 1
+		end
+	end
+	return native.C.bitmap_blend(op,
+		sf, src_data, src_stride, color_buf,
+		df, ffi.cast(u8p, dst.data), dst.stride,
+		dst.w, dst.h, straight and 1 or 0) == 1
+end
+
+--clamp the results of an operator to 0..1 like the native blender does,
+--since some operators can go out of range. NaNs (eg. from 0/0) become 0.
+local function clamp(x)
+	return x > 0 and (x < 1 and x or 1) or 0
+end
+local function clamped_op(operator)
+	return function(...)
+		local r, g, b, a = operator(...)
+		return clamp(r), clamp(g), clamp(b), clamp(a)
+	end
+end
+
+--wrap a premultiplied operator to work on straight alpha values.
+local function straight_op(operator)
+	return function(Sr, Sg, Sb, Sa, Dr, Dg, Db, Da)
+		local r, g, b, a = operator(
+			Sr * Sa, Sg * Sa, Sb * Sa, Sa,
+			Dr * Da, Dg * Da, Db * Da, Da)
+		if a > 0 then
+			return r / a, g / a, b / a, a
+		end
+		return 0, 0, 0, 0
+	end
+end
+
+function bitmap.blend(src, dst, operator, x0, y0, alpha)
 	x0 = x0 or 0
 	y0 = y0 or 0
-	operator = operator or 'src_over'
-	local operator = assert(op[operator], 'invalid operator')
-	local src_getpixel = bitmap.pixel_interface(src, 'rgbaf')
+	local opname = operator or 'src_over'
+	local operator = assert(op[opname], 'invalid operator')
+	local straight = alpha == 'straight'
+	local color = not src.data and src --constant color {r, g, b, a}
+	if color then
+		src = nil
+	else
+		--clip the source to the destination.
+		local x, y, w, h = box2d.clip(x0, y0, src.w, src.h, 0, 0, dst.w, dst.h)
+		if w == 0 or h == 0 then return end
+		src = bitmap.sub(src, x - x0, y - y0, w, h)
+		dst = bitmap.sub(dst, x, y, w, h)
+	end
+	if native_blend(opname, src, dst, color, straight) then
+		return
+	end
+	if straight then
+		operator = straight_op(operator)
+	end
+	operator = clamped_op(operator)
 	local dst_getpixel, dst_setpixel = bitmap.pixel_interface(dst, 'rgbaf')
-	local _, _, w, h = box2d.clip(x0, y0, src.w, src.h, 0, 0, dst.w, dst.h)
-	for y = 0, h-1 do
-		for x = 0, w-1 do
+	if color then
+		local Sr, Sg, Sb, Sa = unpack(color)
+		Sa = Sa or 1
+		for y = 0, dst.h-1 do
+			for x = 0, dst.w-1 do
+				local Dr, Dg, Db, Da = dst_getpixel(x, y)
+				dst_setpixel(x, y, operator(Sr, Sg, Sb, Sa, Dr, Dg, Db, Da))
+			end
+		end
+		return
+	end
+	local src_getpixel = bitmap.pixel_interface(src, 'rgbaf')
+	for y = 0, dst.h-1 do
+		for x = 0, dst.w-1 do
 			local Sr, Sg, Sb, Sa = src_getpixel(x, y)
-			local Dr, Dg, Db, Da = dst_getpixel(x0 + x, y0 + y)
-			dst_setpixel(x0 + x, y0 + y, operator(Sr, Sg, Sb, Sa, Dr, Dg, Db, Da))
+			local Dr, Dg, Db, Da = dst_getpixel(x, y)
+			dst_setpixel(x, y, operator(Sr, Sg, Sb, Sa, Dr, Dg, Db, Da))
 		end
 	end
 end
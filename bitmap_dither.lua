@@ -6,54 +6,96 @@ local bitmap = require'bitmap'
 
 bitmap.dither = {}
 
---floyd-steinberg dithering
+local ffi = require'ffi'
+local native = bitmap.native
+
+if native.C then
+	ffi.cdef[[
+	int32_t bitmap_dither_diffuse(int32_t format, uint8_t *data, int32_t stride,
+		int32_t w, int32_t h, int32_t method, const int32_t *bits, int32_t serpentine);
+	int32_t bitmap_dither_ordered(int32_t format, uint8_t *data, int32_t stride,
+		int32_t w, int32_t h, int32_t mapsize, const int32_t *bits, int32_t threads);
+	]]
+end
 
-local function fs_dither_4c(x, maxval, r1, g1, b1, a1, r0, g0, b0, a0)
-	return
-		math.min(r0 + bit.rshift(x * r1, 4), maxval),
-		math.min(g0 + bit.rshift(x * g1, 4), maxval),
-		math.min(b0 + bit.rshift(x * b1, 4), maxval),
-		math.min(a0 + bit.rshift(x * a1, 4), maxval)
+local bits_buf = ffi.new'int32_t[4]'
+
+local function native_format(src)
+	if not native.C or not native.enabled then return end
+	return native.formats[src.format]
 end
 
-function bitmap.dither.fs(src, rbits, gbits, bbits, abits)
+local function check(ret)
+	assert(ret ~= -1, 'out of memory')
+	return ret == 1
+end
+
+--error diffusion dithering
+
+--kernels as {dx, dy, weight} taps with weights summing up to at most 2^shift.
+local kernels = {
+	fs          = {id = 1, shift = 4, {1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}},
+	atkinson    = {id = 2, shift = 3, {1, 0, 1}, {2, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}, {0, 2, 1}},
+	sierra_lite = {id = 3, shift = 2, {1, 0, 2}, {-1, 1, 1}, {0, 1, 1}},
+}
+
+local function diffuse(kernel, src, serpentine, ...)
+	local format = native_format(src)
+	if format then
+		for i = 0, 3 do
+			bits_buf[i] = select(i+1, ...) or 8
+		end
+		local data, stride = native.top_down(src)
+		if check(native.C.bitmap_dither_diffuse(format,
+			data, stride, src.w, src.h,
+			kernel.id, bits_buf, serpentine and 1 or 0))
+		then
+			return
+		end
+	end
 	local colortype = bitmap.colortype(src)
-	assert(#colortype.channels == 4, 'invalid colortype')
+	local n = #colortype.channels
 	local maxbits = colortype.bpc
 	local maxval  = colortype.max
 	local getpixel, setpixel = bitmap.pixel_interface(src)
-	local rmask = 2^(maxbits-rbits)-1
-	local gmask = 2^(maxbits-gbits)-1
-	local bmask = 2^(maxbits-bbits)-1
-	local amask = 2^(maxbits-abits)-1
+	local band, rshift, min = bit.band, bit.rshift, math.min
+	local mask, err, px = {}, {}, {}
+	for c = 1, n do
+		mask[c] = 2^(maxbits - (select(c, ...) or maxbits)) - 1
+	end
+	local shift = kernel.shift
 	for y = 0, src.h-1 do
-		for x = 0, src.w-1 do
-			local r0, g0, b0, a0 = getpixel(x, y)
-			local r1 = bit.band(r0, rmask)
-			local g1 = bit.band(g0, gmask)
-			local b1 = bit.band(b0, bmask)
-			local a1 = bit.band(a0, amask)
-			setpixel(x, y,
-				bit.band(r0, maxval-rmask),
-				bit.band(g0, maxval-gmask),
-				bit.band(b0, maxval-bmask),
-				bit.band(a0, maxval-amask))
-			if x < src.w-1 then
-				setpixel(x+1, y, fs_dither_4c(7, maxval, r1, g1, b1, a1, getpixel(x+1, y)))
+		local dir = serpentine and y % 2 == 1 and -1 or 1
+		local x0, x1 = 0, src.w-1
+		if dir == -1 then x0, x1 = x1, x0 end
+		for x = x0, x1, dir do
+			px[1], px[2], px[3], px[4] = getpixel(x, y)
+			for c = 1, n do
+				err[c] = band(px[c], mask[c])
+				px[c] = band(px[c], maxval - mask[c])
 			end
-			if y < src.h-1 and x > 0 then
-				setpixel(x-1, y+1, fs_dither_4c(3, maxval, r1, g1, b1, a1, getpixel(x-1, y+1)))
-			end
-			if y < src.h-1 then
-				setpixel(x, y+1, fs_dither_4c(5, maxval, r1, g1, b1, a1, getpixel(x, y+1)))
-			end
-			if y < src.h-1 and x < src.w-1 then
-				setpixel(x+1, y+1, fs_dither_4c(1, maxval, r1, g1, b1, a1, getpixel(x+1, y+1)))
+			setpixel(x, y, unpack(px, 1, n))
+			for i = 1, #kernel do
+				local t = kernel[i]
+				local x, y = x + t[1] * dir, y + t[2]
+				if x >= 0 and x < src.w and y < src.h then
+					px[1], px[2], px[3], px[4] = getpixel(x, y)
+					for c = 1, n do
+						px[c] = min(px[c] + rshift(t[3] * err[c], shift), maxval)
+					end
+					setpixel(x, y, unpack(px, 1, n))
+				end
 			end
 		end
 	end
 end
 
+for name, kernel in pairs(kernels) do
+	bitmap.dither[name] = function(src, rbits, gbits, bbits, abits, serpentine)
+		diffuse(kernel, src, serpentine, rbits, gbits, bbits, abits)
+	end
+end
+
 --ordered dithering
 
 local tmap = {} --threshold maps from wikipedia
@@ -101,12 +143,51 @@ ordered_dither[2] = function(t, maxval, g, a)
 		math.min(a + t, maxval)
 end
 
-function bitmap.dither.ordered(src, mapsize)
+function bitmap.dither.ordered(src, mapsize, rbits, gbits, bbits, abits, threads)
+	local quantize = rbits and true
+	local format = native_format(src)
+	if format then
+		for i = 0, 3 do
+			bits_buf[i] = select(i+1, rbits, gbits, bbits, abits) or 8
+		end
+		local data, stride = native.top_down(src)
+		if check(native.C.bitmap_dither_ordered(format,
+			data, stride, src.w, src.h,
+			mapsize, quantize and bits_buf or nil, threads or 1))
+		then
+			return
+		end
+	end
 	local colortype = bitmap.colortype(src)
 	local maxval = colortype.max
-	local kernel = assert(ordered_dither[#colortype.channels], 'invalid colortype')
+	local n = #colortype.channels
 	local getpixel, setpixel = bitmap.pixel_interface(src)
 	local tmap = assert(tmap[mapsize], 'invalid map size')
+	if quantize then
+		--scale the map to the quantization step of each channel.
+		local band, floor = bit.band, math.floor
+		local maxbits = colortype.bpc
+		local mask, step, px = {}, {}, {}
+		for c = 1, n do
+			local bits = select(c, rbits, gbits, bbits, abits) or maxbits
+			step[c] = 2^(maxbits - bits)
+			mask[c] = maxval - (step[c] - 1)
+		end
+		local n2 = 2 * mapsize^2
+		for y = 0, src.h-1 do
+			local tmap = tmap[bit.band(y, mapsize-1)]
+			for x = 0, src.w-1 do
+				local t = tmap[bit.band(x, mapsize-1)] * 2 - 1
+				px[1], px[2], px[3], px[4] = getpixel(x, y)
+				for c = 1, n do
+					px[c] = band(math.min(px[c] + floor(t * step[c] / n2), maxval), mask[c])
+				end
+				setpixel(x, y, unpack(px, 1, n))
+			end
+		end
+		return
+	end
+	local kernel = assert(ordered_dither[n], 'invalid colortype')
 	for y = 0, src.h-1 do
 		local tmap = tmap[bit.band(y, mapsize-1)]
 		for x = 0, src.w-1 do
@@ -6,8 +6,8 @@ local bitmap = require'bitmap'
 
 bitmap.resize = {}
 
-local min, max, floor, ceil =
-	math.min, math.max, math.floor, math.ceil
+local min, max, floor, ceil, abs, sin, pi =
+	math.min, math.max, math.floor, math.ceil, math.abs, math.sin, math.pi
 
 local function clamp(x, t0, t1)
 	return min(max(x, t0), t1)
@@ -27,18 +27,15 @@ local function args(src, w, h)
 	else --src, dst
 		dst = w
 	end
-
 	local channels, maxval = check_colortypes(src, dst)
-
-	local src_getpixel = bitmap.pixel_interface(src)
-	local _, dst_setpixel = bitmap.pixel_interface(dst)
-
-	return src, dst, src_getpixel, dst_setpixel, channels, maxval
+	return src, dst, channels, maxval
 end
 
 function bitmap.resize.nearest(...)
 
-	local src, dst, src_getpixel, dst_setpixel = args(...)
+	local src, dst = args(...)
+	local src_getpixel = bitmap.pixel_interface(src)
+	local _, dst_setpixel = bitmap.pixel_interface(dst)
 
 	local tx = (src.w-1) / dst.w
 	local ty = (src.h-1) / dst.h
@@ -54,70 +51,176 @@ function bitmap.resize.nearest(...)
 	return dst
 end
 
-function bitmap.resize.bilinear(...)
+--separable filtered resampling
 
-	local src, dst, src_getpixel, dst_setpixel, channels, maxval = args(...)
+local filters = {}
 
-	local kernel = {}
+filters.box = {support = .5, id = 1, f = function(x)
+	return (x > -.5 and x <= .5) and 1 or 0
+end}
 
-	kernel[2] = function(x, y, x1, y1, f1, f2, f3, f4)
+filters.bilinear = {support = 1, id = 2, f = function(x)
+	x = abs(x)
+	return x < 1 and 1 - x or 0
+end}
 
-		local g1, a1 = src_getpixel(x,   y  )
-		local g2, a2 = src_getpixel(x+1, y  )
-		local g3, a3 = src_getpixel(x,   y+1)
-		local g4, a4 = src_getpixel(x+1, y+1)
+filters.bicubic = {support = 2, id = 3, f = function(x) --Keys, a = -0.5
+	local a = -.5
+	x = abs(x)
+	if x < 1 then return ((a + 2) * x - (a + 3)) * x * x + 1 end
+	if x < 2 then return (((x - 5) * x + 8) * x - 4) * a end
+	return 0
+end}
 
-		dst_setpixel(x1, y1,
-			g1 * f1 + g2 * f2 + g3 * f3 + g4 * f4,
-			a1 * f1 + a2 * f2 + a3 * f3 + a4 * f4)
-	end
+local function sinc(x)
+	if x == 0 then return 1 end
+	x = x * pi
+	return sin(x) / x
+end
 
-	kernel[4] = function(x, y, x1, y1, f1, f2, f3, f4)
+filters.lanczos = {support = 3, id = 4, f = function(x) --Lanczos-3
+	return (x > -3 and x < 3) and sinc(x) * sinc(x / 3) or 0
+end}
 
-		local r1, g1, b1, a1 = src_getpixel(x,   y  )
-		local r2, g2, b2, a2 = src_getpixel(x+1, y  )
-		local r3, g3, b3, a3 = src_getpixel(x,   y+1)
-		local r4, g4, b4, a4 = src_getpixel(x+1, y+1)
+--round half away from zero like C's lround().
+local function lround(x)
+	return x >= 0 and floor(x + .5) or -floor(-x + .5)
+end
 
-		dst_setpixel(x1, y1,
-			clamp(r1 * f1 + r2 * f2 + r3 * f3 + r4 * f4, 0, maxval),
-			clamp(g1 * f1 + g2 * f2 + g3 * f3 + g4 * f4, 0, maxval),
-			clamp(b1 * f1 + b2 * f2 + b3 * f3 + b4 * f4, 0, maxval),
-			clamp(a1 * f1 + a2 * f2 + a3 * f3 + a4 * f4, 0, maxval))
+--quantize weights to 14bit fixed point like in the native resampler and
+--make them add up to exactly 1, so that for integer channels the results
+--are the same as those of the native resampler.
+local PRECISION = 2^14
+
+local function quantize(t)
+	local isum, jmax = 0, 1
+	for j = 1, #t do
+		t[j] = lround(t[j] * PRECISION)
+		isum = isum + t[j]
+		if t[j] > t[jmax] then jmax = j end
 	end
+	if #t > 0 then
+		t[jmax] = t[jmax] + PRECISION - isum
+	end
+	for j = 1, #t do t[j] = t[j] / PRECISION end
+end
 
-	local kernel = assert(kernel[channels], 'unsupported colortype')
-
-	local maxx = src.w-2
-	local maxy = src.h-2
-
-	local tx = src.w / dst.w
-	local ty = src.h / dst.h
-
-	for y1 = 0, dst.h-1 do
-		for x1 = 0, dst.w-1 do
+--weights for each output pixel: output pixel i is the sum of input pixels
+--starting at start[i] multiplied by the weights in w[i].
+local function weights(inlen, outlen, filter, fixed)
+	local scale = inlen / outlen
+	local fscale = max(scale, 1)
+	local support = filter.support * fscale
+	local start, w = {}, {}
+	for i = 0, outlen-1 do
+		local center = (i + .5) * scale
+		local x0 = max(floor(center - support + .5), 0)
+		local x1 = min(floor(center + support + .5), inlen)
+		local t, sum = {}, 0
+		for x = x0, x1-1 do
+			local k = filter.f((x - center + .5) / fscale)
+			t[#t+1] = k
+			sum = sum + k
+		end
+		if sum ~= 0 then
+			for j = 1, #t do t[j] = t[j] / sum end
+		end
+		if fixed then
+			quantize(t)
+		end
+		start[i], w[i] = x0, t
+	end
+	return start, w
+end
 
-			local x = floor(tx * x1)
-			local y = floor(ty * y1)
+local function lua_resize(filter, src, dst, channels, maxval)
+	local src_getpixel = bitmap.pixel_interface(src)
+	local _, dst_setpixel = bitmap.pixel_interface(dst)
+	local round = maxval > 1 --integer channels
+	local xstart, xw = weights(src.w, dst.w, filter, round)
+	local ystart, yw = weights(src.h, dst.h, filter, round)
+	local n = channels
+	local function pixel_value(v)
+		v = clamp(v, 0, maxval)
+		return round and floor(v + .5) or v
+	end
+	--horizontal pass into an array of rows of channel values which are
+	--rounded and clamped like in the native resampler.
+	local rows = {}
+	local px = {}
+	for y = 0, src.h-1 do
+		local row = {}
+		for x = 0, dst.w-1 do
+			local t = xw[x]
+			for c = 1, n do px[c] = 0 end
+			for j = 1, #t do
+				local k = t[j]
+				local a, b, c, d = src_getpixel(xstart[x] + j - 1, y)
+				px[1] = px[1] + a * k
+				if n > 1 then px[2] = px[2] + b * k end
+				if n > 2 then px[3] = px[3] + c * k end
+				if n > 3 then px[4] = px[4] + d * k end
+			end
+			for c = 1, n do row[x * n + c] = pixel_value(px[c]) end
+		end
+		rows[y] = row
+	end
+	--vertical pass.
+	for y = 0, dst.h-1 do
+		local t = yw[y]
+		for x = 0, dst.w-1 do
+			for c = 1, n do
+				local v = 0
+				for j = 1, #t do
+					v = v + rows[ystart[y] + j - 1][x * n + c] * t[j]
+				end
+				px[c] = pixel_value(v)
+			end
+			dst_setpixel(x, y, unpack(px, 1, n))
+		end
+	end
+end
 
-			x = clamp(x, 0, maxx)
-			y = clamp(y, 0, maxy)
+local ffi = require'ffi'
+local native = bitmap.native
 
-			local dx = tx * x1 - x
-			local dy = ty * y1 - y
+if native.C then
+	ffi.cdef[[
+	int32_t bitmap_resize(int32_t format,
+		const uint8_t *src, int32_t src_stride, int32_t sw, int32_t sh,
+		uint8_t *dst, int32_t dst_stride, int32_t dw, int32_t dh,
+		int32_t filter);
+	]]
+end
 
-			local f1 = (1-dx)*(1-dy)
-         local f2 = dx*(1-dy)
-			local f3 = (1-dx)*dy
-			local f4 = dx*dy
+--walk bottom-up bitmaps backwards so that rows are always resampled
+--top-down like in Lua (the box filter is not symmetric).
+local function native_resize(filter, src, dst)
+	if not native.C or not native.enabled then return end
+	local format = native.formats[src.format]
+	if not format or src.format ~= dst.format then return end
+	local src_data, src_stride = native.top_down(src)
+	local dst_data, dst_stride = native.top_down(dst)
+	local ret = native.C.bitmap_resize(format,
+		src_data, src_stride, src.w, src.h,
+		dst_data, dst_stride, dst.w, dst.h,
+		filter.id)
+	assert(ret ~= -1, 'out of memory')
+	return ret == 1
+end
 
-			kernel(x, y, x1, y1, f1, f2, f3, f4)
+for name, filter in pairs(filters) do
+	bitmap.resize[name] = function(...)
+		local src, dst, channels, maxval = args(...)
+		if not native_resize(filter, src, dst) then
+			lua_resize(filter, src, dst, channels, maxval)
 		end
+		return dst
 	end
-
-	return dst
 end
 
+bitmap.resize.filters = filters
+
 
 if not ... then require'bitmap_demo' end
 
@@ -29,3 +29,394 @@ for src_format in glue.sortedpairs(bitmap.formats) do
 
 end
 
+
+--native vs Lua --------------------------------------------------------------
+
+local ffi = require'ffi'
+local native = bitmap.native
+
+local function random_bitmap(w, h, format, bottom_up)
+	local bmp = bitmap.new(w, h, format, bottom_up)
+	local p = ffi.cast('uint8_t*', bmp.data)
+	for i = 0, bmp.size-1 do
+		p[i] = math.random(0, 255)
+	end
+	return bmp
+end
+
+local function copy_bitmap(bmp)
+	local bmp2 = bitmap.new(bmp.w, bmp.h, bmp.format, bmp.bottom_up)
+	ffi.copy(bmp2.data, bmp.data, bmp.size)
+	return bmp2
+end
+
+--max. difference between the channel values of two bitmaps.
+local function maxdiff(b1, b2)
+	local getpixel1 = bitmap.pixel_interface(b1)
+	local getpixel2 = bitmap.pixel_interface(b2)
+	local d = 0
+	for y = 0, b1.h-1 do
+		for x = 0, b1.w-1 do
+			local t1 = {getpixel1(x, y)}
+			local t2 = {getpixel2(x, y)}
+			for i = 1, #t1 do
+				d = math.max(d, math.abs(t1[i] - t2[i]))
+			end
+		end
+	end
+	return d
+end
+
+--run f with the native code enabled and disabled.
+local function native_and_lua(f)
+	native.enabled = true
+	local r1 = f()
+	native.enabled = false
+	local r2 = f()
+	native.enabled = true
+	return r1, r2
+end
+
+--max. allowed difference between the native and Lua converters: 1 in 8bit
+--units, or one quantization step of the destination for rgb565 (whose
+--channels are seen as 0..255 by the pixel interface).
+local function convert_tolerance(dst)
+	if dst.format == 'rgb565' then return 255 / 31 + 1e-9 end
+	return bitmap.colortype(dst).max / 255
+end
+
+local function test_native_convert()
+	if not native.C then print'native bitmap library not found'; return end
+	math.randomseed(1)
+	for src_format in glue.sortedpairs(native.formats) do
+		for dst_format in bitmap.conversions(src_format) do
+			if native.formats[dst_format] and dst_format ~= src_format then
+				for _,bottom_up in ipairs{false, true} do
+					local src = random_bitmap(67, 13, src_format)
+					local d1, d2 = native_and_lua(function()
+						local dst = bitmap.new(67, 13, dst_format, bottom_up)
+						bitmap.paint(dst, src)
+						return dst
+					end)
+					local d = maxdiff(d1, d2)
+					assert(d <= convert_tolerance(d1), string.format(
+						'%s -> %s: native and Lua differ by %g', src_format, dst_format, d))
+				end
+			end
+		end
+	end
+	print'native convert ok'
+end
+
+--multiply the colors of a bitmap with its alpha, so that it contains valid
+--premultiplied pixels.
+local function premultiply(bmp)
+	local getpixel, setpixel = bitmap.pixel_interface(bmp, 'rgbaf')
+	for y = 0, bmp.h-1 do
+		for x = 0, bmp.w-1 do
+			local r, g, b, a = getpixel(x, y)
+			setpixel(x, y, r * a, g * a, b * a, a)
+		end
+	end
+	return bmp
+end
+
+local function test_native_blend()
+	if not native.C then print'native bitmap library not found'; return end
+	require'bitmap_blend'
+	math.randomseed(1)
+	for opname in glue.sortedpairs(bitmap.blend_op) do
+		for _,alpha in ipairs{'premultiplied', 'straight'} do
+			for _,src_format in ipairs{'rgba8', 'bgra8', 'argb8', 'rgba16', 'color'} do
+				for _,dst_format in ipairs{'rgba8', 'bgra8', 'rgba16'} do
+					for _,bottom_up in ipairs{false, true} do
+						local src, dst
+						if src_format == 'color' then
+							src = {.2, .7, .4, .6}
+						else
+							src = random_bitmap(37, 9, src_format)
+						end
+						dst = random_bitmap(37, 9, dst_format, bottom_up)
+						if alpha == 'premultiplied' then
+							if src.data then
+								premultiply(src)
+							else
+								src = {.12, .42, .24, .6}
+							end
+							premultiply(dst)
+						end
+						local d1, d2 = native_and_lua(function()
+							local dst = copy_bitmap(dst)
+							bitmap.blend(src, dst, opname, 0, 0, alpha)
+							return dst
+						end)
+						local d = maxdiff(d1, d2)
+						assert(d <= bitmap.colortype(d1).max / 255, string.format(
+							'%s %s %s -> %s: native and Lua differ by %g',
+							opname, alpha, src_format, dst_format, d))
+					end
+				end
+			end
+		end
+	end
+	print'native blend ok'
+end
+
+--blending at negative coordinates must clip the source, not the dest.
+--the Lua path can be off by 1 here too, since it goes through rgbaf.
+local function test_blend_clip()
+	require'bitmap_blend'
+	math.randomseed(1)
+	local x0, y0 = -3, -2
+	for _,src_bottom_up in ipairs{false, true} do
+		for _,dst_bottom_up in ipairs{false, true} do
+			local src = random_bitmap(11, 7, 'rgba8', src_bottom_up)
+			local dst = random_bitmap(13, 9, 'rgba8', dst_bottom_up)
+			local d1, d2 = native_and_lua(function()
+				local dst = copy_bitmap(dst)
+				bitmap.blend(src, dst, 'src', x0, y0)
+				return dst
+			end)
+			local src_getpixel = bitmap.pixel_interface(src)
+			local dst_getpixel = bitmap.pixel_interface(dst)
+			for _,d in ipairs{d1, d2} do
+				local getpixel = bitmap.pixel_interface(d)
+				for y = 0, d.h-1 do
+					for x = 0, d.w-1 do
+						local sx, sy = x - x0, y - y0
+						local inside = sx < src.w and sy < src.h
+						local r1, g1, b1, a1 = getpixel(x, y)
+						local r2, g2, b2, a2
+						if inside then
+							r2, g2, b2, a2 = src_getpixel(sx, sy)
+						else
+							r2, g2, b2, a2 = dst_getpixel(x, y)
+						end
+						local d = math.max(math.abs(r1 - r2), math.abs(g1 - g2),
+							math.abs(b1 - b2), math.abs(a1 - a2))
+						assert(d <= 1,
+							string.format('pixel %d,%d %s', x, y,
+								inside and 'not blended' or 'overwritten'))
+					end
+				end
+			end
+		end
+	end
+	print'blend clip ok'
+end
+
+--the Lua resampler quantizes the weights like the native one so the results
+--must be identical, except for downscales of more than 2x.
+local function test_native_resize()
+	if not native.C then print'native bitmap library not found'; return end
+	require'bitmap_resize'
+	math.randomseed(1)
+	local sizes = {
+		{37, 23, 71, 45}, --upscale
+		{5, 3, 64, 40},   --large upscale
+		{37, 23, 19, 12}, --downscale
+		{40, 30, 20, 15}, --exactly 2x
+		{37, 23, 50, 13}, --up and down
+		{37, 23, 37, 23}, --same size
+		{1, 1, 7, 5},
+	}
+	for filter in glue.sortedpairs(bitmap.resize.filters) do
+		for _,format in ipairs{'g8', 'ga8', 'rgb8', 'bgr8', 'rgba8', 'bgra8', 'argb8'} do
+			for _,t in ipairs(sizes) do
+				local sw, sh, dw, dh = unpack(t)
+				for _,bottom_up in ipairs{false, true} do
+					local src = random_bitmap(sw, sh, format)
+					local d1, d2 = native_and_lua(function()
+						local dst = bitmap.new(dw, dh, format, bottom_up)
+						return bitmap.resize[filter](src, dst)
+					end)
+					local d = maxdiff(d1, d2)
+					assert(d == 0, string.format(
+						'%s %s %dx%d -> %dx%d: native and Lua differ by %g',
+						filter, format, sw, sh, dw, dh, d))
+				end
+			end
+		end
+	end
+	print'native resize ok'
+end
+
+--a flat image must stay flat, including through the box pre-reduction of
+--the native resampler with blocks that don't divide the source.
+local function test_resize_flat()
+	require'bitmap_resize'
+	for filter in glue.sortedpairs(bitmap.resize.filters) do
+		for _,t in ipairs{{97, 61, 13, 7}, {100, 100, 10, 10}, {301, 7, 4, 3}} do
+			local sw, sh, dw, dh = unpack(t)
+			local src = bitmap.new(sw, sh, 'rgba8')
+			local _, setpixel = bitmap.pixel_interface(src)
+			for y = 0, sh-1 do
+				for x = 0, sw-1 do
+					setpixel(x, y, 13, 200, 255, 77)
+				end
+			end
+			local d1, d2 = native_and_lua(function()
+				return bitmap.resize[filter](src, dw, dh)
+			end)
+			for _,dst in ipairs{d1, d2} do
+				local getpixel = bitmap.pixel_interface(dst)
+				for y = 0, dh-1 do
+					for x = 0, dw-1 do
+						local r, g, b, a = getpixel(x, y)
+						assert(r == 13 and g == 200 and b == 255 and a == 77, string.format(
+							'%s %dx%d -> %dx%d: pixel %d,%d not flat', filter, sw, sh, dw, dh, x, y))
+					end
+				end
+			end
+		end
+	end
+	print'resize flat ok'
+end
+
+test_native_convert()
+test_native_blend()
+test_blend_clip()
+--the fs and ordered dithering code from before the native dithering was
+--added, to check that the results didn't change.
+local prev_dither = {}
+
+function prev_dither.fs(src, rbits, gbits, bbits, abits)
+	local colortype = bitmap.colortype(src)
+	local maxbits = colortype.bpc
+	local maxval  = colortype.max
+	local getpixel, setpixel = bitmap.pixel_interface(src)
+	local rmask = 2^(maxbits-rbits)-1
+	local gmask = 2^(maxbits-gbits)-1
+	local bmask = 2^(maxbits-bbits)-1
+	local amask = 2^(maxbits-abits)-1
+	local function dither(x, r1, g1, b1, a1, r0, g0, b0, a0)
+		return
+			math.min(r0 + bit.rshift(x * r1, 4), maxval),
+			math.min(g0 + bit.rshift(x * g1, 4), maxval),
+			math.min(b0 + bit.rshift(x * b1, 4), maxval),
+			math.min(a0 + bit.rshift(x * a1, 4), maxval)
+	end
+	for y = 0, src.h-1 do
+		for x = 0, src.w-1 do
+			local r0, g0, b0, a0 = getpixel(x, y)
+			local r1 = bit.band(r0, rmask)
+			local g1 = bit.band(g0, gmask)
+			local b1 = bit.band(b0, bmask)
+			local a1 = bit.band(a0, amask)
+			setpixel(x, y,
+				bit.band(r0, maxval-rmask),
+				bit.band(g0, maxval-gmask),
+				bit.band(b0, maxval-bmask),
+				bit.band(a0, maxval-amask))
+			if x < src.w-1 then
+				setpixel(x+1, y, dither(7, r1, g1, b1, a1, getpixel(x+1, y)))
+			end
+			if y < src.h-1 and x > 0 then
+				setpixel(x-1, y+1, dither(3, r1, g1, b1, a1, getpixel(x-1, y+1)))
+			end
+			if y < src.h-1 then
+				setpixel(x, y+1, dither(5, r1, g1, b1, a1, getpixel(x, y+1)))
+			end
+			if y < src.h-1 and x < src.w-1 then
+				setpixel(x+1, y+1, dither(1, r1, g1, b1, a1, getpixel(x+1, y+1)))
+			end
+		end
+	end
+end
+
+local tmap = {
+	[2] = {1, 3, 4, 2},
+	[3] = {3, 7, 4, 6, 1, 9, 2, 8, 5},
+	[4] = {1, 9, 3, 11, 13, 5, 15, 7, 4, 12, 2, 10, 16, 8, 14, 6},
+	[8] = {
+		 1, 49, 13, 61,  4, 52, 16, 64, 33, 17, 45, 29, 36, 20, 48, 32,
+		 9, 57,  5, 53, 12, 60,  8, 56, 41, 25, 37, 21, 44, 28, 40, 24,
+		 3, 51, 15, 63,  2, 50, 14, 62, 35, 19, 47, 31, 34, 18, 46, 30,
+		11, 59,  7, 55, 10, 58,  6, 54, 43, 27, 39, 23, 42, 26, 38, 22},
+}
+
+function prev_dither.ordered(src, mapsize)
+	local maxval = bitmap.colortype(src).max
+	local getpixel, setpixel = bitmap.pixel_interface(src)
+	local map = tmap[mapsize]
+	local function dither(t, ...)
+		local px = {...}
+		for i = 1, #px do
+			px[i] = math.min(px[i] + t, maxval)
+		end
+		return unpack(px)
+	end
+	for y = 0, src.h-1 do
+		for x = 0, src.w-1 do
+			local t = map[bit.band(y, mapsize-1) * mapsize + bit.band(x, mapsize-1) + 1]
+			setpixel(x, y, dither(t, getpixel(x, y)))
+		end
+	end
+end
+
+--dither a copy of src with the native code enabled and disabled and check
+--that the results are identical, and identical to the previous code if given.
+local function check_dither(src, prev, f, ...)
+	local args = {...}
+	local d1, d2 = native_and_lua(function()
+		local dst = copy_bitmap(src)
+		f(dst, unpack(args, 1, table.maxn(args)))
+		return dst
+	end)
+	local what = src.format..(src.bottom_up and ' bottom-up' or '')
+	local d = maxdiff(d1, d2)
+	assert(d == 0, string.format('%s: native and Lua differ by %g', what, d))
+	if prev then
+		local d3 = copy_bitmap(src)
+		prev(d3, unpack(args, 1, table.maxn(args)))
+		local d = maxdiff(d1, d3)
+		assert(d == 0, string.format('%s: results changed by %g', what, d))
+	end
+end
+
+local function test_native_dither()
+	if not native.C then print'native bitmap library not found'; return end
+	require'bitmap_dither'
+	math.randomseed(1)
+	local all = {'g8', 'ga8', 'rgb8', 'bgr8', 'rgba8', 'bgra8', 'argb8'}
+	local bits = {{5, 6, 5, 0}, {1, 2, 3, 4}, {8, 8, 8, 8}, {4, 4, 4, 4}}
+	--bottom-up bitmaps must be dithered top to bottom too.
+	for _,bottom_up in ipairs{false, true} do
+		for _,format in ipairs(all) do
+			local n = #bitmap.colortype(bitmap.new(1, 1, format)).channels
+			for _,bits in ipairs(bits) do
+				local src = random_bitmap(67, 13, format, bottom_up)
+				local r, g, b, a = unpack(bits)
+				--the previous fs code only worked with 4 channels.
+				check_dither(src, n == 4 and prev_dither.fs, bitmap.dither.fs, r, g, b, a)
+				for _,method in ipairs{'fs', 'atkinson', 'sierra_lite'} do
+					check_dither(src, nil, bitmap.dither[method], r, g, b, a, true)
+					check_dither(src, nil, bitmap.dither[method], r, g, b, a)
+				end
+				--the native code uses a band of at least 16 rows per thread.
+				local src = random_bitmap(37, 147, format, bottom_up)
+				for _,mapsize in ipairs{2, 3, 4, 8} do
+					for _,threads in ipairs{1, 3, 8} do
+						check_dither(src, nil, bitmap.dither.ordered, mapsize, r, g, b, a, threads)
+					end
+				end
+			end
+			--the Lua code can't skip quantizing without 2 or 4 channels.
+			if n == 2 or n == 4 then
+				local src = random_bitmap(37, 147, format, bottom_up)
+				for _,mapsize in ipairs{2, 3, 4, 8} do
+					check_dither(src, prev_dither.ordered, bitmap.dither.ordered, mapsize)
+					for _,threads in ipairs{3, 8} do
+						check_dither(src, prev_dither.ordered, bitmap.dither.ordered,
+							mapsize, nil, nil, nil, nil, threads)
+					end
+				end
+			end
+		end
+	end
+	print'native dither ok'
+end
+
+test_native_resize()
+test_resize_flat()
+test_native_dither()
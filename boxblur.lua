@@ -27,6 +27,12 @@ void boxblur_8888(u8 *src, u8 *dst, i32 width, i32 height,
 	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
 	void* blurx, void* sumx);
 
+i32 boxblur_avx2(i32 enable);
+
+i32 boxblur_mt(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 bpp, i32 radius, i32 passes,
+	i32 threads);
+
 void boxblur_extend(u8 *src, i32 width, i32 height,
 	i32 src_stride, i32 bpp, i32 radius);
 
@@ -56,7 +62,7 @@ function boxblur.new(...)
 	local format_string = assert(format or img.format, 'format expected')
 	local format = bitmap.format(format_string)
 	local blur_func = assert(blur_func[format.bpp], 'unsupoorted format')
-	radius = round(clamp(radius, 0, 255))
+	radius = round(clamp(radius, 0, 128))
 
 	local self = {__index = blur}
 	setmetatable(self, self)
@@ -67,6 +73,11 @@ function boxblur.new(...)
 	local h1 = 2 * radius
 	local w2 = radius + 128 / format.bpp
 	local h2 = radius
+	--the C code works in memory order, where the top of a bottom-up bitmap
+	--is its bottom.
+	if bottom_up then
+		h1, h2 = h2, h1
+	end
 
 	local src_data = bitmap.new(
 		w + w1 + w2,
@@ -101,10 +112,9 @@ function boxblur.new(...)
 	return self
 end
 
+--NOTE: for multiple passes, src is used as scratch and dst must have the
+--same paddings as src. blurx and sumx are cleared by the C code as needed.
 function blur:_blur(src, dst)
-	bitmap.clear(self._blurx.parent)
-	--clear sumx because blur needs to read some 0es from it.
-	ffi.fill(self._sumx, ffi.sizeof(self._sumx))
 	self._blur_func(
 		src.data,
 		dst.data,
@@ -152,34 +162,38 @@ function blur:blur(radius, passes)
 	elseif radius == 0 or passes == 0 then --no blur
 		if self.radius and self.radius ~= 0 then --src blurred, repaint
 			self._valid = false
-			self:_repaint()
 		end
+		self:_repaint()
 		self.radius = 0
 		self.passes = 0
 		bitmap.paint(self.dst, self.src)
-	elseif passes == 1 then
+	else
 		if self.passes and self.passes > 1 then --src blurred, repaint
 			self._valid = false
 		end
 		self:_repaint()
 		self.radius = radius
-		self.passes = 1
+		self.passes = passes
 		self:_extend(self.src)
 		self:_blur(self.src, self.dst)
-	else
-		self._valid = false
-		self:_repaint()
-		self.radius = radius
-		self.passes = passes
-		local src, dst = self.dst, self.src
-		for i=1,passes do
-			src, dst = dst, src
-			self:_extend(src)
-			self:_blur(src, dst)
-		end
-		self.src, self.dst = src, dst
 	end
 	return self.dst
 end
 
+--blur a bitmap into another bitmap of the same format and size (or a new
+--one) using multiple threads. no paddings or pre-extending are needed.
+function boxblur.blur(src, dst, radius, passes, threads)
+	local format = bitmap.format(src.format)
+	assert(blur_func[format.bpp], 'unsupported format')
+	dst = dst or bitmap.new(src.w, src.h, src.format, src.bottom_up)
+	assert(dst.w == src.w and dst.h == src.h and dst.format == src.format,
+		'dst must have the same size and format as src')
+	assert(dst.bottom_up == src.bottom_up, 'dst must have the same orientation')
+	radius = round(clamp(radius, 0, 128))
+	assert(C.boxblur_mt(src.data, dst.data, src.w, src.h,
+		src.stride, dst.stride, format.bpp, radius, passes or 1,
+		threads or 0) == 1, 'out of memory')
+	return dst
+end
+
 return boxblur
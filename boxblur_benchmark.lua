@@ -0,0 +1,97 @@
+--benchmark for boxblur: ms per blur for radii 1..64 at image sizes up to 8K,
+--with the SSE2 and the AVX2 kernels, and scaling of the multi-threaded blur.
+--usage: luajit boxblur_benchmark.lua [passes] [g8 | bgra8]
+--       luajit boxblur_benchmark.lua threads [max_threads]
+local ffi = require'ffi'
+local time = require'time'
+local bitmap = require'bitmap'
+local boxblur = require'boxblur'
+
+if ... == 'boxblur_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+--ms per 3-pass blur of an 8K image with 1 to max_threads threads.
+local function bench_threads(max_threads)
+	for _,format in ipairs{'g8', 'bgra8'} do
+		local src = bitmap.new(7680, 4320, format)
+		local p = ffi.cast('uint8_t*', src.data)
+		for i = 0, src.size-1 do p[i] = i * 7 % 251 end
+		local dst = bitmap.new(src.w, src.h, format)
+		for _,radius in ipairs{4, 32} do
+			local t1
+			local threads = 1
+			while threads <= max_threads do
+				local n = 0
+				local t0 = time.clock()
+				local t
+				repeat
+					boxblur.blur(src, dst, radius, 3, threads)
+					n = n + 1
+					t = time.clock()
+				until n >= 3 and t - t0 >= .5
+				local dt = (t - t0) / n * 1000
+				t1 = t1 or dt
+				print(string.format('%-5s 8K r=%-2d 3 passes %3d threads: %8.2fms  %5.2fx',
+					format, radius, threads, dt, t1 / dt))
+				threads = threads * 2
+			end
+		end
+	end
+end
+
+if ... == 'threads' then
+	local ncpu = tonumber(io.popen'nproc':read'*l') or 1
+	bench_threads(tonumber((select(2, ...))) or ncpu)
+	return
+end
+
+local passes = tonumber((...)) or 3
+local formats = select(2, ...) and {(select(2, ...))} or {'g8', 'bgra8'}
+
+local sizes = {
+	{'HD',   1280,  720},
+	{'FHD',  1920, 1080},
+	{'4K',   3840, 2160},
+	{'8K',   7680, 4320},
+}
+local radii = {1, 2, 4, 8, 16, 32, 64}
+
+local function bench(blur, radius)
+	local n = 0
+	local t0 = time.clock()
+	local t1
+	repeat --at least 3 runs and at least 1/4s.
+		blur:blur(radius, passes)
+		blur:invalidate()
+		n = n + 1
+		t1 = time.clock()
+	until n >= 3 and t1 - t0 >= .25
+	return (t1 - t0) / n * 1000
+end
+
+local has_avx2 = boxblur.C.boxblur_avx2(1) == 1
+
+for _,format in ipairs(formats) do
+	for _,size in ipairs(sizes) do
+		local name, w, h = unpack(size)
+		local img = bitmap.new(w, h, format)
+		local p = ffi.cast('uint8_t*', img.data)
+		for i = 0, img.size-1 do p[i] = i * 7 % 251 end
+		local blur = boxblur.new(img, 64, passes)
+		for _,radius in ipairs(radii) do
+			boxblur.C.boxblur_avx2(0)
+			local sse2 = bench(blur, radius)
+			local avx2
+			if has_avx2 then
+				boxblur.C.boxblur_avx2(1)
+				avx2 = bench(blur, radius)
+			end
+			print(string.format('%-5s %-3s %5dx%-4d r=%-2d %d pass(es): SSE2 %8.2fms  AVX2 %s',
+				format, name, w, h, radius, passes, sse2,
+				avx2 and string.format('%8.2fms', avx2) or 'n/a'))
+		end
+		blur = nil
+		collectgarbage()
+	end
+end
@@ -0,0 +1,151 @@
+local boxblur = require'boxblur'
+local bitmap = require'bitmap'
+local ffi = require'ffi'
+
+local floor, min, max = math.floor, math.min, math.max
+
+local function random_bitmap(w, h, format, bottom_up)
+	local bmp = bitmap.new(w, h, format, bottom_up)
+	local p = ffi.cast('uint8_t*', bmp.data)
+	for i = 0, bmp.size-1 do
+		p[i] = math.random(0, 255)
+	end
+	return bmp
+end
+
+--bitmap rows in memory order as a flat 0-based array of samples.
+local function samples(bmp)
+	local n = bmp.w * bitmap.format(bmp.format).bpp / 8
+	local p = ffi.cast('uint8_t*', bmp.data)
+	local t = {n = n, h = bmp.h}
+	for y = 0, bmp.h-1 do
+		for i = 0, n-1 do
+			t[y * n + i] = p[y * bmp.stride + i]
+		end
+	end
+	return t
+end
+
+--plain Lua box blur with clamped edges, done like the C code: the x-blurred
+--samples are truncated before the y pass, and both divide by multiplying
+--with a 16bit reciprocal.
+local function ref_pass(t, w, h, ch, r)
+	local f = floor(65536 / (2 * r + 1))
+	local n = w * ch
+	local xt, out = {}, {n = n, h = h}
+	for y = 0, h-1 do
+		for x = 0, w-1 do
+			for c = 0, ch-1 do
+				local s = 0
+				for i = -r, r do
+					s = s + t[y * n + min(max(x + i, 0), w-1) * ch + c]
+				end
+				xt[y * n + x * ch + c] = floor(s * f / 65536)
+			end
+		end
+	end
+	for y = 0, h-1 do
+		for i = 0, n-1 do
+			local s = 0
+			for j = -r, r do
+				s = s + xt[min(max(y + j, 0), h-1) * n + i]
+			end
+			out[y * n + i] = floor(s * f / 65536)
+		end
+	end
+	return out
+end
+
+local function ref_blur(bmp, r, passes)
+	local ch = bitmap.format(bmp.format).bpp / 8
+	local t = samples(bmp)
+	if r == 0 then return t end
+	for i = 1, passes do
+		t = ref_pass(t, bmp.w, bmp.h, ch, r)
+	end
+	return t
+end
+
+local function check(t, bmp, what)
+	local t2 = samples(bmp)
+	for i = 0, t.n * t.h - 1 do
+		if t[i] ~= t2[i] then
+			error(string.format('%s: sample %d: %d, expected %d', what, i, t2[i], t[i]), 2)
+		end
+	end
+end
+
+--the multi-pass loop that boxblur.lua did before the C code did the passes.
+local function old_blur(img, radius, passes)
+	local b = boxblur.new(img, radius, 1)
+	b:_repaint()
+	b.radius = radius
+	b.passes = 1
+	local src, dst = b.dst, b.src
+	for i = 1, passes do
+		src, dst = dst, src
+		b:_extend(src)
+		b:_blur(src, dst)
+	end
+	return dst
+end
+
+local formats = {'g8', 'bgra8'}
+local sizes = {{1, 1}, {7, 3}, {37, 23}, {21, 64}}
+local radii = {0, 1, 3, 128}
+
+--blur:blur() with the AVX2 and SSE2 vertical pass, and the old Lua loop of
+--single passes, against the reference.
+local function test_blur()
+	local avx2 = boxblur.C.boxblur_avx2(-1)
+	for _,format in ipairs(formats) do
+		for _,sz in ipairs(sizes) do
+			local img = random_bitmap(sz[1], sz[2], format)
+			for _,r in ipairs(radii) do
+				for passes = 1, 3 do
+					local what = string.format('%s %dx%d r=%d passes=%d',
+						format, sz[1], sz[2], r, passes)
+					local t = ref_blur(img, r, passes)
+					for _,enable in ipairs{1, 0} do
+						boxblur.C.boxblur_avx2(enable)
+						local b = boxblur.new(img, r, passes)
+						check(t, b:blur(), what..' avx2='..boxblur.C.boxblur_avx2(-1))
+					end
+					if r > 0 then
+						check(t, old_blur(img, r, passes), what..' old loop')
+					end
+				end
+			end
+		end
+	end
+	boxblur.C.boxblur_avx2(avx2)
+	print'blur ok'
+end
+
+--boxblur.blur() on 1..N threads against blur:blur() and the reference.
+local function test_blur_mt()
+	for _,format in ipairs(formats) do
+		for _,sz in ipairs{{7, 3}, {37, 23}, {53, 211}} do
+			for _,bottom_up in ipairs{false, true} do
+				local img = random_bitmap(sz[1], sz[2], format, bottom_up)
+				for _,r in ipairs(radii) do
+					for passes = 1, 3 do
+						local what = string.format('%s %dx%d%s r=%d passes=%d',
+							format, sz[1], sz[2], bottom_up and ' bottom-up' or '', r, passes)
+						local t = ref_blur(img, r, passes)
+						check(t, boxblur.new(img, r, passes):blur(), what)
+						for _,threads in ipairs{1, 2, 3, 5, 8} do
+							local dst = boxblur.blur(img, nil, r, passes, threads)
+							check(t, dst, what..' threads='..threads)
+						end
+					end
+				end
+			end
+		end
+	end
+	print'blur_mt ok'
+end
+
+math.randomseed(1)
+test_blur()
+test_blur_mt()
@@ -0,0 +1,137 @@
+--benchmark for cjson: MB/s of decoding generated JSON documents shaped
+--like the usual parser benchmark corpora: twitter.json (objects with many
+--short strings, some with escapes and non-ASCII text, pretty-printed),
+--canada.json (deeply nested arrays of floating point coordinates) and
+--citm_catalog.json (mostly integers and short keys). Real corpus files
+--can be given on the command line instead.
+--usage: luajit cjson_benchmark.lua [size_MB | file1.json ...]
+local cjson = require'cjson'
+local time = require'time'
+local glue = require'glue'
+
+if ... == 'cjson_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local size = (tonumber((...)) or 50) * 1024^2
+
+math.randomseed(1234)
+local random = math.random
+
+local words = {'the', 'quick', 'brown', 'fox', 'jumps', 'over', 'lazy', 'dog',
+	'lorem', 'ipsum', '東京', 'café', 'naïve', '😀', 'http://t.co/x'}
+local function text(n)
+	local t = {}
+	for i = 1, n do
+		t[i] = words[random(#words)]
+	end
+	return table.concat(t, ' ')
+end
+
+local function pad(depth)
+	return '\n'..('  '):rep(depth)
+end
+
+--pretty-printed objects with string-heavy fields, like twitter.json.
+local function twitter(size)
+	local t = {'{"statuses": ['}
+	local n = 0
+	local i = 0
+	while n < size do
+		i = i + 1
+		local s = table.concat({
+			pad(1)..'{',
+			pad(2)..'"created_at": "Sun Aug 31 00:29:15 +0000 2014",',
+			pad(2)..'"id": '..(505874924095815700 + i)..',',
+			pad(2)..'"id_str": "'..(505874924095815700 + i)..'",',
+			pad(2)..'"text": '..cjson.encode(text(random(5, 25)))..',',
+			pad(2)..'"source": "<a href=\\"https://mobile.twitter.com\\" rel=\\"nofollow\\">Mobile Web<\\/a>",',
+			pad(2)..'"truncated": false,',
+			pad(2)..'"in_reply_to_status_id": null,',
+			pad(2)..'"user": {',
+			pad(3)..'"id": '..random(1, 2^31)..',',
+			pad(3)..'"name": "\\u3072\\u3081\\u3044\\u3059\\u3059",',
+			pad(3)..'"screen_name": "user_'..i..'",',
+			pad(3)..'"description": '..cjson.encode(text(random(0, 15)))..',',
+			pad(3)..'"followers_count": '..random(0, 100000)..',',
+			pad(3)..'"verified": '..(random() < 0.1 and 'true' or 'false'),
+			pad(2)..'},',
+			pad(2)..'"retweet_count": '..random(0, 1000)..',',
+			pad(2)..'"lang": "ja"',
+			pad(1)..'},',
+		})
+		t[#t+1] = s
+		n = n + #s
+	end
+	t[#t] = t[#t]:sub(1, -2) --remove the last comma
+	t[#t+1] = '\n]}'
+	return table.concat(t)
+end
+
+--compact nested arrays of coordinates, like canada.json.
+local function canada(size)
+	local t = {'{"type":"FeatureCollection","features":[{"type":"Feature",'
+		..'"geometry":{"type":"Polygon","coordinates":['}
+	local n = 0
+	while n < size do
+		local ring = {}
+		for i = 1, 1000 do
+			ring[i] = string.format('[%.15g,%.15g]',
+				-65.613616999999977 + random() * 10,
+				43.420273000000009 + random() * 10)
+		end
+		local s = '['..table.concat(ring, ',')..'],'
+		t[#t+1] = s
+		n = n + #s
+	end
+	t[#t] = t[#t]:sub(1, -2)
+	t[#t+1] = ']}}]}'
+	return table.concat(t)
+end
+
+--indented objects of integers and short keys, like citm_catalog.json.
+local function citm(size)
+	local t = {'{"events": {'}
+	local n = 0
+	local i = 0
+	while n < size do
+		i = i + 1
+		local s = string.format('%s"%d": {%s"id": %d,%s"logo": null,'
+			..'%s"name": "Event %d",%s"subTopicIds": [%d, %d, %d],'
+			..'%s"topicIds": [%d, %d]%s},',
+			pad(1), 138586341 + i, pad(2), 138586341 + i, pad(2), pad(2), i,
+			pad(2), random(1, 1e9), random(1, 1e9), random(1, 1e9),
+			pad(2), random(1, 1e5), random(1, 1e5), pad(1))
+		t[#t+1] = s
+		n = n + #s
+	end
+	t[#t] = t[#t]:sub(1, -2)
+	t[#t+1] = '\n}}'
+	return table.concat(t)
+end
+
+local function bench(name, s)
+	cjson.decode(s) --warm up
+	collectgarbage()
+	local reps = 0
+	local t0 = time.clock()
+	local dt
+	repeat
+		cjson.decode(s)
+		reps = reps + 1
+		dt = time.clock() - t0
+	until dt > 1
+	print(string.format('%-24s %6.1f MB  %7.1f MB/s',
+		name, #s / 1024^2, #s * reps / 1024^2 / dt))
+end
+
+if tonumber((...)) or not ... then
+	bench('twitter-like', twitter(size))
+	bench('canada-like',  canada(size))
+	bench('citm-like',    citm(size))
+else
+	for i = 1, select('#', ...) do
+		local file = select(i, ...)
+		bench(file:match'[^/\\]*$', assert(glue.readfile(file)))
+	end
+end
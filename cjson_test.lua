@@ -0,0 +1,127 @@
+local cjson = require'cjson'
+local ffi = require'ffi'
+
+ffi.cdef'double strtod(const char *s, char **endptr);'
+
+--numbers must decode to the same double as strtod() gives, bit for bit.
+local u = ffi.new'union { double d; uint64_t u; }'
+local function bits(d)
+	u.d = d
+	return u.u
+end
+
+local function check_number(s)
+	local d = cjson.decode('['..s..']')[1]
+	local e = ffi.C.strtod(s, nil)
+	assert(bits(d) == bits(e), string.format('%s: %.17g ~= %.17g', s, d, e))
+end
+
+local hard_numbers = {
+	--subnormals and the normal/subnormal boundary.
+	'4.9406564584124654e-324', '5e-324', '1e-323', '1e-320', '3e-310',
+	'2.4703282292062327e-324', '2.4703282292062328e-324', --halfway to 5e-324
+	'2.2250738585072009e-308', '2.2250738585072011e-308', '2.2250738585072014e-308',
+	'2.225073858507201136057409796709131975934819546351645648e-308',
+	'-4.9406564584124654e-324', '-2.2250738585072011e-308',
+	--19 and 20 significant digits and 2^63, 2^64 around.
+	'1234567890123456789', '12345678901234567890', '0.1234567890123456789',
+	'9223372036854775807', '9223372036854775808', '9223372036854775809',
+	'18446744073709551615', '18446744073709551616', '18446744073709551617',
+	'1.0000000000000000001', '9999999999999999999', '99999999999999999999',
+	'7.2057594037927933e16', '1.7976931348623157e308',
+	--halfway between two doubles: round to even, and a digit after the tie
+	--decides, no matter how far it is.
+	'9007199254740993', '9007199254740995', '9007199254740997',
+	'9007199254740993.000000000000000000001', '9007199254740992.999999999999999999999',
+	'1.00000000000000011102230246251565404236316680908203125',
+	'1.00000000000000011102230246251565404236316680908203124',
+	'1.00000000000000011102230246251565404236316680908203126',
+	'1.00000000000000033306690738754696212708950042724609375',
+	'8.988465674311580536566680e307',
+	'2.0000000000000004440892098500626161694526672363281250',
+	--huge exponents: overflow to inf, underflow to 0, and big exponents
+	--compensated by many digits.
+	'1e308', '1e309', '-1e309', '1.7976931348623158e308', '1.7976931348623159e308',
+	'1e400', '1e-400', '1e-324', '0e999999999', '1e-999999999', '1e999999999',
+	'0.0000000000000000000000000000000000000000000001e350',
+	'1000000000000000000000000000000000000000000000000e-350',
+	'123456789012345678901234567890e-330', '-0', '-0.0', '0e-5',
+}
+
+local function test_numbers()
+	for _,s in ipairs(hard_numbers) do
+		check_number(s)
+	end
+	math.randomseed(1)
+	local random = math.random
+	for i = 1, 100000 do
+		--random doubles printed with 17 digits, which round-trip, and with
+		--fewer digits, which fall between doubles.
+		u.u = random(0, 2^31-1) * 2^32 + random(0, 2^32-1)
+		local d = u.d
+		if d == d and d ~= 1/0 and d ~= -1/0 then
+			check_number(string.format('%.17g', d))
+			check_number(string.format('%.'..random(1, 16)..'e', d))
+		end
+		--random digit strings with 1 to 25 digits and random exponents.
+		local t = {}
+		for j = 1, random(1, 25) do
+			t[j] = random(0, 9)
+		end
+		local digits = table.concat(t):gsub('^0+(%d)', '%1')
+		local k = random(0, #digits)
+		local s = k > 0 and k < #digits and digits:sub(1, k)..'.'..digits:sub(k+1) or digits
+		check_number(s..'e'..random(-340, 320))
+	end
+	print'numbers ok'
+end
+
+--strings with escapes at every position up to past two SIMD widths (32
+--bytes) and ending at every position relative to the end of the input.
+local escapes = {
+	{'\\n', '\n'}, {'\\"', '"'}, {'\\\\', '\\'}, {'\\/', '/'}, {'\\t', '\t'},
+	{'\\u00e9', 'é'}, {'\\u20AC', '€'}, {'\\ud83d\\ude00', '😀'},
+}
+
+local function test_strings()
+	for len = 0, 70 do
+		local plain = ('abcdefghijklmnopqrstuvwxyz0123456789'):rep(2):sub(1, len)
+		assert(cjson.decode('"'..plain..'"') == plain)
+		assert(cjson.decode('["'..plain..'"]')[1] == plain)
+		--non-ASCII bytes are copied as they are.
+		local utf8 = ('é'):rep(len)
+		assert(cjson.decode('"'..utf8..'"') == utf8)
+		for pos = 0, len do
+			for _,e in ipairs(escapes) do
+				local json = plain:sub(1, pos)..e[1]..plain:sub(pos + 1)
+				local str  = plain:sub(1, pos)..e[2]..plain:sub(pos + 1)
+				assert(cjson.decode('"'..json..'"') == str, json)
+				assert(cjson.decode('["'..json..'", 1]')[1] == str, json)
+			end
+			--control characters are copied as they are (as the scalar scanner
+			--always did), while a zero byte or the end of input is an error.
+			local json = plain:sub(1, pos)..'\1\31'..plain:sub(pos + 1)
+			assert(cjson.decode('"'..json..'"') == json)
+			local json = plain:sub(1, pos)..'\0'..plain:sub(pos + 1)
+			assert(not pcall(cjson.decode, '"'..json..'"'))
+			assert(not pcall(cjson.decode, '"'..plain:sub(1, pos)))
+		end
+	end
+	print'strings ok'
+end
+
+--whitespace runs of all lengths between tokens.
+local function test_whitespace()
+	for len = 0, 70 do
+		local ws = (' \t\r\n'):rep(18):sub(1, len)
+		local t = cjson.decode(ws..'['..ws..'1'..ws..','..ws..'"a"'..ws..']'..ws)
+		assert(t[1] == 1 and t[2] == 'a')
+		local t = cjson.decode('{'..ws..'"k"'..ws..':'..ws..'true'..ws..'}')
+		assert(t.k == true)
+	end
+	print'whitespace ok'
+end
+
+test_numbers()
+test_strings()
+test_whitespace()
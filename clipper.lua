@@ -35,6 +35,14 @@ typedef enum {
 typedef struct clipper_Polygon clipper_polygon;
 typedef struct clipper_Polygons clipper_polygons;
 typedef struct clipper_Clipper clipper;
+typedef struct clipper_flat {
+	int64_t* xy;
+	int*     rings;
+	int*     regions;
+	int      npoints;
+	int      nrings;
+	int      nregions;
+} clipper_flat;
 
 clipper_polygon*  clipper_polygon_create(int);
 void              clipper_polygon_free        (clipper_polygon*);
@@ -66,9 +74,25 @@ void              clipper_get_bounds   (clipper*, clipper_rect*);
 clipper_polygons* clipper_execute      (clipper*, clipper_ClipType,
 																	clipper_PolyFillType,
 																	clipper_PolyFillType);
+int               clipper_execute_into (clipper*, clipper_ClipType,
+																	clipper_PolyFillType,
+																	clipper_PolyFillType,
+																	clipper_polygons*);
 void              clipper_clear        (clipper*);
 int               clipper_get_reverse_solution (clipper*);
 void              clipper_set_reverse_solution (clipper*, int);
+int               clipper_get_reuse_memory (clipper*);
+void              clipper_set_reuse_memory (clipper*, int);
+
+void              clipper_flat_free     (clipper_flat*);
+clipper_polygons* clipper_flat_polygons (const clipper_flat*, int region);
+clipper_flat*     clipper_polygons_flat (clipper_polygons*);
+clipper_flat*     clipper_clip_batch    (const clipper_flat*, const clipper_flat*,
+																	clipper_ClipType,
+																	clipper_PolyFillType,
+																	clipper_PolyFillType, int threads);
+clipper_flat*     clipper_clip_rects    (const clipper_flat*, const int64_t*, int, int threads);
+clipper_flat*     clipper_offset_batch  (const clipper_flat*, double, clipper_JoinType, double, int threads);
 ]]
 
 local fill_types = {
@@ -186,10 +210,93 @@ function polygons:offset(delta, join_type, limit)
 	return ffi.gc(out, C.clipper_polygons_free)
 end
 
+function polygons:flat()
+	return ffi.gc(assert(C.clipper_polygons_flat(self), 'out of memory'), C.clipper_flat_free)
+end
+
+local flat = {} --flat polygon set methods
+
+local flat_ptr_type = ffi.typeof'clipper_flat*'
+local anchors = setmetatable({}, {__mode = 'k'}) --keep input arrays alive
+
+local function array(ctype, t, n)
+	if type(t) ~= 'table' then return t end
+	return ffi.new(ctype, n or #t, t)
+end
+
+--rings and regions are 0-based offsets with an extra end offset at the end.
+function flat.new(xy, rings, nrings, regions, nregions)
+	nrings = nrings or #rings - 1
+	rings = array('int[?]', rings, nrings + 1)
+	nregions = regions and (nregions or #regions - 1) or 1
+	regions = regions and array('int[?]', regions, nregions + 1)
+	xy = array('int64_t[?]', xy, rings[nrings] * 2)
+	local self = ffi.new('clipper_flat', xy, rings, regions, rings[nrings], nrings, nregions)
+	anchors[self] = {xy, rings, regions}
+	return self
+end
+
+function flat:free()
+	assert(ffi.istype(flat_ptr_type, self), 'not a clipper result')
+	C.clipper_flat_free(self)
+	ffi.gc(self, nil)
+end
+
+function flat:region_count()
+	return self.regions ~= nil and self.nregions or 1
+end
+
+--first and last ring index of a region, 1-based and inclusive.
+function flat:region(i)
+	if self.regions == nil then return 1, self.nrings end
+	return self.regions[i-1] + 1, self.regions[i]
+end
+
+--pointer to the first x coordinate and number of points of a ring.
+function flat:ring(i)
+	local j = self.rings[i-1]
+	return self.xy + 2 * j, self.rings[i] - j
+end
+
+function flat:polygons(region)
+	local out = C.clipper_flat_polygons(self, region and region-1 or -1)
+	return ffi.gc(assert(out, 'out of memory'), C.clipper_polygons_free)
+end
+
+local function to_flat(poly)
+	if ffi.istype('clipper_polygons*', poly) then return poly:flat() end
+	return poly
+end
+
+local function flat_result(out)
+	return ffi.gc(assert(out, 'clipping failed'), C.clipper_flat_free)
+end
+
+local function clip_batch(subj, clip, clip_type, subj_fill_type, clip_fill_type, threads)
+	return flat_result(C.clipper_clip_batch(to_flat(subj), to_flat(clip),
+		clip_types[clip_type],
+		fill_types[subj_fill_type or 'even_odd'],
+		fill_types[clip_fill_type or 'even_odd'],
+		threads or 0))
+end
+
+local function clip_rects(subj, rects, nrects, threads)
+	nrects = nrects or #rects / 4
+	rects = array('int64_t[?]', rects, nrects * 4)
+	return flat_result(C.clipper_clip_rects(to_flat(subj), rects, nrects, threads or 0))
+end
+
+local function offset_batch(subj, delta, join_type, limit, threads)
+	return flat_result(C.clipper_offset_batch(to_flat(subj), delta,
+		join_types[join_type or 'square'], limit or 0, threads or 0))
+end
+
 local clipper = {} --clipper methods
 
-function clipper.new()
-	return ffi.gc(C.clipper_create(), C.clipper_free)
+function clipper.new(reuse_memory)
+	local self = ffi.gc(C.clipper_create(), C.clipper_free)
+	if reuse_memory then self:reuse_memory(true) end
+	return self
 end
 
 function clipper:free()
@@ -214,8 +321,15 @@ function clipper:get_bounds(r)
 	return r.x1, r.y1, r.x2, r.y2
 end
 
-function clipper:execute(clip_type, subj_fill_type, clip_fill_type, reverse)
+function clipper:execute(clip_type, subj_fill_type, clip_fill_type, reverse, out)
 	C.clipper_set_reverse_solution(self, reverse and 1 or 0)
+	if out then --reuse the polygons (and their buffers) of a previous result
+		assert(C.clipper_execute_into(self,
+						clip_types[clip_type],
+						fill_types[subj_fill_type or 'even_odd'],
+						fill_types[clip_fill_type or 'even_odd'], out) ~= 0)
+		return out
+	end
 	local out = C.clipper_execute(self,
 						clip_types[clip_type],
 						fill_types[subj_fill_type or 'even_odd'],
@@ -225,14 +339,27 @@ end
 
 clipper.clear = C.clipper_clear
 
+--keep the clipper's internal memory across clear() calls (or give it back).
+function clipper:reuse_memory(reuse)
+	if reuse == nil then
+		return C.clipper_get_reuse_memory(self) ~= 0
+	end
+	C.clipper_set_reuse_memory(self, reuse and 1 or 0)
+end
+
 ffi.metatype('clipper_polygon', {__index = polygon})
 ffi.metatype('clipper_polygons', {__index = polygons})
 ffi.metatype('clipper', {__index = clipper})
+ffi.metatype('clipper_flat', {__index = flat})
 
 return {
 	new = clipper.new,
 	polygon = polygon.new,
 	polygons = polygons.new,
+	flat = flat.new,
+	clip_batch = clip_batch,
+	clip_rects = clip_rects,
+	offset_batch = offset_batch,
 	C = C,
 }
 
@@ -0,0 +1,225 @@
+--benchmark for clipper: one-shot clipping of large random polygon sets and
+--batches of small real-world-like jobs (polygon vs tile, star vs circle,
+--union of buffered points), each with a new clipper per job vs a single
+--clipper reused between execute() calls, and the batch API: a subject set
+--clipped against a grid of tiles with clip_batch() and clip_rects() on
+--1..N threads vs a loop of execute() calls.
+--usage: luajit clipper_benchmark.lua [scale] [max_threads]
+local ffi = require'ffi'
+local time = require'time'
+local clipper = require'clipper'
+
+if ... == 'clipper_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local scale = tonumber((...)) or 1
+math.randomseed(1234)
+
+local function bench(f)
+	local n = 0
+	local t0 = time.clock()
+	local t1
+	repeat
+		f()
+		n = n + 1
+		t1 = time.clock()
+	until t1 - t0 >= .5
+	return (t1 - t0) / n
+end
+
+--polygon generators ---------------------------------------------------------
+
+local function random_polygon(n, x, y, r)
+	local p = clipper.polygon()
+	for i = 1, n do
+		p:add(x + math.random(-r, r), y + math.random(-r, r))
+	end
+	return p
+end
+
+local function circle(x, y, r, n)
+	local p = clipper.polygon()
+	for i = 0, n-1 do
+		local a = i / n * 2 * math.pi
+		p:add(math.floor(x + r * math.cos(a) + .5), math.floor(y + r * math.sin(a) + .5))
+	end
+	return p
+end
+
+local function star(x, y, r1, r2, n)
+	local p = clipper.polygon()
+	for i = 0, 2*n-1 do
+		local a = i / (2*n) * 2 * math.pi
+		local r = i % 2 == 0 and r1 or r2
+		p:add(math.floor(x + r * math.cos(a) + .5), math.floor(y + r * math.sin(a) + .5))
+	end
+	return p
+end
+
+local function rect(x1, y1, x2, y2)
+	local p = clipper.polygon()
+	p:add(x1, y1); p:add(x2, y1); p:add(x2, y2); p:add(x1, y2)
+	return p
+end
+
+--a country-outline-like polygon: a circle with fractal noise on the radius.
+local function outline(x, y, r, n)
+	local p = clipper.polygon()
+	local noise = 0
+	for i = 0, n-1 do
+		local a = i / n * 2 * math.pi
+		noise = noise * .9 + (math.random() - .5) * r * .05
+		local rr = r + noise
+		p:add(math.floor(x + rr * math.cos(a) + .5), math.floor(y + rr * math.sin(a) + .5))
+	end
+	return p
+end
+
+--workloads ------------------------------------------------------------------
+
+local function report(name, fresh, reuse)
+	print(string.format('%-36s fresh: %9.3f ms  reuse: %9.3f ms  (%.2fx)',
+		name, fresh * 1000, reuse * 1000, fresh / reuse))
+end
+
+--one big job: both modes just run it once per iteration.
+local function one_shot(name, clip_type, subj, clip, fill)
+	local function fresh()
+		local c = clipper.new()
+		c:add_subject(subj)
+		c:add_clip(clip)
+		local out = c:execute(clip_type, fill, fill)
+		c:free()
+		out:free()
+	end
+	local c = clipper.new(true)
+	local out = clipper.polygons()
+	local function reuse()
+		c:clear()
+		c:add_subject(subj)
+		c:add_clip(clip)
+		c:execute(clip_type, fill, fill, false, out)
+	end
+	report(name, bench(fresh), bench(reuse))
+end
+
+--many small jobs: jobs is an array of {subject, clip} pairs.
+local function batch(name, clip_type, jobs, fill)
+	local function fresh()
+		for i = 1, #jobs do
+			local c = clipper.new()
+			c:add_subject(jobs[i][1])
+			c:add_clip(jobs[i][2])
+			local out = c:execute(clip_type, fill, fill)
+			c:free()
+			out:free()
+		end
+	end
+	local c = clipper.new(true)
+	local out = clipper.polygons()
+	local function reuse()
+		for i = 1, #jobs do
+			c:clear()
+			c:add_subject(jobs[i][1])
+			c:add_clip(jobs[i][2])
+			c:execute(clip_type, fill, fill, false, out)
+		end
+	end
+	report(string.format('%s x%d', name, #jobs), bench(fresh), bench(reuse))
+end
+
+local n = math.floor(60 * scale)
+
+--random self-intersecting polygons: dominated by intersections and scanbeams.
+local subj = clipper.polygons()
+local clip = clipper.polygons()
+for i = 1, 8 do
+	subj:add(random_polygon(n, 0, 0, 10000))
+	clip:add(random_polygon(n, 0, 0, 10000))
+end
+one_shot(string.format('random %dx%d intersection', 8, n),
+	'intersection', subj, clip, 'non_zero')
+one_shot(string.format('random %dx%d union', 8, n),
+	'union', subj, clip, 'non_zero')
+
+--a detailed outline cut by a grid of tiles (map tiling).
+local shape = clipper.polygons(outline(50000, 50000, 40000, math.floor(2000 * scale)))
+local jobs = {}
+for ty = 0, 9 do
+	for tx = 0, 9 do
+		jobs[#jobs+1] = {shape, clipper.polygons(rect(tx * 10000, ty * 10000, (tx+1) * 10000, (ty+1) * 10000))}
+	end
+end
+batch('outline vs tile', 'intersection', jobs, 'even_odd')
+
+--lots of small star vs circle jobs (UI hit areas, font-like shapes).
+local jobs = {}
+for i = 1, math.floor(1000 * scale) do
+	local x, y = math.random(0, 1000), math.random(0, 1000)
+	jobs[i] = {
+		clipper.polygons(star(x, y, 100, 40, 7)),
+		clipper.polygons(circle(x + 30, y + 20, 80, 32)),
+	}
+end
+batch('star vs circle', 'difference', jobs, 'non_zero')
+
+--union of buffered points (each job merges a cluster of 20 circles).
+local jobs = {}
+for i = 1, math.floor(100 * scale) do
+	local s = clipper.polygons()
+	local c = clipper.polygons()
+	for j = 1, 10 do
+		s:add(circle(math.random(0, 500), math.random(0, 500), 60, 24))
+		c:add(circle(math.random(0, 500), math.random(0, 500), 60, 24))
+	end
+	jobs[i] = {s, c}
+end
+batch('circle cluster union', 'union', jobs, 'non_zero')
+
+--tiling a set of shapes: a loop over the tiles vs the batch API.
+local subj = clipper.polygons()
+for i = 1, math.floor(300 * scale) do
+	subj:add(star(math.random(0, 100000), math.random(0, 100000),
+		math.random(500, 3000), math.random(100, 500), math.random(3, 12)))
+end
+local grid = 32
+local tile = 100000 / grid
+local rects, xy, rings, regions = {}, {}, {}, {}
+for ty = 0, grid-1 do
+	for tx = 0, grid-1 do
+		local x1, y1, x2, y2 = tx * tile, ty * tile, (tx+1) * tile, (ty+1) * tile
+		for _,v in ipairs{x1, y1, x2, y2} do rects[#rects+1] = v end
+		regions[#regions+1] = #rings
+		rings[#rings+1] = #xy / 2
+		for _,v in ipairs{x1, y1, x2, y1, x2, y2, x1, y2} do xy[#xy+1] = v end
+	end
+end
+rings[#rings+1] = #xy / 2
+regions[#regions+1] = #rings - 1
+local tiles = clipper.flat(xy, rings, nil, regions)
+local subj_flat = subj:flat()
+
+local c = clipper.new(true)
+local out = clipper.polygons()
+local loop = bench(function()
+	for i = 1, tiles:region_count() do
+		c:clear()
+		c:add_subject(subj)
+		c:add_clip(tiles:polygons(i))
+		c:execute('intersection', 'non_zero', 'non_zero', false, out)
+	end
+end)
+print(string.format('%d stars vs %d tiles: execute() loop: %9.3f ms',
+	subj:size(), grid * grid, loop * 1000))
+local max_threads = tonumber((select(2, ...))) or 4
+for threads = 1, max_threads do
+	local batch = bench(function()
+		clipper.clip_batch(subj_flat, tiles, 'intersection', 'non_zero', 'non_zero', threads):free()
+	end)
+	local rect = bench(function()
+		clipper.clip_rects(subj_flat, rects, nil, threads):free()
+	end)
+	print(string.format('  %2d threads: clip_batch: %9.3f ms (%.1fx)  clip_rects: %9.3f ms (%.1fx)',
+		threads, batch * 1000, loop / batch, rect * 1000, loop / rect))
+end
@@ -0,0 +1,221 @@
+local clipper = require'clipper'
+local ffi = require'ffi'
+
+local function star(x, y, r1, r2, n)
+	local p = clipper.polygon()
+	for i = 0, 2*n-1 do
+		local a = i / (2*n) * 2 * math.pi
+		local r = i % 2 == 0 and r1 or r2
+		p:add(math.floor(x + r * math.cos(a) + .5), math.floor(y + r * math.sin(a) + .5))
+	end
+	return p
+end
+
+local function rect(x1, y1, x2, y2)
+	local p = clipper.polygon()
+	p:add(x1, y1); p:add(x2, y1); p:add(x2, y2); p:add(x1, y2)
+	return p
+end
+
+--a list of rings as lists of x, y.
+local function polygons_rings(polys)
+	local t = {}
+	for i = 1, polys:size() do
+		local p = polys:get(i)
+		local ring = {}
+		for j = 1, p:size() do
+			local pt = p:get(j)
+			ring[#ring+1] = tonumber(pt.x)
+			ring[#ring+1] = tonumber(pt.y)
+		end
+		t[#t+1] = ring
+	end
+	return t
+end
+
+local function region_rings(flat, region)
+	local t = {}
+	local i1, i2 = flat:region(region)
+	for i = i1, i2 do
+		local xy, n = flat:ring(i)
+		local ring = {}
+		for j = 0, 2*n-1 do
+			ring[#ring+1] = tonumber(xy[j])
+		end
+		t[#t+1] = ring
+	end
+	return t
+end
+
+--rings as a string which doesn't depend on the order of the rings or on
+--the starting point of each ring.
+local function normalize(rings)
+	local t = {}
+	for _,ring in ipairs(rings) do
+		local n = #ring / 2
+		local k = 0
+		for i = 1, n-1 do
+			local x, y, kx, ky = ring[2*i+1], ring[2*i+2], ring[2*k+1], ring[2*k+2]
+			if x < kx or (x == kx and y < ky) then k = i end
+		end
+		local s = {}
+		for i = 0, n-1 do
+			local j = (k + i) % n
+			s[#s+1] = ring[2*j+1]..','..ring[2*j+2]
+		end
+		t[#t+1] = table.concat(s, ' ')
+	end
+	table.sort(t)
+	return table.concat(t, '\n')
+end
+
+local function bounds(rings)
+	local x1, y1, x2, y2 = 1/0, 1/0, -1/0, -1/0
+	for _,ring in ipairs(rings) do
+		for i = 1, #ring, 2 do
+			x1 = math.min(x1, ring[i])
+			y1 = math.min(y1, ring[i+1])
+			x2 = math.max(x2, ring[i])
+			y2 = math.max(y2, ring[i+1])
+		end
+	end
+	return x1, y1, x2, y2
+end
+
+--moving a vertex by d changes the area by at most d times half the sum of
+--the lengths of its edges, so the area of rings whose vertices are rounded
+--differently can differ by at most perimeter * d.
+local function perimeter(rings)
+	local p = 0
+	for _,ring in ipairs(rings) do
+		local n = #ring / 2
+		for i = 0, n-1 do
+			local j = (i + 1) % n
+			p = p + math.sqrt((ring[2*j+1] - ring[2*i+1])^2 + (ring[2*j+2] - ring[2*i+2])^2)
+		end
+	end
+	return p
+end
+
+local function area(rings)
+	local a = 0
+	for _,ring in ipairs(rings) do
+		local n = #ring / 2
+		for i = 0, n-1 do
+			local j = (i + 1) % n
+			a = a + ring[2*i+1] * ring[2*j+2] - ring[2*j+1] * ring[2*i+2]
+		end
+	end
+	return a / 2
+end
+
+--subject: a grid of stars with a star hole in one of them.
+local subj = clipper.polygons()
+for x = 0, 3 do
+	for y = 0, 3 do
+		subj:add(star(x * 250 + 120, y * 250 + 120, 120, 50, 5 + x + y))
+	end
+end
+local hole = star(250 + 120, 250 + 120, 40, 20, 7)
+hole:reverse()
+subj:add(hole)
+
+--clip regions: tiles, some of them with a star added.
+local tiles = {}
+local regions = {0}
+local clip = clipper.polygons()
+for x = 0, 1000, 125 do
+	for y = 0, 1000, 125 do
+		local x1, y1, x2, y2 = x - 10, y - 10, x + 137, y + 131
+		tiles[#tiles+1] = {x1, y1, x2, y2}
+		clip:add(rect(x1, y1, x2, y2))
+		if (x + y) % 250 == 0 then
+			clip:add(star(x + 60, y + 60, 70, 30, 4))
+		end
+		regions[#regions+1] = clip:size()
+	end
+end
+local clip_rings = clip:flat() --must be kept alive while clip_flat is used
+local clip_flat = clipper.flat(clip_rings.xy, clip_rings.rings, clip_rings.nrings, regions)
+
+--the subject rings whose bounds overlap the bounds of a clip region, which
+--is what clip_batch() clips for intersections.
+local function overlapping_rings(polys, rings)
+	local x1, y1, x2, y2 = bounds(rings)
+	local out = clipper.polygons()
+	for i = 1, polys:size() do
+		local p = polys:get(i)
+		local bx1, by1, bx2, by2 = bounds(polygons_rings(clipper.polygons(p)))
+		if bx1 <= x2 and x1 <= bx2 and by1 <= y2 and y1 <= by2 then
+			out:add(p)
+		end
+	end
+	return out
+end
+
+--clip_batch() must give the same results as execute() on the same input.
+--skipping subject rings changes the order in which edges are processed, so
+--against the whole subject the intersections can only differ by rounding.
+local function test_clip_batch()
+	for _,op in ipairs{'intersection', 'union', 'difference', 'xor'} do
+		for _,fill in ipairs{'even_odd', 'non_zero'} do
+			for _,threads in ipairs{1, 3} do
+				local out = clipper.clip_batch(subj, clip_flat, op, fill, fill, threads)
+				assert(out:region_count() == #regions - 1)
+				for r = 1, #regions - 1 do
+					local clip = clip_flat:polygons(r)
+					local rings = region_rings(out, r)
+					local c = clipper.new()
+					local input = op == 'intersection'
+						and overlapping_rings(subj, polygons_rings(clip)) or subj
+					if input:size() > 0 then
+						c:add_subject(input)
+					end
+					c:add_clip(clip)
+					local expected = polygons_rings(c:execute(op, fill, fill))
+					assert(normalize(rings) == normalize(expected),
+						string.format('%s %s %d threads: region %d differs', op, fill, threads, r))
+					if op == 'intersection' then
+						local c = clipper.new()
+						c:add_subject(subj)
+						c:add_clip(clip)
+						local expected = polygons_rings(c:execute(op, fill, fill))
+						local err = math.abs(area(rings) - area(expected))
+						assert(err <= perimeter(rings) * math.sqrt(2), string.format(
+							'%s %d threads: region %d: area differs by %g', fill, threads, r, err))
+					end
+				end
+			end
+		end
+	end
+	print'clip_batch ok'
+end
+
+--clip_rects() clips each ring on its own and rounds the intersections with
+--the rectangle's sides differently than the sweep of execute() does.
+local function test_clip_rects()
+	local rects = {}
+	for _,t in ipairs(tiles) do
+		for i = 1, 4 do rects[#rects+1] = t[i] end
+	end
+	local max_err = 0
+	for _,threads in ipairs{1, 3} do
+		local out = clipper.clip_rects(subj, rects, nil, threads)
+		assert(out:region_count() == #tiles)
+		for r, t in ipairs(tiles) do
+			local c = clipper.new()
+			c:add_subject(subj)
+			c:add_clip(rect(unpack(t)))
+			local expected = area(polygons_rings(c:execute('intersection', 'non_zero', 'non_zero')))
+			local rings = region_rings(out, r)
+			local err = math.abs(area(rings) - expected)
+			assert(err <= perimeter(rings) * math.sqrt(2),
+				string.format('%d threads: rect %d: area differs by %g', threads, r, err))
+			max_err = math.max(max_err, err)
+		end
+	end
+	print(string.format('clip_rects ok (max. area error: %g)', max_err))
+end
+
+test_clip_batch()
+test_clip_rects()
@@ -0,0 +1,298 @@
+/*
+	Pixel format converters for bitmap.lua.
+	Written by Cosmin Apreutesei. Public Domain.
+
+	Formats which only differ in the order of their 8bit channels are
+	converted with a byte shuffle (SSSE3 when available). Other formats are
+	unpacked to and packed from rgba8 in chunks of pixels that fit in L1.
+	Results are the same as the Lua converters in bitmap.lua, except when
+	going through the rgba8 intermediate loses precision (from 16bit or
+	from fractional values), where they can differ by 1 in 8bit units.
+*/
+
+#include <x86intrin.h>
+#include <string.h>
+#include "bitmap.h"
+
+#define CHUNK 256 /* pixels */
+
+/* 8bit channel layouts: byte offsets of r, g, b, a in a pixel, or -1 for
+   a missing alpha channel (which reads as 0xff). gray formats have all of
+   r, g, b point to the gray channel. */
+typedef struct { i32 bpp, r, g, b, a, gray; } layout;
+
+static const layout layouts[BITMAP_FORMAT_COUNT] = {
+	[BITMAP_G8   ] = {1, 0, 0, 0, -1, 1},
+	[BITMAP_GA8  ] = {2, 0, 0, 0,  1, 1},
+	[BITMAP_RGB8 ] = {3, 0, 1, 2, -1, 0},
+	[BITMAP_BGR8 ] = {3, 2, 1, 0, -1, 0},
+	[BITMAP_RGBA8] = {4, 0, 1, 2,  3, 0},
+	[BITMAP_BGRA8] = {4, 2, 1, 0,  3, 0},
+	[BITMAP_ARGB8] = {4, 1, 2, 3,  0, 0},
+};
+
+static i32 bytes_per_pixel(i32 fmt)
+{
+	switch (fmt) {
+		case BITMAP_RGBA16: return 8;
+		case BITMAP_RGB565: return 2;
+		case BITMAP_CMYK8:  return 4;
+		case BITMAP_YCC8:   return 3;
+		default:            return layouts[fmt].bpp;
+	}
+}
+
+/* byte shuffle between 8bit layouts -------------------------------------- */
+
+typedef struct {
+	i32 sbpp, dbpp;
+	i8 src_of[4];  /* src byte offset for each dst byte, -1 for 0xff */
+	__m128i mask;  /* pshufb mask for 4 pixels */
+	__m128i alpha; /* 0xff where the alpha is missing */
+} swizzle;
+
+static void swizzle_init(swizzle *sw, const layout *s, const layout *d)
+{
+	i32 i, p;
+	i8 m[16];
+	u8 a[16];
+	sw->sbpp = s->bpp;
+	sw->dbpp = d->bpp;
+	for (i = 0; i < 4; i++)
+		sw->src_of[i] = -1;
+	if (d->gray) {
+		sw->src_of[d->r] = s->r;
+	} else {
+		sw->src_of[d->r] = s->r;
+		sw->src_of[d->g] = s->g;
+		sw->src_of[d->b] = s->b;
+	}
+	if (d->a >= 0)
+		sw->src_of[d->a] = s->a;
+	memset(m, -1, 16);
+	memset(a, 0, 16);
+	for (p = 0; p < 4; p++)
+		for (i = 0; i < d->bpp; i++) {
+			i32 so = sw->src_of[i];
+			if (so >= 0)
+				m[p * d->bpp + i] = p * s->bpp + so;
+			else
+				a[p * d->bpp + i] = 0xff;
+		}
+	sw->mask  = _mm_loadu_si128((__m128i*)m);
+	sw->alpha = _mm_loadu_si128((__m128i*)a);
+}
+
+static void swizzle_row_c(const swizzle *sw, const u8 *s, u8 *d, i32 n)
+{
+	i32 x, i;
+	for (x = 0; x < n; x++, s += sw->sbpp, d += sw->dbpp)
+		for (i = 0; i < sw->dbpp; i++)
+			d[i] = sw->src_of[i] >= 0 ? s[sw->src_of[i]] : 0xff;
+}
+
+__attribute__((target("ssse3")))
+static void swizzle_row_ssse3(const swizzle *sw, const u8 *s, u8 *d, i32 n)
+{
+	i32 x = 0;
+	/* 4 pixels per step, but loads and stores are 16 bytes wide, so stop
+	   while they're still within the row. */
+	i32 minbpp = sw->sbpp < sw->dbpp ? sw->sbpp : sw->dbpp;
+	i32 nv = n - (16 + minbpp - 1) / minbpp;
+	for (; x <= nv; x += 4) {
+		__m128i v = _mm_loadu_si128((__m128i*)(s + x * sw->sbpp));
+		v = _mm_or_si128(_mm_shuffle_epi8(v, sw->mask), sw->alpha);
+		_mm_storeu_si128((__m128i*)(d + x * sw->dbpp), v);
+	}
+	swizzle_row_c(sw, s + x * sw->sbpp, d + x * sw->dbpp, n - x);
+}
+
+typedef void (*swizzle_func)(const swizzle*, const u8*, u8*, i32);
+static swizzle_func swizzle_row;
+
+/* rgb to gray ------------------------------------------------------------ */
+
+/* same formula and rounding as rgb2g() and round8() in bitmap.lua. */
+static void gray_row(const layout *s, const layout *d, const u8 *sp, u8 *dp, i32 n)
+{
+	i32 x;
+	for (x = 0; x < n; x++, sp += s->bpp, dp += d->bpp) {
+		double g = 0.2126 * sp[s->r] + 0.7152 * sp[s->g] + 0.0722 * sp[s->b] + 0.5;
+		dp[0] = g > 255 ? 255 : (u8)g;
+		if (d->a >= 0)
+			dp[d->a] = s->a >= 0 ? sp[s->a] : 0xff;
+	}
+}
+
+/* unpack to rgba8 -------------------------------------------------------- */
+
+static void unpack_rgba16(const u8 *sp, u8 *d, i32 n)
+{
+	const u16 *s = (const u16*)sp;
+	i32 i;
+	for (i = 0; i < n * 4; i++)
+		d[i] = (s[i] * 255 + 32895) >> 16;
+}
+
+static void unpack_rgb565(const u8 *sp, u8 *d, i32 n)
+{
+	const u16 *s = (const u16*)sp;
+	i32 x;
+	for (x = 0; x < n; x++, d += 4) {
+		u16 v = s[x];
+		d[0] = (u8)((v >> 11)        * (255.0 / 31));
+		d[1] = (u8)(((v >> 5) & 63)  * (255.0 / 63));
+		d[2] = (u8)((v & 31)         * (255.0 / 31));
+		d[3] = 0xff;
+	}
+}
+
+static void unpack_cmyk8(const u8 *s, u8 *d, i32 n)
+{
+	i32 x;
+	for (x = 0; x < n; x++, s += 4, d += 4) {
+		i32 k = s[3];
+		d[0] = (s[0] * k * 255 + 32895) >> 16;
+		d[1] = (s[1] * k * 255 + 32895) >> 16;
+		d[2] = (s[2] * k * 255 + 32895) >> 16;
+		d[3] = 0xff;
+	}
+}
+
+static u8 round8(double x)
+{
+	x += 0.5;
+	return x < 0 ? 0 : (x > 255 ? 255 : (u8)x);
+}
+
+static void unpack_ycc8(const u8 *s, u8 *d, i32 n)
+{
+	i32 x;
+	for (x = 0; x < n; x++, s += 3, d += 4) {
+		double y = s[0], cb = s[1] - 128, cr = s[2] - 128;
+		d[0] = round8(y                + 1.402   * cr);
+		d[1] = round8(y - 0.34414 * cb - 0.71414 * cr);
+		d[2] = round8(y + 1.772   * cb);
+		d[3] = 0xff;
+	}
+}
+
+/* pack from rgba8 -------------------------------------------------------- */
+
+static void pack_rgba16(const u8 *s, u8 *dp, i32 n)
+{
+	u16 *d = (u16*)dp;
+	i32 i;
+	for (i = 0; i < n * 4; i++)
+		d[i] = s[i] * 257;
+}
+
+static void pack_rgb565(const u8 *s, u8 *dp, i32 n)
+{
+	u16 *d = (u16*)dp;
+	i32 x;
+	for (x = 0; x < n; x++, s += 4)
+		d[x] = ((s[0] >> 3) << 11) | ((s[1] >> 2) << 5) | (s[2] >> 3);
+}
+
+/* row converters --------------------------------------------------------- */
+
+typedef void (*unpack_func)(const u8*, u8*, i32);
+
+static unpack_func unpacker(i32 fmt)
+{
+	switch (fmt) {
+		case BITMAP_RGBA16: return unpack_rgba16;
+		case BITMAP_RGB565: return unpack_rgb565;
+		case BITMAP_CMYK8:  return unpack_cmyk8;
+		case BITMAP_YCC8:   return unpack_ycc8;
+	}
+	return 0;
+}
+
+static unpack_func packer(i32 fmt)
+{
+	switch (fmt) {
+		case BITMAP_RGBA16: return pack_rgba16;
+		case BITMAP_RGB565: return pack_rgb565;
+	}
+	return 0;
+}
+
+typedef struct {
+	unpack_func unpack; /* src -> rgba8 (if src is not a layout) */
+	unpack_func pack;   /* rgba8 -> dst (if dst is not a layout) */
+	const layout *sl, *dl; /* layouts of src and dst (or rgba8) */
+	i32 gray;           /* rgb -> gray */
+	swizzle sw;
+	i32 sbpp, dbpp;
+} converter;
+
+static void convert_row(const converter *c, const u8 *s, u8 *d, i32 n)
+{
+	u8 buf1[CHUNK * 8], buf2[CHUNK * 8];
+	i32 x, k;
+	if (!c->unpack && !c->pack) {
+		if (c->gray)
+			gray_row(c->sl, c->dl, s, d, n);
+		else
+			swizzle_row(&c->sw, s, d, n);
+		return;
+	}
+	for (x = 0; x < n; x += k) {
+		const u8 *s1 = s + x * c->sbpp;
+		u8 *d1 = d + x * c->dbpp;
+		k = n - x < CHUNK ? n - x : CHUNK;
+		if (c->unpack) {
+			c->unpack(s1, buf1, k);
+			s1 = buf1;
+		}
+		if (c->pack) {
+			if (c->sl != &layouts[BITMAP_RGBA8]) {
+				swizzle_row(&c->sw, s1, buf2, k);
+				s1 = buf2;
+			}
+			c->pack(s1, d1, k);
+		} else if (c->gray) {
+			gray_row(c->sl, c->dl, s1, d1, k);
+		} else {
+			swizzle_row(&c->sw, s1, d1, k);
+		}
+	}
+}
+
+static i32 converter_init(converter *c, i32 sf, i32 df)
+{
+	if (sf < 1 || sf >= BITMAP_FORMAT_COUNT || df < 1 || df >= BITMAP_FORMAT_COUNT)
+		return 0;
+	if (df == BITMAP_CMYK8 || df == BITMAP_YCC8) /* no conversions into these */
+		return 0;
+	c->unpack = unpacker(sf);
+	c->pack   = packer(df);
+	c->sl = c->unpack ? &layouts[BITMAP_RGBA8] : &layouts[sf];
+	c->dl = c->pack   ? &layouts[BITMAP_RGBA8] : &layouts[df];
+	c->gray = c->dl->gray && !c->sl->gray;
+	c->sbpp = bytes_per_pixel(sf);
+	c->dbpp = bytes_per_pixel(df);
+	swizzle_init(&c->sw, c->sl, c->dl);
+	if (!swizzle_row) {
+		__builtin_cpu_init();
+		swizzle_row = __builtin_cpu_supports("ssse3")
+			? swizzle_row_ssse3 : swizzle_row_c;
+	}
+	return 1;
+}
+
+i32 bitmap_convert(
+	i32 src_format, const u8 *src, i32 src_stride,
+	i32 dst_format, u8 *dst, i32 dst_stride,
+	i32 w, i32 h)
+{
+	converter c;
+	i32 y;
+	if (!converter_init(&c, src_format, dst_format))
+		return 0;
+	for (y = 0; y < h; y++, src += src_stride, dst += dst_stride)
+		convert_row(&c, src, dst, w);
+	return 1;
+}
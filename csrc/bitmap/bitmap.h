@@ -0,0 +1,115 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+
+typedef int8_t i8;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef int32_t i32;
+typedef uint32_t u32;
+
+/* pixel formats, named as in bitmap.lua */
+enum {
+	BITMAP_G8 = 1,
+	BITMAP_GA8,
+	BITMAP_RGB8,
+	BITMAP_BGR8,
+	BITMAP_RGBA8,
+	BITMAP_BGRA8,
+	BITMAP_ARGB8,
+	BITMAP_RGBA16,
+	BITMAP_RGB565,
+	BITMAP_CMYK8,
+	BITMAP_YCC8,
+	BITMAP_FORMAT_COUNT
+};
+
+/* convert w x h pixels between two different formats. strides are in bytes
+   and can be negative. src and dst must not overlap. returns 0 if the
+   conversion is not supported, in which case nothing is written. */
+i32 bitmap_convert(
+	i32 src_format, const u8 *src, i32 src_stride,
+	i32 dst_format, u8 *dst, i32 dst_stride,
+	i32 w, i32 h);
+
+/* blend operators, named and ordered as in bitmap_blend.lua */
+enum {
+	BITMAP_OP_CLEAR = 1,
+	BITMAP_OP_SRC,
+	BITMAP_OP_DST,
+	BITMAP_OP_SRC_OVER,
+	BITMAP_OP_DST_OVER,
+	BITMAP_OP_SRC_IN,
+	BITMAP_OP_DST_IN,
+	BITMAP_OP_SRC_OUT,
+	BITMAP_OP_DST_OUT,
+	BITMAP_OP_SRC_ATOP,
+	BITMAP_OP_DST_ATOP,
+	BITMAP_OP_XOR,
+	BITMAP_OP_DARKEN,
+	BITMAP_OP_LIGHTEN,
+	BITMAP_OP_MODULATE,
+	BITMAP_OP_SCREEN,
+	BITMAP_OP_ADD,
+	BITMAP_OP_SATURATE,
+	BITMAP_OP_COUNT
+};
+
+/* pixels are straight alpha: premultiply them before blending and
+   unpremultiply the result. */
+#define BITMAP_BLEND_STRAIGHT 1
+
+/* blend w x h pixels of src into dst. formats can be rgba8, bgra8, argb8
+   or rgba16. if src is NULL, the source is the constant pixel `color`
+   given as r, g, b, a floats in 0..1. strides are in bytes and can be
+   negative. returns 0 if the op or formats are not supported. */
+i32 bitmap_blend(i32 op,
+	i32 src_format, const u8 *src, i32 src_stride, const float *color,
+	i32 dst_format, u8 *dst, i32 dst_stride,
+	i32 w, i32 h, i32 flags);
+
+/* resampling filters, as in bitmap_resize.lua */
+enum {
+	BITMAP_FILTER_BOX = 1,
+	BITMAP_FILTER_BILINEAR,
+	BITMAP_FILTER_BICUBIC,
+	BITMAP_FILTER_LANCZOS,
+	BITMAP_FILTER_COUNT
+};
+
+/* resample a sw x sh bitmap into a dw x dh bitmap of the same format with
+   a separable filter. formats can be any of the 8bit formats g8, ga8,
+   rgb8, bgr8, rgba8, bgra8, argb8. strides are in bytes and can be
+   negative. returns 0 if the format or filter are not supported, -1 if
+   out of memory. */
+i32 bitmap_resize(i32 format,
+	const u8 *src, i32 src_stride, i32 sw, i32 sh,
+	u8 *dst, i32 dst_stride, i32 dw, i32 dh,
+	i32 filter);
+
+/* error diffusion methods, as in bitmap_dither.lua */
+enum {
+	BITMAP_DITHER_FS = 1,
+	BITMAP_DITHER_ATKINSON,
+	BITMAP_DITHER_SIERRA_LITE,
+	BITMAP_DITHER_COUNT
+};
+
+/* dither w x h pixels in place by error diffusion, keeping bits[i] bits of
+   each channel, with channels in colortype order (r, g, b, a or g, a).
+   formats can be any of the 8bit formats g8, ga8, rgb8, bgr8, rgba8,
+   bgra8, argb8. odd rows are scanned right to left if serpentine is set.
+   returns 0 if the format or method are not supported, -1 if out of memory. */
+i32 bitmap_dither_diffuse(i32 format, u8 *data, i32 stride, i32 w, i32 h,
+	i32 method, const i32 *bits, i32 serpentine);
+
+/* ordered dithering with a 2x2, 3x3, 4x4 or 8x8 threshold map on the same
+   formats. if bits is NULL, the map value is added to all channels and the
+   low bits are kept. otherwise the map is scaled to the quantization step
+   of each channel and the low bits are cleared. rows are split in bands
+   between `threads` threads (0 means one per CPU). */
+i32 bitmap_dither_ordered(i32 format, u8 *data, i32 stride, i32 w, i32 h,
+	i32 mapsize, const i32 *bits, i32 threads);
+
+#endif
@@ -0,0 +1,415 @@
+/*
+	Porter-Duff and separable blend operators for bitmap_blend.lua.
+	Written by Cosmin Apreutesei. Public Domain.
+
+	Pixels are unpacked into float planes in chunks that fit in L1, blended
+	with the same formulas as the Lua operators (which the compiler
+	vectorizes) and packed back with rounding and clamping. src_over on
+	premultiplied 8bit pixels of the same layout has an exact integer SSE2
+	path since it's the operator used for compositing layers.
+*/
+
+#include <x86intrin.h>
+#include <string.h>
+#include "bitmap.h"
+
+#define CHUNK 256 /* pixels */
+
+/* bytes per channel and channel indices of the 4-channel formats. */
+typedef struct { i32 bpc, r, g, b, a; } rgba_layout;
+
+static i32 rgba_layout_init(rgba_layout *l, i32 fmt)
+{
+	static const rgba_layout layouts[] = {
+		{1, 0, 1, 2, 3}, /* rgba8 */
+		{1, 2, 1, 0, 3}, /* bgra8 */
+		{1, 1, 2, 3, 0}, /* argb8 */
+		{2, 0, 1, 2, 3}, /* rgba16 */
+	};
+	if (fmt < BITMAP_RGBA8 || fmt > BITMAP_RGBA16)
+		return 0;
+	*l = layouts[fmt - BITMAP_RGBA8];
+	return 1;
+}
+
+typedef struct { float r[CHUNK], g[CHUNK], b[CHUNK], a[CHUNK]; } planes;
+
+/* pointers to the planes in the order of the channels in memory. */
+static void plane_order(const rgba_layout *l, planes *c, float **pl)
+{
+	pl[l->r] = c->r;
+	pl[l->g] = c->g;
+	pl[l->b] = c->b;
+	pl[l->a] = c->a;
+}
+
+/* 4 pixels of 4 channels as 32bit ints -> 4 planes. */
+static inline void store4(__m128i p0, __m128i p1, __m128i p2, __m128i p3,
+	float **pl, i32 i, __m128 scale)
+{
+	__m128 v0 = _mm_cvtepi32_ps(p0);
+	__m128 v1 = _mm_cvtepi32_ps(p1);
+	__m128 v2 = _mm_cvtepi32_ps(p2);
+	__m128 v3 = _mm_cvtepi32_ps(p3);
+	_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+	_mm_storeu_ps(pl[0] + i, _mm_mul_ps(v0, scale));
+	_mm_storeu_ps(pl[1] + i, _mm_mul_ps(v1, scale));
+	_mm_storeu_ps(pl[2] + i, _mm_mul_ps(v2, scale));
+	_mm_storeu_ps(pl[3] + i, _mm_mul_ps(v3, scale));
+}
+
+static void load_planes(const rgba_layout *l, const u8 *p, planes *c, i32 n)
+{
+	float *pl[4];
+	__m128i z = _mm_setzero_si128();
+	i32 i = 0, j;
+	plane_order(l, c, pl);
+	if (l->bpc == 1) {
+		__m128 scale = _mm_set1_ps(1.f / 255);
+		for (; i + 4 <= n; i += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(v, z);
+			__m128i hi = _mm_unpackhi_epi8(v, z);
+			store4(
+				_mm_unpacklo_epi16(lo, z), _mm_unpackhi_epi16(lo, z),
+				_mm_unpacklo_epi16(hi, z), _mm_unpackhi_epi16(hi, z),
+				pl, i, scale);
+		}
+		for (; i < n; i++)
+			for (j = 0; j < 4; j++)
+				pl[j][i] = p[i * 4 + j] * (1.f / 255);
+	} else {
+		const u16 *q = (const u16*)p;
+		__m128 scale = _mm_set1_ps(1.f / 65535);
+		for (; i + 4 <= n; i += 4) {
+			__m128i v0 = _mm_loadu_si128((const __m128i*)(q + i * 4));
+			__m128i v1 = _mm_loadu_si128((const __m128i*)(q + i * 4 + 8));
+			store4(
+				_mm_unpacklo_epi16(v0, z), _mm_unpackhi_epi16(v0, z),
+				_mm_unpacklo_epi16(v1, z), _mm_unpackhi_epi16(v1, z),
+				pl, i, scale);
+		}
+		for (; i < n; i++)
+			for (j = 0; j < 4; j++)
+				pl[j][i] = q[i * 4 + j] * (1.f / 65535);
+	}
+}
+
+/* clamp to 0..1, also turning NaNs into 0. */
+#define CLAMP(x) ((x) > 0 ? ((x) < 1 ? (x) : 1) : 0)
+
+/* 4 planes -> 4 pixels of 4 channels as rounded and clamped 32bit ints.
+   maxps returns the second operand for NaNs so they become 0. */
+static inline void load4(float **pl, i32 i, __m128 scale, __m128i *p)
+{
+	__m128 z = _mm_setzero_ps(), one = _mm_set1_ps(1), half = _mm_set1_ps(.5f);
+	__m128 v[4];
+	for (i32 j = 0; j < 4; j++) {
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pl[j] + i), z), one);
+		v[j] = _mm_add_ps(_mm_mul_ps(x, scale), half);
+	}
+	_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+	for (i32 j = 0; j < 4; j++)
+		p[j] = _mm_cvttps_epi32(v[j]);
+}
+
+static void store_planes(const rgba_layout *l, planes *c, u8 *p, i32 n)
+{
+	float *pl[4];
+	__m128i v[4];
+	i32 i = 0, j;
+	plane_order(l, c, pl);
+	if (l->bpc == 1) {
+		__m128 scale = _mm_set1_ps(255);
+		for (; i + 4 <= n; i += 4) {
+			load4(pl, i, scale, v);
+			_mm_storeu_si128((__m128i*)(p + i * 4), _mm_packus_epi16(
+				_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+		}
+		for (; i < n; i++)
+			for (j = 0; j < 4; j++)
+				p[i * 4 + j] = (u8)(CLAMP(pl[j][i]) * 255 + .5f);
+	} else {
+		u16 *q = (u16*)p;
+		__m128 scale = _mm_set1_ps(65535);
+		/* there's no unsigned 32->16bit pack in SSE2: bias to signed. */
+		__m128i bias32 = _mm_set1_epi32(32768);
+		__m128i bias16 = _mm_set1_epi16(-32768);
+		for (; i + 4 <= n; i += 4) {
+			load4(pl, i, scale, v);
+			for (j = 0; j < 4; j++)
+				v[j] = _mm_sub_epi32(v[j], bias32);
+			_mm_storeu_si128((__m128i*)(q + i * 4), _mm_xor_si128(
+				_mm_packs_epi32(v[0], v[1]), bias16));
+			_mm_storeu_si128((__m128i*)(q + i * 4 + 8), _mm_xor_si128(
+				_mm_packs_epi32(v[2], v[3]), bias16));
+		}
+		for (; i < n; i++)
+			for (j = 0; j < 4; j++)
+				q[i * 4 + j] = (u16)(CLAMP(pl[j][i]) * 65535 + .5f);
+	}
+}
+
+static void premultiply(planes *c, i32 n)
+{
+	i32 i;
+	for (i = 0; i < n; i++) {
+		float a = c->a[i];
+		c->r[i] *= a;
+		c->g[i] *= a;
+		c->b[i] *= a;
+	}
+}
+
+static void unpremultiply(planes *c, i32 n)
+{
+	i32 i;
+	for (i = 0; i < n; i++) {
+		float m = c->a[i] > 0 ? 1 / c->a[i] : 0;
+		c->r[i] *= m;
+		c->g[i] *= m;
+		c->b[i] *= m;
+	}
+}
+
+/* the operators, same formulas as in bitmap_blend.lua. */
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define DIV(x, y) ((x) / MAX(y, 1e-30f)) /* x/0 is 0 for premultiplied x */
+
+#define BLEND_OP(name, R, G, B, A) \
+static void op_##name(const planes *s, planes *d, i32 n) \
+{ \
+	i32 i; \
+	for (i = 0; i < n; i++) { \
+		float Sr = s->r[i], Sg = s->g[i], Sb = s->b[i], Sa = s->a[i]; \
+		float Dr = d->r[i], Dg = d->g[i], Db = d->b[i], Da = d->a[i]; \
+		float r = (R), g = (G), b = (B), a = (A); \
+		(void)Sr; (void)Sg; (void)Sb; (void)Sa; \
+		(void)Dr; (void)Dg; (void)Db; (void)Da; \
+		d->r[i] = r; d->g[i] = g; d->b[i] = b; d->a[i] = a; \
+	} \
+}
+
+#define UNION_A (Sa + Da - Sa * Da)
+#define ADD_A   MIN(1, Sa + Da)
+#define SAT_A   MIN(Sa, 1 - Da)
+
+BLEND_OP(clear, 0, 0, 0, 0)
+BLEND_OP(src, Sr, Sg, Sb, Sa)
+BLEND_OP(dst, Dr, Dg, Db, Da)
+BLEND_OP(src_over,
+	Sr + (1 - Sa) * Dr,
+	Sg + (1 - Sa) * Dg,
+	Sb + (1 - Sa) * Db,
+	UNION_A)
+BLEND_OP(dst_over,
+	Dr + (1 - Da) * Sr,
+	Dg + (1 - Da) * Sg,
+	Db + (1 - Da) * Sb,
+	UNION_A)
+BLEND_OP(src_in, Sr * Da, Sg * Da, Sb * Da, Sa * Da)
+BLEND_OP(dst_in, Sa * Dr, Sa * Dg, Sa * Db, Sa * Da)
+BLEND_OP(src_out,
+	Sr * (1 - Dr),
+	Sg * (1 - Dg),
+	Sb * (1 - Db),
+	Sa * (1 - Da))
+BLEND_OP(dst_out,
+	Dr * (1 - Sa),
+	Dg * (1 - Sa),
+	Db * (1 - Sa),
+	Da * (1 - Sa))
+BLEND_OP(src_atop,
+	Sr * Da + (1 - Sa) * Dr,
+	Sg * Da + (1 - Sa) * Dg,
+	Sb * Da + (1 - Sa) * Db,
+	Da)
+BLEND_OP(dst_atop,
+	Sa * Dr + Sr * (1 - Da),
+	Sa * Dg + Sg * (1 - Da),
+	Sa * Db + Sb * (1 - Da),
+	Sa)
+BLEND_OP(xor,
+	Sr * (1 - Da) + (1 - Sa) * Dr,
+	Sg * (1 - Da) + (1 - Sa) * Dg,
+	Sb * (1 - Da) + (1 - Sa) * Db,
+	Sa + Da - 2 * Sa * Da)
+BLEND_OP(darken,
+	Sr * (1 - Da) + Dr * (1 - Sa) + MIN(Sr, Dr),
+	Sg * (1 - Da) + Dg * (1 - Sa) + MIN(Sg, Dg),
+	Sb * (1 - Da) + Db * (1 - Sa) + MIN(Sb, Db),
+	UNION_A)
+BLEND_OP(lighten,
+	Sr * (1 - Da) + Dr * (1 - Sa) + MAX(Sr, Dr),
+	Sg * (1 - Da) + Dg * (1 - Sa) + MAX(Sg, Dg),
+	Sb * (1 - Da) + Db * (1 - Sa) + MAX(Sb, Db),
+	UNION_A)
+BLEND_OP(modulate, Sr * Dr, Sg * Dg, Sb * Db, Sa * Da)
+BLEND_OP(screen,
+	Sr + Dr - Sr * Dr,
+	Sg + Dg - Sg * Dg,
+	Sb + Db - Sb * Db,
+	UNION_A)
+BLEND_OP(add,
+	DIV(Sr + Dr, ADD_A),
+	DIV(Sg + Dg, ADD_A),
+	DIV(Sb + Db, ADD_A),
+	ADD_A)
+BLEND_OP(saturate,
+	DIV(SAT_A * Sr + Dr, ADD_A),
+	DIV(SAT_A * Sg + Dg, ADD_A),
+	DIV(SAT_A * Sb + Db, ADD_A),
+	ADD_A)
+
+typedef void (*op_func)(const planes*, planes*, i32);
+
+static const op_func ops[BITMAP_OP_COUNT] = {
+	0,
+	op_clear, op_src, op_dst,
+	op_src_over, op_dst_over,
+	op_src_in, op_dst_in,
+	op_src_out, op_dst_out,
+	op_src_atop, op_dst_atop,
+	op_xor, op_darken, op_lighten,
+	op_modulate, op_screen, op_add, op_saturate,
+};
+
+/* exact x * y / 255 for x, y in 0..255 on 16bit lanes. */
+static inline __m128i mul_div255(__m128i x, __m128i y)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static inline u8 mul_div255_c(u32 x, u32 y)
+{
+	u32 t = x * y + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+/* broadcast the alpha of each pixel to all its 16bit lanes. */
+static inline __m128i alpha16(__m128i p, i32 ai)
+{
+	if (ai == 3)
+		return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xff), 0xff);
+	else
+		return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0x00), 0x00);
+}
+
+static inline __m128i src_over4(__m128i s, __m128i d, i32 ai)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i k = _mm_set1_epi16(255);
+	__m128i slo = _mm_unpacklo_epi8(s, z);
+	__m128i shi = _mm_unpackhi_epi8(s, z);
+	__m128i dlo = _mm_unpacklo_epi8(d, z);
+	__m128i dhi = _mm_unpackhi_epi8(d, z);
+	dlo = mul_div255(dlo, _mm_sub_epi16(k, alpha16(slo, ai)));
+	dhi = mul_div255(dhi, _mm_sub_epi16(k, alpha16(shi, ai)));
+	return _mm_packus_epi16(_mm_add_epi16(slo, dlo), _mm_add_epi16(shi, dhi));
+}
+
+/* premultiplied 8bit src_over of a row, src == NULL means a constant pixel. */
+static void src_over_row8(const u8 *s, const u8 *c, u8 *d, i32 n, i32 ai)
+{
+	i32 i = 0, j;
+	if (!s) {
+		__m128i cv = _mm_set1_epi32(*(const i32*)c);
+		for (; i + 4 <= n; i += 4) {
+			__m128i dv = _mm_loadu_si128((__m128i*)(d + i * 4));
+			_mm_storeu_si128((__m128i*)(d + i * 4), src_over4(cv, dv, ai));
+		}
+	}
+	for (; s && i + 4 <= n; i += 4) {
+		__m128i sv = _mm_loadu_si128((const __m128i*)(s + i * 4));
+		__m128i dv = _mm_loadu_si128((__m128i*)(d + i * 4));
+		_mm_storeu_si128((__m128i*)(d + i * 4), src_over4(sv, dv, ai));
+	}
+	for (; i < n; i++) {
+		const u8 *sp = s ? s + i * 4 : c;
+		u8 *dp = d + i * 4;
+		u32 ia = 255 - sp[ai];
+		for (j = 0; j < 4; j++) {
+			u32 v = sp[j] + mul_div255_c(dp[j], ia);
+			dp[j] = v < 255 ? v : 255;
+		}
+	}
+}
+
+i32 bitmap_blend(i32 op,
+	i32 src_format, const u8 *src, i32 src_stride, const float *color,
+	i32 dst_format, u8 *dst, i32 dst_stride,
+	i32 w, i32 h, i32 flags)
+{
+	rgba_layout sl, dl;
+	planes s, d;
+	i32 x, y, k, i;
+	i32 straight = flags & BITMAP_BLEND_STRAIGHT;
+	if (op < 1 || op >= BITMAP_OP_COUNT)
+		return 0;
+	if (!rgba_layout_init(&dl, dst_format))
+		return 0;
+	if (src && !rgba_layout_init(&sl, src_format))
+		return 0;
+
+	if (!src) { /* constant source: fill the source planes once */
+		float a = CLAMP(color[3]);
+		float m = straight ? a : 1;
+		for (i = 0; i < CHUNK; i++) {
+			s.r[i] = CLAMP(color[0]) * m;
+			s.g[i] = CLAMP(color[1]) * m;
+			s.b[i] = CLAMP(color[2]) * m;
+			s.a[i] = a;
+		}
+	}
+
+	/* operators that don't need to look at pixels */
+	if (op == BITMAP_OP_DST && !straight)
+		return 1;
+	if (op == BITMAP_OP_CLEAR
+		|| (op == BITMAP_OP_SRC && src && src_format == dst_format && !straight))
+	{
+		for (y = 0; y < h; y++, src += src ? src_stride : 0, dst += dst_stride)
+			if (op == BITMAP_OP_CLEAR)
+				memset(dst, 0, w * 4 * dl.bpc);
+			else
+				memcpy(dst, src, w * 4 * dl.bpc);
+		return 1;
+	}
+
+	if (op == BITMAP_OP_SRC_OVER && !straight && dl.bpc == 1
+		&& (!src || src_format == dst_format))
+	{
+		u8 c[4];
+		if (!src) {
+			c[dl.r] = (u8)(s.r[0] * 255 + .5f);
+			c[dl.g] = (u8)(s.g[0] * 255 + .5f);
+			c[dl.b] = (u8)(s.b[0] * 255 + .5f);
+			c[dl.a] = (u8)(s.a[0] * 255 + .5f);
+		}
+		for (y = 0; y < h; y++, src += src ? src_stride : 0, dst += dst_stride)
+			src_over_row8(src, c, dst, w, dl.a);
+		return 1;
+	}
+
+	for (y = 0; y < h; y++, src += src ? src_stride : 0, dst += dst_stride) {
+		for (x = 0; x < w; x += k) {
+			k = w - x < CHUNK ? w - x : CHUNK;
+			if (src) {
+				load_planes(&sl, src + x * 4 * sl.bpc, &s, k);
+				if (straight)
+					premultiply(&s, k);
+			}
+			load_planes(&dl, dst + x * 4 * dl.bpc, &d, k);
+			if (straight)
+				premultiply(&d, k);
+			ops[op](&s, &d, k);
+			if (straight)
+				unpremultiply(&d, k);
+			store_planes(&dl, &d, dst + x * 4 * dl.bpc, k);
+		}
+	}
+	return 1;
+}
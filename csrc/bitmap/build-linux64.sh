@@ -0,0 +1 @@
+P=linux64 C=-fPIC L="-s -static-libgcc -lm -lpthread" D=libbitmap.so A=libbitmap.a ./build.sh
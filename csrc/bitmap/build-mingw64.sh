@@ -0,0 +1 @@
+P=mingw64 L="-s -static-libgcc" D=bitmap.dll A=bitmap.a ./build.sh
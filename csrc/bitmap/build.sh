@@ -0,0 +1,5 @@
+${X}gcc -c -O3 -std=gnu99 -Wall -msse2 $C bitmap.c blend.c resize.c dither.c
+${X}gcc *.o -shared -o ../../bin/$P/$D $L
+rm -f      ../../bin/$P/$A
+${X}ar rcs ../../bin/$P/$A *.o
+rm *.o
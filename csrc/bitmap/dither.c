@@ -0,0 +1,405 @@
+/*
+	Error diffusion and ordered dithering for bitmap_dither.lua.
+	Written by Cosmin Apreutesei. Public Domain.
+
+	Error diffusion is serial along a row, so it's vectorized across the
+	channels of a pixel instead: each pixel is one register of 16bit lanes
+	and the errors for the next rows are kept in small per-row buffers
+	rather than being added into the bitmap. Since errors are never
+	negative, clamping once when a pixel is visited gives the same result
+	as clamping after each addition like the Lua code does.
+
+	Ordered dithering adds a precomputed row of thresholds and masks the low
+	bits 16 bytes at a time, optionally on multiple threads, one band of
+	rows per thread. The threads are kept in a pool between calls.
+*/
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600 /* for SRW locks and condition variables */
+#endif
+#include <x86intrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "bitmap.h"
+
+typedef int16_t i16;
+
+/* channel layout of the 8bit formats: bytes per pixel and byte offsets
+   of the channels in colortype order (g, a or r, g, b, a), -1 if missing. */
+typedef struct { i32 bpp; i32 ofs[4]; } dither_layout;
+
+static i32 dither_layout_init(dither_layout *l, i32 fmt)
+{
+	static const dither_layout layouts[] = {
+		{0},
+		{1, {0, -1, -1, -1}}, /* g8 */
+		{2, {0,  1, -1, -1}}, /* ga8 */
+		{3, {0,  1,  2, -1}}, /* rgb8 */
+		{3, {2,  1,  0, -1}}, /* bgr8 */
+		{4, {0,  1,  2,  3}}, /* rgba8 */
+		{4, {2,  1,  0,  3}}, /* bgra8 */
+		{4, {1,  2,  3,  0}}, /* argb8 */
+	};
+	if (fmt < BITMAP_G8 || fmt > BITMAP_ARGB8)
+		return 0;
+	*l = layouts[fmt];
+	return 1;
+}
+
+/* masks of the low bits to drop for each byte of a pixel, given the number
+   of bits to keep for each channel in colortype order. */
+static void low_masks(const dither_layout *l, const i32 *bits, u8 *masks)
+{
+	i32 i;
+	memset(masks, 0, 4);
+	for (i = 0; i < 4; i++) {
+		i32 b = bits[i] < 0 ? 0 : bits[i] > 8 ? 8 : bits[i];
+		if (l->ofs[i] >= 0)
+			masks[l->ofs[i]] = (1 << (8 - b)) - 1;
+	}
+}
+
+static inline __attribute__((always_inline)) u32 load_px(const u8 *p, i32 bpp)
+{
+	u32 v = 0;
+	switch (bpp) {
+	case 4: memcpy(&v, p, 4); break;
+	case 3: v = p[0] | (p[1] << 8) | (p[2] << 16); break;
+	case 2: v = p[0] | (p[1] << 8); break;
+	case 1: v = p[0]; break;
+	}
+	return v;
+}
+
+static inline __attribute__((always_inline)) void store_px(u8 *p, u32 v, i32 bpp)
+{
+	switch (bpp) {
+	case 4: memcpy(p, &v, 4); break;
+	case 3: p[2] = v >> 16; /* fall through */
+	case 2: p[1] = v >> 8;  /* fall through */
+	case 1: p[0] = v; break;
+	}
+}
+
+/* error diffusion ---------------------------------------------------------- */
+
+typedef struct { i32 dx, dy, w; } tap;
+
+typedef struct { i32 shift, n; tap taps[6]; } kernel;
+
+static const kernel kernels[BITMAP_DITHER_COUNT] = {
+	{0},
+	{4, 4, {{1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}}}, /* floyd-steinberg */
+	{3, 6, {{1, 0, 1}, {2, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}, {0, 2, 1}}}, /* atkinson */
+	{2, 3, {{1, 0, 2}, {-1, 1, 1}, {0, 1, 1}}}, /* sierra lite */
+};
+
+#define PAD 2 /* pixels on each side of the error rows for taps that fall off */
+
+static inline __attribute__((always_inline)) void diffuse_row(
+	u8 *row, i32 w, i32 dir, const kernel *k, i16 **err,
+	__m128i lowmask, __m128i wv[6], i32 bpp)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i maxv = _mm_set1_epi16(255);
+	__m128i shift = _mm_cvtsi32_si128(k->shift);
+	i32 x = dir > 0 ? 0 : w - 1;
+	i32 i, j;
+	for (i = 0; i < w; i++, x += dir) {
+		__m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(load_px(row + x * bpp, bpp)), z);
+		__m128i e0 = _mm_loadl_epi64((__m128i*)(err[0] + (x + PAD) * 4));
+		__m128i v = _mm_min_epi16(_mm_add_epi16(p, e0), maxv);
+		__m128i e = _mm_and_si128(v, lowmask);
+		__m128i q = _mm_andnot_si128(lowmask, v);
+		store_px(row + x * bpp, _mm_cvtsi128_si32(_mm_packus_epi16(q, q)), bpp);
+		for (j = 0; j < k->n; j++) {
+			i16 *t = err[k->taps[j].dy] + (x + k->taps[j].dx * dir + PAD) * 4;
+			__m128i tv = _mm_loadl_epi64((__m128i*)t);
+			tv = _mm_add_epi16(tv, _mm_srl_epi16(_mm_mullo_epi16(e, wv[j]), shift));
+			_mm_storel_epi64((__m128i*)t, tv);
+		}
+	}
+}
+
+i32 bitmap_dither_diffuse(i32 format, u8 *data, i32 stride, i32 w, i32 h,
+	i32 method, const i32 *bits, i32 serpentine)
+{
+	dither_layout l;
+	const kernel *k;
+	u8 masks[4];
+	__m128i lowmask, wv[6];
+	i16 *buf, *err[3];
+	i32 y, i, n = (w + 2 * PAD) * 4;
+	if (!dither_layout_init(&l, format))
+		return 0;
+	if (method < 1 || method >= BITMAP_DITHER_COUNT)
+		return 0;
+	k = &kernels[method];
+	low_masks(&l, bits, masks);
+	lowmask = _mm_setr_epi16(masks[0], masks[1], masks[2], masks[3], 0, 0, 0, 0);
+	for (i = 0; i < k->n; i++)
+		wv[i] = _mm_set1_epi16(k->taps[i].w);
+	buf = calloc(3 * n, sizeof(i16));
+	if (!buf)
+		return -1;
+	err[0] = buf;
+	err[1] = buf + n;
+	err[2] = buf + 2 * n;
+	for (y = 0; y < h; y++, data += stride) {
+		i32 dir = serpentine && (y & 1) ? -1 : 1;
+		i16 *t;
+		switch (l.bpp) { /* specialize for each pixel size */
+		case 1: diffuse_row(data, w, dir, k, err, lowmask, wv, 1); break;
+		case 2: diffuse_row(data, w, dir, k, err, lowmask, wv, 2); break;
+		case 3: diffuse_row(data, w, dir, k, err, lowmask, wv, 3); break;
+		case 4: diffuse_row(data, w, dir, k, err, lowmask, wv, 4); break;
+		}
+		t = err[0];
+		err[0] = err[1];
+		err[1] = err[2];
+		err[2] = t;
+		memset(t, 0, n * sizeof(i16));
+	}
+	free(buf);
+	return 1;
+}
+
+/* ordered dithering -------------------------------------------------------- */
+
+typedef struct {
+	u8 *data;
+	i32 stride, y0, y1, n; /* n: bytes per row */
+	i32 mapsize;
+	const u8 *thr;  /* mapsize rows of n + 16 threshold bytes */
+	const u8 *keep; /* n + 16 mask bytes */
+} ordered_band;
+
+static void ordered_rows(ordered_band *b)
+{
+	i32 y, x;
+	for (y = b->y0; y < b->y1; y++) {
+		u8 *p = b->data + y * b->stride;
+		const u8 *t = b->thr + (y & (b->mapsize - 1)) * (b->n + 16);
+		for (x = 0; x + 16 <= b->n; x += 16) {
+			__m128i v = _mm_loadu_si128((__m128i*)(p + x));
+			v = _mm_adds_epu8(v, _mm_loadu_si128((const __m128i*)(t + x)));
+			v = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)(b->keep + x)));
+			_mm_storeu_si128((__m128i*)(p + x), v);
+		}
+		for (; x < b->n; x++) {
+			i32 v = p[x] + t[x];
+			p[x] = (v < 255 ? v : 255) & b->keep[x];
+		}
+	}
+}
+
+static i32 cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/* thread pool: workers are started as needed and are kept for the life of
+   the process, waiting for the next call. worker i dithers band i. calls
+   from different threads are run one at a time. */
+
+#ifdef _WIN32
+static SRWLOCK pool_job_lock = SRWLOCK_INIT;
+static SRWLOCK pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE pool_work = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE pool_done = CONDITION_VARIABLE_INIT;
+#define mutex_lock(m)     AcquireSRWLockExclusive(&m)
+#define mutex_unlock(m)   ReleaseSRWLockExclusive(&m)
+#define cond_wait(c, m)   SleepConditionVariableSRW(&c, &m, INFINITE, 0)
+#define cond_signal(c)    WakeConditionVariable(&c)
+#define cond_broadcast(c) WakeAllConditionVariable(&c)
+#else
+static pthread_mutex_t pool_job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+#define mutex_lock(m)     pthread_mutex_lock(&m)
+#define mutex_unlock(m)   pthread_mutex_unlock(&m)
+#define cond_wait(c, m)   pthread_cond_wait(&c, &m)
+#define cond_signal(c)    pthread_cond_signal(&c)
+#define cond_broadcast(c) pthread_cond_broadcast(&c)
+#endif
+
+static i32 pool_size;             /* number of workers started */
+static ordered_band *pool_bands;  /* bands of the current call */
+static i32 pool_nt;               /* workers 1..pool_nt-1 work on the current call */
+static unsigned pool_gen;         /* call number */
+static i32 pool_running;          /* workers still working on the current call */
+
+static void pool_worker(i32 id)
+{
+	unsigned gen = 0;
+	mutex_lock(pool_lock);
+	for (;;) {
+		while (pool_gen == gen)
+			cond_wait(pool_work, pool_lock);
+		gen = pool_gen;
+		if (id >= pool_nt) continue; /* not needed for this call */
+		ordered_band *b = &pool_bands[id];
+		mutex_unlock(pool_lock);
+		ordered_rows(b);
+		mutex_lock(pool_lock);
+		if (--pool_running == 0)
+			cond_signal(pool_done);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_thread(void *arg) { pool_worker((i32)(intptr_t)arg); return 0; }
+#else
+static void *pool_thread(void *arg) { pool_worker((i32)(intptr_t)arg); return 0; }
+#endif
+
+/* start workers until there are n-1 of them. returns the number of threads
+   that can work on a call, including the calling thread. */
+static i32 pool_grow(i32 n)
+{
+	while (pool_size < n - 1) {
+		void *id = (void*)(intptr_t)(pool_size + 1);
+#ifdef _WIN32
+		HANDLE th = CreateThread(0, 0, pool_thread, id, 0, 0);
+		if (!th) break;
+		CloseHandle(th);
+#else
+		pthread_t th;
+		if (pthread_create(&th, 0, pool_thread, id) != 0) break;
+		pthread_detach(th);
+#endif
+		pool_size++;
+	}
+	return pool_size + 1 < n ? pool_size + 1 : n;
+}
+
+/* run all bands: band 0 on the calling thread, the rest on the workers.
+   bands left without a worker are dithered on the calling thread. */
+static void run_bands(ordered_band *bands, i32 nb)
+{
+	i32 i, nt;
+	if (nb == 1) {
+		ordered_rows(&bands[0]);
+		return;
+	}
+	mutex_lock(pool_job_lock);
+	mutex_lock(pool_lock);
+	nt = pool_grow(nb);
+	pool_bands = bands;
+	pool_nt = nt;
+	pool_running = nt - 1;
+	pool_gen++;
+	cond_broadcast(pool_work);
+	mutex_unlock(pool_lock);
+	ordered_rows(&bands[0]);
+	for (i = nt; i < nb; i++)
+		ordered_rows(&bands[i]);
+	mutex_lock(pool_lock);
+	while (pool_running > 0)
+		cond_wait(pool_done, pool_lock);
+	mutex_unlock(pool_lock);
+	mutex_unlock(pool_job_lock);
+}
+
+static const u8 bayer2[] = {1, 3, 4, 2};
+static const u8 bayer3[] = {3, 7, 4, 6, 1, 9, 2, 8, 5};
+static const u8 bayer4[] = {
+	 1,  9,  3, 11,
+	13,  5, 15,  7,
+	 4, 12,  2, 10,
+	16,  8, 14,  6};
+static const u8 bayer8[] = {
+	 1, 49, 13, 61,  4, 52, 16, 64,
+	33, 17, 45, 29, 36, 20, 48, 32,
+	 9, 57,  5, 53, 12, 60,  8, 56,
+	41, 25, 37, 21, 44, 28, 40, 24,
+	 3, 51, 15, 63,  2, 50, 14, 62,
+	35, 19, 47, 31, 34, 18, 46, 30,
+	11, 59,  7, 55, 10, 58,  6, 54,
+	43, 27, 39, 23, 42, 26, 38, 22};
+
+i32 bitmap_dither_ordered(i32 format, u8 *data, i32 stride, i32 w, i32 h,
+	i32 mapsize, const i32 *bits, i32 threads)
+{
+	dither_layout l;
+	const u8 *map;
+	u8 masks[4];
+	u8 *thr, *keep;
+	ordered_band bands[256];
+	i32 n, x, y, c, nb, band_h;
+	if (!dither_layout_init(&l, format))
+		return 0;
+	switch (mapsize) {
+	case 2: map = bayer2; break;
+	case 3: map = bayer3; break;
+	case 4: map = bayer4; break;
+	case 8: map = bayer8; break;
+	default: return 0;
+	}
+	if (w < 1 || h < 1)
+		return 1;
+	n = w * l.bpp;
+	thr = malloc((mapsize + 1) * (n + 16));
+	if (!thr)
+		return -1;
+	keep = thr + mapsize * (n + 16);
+
+	/* without bits, the map value is added to all channels and quantization
+	   is left to the conversion to a lower bit depth. with bits, the map
+	   value is scaled to the quantization step of each channel. */
+	if (bits)
+		low_masks(&l, bits, masks);
+	else
+		memset(masks, 0, 4);
+	for (y = 0; y < mapsize; y++) {
+		u8 *t = thr + y * (n + 16);
+		for (x = 0; x < w; x++) {
+			/* (same indexing as the Lua code, which is off for mapsize 3) */
+			i32 v = map[y * mapsize + (x & (mapsize - 1))];
+			for (c = 0; c < l.bpp; c++) {
+				i32 step = masks[c] + 1;
+				t[x * l.bpp + c] = bits
+					? ((2 * v - 1) * step) / (2 * mapsize * mapsize)
+					: v;
+			}
+		}
+	}
+	for (x = 0; x < w; x++)
+		for (c = 0; c < l.bpp; c++)
+			keep[x * l.bpp + c] = ~masks[c];
+
+	nb = threads > 0 ? threads : cpu_count();
+	if (nb > h / 16) nb = h / 16; /* not worth it for less rows than that */
+	if (nb < 1) nb = 1;
+	if (nb > 256) nb = 256;
+	band_h = (h + nb - 1) / nb;
+	nb = (h + band_h - 1) / band_h;
+	for (c = 0; c < nb; c++) {
+		ordered_band *b = &bands[c];
+		b->data = data;
+		b->stride = stride;
+		b->y0 = c * band_h;
+		b->y1 = b->y0 + band_h < h ? b->y0 + band_h : h;
+		b->n = n;
+		b->mapsize = mapsize;
+		b->thr = thr;
+		b->keep = keep;
+	}
+	run_bands(bands, nb);
+	free(thr);
+	return 1;
+}
@@ -0,0 +1,354 @@
+/*
+	Separable filtered resampling for bitmap_resize.lua.
+	Written by Cosmin Apreutesei. Public Domain.
+
+	Filter weights are precomputed once per output column and per output row
+	in 14bit fixed point. Source rows are resampled horizontally as they are
+	needed into a small ring of intermediate rows which are then resampled
+	vertically, so the intermediate never gets larger than the filter window.
+	Both passes multiply pairs of taps with pmaddwd (SSE2). Downscales of
+	more than 2x are first box-reduced by an integer factor so the filter
+	window stays small regardless of the ratio.
+*/
+
+#include <x86intrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bitmap.h"
+
+#define PRECISION 14 /* weight bits: a weight of 1.0 must fit in an i16 */
+
+typedef int16_t i16;
+
+/* filters */
+
+typedef struct { double support; double (*f)(double); } filter;
+
+static double box_filter(double x)
+{
+	return x > -.5 && x <= .5 ? 1 : 0;
+}
+
+static double triangle_filter(double x)
+{
+	x = fabs(x);
+	return x < 1 ? 1 - x : 0;
+}
+
+static double bicubic_filter(double x) /* Keys, a = -0.5 */
+{
+	const double a = -.5;
+	x = fabs(x);
+	if (x < 1) return ((a + 2) * x - (a + 3)) * x * x + 1;
+	if (x < 2) return (((x - 5) * x + 8) * x - 4) * a;
+	return 0;
+}
+
+static double sinc(double x)
+{
+	if (x == 0) return 1;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+static double lanczos_filter(double x) /* Lanczos-3 */
+{
+	return x > -3 && x < 3 ? sinc(x) * sinc(x / 3) : 0;
+}
+
+static const filter filters[BITMAP_FILTER_COUNT] = {
+	{0, 0},
+	{.5, box_filter},
+	{1, triangle_filter},
+	{2, bicubic_filter},
+	{3, lanczos_filter},
+};
+
+/* weight tables: output pixel i is the sum of n[i] input pixels starting
+   at start[i] multiplied by w[i * taps ...]. */
+
+typedef struct { i32 *start, *n; i16 *w; i32 taps; } coeffs;
+
+static void coeffs_free(coeffs *c)
+{
+	free(c->start);
+	free(c->n);
+	free(c->w);
+}
+
+static i32 coeffs_init(coeffs *c, i32 in, i32 out, const filter *f)
+{
+	double scale = (double)in / out;
+	double fscale = scale > 1 ? scale : 1;
+	double support = f->support * fscale;
+	double *k;
+	i32 i, j;
+	c->taps = (i32)ceil(support) * 2 + 1;
+	c->start = malloc(out * sizeof(i32));
+	c->n = malloc(out * sizeof(i32));
+	c->w = calloc(out * c->taps, sizeof(i16));
+	k = malloc(c->taps * sizeof(double));
+	if (!c->start || !c->n || !c->w || !k) {
+		coeffs_free(c);
+		free(k);
+		return 0;
+	}
+	for (i = 0; i < out; i++) {
+		double center = (i + .5) * scale;
+		double sum = 0;
+		i32 xmin = (i32)(center - support + .5);
+		i32 xmax = (i32)(center + support + .5);
+		i32 isum = 0, jmax = 0;
+		i16 *w = c->w + i * c->taps;
+		if (xmin < 0) xmin = 0;
+		if (xmax > in) xmax = in;
+		xmax -= xmin;
+		for (j = 0; j < xmax; j++) {
+			k[j] = f->f((j + xmin - center + .5) / fscale);
+			sum += k[j];
+		}
+		for (j = 0; j < xmax; j++) {
+			w[j] = (i16)lround(sum != 0 ? k[j] / sum * (1 << PRECISION) : 0);
+			isum += w[j];
+			if (w[j] > w[jmax]) jmax = j;
+		}
+		/* make the weights add up exactly so flat areas stay flat */
+		w[jmax] += (1 << PRECISION) - isum;
+		c->start[i] = xmin;
+		c->n[i] = xmax;
+	}
+	free(k);
+	return 1;
+}
+
+/* horizontal pass: pixels of up to 4 channels are loaded into the low
+   32 bits of a register and two taps are interleaved for pmaddwd. */
+
+static inline __attribute__((always_inline)) u32 load_px(const u8 *p, i32 bpp)
+{
+	u32 v = 0;
+	switch (bpp) {
+	case 4: memcpy(&v, p, 4); break;
+	case 3: v = p[0] | (p[1] << 8) | (p[2] << 16); break;
+	case 2: v = p[0] | (p[1] << 8); break;
+	case 1: v = p[0]; break;
+	}
+	return v;
+}
+
+static inline __attribute__((always_inline)) void store_px(u8 *p, u32 v, i32 bpp)
+{
+	switch (bpp) {
+	case 4: memcpy(p, &v, 4); break;
+	case 3: p[2] = v >> 16; /* fall through */
+	case 2: p[1] = v >> 8;  /* fall through */
+	case 1: p[0] = v; break;
+	}
+}
+
+static inline __attribute__((always_inline)) void resample_row_h_bpp(
+	const u8 *s, u8 *d, i32 dw, const coeffs *c, i32 bpp)
+{
+	__m128i z = _mm_setzero_si128();
+	i32 x, k;
+	for (x = 0; x < dw; x++) {
+		const u8 *p = s + c->start[x] * bpp;
+		const i16 *w = c->w + x * c->taps;
+		i32 n = c->n[x];
+		__m128i sum = _mm_set1_epi32(1 << (PRECISION - 1));
+		for (k = 0; k + 2 <= n; k += 2) {
+			__m128i a = _mm_cvtsi32_si128(load_px(p + k * bpp, bpp));
+			__m128i b = _mm_cvtsi32_si128(load_px(p + (k + 1) * bpp, bpp));
+			__m128i ab = _mm_unpacklo_epi8(_mm_unpacklo_epi8(a, b), z);
+			__m128i ww = _mm_set1_epi32(((u32)(u16)w[k + 1] << 16) | (u16)w[k]);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(ab, ww));
+		}
+		if (k < n) {
+			__m128i a = _mm_cvtsi32_si128(load_px(p + k * bpp, bpp));
+			__m128i ab = _mm_unpacklo_epi8(_mm_unpacklo_epi8(a, z), z);
+			__m128i ww = _mm_set1_epi32((u16)w[k]);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(ab, ww));
+		}
+		sum = _mm_srai_epi32(sum, PRECISION);
+		sum = _mm_packs_epi32(sum, sum);
+		sum = _mm_packus_epi16(sum, sum);
+		store_px(d + x * bpp, _mm_cvtsi128_si32(sum), bpp);
+	}
+}
+
+static void resample_row_h(const u8 *s, u8 *d, i32 dw, const coeffs *c, i32 bpp)
+{
+	switch (bpp) { /* specialize for each pixel size */
+	case 1: resample_row_h_bpp(s, d, dw, c, 1); break;
+	case 2: resample_row_h_bpp(s, d, dw, c, 2); break;
+	case 3: resample_row_h_bpp(s, d, dw, c, 3); break;
+	case 4: resample_row_h_bpp(s, d, dw, c, 4); break;
+	}
+}
+
+/* vertical pass: bytes of two rows are interleaved for pmaddwd,
+   16 bytes at a time regardless of the pixel format. */
+
+static void resample_row_v(const u8 **rows, u8 *d, i32 nbytes, const i16 *w, i32 n)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i r = _mm_set1_epi32(1 << (PRECISION - 1));
+	i32 x = 0, k;
+	for (; x + 16 <= nbytes; x += 16) {
+		__m128i s0 = r, s1 = r, s2 = r, s3 = r;
+		for (k = 0; k < n; k += 2) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(rows[k] + x));
+			__m128i b = k + 1 < n ? _mm_loadu_si128((const __m128i*)(rows[k+1] + x)) : z;
+			u16 w1 = k + 1 < n ? (u16)w[k+1] : 0;
+			__m128i ww = _mm_set1_epi32(((u32)w1 << 16) | (u16)w[k]);
+			__m128i lo = _mm_unpacklo_epi8(a, b);
+			__m128i hi = _mm_unpackhi_epi8(a, b);
+			s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, z), ww));
+			s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, z), ww));
+			s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, z), ww));
+			s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, z), ww));
+		}
+		s0 = _mm_packs_epi32(_mm_srai_epi32(s0, PRECISION), _mm_srai_epi32(s1, PRECISION));
+		s2 = _mm_packs_epi32(_mm_srai_epi32(s2, PRECISION), _mm_srai_epi32(s3, PRECISION));
+		_mm_storeu_si128((__m128i*)(d + x), _mm_packus_epi16(s0, s2));
+	}
+	for (; x < nbytes; x++) {
+		i32 sum = 1 << (PRECISION - 1);
+		for (k = 0; k < n; k++)
+			sum += rows[k][x] * w[k];
+		sum >>= PRECISION;
+		d[x] = sum < 0 ? 0 : sum > 255 ? 255 : sum;
+	}
+}
+
+/* box-reduce by integer factors fx, fy. the last block in a row or
+   column can be smaller and is averaged over the pixels it has. the rows
+   of a block are first summed into `acc` (sw * bpp column sums) with SSE2,
+   then the columns of each block are summed. */
+
+static void add_row(u32 *acc, const u8 *p, i32 n)
+{
+	__m128i z = _mm_setzero_si128();
+	i32 x = 0;
+	for (; x + 16 <= n; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p + x));
+		__m128i lo = _mm_unpacklo_epi8(v, z);
+		__m128i hi = _mm_unpackhi_epi8(v, z);
+		__m128i *a = (__m128i*)(acc + x);
+		_mm_storeu_si128(a+0, _mm_add_epi32(_mm_loadu_si128(a+0), _mm_unpacklo_epi16(lo, z)));
+		_mm_storeu_si128(a+1, _mm_add_epi32(_mm_loadu_si128(a+1), _mm_unpackhi_epi16(lo, z)));
+		_mm_storeu_si128(a+2, _mm_add_epi32(_mm_loadu_si128(a+2), _mm_unpacklo_epi16(hi, z)));
+		_mm_storeu_si128(a+3, _mm_add_epi32(_mm_loadu_si128(a+3), _mm_unpackhi_epi16(hi, z)));
+	}
+	for (; x < n; x++)
+		acc[x] += p[x];
+}
+
+static void box_reduce(const u8 *s, i32 sstride, i32 sw, i32 sh,
+	u8 *d, i32 dstride, i32 fx, i32 fy, i32 bpp, u32 *acc)
+{
+	i32 dw = (sw + fx - 1) / fx;
+	i32 dh = (sh + fy - 1) / fy;
+	i32 x, y, i, j, c;
+	for (y = 0; y < dh; y++, d += dstride) {
+		i32 bh = sh - y * fy < fy ? sh - y * fy : fy;
+		memset(acc, 0, sw * bpp * sizeof(u32));
+		for (j = 0; j < bh; j++)
+			add_row(acc, s + (y * fy + j) * sstride, sw * bpp);
+		for (x = 0; x < dw; x++) {
+			i32 bw = sw - x * fx < fx ? sw - x * fx : fx;
+			u32 cnt = bw * bh;
+			const u32 *a = acc + x * fx * bpp;
+			for (c = 0; c < bpp; c++) {
+				u32 sum = 0;
+				for (i = 0; i < bw; i++)
+					sum += a[i * bpp + c];
+				d[x * bpp + c] = (sum + cnt / 2) / cnt;
+			}
+		}
+	}
+}
+
+static i32 bytes_per_pixel8(i32 fmt)
+{
+	switch (fmt) {
+	case BITMAP_G8: return 1;
+	case BITMAP_GA8: return 2;
+	case BITMAP_RGB8: case BITMAP_BGR8: return 3;
+	case BITMAP_RGBA8: case BITMAP_BGRA8: case BITMAP_ARGB8: return 4;
+	}
+	return 0;
+}
+
+i32 bitmap_resize(i32 format,
+	const u8 *src, i32 src_stride, i32 sw, i32 sh,
+	u8 *dst, i32 dst_stride, i32 dw, i32 dh,
+	i32 filter)
+{
+	i32 bpp = bytes_per_pixel8(format);
+	i32 fx, fy, y, k, ring_size, next_row, ret = -1;
+	coeffs cx = {0}, cy = {0};
+	u8 *reduced = 0, *ring = 0;
+	u32 *acc = 0;
+	const u8 **rows = 0;
+	i32 row_size = dw * bpp;
+
+	if (!bpp || filter < 1 || filter >= BITMAP_FILTER_COUNT)
+		return 0;
+	if (sw < 1 || sh < 1 || dw < 1 || dh < 1)
+		return 1;
+
+	/* box-reduce so that the filtered pass downscales by at most 2x */
+	fx = sw / dw / 2; if (fx < 1) fx = 1;
+	fy = sh / dh / 2; if (fy < 1) fy = 1;
+	if (fx > 1 || fy > 1) {
+		i32 rw = (sw + fx - 1) / fx;
+		i32 rh = (sh + fy - 1) / fy;
+		reduced = malloc(rw * rh * bpp);
+		acc = malloc(sw * bpp * sizeof(u32));
+		if (!reduced || !acc)
+			goto out;
+		box_reduce(src, src_stride, sw, sh, reduced, rw * bpp, fx, fy, bpp, acc);
+		src = reduced;
+		src_stride = rw * bpp;
+		sw = rw;
+		sh = rh;
+	}
+
+	if (!coeffs_init(&cx, sw, dw, &filters[filter]))
+		goto out;
+	if (!coeffs_init(&cy, sh, dh, &filters[filter]))
+		goto out;
+
+	/* the window of source rows only moves forward so a ring of
+	   horizontally resampled rows as large as the window is enough. */
+	ring_size = cy.taps + 1;
+	ring = malloc(ring_size * row_size);
+	rows = malloc(cy.taps * sizeof(u8*));
+	if (!ring || !rows)
+		goto out;
+
+	next_row = 0;
+	for (y = 0; y < dh; y++) {
+		i32 y0 = cy.start[y];
+		i32 n = cy.n[y];
+		if (next_row < y0)
+			next_row = y0;
+		for (; next_row < y0 + n; next_row++)
+			resample_row_h(src + next_row * src_stride,
+				ring + (next_row % ring_size) * row_size, dw, &cx, bpp);
+		for (k = 0; k < n; k++)
+			rows[k] = ring + ((y0 + k) % ring_size) * row_size;
+		resample_row_v(rows, dst + y * dst_stride, row_size, cy.w + y * cy.taps, n);
+	}
+	ret = 1;
+out:
+	coeffs_free(&cx);
+	coeffs_free(&cy);
+	free(reduced);
+	free(acc);
+	free(ring);
+	free(rows);
+	return ret;
+}
@@ -3,11 +3,28 @@
 	Written by Cosmin Apreutesei. Public Domain.
 
 	Compile with: gcc boxblur.c -ansi -pedantic -Wall -msse2 -DSSE -O3
+
+	Sums are kept in 16bit unsigned ints which wrap around harmlessly while
+	moving the window, so they are exact for radius <= 128.
+
+	With SSE, the vertical pass has an AVX2 variant which is selected at
+	runtime based on CPU support.
 */
 
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600 /* for SRW locks and condition variables */
+#endif
 #include <x86intrin.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "boxblur.h"
 
 #ifdef SSE
@@ -16,149 +33,479 @@
 	#define X_INC 1
 #endif
 
-void boxblur_g8(u8 *src, u8 *dst, i32 width, i32 height,
-	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
-	i16* blurx, i16* sumx)
+#define MAX_RADIUS 128
+
+/* moving average on x ----------------------------------------------------- */
+
+/* blur one row of `n` pixels of `ch` interleaved channels into xrow. */
+static void blur_x(u8 *row, u16 *xrow, i32 n, i32 ch, i32 radius, u16 factor)
 {
-	int x, y;
-	i16 factor;
+	int x, c;
 #ifdef SSE
-	__m128i factors;
+	__m128i factors = _mm_set1_epi16(factor);
+	__m128i zero = _mm_setzero_si128();
+	__m128i S;
 #endif
+	u16 S0[4] = {0, 0, 0, 0};
+	u8 *add = row + radius * ch;
+	u8 *sub = row + (-radius - 1) * ch;
 
-	factor = 65536 / (2 * radius + 1);
+	for (x = (-radius - 1) * ch; x < radius * ch; x += ch)
+		for (c = 0; c < ch; c++)
+			S0[c] += row[x + c];
+
+#ifndef SSE
+	for (x = 0; x < n * ch; x += ch)
+		for (c = 0; c < ch; c++) {
+			S0[c] += add[x + c] - sub[x + c];
+			xrow[x + c] = (S0[c] * factor) >> 16;
+		}
+#else
+	/* running sums for 8 samples at a time with a prefix sum over the
+	   per-sample differences, shifted by one pixel at each step. */
+	if (ch == 1)
+		S = _mm_set1_epi16(S0[0]);
+	else
+		S = _mm_set_epi16(S0[3], S0[2], S0[1], S0[0],
+			S0[3], S0[2], S0[1], S0[0]);
+	for (x = 0; x < n * ch; x += 8) {
+		__m128i d = _mm_sub_epi16(
+			_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&add[x]), zero),
+			_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&sub[x]), zero));
+		if (ch == 1) {
+			d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+			d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+		}
+		d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+		S = _mm_add_epi16(S, d);
+		_mm_storeu_si128((__m128i*)&xrow[x], _mm_mulhi_epu16(S, factors));
+		/* broadcast the last pixel's sums */
+		if (ch == 1)
+			S = _mm_shuffle_epi32(_mm_unpackhi_epi16(S, S), 0xff);
+		else
+			S = _mm_unpackhi_epi64(S, S);
+	}
+#endif
+}
+
+/* moving average on y ----------------------------------------------------- */
+
+typedef void (*blur_y_func)(u16 *xrow, u16 *xrow0, u16 *sumx, u8 *dstrow,
+	i32 n, u16 factor);
+
+static void blur_y(u16 *xrow, u16 *xrow0, u16 *sumx, u8 *dstrow,
+	i32 n, u16 factor)
+{
+	int x;
 #ifdef SSE
-	factors = _mm_set1_epi16(factor);
+	__m128i factors = _mm_set1_epi16(factor);
 #endif
-	for (y = -radius; y < height + radius; y++) {
+	for (x = 0; x < n; x += X_INC) {
+#ifndef SSE
+		sumx[x] = sumx[x] + xrow[x] - xrow0[x];
+		dstrow[x] = (sumx[x] * factor) >> 16;
+#else
+		__m128i sumxx = _mm_add_epi16(
+			_mm_loadu_si128((__m128i*)&sumx[x]),
+			_mm_sub_epi16(
+				_mm_loadu_si128((__m128i*)&xrow[x]),
+				_mm_loadu_si128((__m128i*)&xrow0[x])));
 
-		int i;
-		i16 S;
-		u8 *row, *dstrow;
-		i16 *xrow, *xrow0;
+		_mm_storeu_si128((__m128i*)&sumx[x], sumxx);
 
-		row = src + y * src_stride;
-		xrow0 = blurx + (y - 2 * radius - 1) * src_stride;
-		xrow = blurx + y * src_stride;
-		dstrow = dst + (y - radius) * dst_stride;
+		_mm_storel_epi64((__m128i*)&dstrow[x],
+			_mm_packus_epi16(
+				_mm_mulhi_epu16(sumxx, factors),
+				_mm_setzero_si128()));
+#endif
+	}
+}
 
-		S = 0;
-		for (i = (-radius - 1); i < radius; i++) {
-			S += row[i];
-		}
+#ifdef SSE
+__attribute__((target("avx2")))
+static void blur_y_avx2(u16 *xrow, u16 *xrow0, u16 *sumx, u8 *dstrow,
+	i32 n, u16 factor)
+{
+	int x;
+	__m256i factors = _mm256_set1_epi16(factor);
+	for (x = 0; x < n; x += 16) {
+		__m256i p, sumxx = _mm256_add_epi16(
+			_mm256_loadu_si256((__m256i*)&sumx[x]),
+			_mm256_sub_epi16(
+				_mm256_loadu_si256((__m256i*)&xrow[x]),
+				_mm256_loadu_si256((__m256i*)&xrow0[x])));
 
-		/* moving average on x */
-		for (x = 0; x < width; x ++) {
-			S = S + row[x+radius] - row[x-radius-1];
-			xrow[x] = (S * factor) >> 16;
-		}
+		_mm256_storeu_si256((__m256i*)&sumx[x], sumxx);
 
-		/* moving average on y */
-		for (x = 0; x < width; x += X_INC) {
-#ifndef SSE
-			sumx[x] = sumx[x] + xrow[x] - xrow0[x];
-			dstrow[x] = (sumx[x] * factor) >> 16;
+		/* packus works per 128bit lane so gather the low qword of each. */
+		p = _mm256_packus_epi16(
+			_mm256_mulhi_epu16(sumxx, factors),
+			_mm256_setzero_si256());
+		_mm_storeu_si128((__m128i*)&dstrow[x],
+			_mm256_castsi256_si128(_mm256_permute4x64_epi64(p, 0x08)));
+	}
+}
+#endif
+
+static blur_y_func blur_y_impl;
+static i32 avx2_enabled = -1; /* -1 = not yet detected */
+
+i32 boxblur_avx2(i32 enable)
+{
+	i32 supported = 0;
+#ifdef SSE
+	__builtin_cpu_init();
+	supported = __builtin_cpu_supports("avx2") != 0;
+#endif
+	if (enable >= 0 || avx2_enabled < 0) {
+		avx2_enabled = enable != 0 && supported;
+#ifdef SSE
+		blur_y_impl = avx2_enabled ? blur_y_avx2 : blur_y;
 #else
-			__m128i sumxx = _mm_adds_epi16(
-				_mm_loadu_si128((__m128i*)&sumx[x]),
-				_mm_sub_epi16(
-					_mm_loadu_si128((__m128i*)&xrow[x]),
-					_mm_loadu_si128((__m128i*)&xrow0[x])));
-
-			_mm_storeu_si128((__m128i*)&sumx[x], sumxx);
-
-			_mm_storeu_si128((__m128i*)&dstrow[x],
-				_mm_packus_epi16(
-					_mm_mulhi_epi16(sumxx, factors),
-					_mm_setzero_si128()));
+		blur_y_impl = blur_y;
 #endif
-		}
 	}
+	return avx2_enabled;
+}
+
+/* detect the CPU when the library is loaded, before any threads can call
+   it, so that concurrent first calls only read avx2_enabled and blur_y_impl. */
+__attribute__((constructor))
+static void boxblur_avx2_at_load(void)
+{
+	if (avx2_enabled < 0)
+		boxblur_avx2(1);
+}
+
+/* passes ------------------------------------------------------------------ */
+
+/* one blur pass. blurx is addressed with its own stride (in samples). */
+static void blur_pass(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 ch, i32 radius,
+	u16 *blurx, i32 blurx_stride, u16 *sumx)
+{
+	int y;
+	u16 factor = 65536 / (2 * radius + 1);
+	i32 n = width * ch;
+	blur_y_func blur_y_row = blur_y_impl;
+
+	/* rows above -radius are read (as xrow0) but never written, and they
+	   must hold zeroes, same as sumx at the start of each pass. */
+	for (y = -3 * radius - 1; y < -radius; y++)
+		memset(blurx + y * blurx_stride, 0, (n + 16) * sizeof(u16));
+	memset(sumx, 0, (n + 16) * sizeof(u16));
+
+	for (y = -radius; y < height + radius; y++) {
+		u8 *row = src + y * src_stride;
+		u16 *xrow0 = blurx + (y - 2 * radius - 1) * blurx_stride;
+		u16 *xrow = blurx + y * blurx_stride;
+		u8 *dstrow = dst + (y - radius) * dst_stride;
+		blur_x(row, xrow, width, ch, radius, factor);
+		blur_y_row(xrow, xrow0, sumx, dstrow, n, factor);
+	}
+}
 
+static void boxblur(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
+	u16 *blurx, u16 *sumx, i32 ch)
+{
+	int i, y;
+	if (radius > MAX_RADIUS)
+		radius = MAX_RADIUS;
+	if (radius < 1 || passes < 1)
+		return;
+	if (avx2_enabled < 0)
+		boxblur_avx2(1);
+	/* ping-pong between src and dst, re-extending the edges every time. */
+	for (i = 0; i < passes; i++) {
+		u8 *s = i & 1 ? dst : src;
+		u8 *d = i & 1 ? src : dst;
+		i32 ss = i & 1 ? dst_stride : src_stride;
+		i32 ds = i & 1 ? src_stride : dst_stride;
+		if (i > 0)
+			boxblur_extend(s, width, height, ss, ch * 8, radius);
+		blur_pass(s, d, width, height, ss, ds, ch, radius,
+			blurx, src_stride, sumx);
+	}
+	/* with an even number of passes the result is in src. */
+	if (!(passes & 1))
+		for (y = 0; y < height; y++)
+			memcpy(dst + y * dst_stride, src + y * src_stride, width * ch);
+}
+
+void boxblur_g8(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
+	u16* blurx, u16* sumx)
+{
+	boxblur(src, dst, width, height, src_stride, dst_stride, radius, passes,
+		blurx, sumx, 1);
 }
 
 void boxblur_8888(u8 *src, u8 *dst, i32 width, i32 height,
 	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
-	i16* blurx, i16* sumx)
+	u16* blurx, u16* sumx)
 {
+	boxblur(src, dst, width, height, src_stride, dst_stride, radius, passes,
+		blurx, sumx, 4);
+}
 
-	int x, y;
-	i16 factor;
-#ifdef SSE
-	__m128i factors;
+/* multi-threaded blur of unpadded images -------------------------------- */
+
+/* The image is split into horizontal bands, one per thread. Each band reads
+   `radius` rows above and below it (clamped to the image), so bands are
+   independent within a pass. Passes are separated by waiting for all the
+   bands to finish.
+   Rows are copied into a line buffer with clamped edges before blurring,
+   and the x-blurred rows are kept in a ring of 2*radius+2 rows, so the
+   memory needed per thread doesn't depend on the image height. */
+
+typedef struct {
+	/* pass args */
+	u8 *src, *dst;
+	i32 src_stride, dst_stride;
+	/* band args */
+	i32 width, height, ch, radius;
+	i32 y0, y1;
+	/* scratch */
+	u8 *line;  /* (width + 2 * radius + 16) * ch */
+	u8 *out;   /* width * ch + 16 */
+	u16 *ring; /* (2 * radius + 2) rows of width * ch + 16 */
+	u16 *zero; /* width * ch + 16 */
+	u16 *sumx; /* width * ch + 16 */
+} band_t;
+
+static void blur_band(band_t *b)
+{
+	i32 y, i, x, ch = b->ch, r = b->radius;
+	i32 n = b->width * ch;
+	i32 rs = n + 16; /* ring stride */
+	i32 rows = 2 * r + 2;
+	u16 factor = 65536 / (2 * r + 1);
+	u8 *line = b->line + (r + 1) * ch;
+	blur_y_func blur_y_row = blur_y_impl;
+
+	memset(b->sumx, 0, rs * sizeof(u16));
+	for (y = b->y0 - r; y < b->y1 + r; y++) {
+		i32 sy = y < 0 ? 0 : (y >= b->height ? b->height - 1 : y);
+		i32 i0 = y - 2 * r - 1; /* row leaving the window */
+		u16 *xrow = b->ring + ((y - b->y0 + r) % rows) * rs;
+		u16 *xrow0 = i0 < b->y0 - r ? b->zero
+			: b->ring + ((i0 - b->y0 + r) % rows) * rs;
+		u8 *row = b->src + sy * b->src_stride;
+
+		/* copy the row into the line buffer, extending its edges. */
+		memcpy(line, row, n);
+		for (x = -r - 1; x < 0; x++)
+			for (i = 0; i < ch; i++)
+				line[x * ch + i] = row[i];
+		for (x = b->width; x < b->width + r + 8; x++)
+			for (i = 0; i < ch; i++)
+				line[x * ch + i] = row[n - ch + i];
+
+		blur_x(line, xrow, b->width, ch, r, factor);
+		blur_y_row(xrow, xrow0, b->sumx, b->out, n, factor);
+		if (y - r >= b->y0)
+			memcpy(b->dst + (y - r) * b->dst_stride, b->out, n);
+	}
+}
+
+static i32 cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
 #endif
+}
 
-	factor = 65536 / (2 * radius + 1);
-#ifdef SSE
-	factors = _mm_set1_epi16(factor);
+/* thread pool: workers are started as needed and are kept for the life of
+   the process, waiting for the next pass. worker i blurs band i. passes
+   from different threads are run one at a time. */
+
+#ifdef _WIN32
+static SRWLOCK pool_job_lock = SRWLOCK_INIT;
+static SRWLOCK pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE pool_work = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE pool_done = CONDITION_VARIABLE_INIT;
+#define mutex_lock(m)     AcquireSRWLockExclusive(&m)
+#define mutex_unlock(m)   ReleaseSRWLockExclusive(&m)
+#define cond_wait(c, m)   SleepConditionVariableSRW(&c, &m, INFINITE, 0)
+#define cond_signal(c)    WakeConditionVariable(&c)
+#define cond_broadcast(c) WakeAllConditionVariable(&c)
+#else
+static pthread_mutex_t pool_job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+#define mutex_lock(m)     pthread_mutex_lock(&m)
+#define mutex_unlock(m)   pthread_mutex_unlock(&m)
+#define cond_wait(c, m)   pthread_cond_wait(&c, &m)
+#define cond_signal(c)    pthread_cond_signal(&c)
+#define cond_broadcast(c) pthread_cond_broadcast(&c)
 #endif
 
-	for (y = -radius; y < height + radius; y++) {
+static i32 pool_size;       /* number of workers started */
+static band_t *pool_bands;  /* bands of the current pass */
+static i32 pool_nt;         /* workers 1..pool_nt-1 work on the current pass */
+static unsigned pool_gen;   /* pass number */
+static i32 pool_running;    /* workers still working on the current pass */
 
-		int i;
-		i16 S0, S1, S2, S3;
-		u8 *row, *dstrow;
-		i16 *xrow, *xrow0;
-
-		row = src + y * src_stride;
-		xrow0 = blurx + (y - 2 * radius - 1) * src_stride;
-		xrow = blurx + y * src_stride;
-		dstrow = dst + (y - radius) * dst_stride;
-
-		S0 = 0;
-		S1 = 0;
-		S2 = 0;
-		S3 = 0;
-
-		for (i = (-radius-1) * 4; i < radius * 4; i += 4) {
-			S0 += row[i+0];
-			S1 += row[i+1];
-			S2 += row[i+2];
-			S3 += row[i+3];
-		}
+static void pool_worker(i32 id)
+{
+	unsigned gen = 0;
+	band_t *b;
+	mutex_lock(pool_lock);
+	for (;;) {
+		while (pool_gen == gen)
+			cond_wait(pool_work, pool_lock);
+		gen = pool_gen;
+		if (id >= pool_nt) continue; /* not needed for this pass */
+		b = &pool_bands[id];
+		mutex_unlock(pool_lock);
+		blur_band(b);
+		mutex_lock(pool_lock);
+		if (--pool_running == 0)
+			cond_signal(pool_done);
+	}
+}
 
-		for (x = 0; x < width * 4; x += 4) {
-			/* moving average on x */
-			S0 = S0 + row[x + radius * 4 + 0] - row[x + (-radius-1) * 4 + 0];
-			S1 = S1 + row[x + radius * 4 + 1] - row[x + (-radius-1) * 4 + 1];
-			S2 = S2 + row[x + radius * 4 + 2] - row[x + (-radius-1) * 4 + 2];
-			S3 = S3 + row[x + radius * 4 + 3] - row[x + (-radius-1) * 4 + 3];
-			/* horizontal blur */
-#ifndef SSE
-			xrow[x+0] = (S0 * factor) >> 16;
-			xrow[x+1] = (S1 * factor) >> 16;
-			xrow[x+2] = (S2 * factor) >> 16;
-			xrow[x+3] = (S3 * factor) >> 16;
+#ifdef _WIN32
+static DWORD WINAPI pool_thread(void *arg) { pool_worker((i32)(intptr_t)arg); return 0; }
 #else
-			_mm_storeu_si128((__m128i*)&xrow[x],
-				_mm_mulhi_epi16(
-					_mm_set_epi16(0, 0, 0, 0, S3, S2, S1, S0),
-					factors));
+static void *pool_thread(void *arg) { pool_worker((i32)(intptr_t)arg); return 0; }
 #endif
-		}
 
-		/* moving average on y */
-		for (x = 0; x < width * 4; x += X_INC) {
-#ifndef SSE
-			sumx[x] = sumx[x] + xrow[x] - xrow0[x];
-			dstrow[x] = (sumx[x] * factor) >> 16;
+/* start workers until there are n-1 of them. returns the number of threads
+   that can work on a pass, including the calling thread. */
+static i32 pool_grow(i32 n)
+{
+	while (pool_size < n - 1) {
+		void *id = (void*)(intptr_t)(pool_size + 1);
+#ifdef _WIN32
+		HANDLE th = CreateThread(0, 0, pool_thread, id, 0, 0);
+		if (!th) break;
+		CloseHandle(th);
 #else
-			__m128i sumxx = _mm_adds_epi16(
-				_mm_loadu_si128((__m128i*)&sumx[x]),
-				_mm_sub_epi16(
-					_mm_loadu_si128((__m128i*)&xrow[x]),
-					_mm_loadu_si128((__m128i*)&xrow0[x])));
-
-			_mm_storeu_si128((__m128i*)&sumx[x], sumxx);
-
-			_mm_storeu_si128((__m128i*)&dstrow[x],
-				_mm_packus_epi16(
-					_mm_mulhi_epi16(sumxx, factors),
-					_mm_setzero_si128()));
+		pthread_t th;
+		if (pthread_create(&th, 0, pool_thread, id) != 0) break;
+		pthread_detach(th);
 #endif
+		pool_size++;
+	}
+	return pool_size + 1 < n ? pool_size + 1 : n;
+}
+
+/* run a pass on all bands: band 0 on the calling thread, the rest on the
+   workers. bands left without a worker are blurred on the calling thread. */
+static void run_bands(band_t *bands, i32 nb)
+{
+	i32 i, nt;
+	if (nb == 1) {
+		blur_band(&bands[0]);
+		return;
+	}
+	mutex_lock(pool_job_lock);
+	mutex_lock(pool_lock);
+	nt = pool_grow(nb);
+	pool_bands = bands;
+	pool_nt = nt;
+	pool_running = nt - 1;
+	pool_gen++;
+	cond_broadcast(pool_work);
+	mutex_unlock(pool_lock);
+	blur_band(&bands[0]);
+	for (i = nt; i < nb; i++)
+		blur_band(&bands[i]);
+	mutex_lock(pool_lock);
+	while (pool_running > 0)
+		cond_wait(pool_done, pool_lock);
+	mutex_unlock(pool_lock);
+	mutex_unlock(pool_job_lock);
+}
+
+i32 boxblur_mt(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 bpp, i32 radius, i32 passes,
+	i32 threads)
+{
+	i32 i, p, nb, band_h, ch = bpp >> 3;
+	i32 n = width * ch;
+	size_t scratch_size;
+	band_t bands[256];
+	u8 *scratch = 0, *tmp = 0;
+	i32 ret = 0;
+
+	if (radius > MAX_RADIUS)
+		radius = MAX_RADIUS;
+	if (width < 1 || height < 1)
+		return 1;
+	if (radius < 1 || passes < 1) {
+		for (i = 0; i < height; i++)
+			memcpy(dst + i * dst_stride, src + i * src_stride, n);
+		return 1;
+	}
+	if (avx2_enabled < 0)
+		boxblur_avx2(1);
+
+	/* bands much thinner than the radius would mostly do overlap work. */
+	nb = threads > 0 ? threads : cpu_count();
+	if (nb > height / (radius > 8 ? radius : 8))
+		nb = height / (radius > 8 ? radius : 8);
+	if (nb < 1) nb = 1;
+	if (nb > 256) nb = 256;
+	band_h = (height + nb - 1) / nb;
+	nb = (height + band_h - 1) / band_h;
+
+	scratch_size =
+		  ((width + 2 * radius + 16) * ch + 15) / 16 * 16 /* line */
+		+ (n + 16 + 15) / 16 * 16                          /* out */
+		+ (2 * radius + 4) * (n + 16) * sizeof(u16);       /* ring, zero, sumx */
+	scratch = (u8*)malloc(scratch_size * nb);
+	if (!scratch)
+		goto done;
+	if (passes > 1) {
+		tmp = (u8*)malloc((size_t)n * height);
+		if (!tmp)
+			goto done;
+	}
+
+	for (i = 0; i < nb; i++) {
+		band_t *b = &bands[i];
+		u8 *m = scratch + scratch_size * i;
+		b->width  = width;
+		b->height = height;
+		b->ch     = ch;
+		b->radius = radius;
+		b->y0     = i * band_h;
+		b->y1     = b->y0 + band_h < height ? b->y0 + band_h : height;
+		b->line   = m; m += ((width + 2 * radius + 16) * ch + 15) / 16 * 16;
+		b->out    = m; m += (n + 16 + 15) / 16 * 16;
+		b->ring   = (u16*)m;
+		b->zero   = b->ring + (2 * radius + 2) * (n + 16);
+		b->sumx   = b->zero + (n + 16);
+		memset(b->zero, 0, (n + 16) * sizeof(u16));
+	}
+
+	/* ping-pong between dst and tmp, starting from src and ending in dst. */
+	for (p = 0; p < passes; p++) {
+		i32 to_dst = (passes - p) & 1;
+		u8 *s = p == 0 ? src : (to_dst ? tmp : dst);
+		i32 ss = p == 0 ? src_stride : (to_dst ? n : dst_stride);
+		for (i = 0; i < nb; i++) {
+			bands[i].src = s;
+			bands[i].src_stride = ss;
+			bands[i].dst = to_dst ? dst : tmp;
+			bands[i].dst_stride = to_dst ? dst_stride : n;
 		}
+		run_bands(bands, nb);
 	}
+	ret = 1;
 
+done:
+	free(tmp);
+	free(scratch);
+	return ret;
 }
 
 void boxblur_extend(u8 *src, i32 width, i32 height,
@@ -189,4 +536,3 @@ void boxblur_extend(u8 *src, i32 width, i32 height,
 	}
 
 }
-
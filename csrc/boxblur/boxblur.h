@@ -3,15 +3,26 @@
 
 typedef unsigned char u8;
 typedef short i16;
+typedef unsigned short u16;
 typedef int i32;
 
 void boxblur_g8(u8 *src, u8 *dst, i32 width, i32 height,
 	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
-	i16* blurx, i16* sumx);
+	u16* blurx, u16* sumx);
 
 void boxblur_8888(u8 *src, u8 *dst, i32 width, i32 height,
 	i32 src_stride, i32 dst_stride, i32 radius, i32 passes,
-	i16* blurx, i16* sumx);
+	u16* blurx, u16* sumx);
+
+/* enable/disable the AVX2 kernels (if supported), or query with -1. */
+i32 boxblur_avx2(i32 enable);
+
+/* blur without padding: edges are clamped internally. the image is split
+   into horizontal bands which are blurred on `threads` threads (0 = one
+   per CPU). src is not modified. returns 0 if out of memory. */
+i32 boxblur_mt(u8 *src, u8 *dst, i32 width, i32 height,
+	i32 src_stride, i32 dst_stride, i32 bpp, i32 radius, i32 passes,
+	i32 threads);
 
 void boxblur_extend(u8 *src, i32 width, i32 height,
 	i32 src_stride, i32 bpp, i32 radius);
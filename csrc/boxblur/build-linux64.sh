@@ -1 +1 @@
-P=linux64 C=-fPIC L="-s -static-libgcc" D=libboxblur.so A=libboxblur.a ./build.sh
+P=linux64 C=-fPIC L="-s -static-libgcc -lpthread" D=libboxblur.so A=libboxblur.a ./build.sh
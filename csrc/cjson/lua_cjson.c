@@ -752,6 +752,141 @@ static int json_encode(lua_State *l)
 static void json_process_value(lua_State *l, json_parse_t *json,
                                json_token_t *token);
 
+/* Vectorised scanning of string contents and whitespace runs, 16 (SSE2)
+ * or 32 (AVX2, when the CPU supports it) bytes at a time.
+ *
+ * Loads are aligned so they never cross a page boundary, which makes it
+ * safe to read past the terminating NUL of the Lua string. Bytes before
+ * the start pointer are masked out.
+ *
+ * json_scan_string() returns a pointer to the first '"', '\\' or NUL at or
+ * after p, json_skip_whitespace() to the first non-whitespace character. */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || \
+    (defined(__i386__) && defined(__SSE2__)))
+
+#include <stdint.h>
+#include <immintrin.h>
+
+static const char *json_scan_string_sse2(const char *p)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+    const char *a = (const char *)((uintptr_t)p & ~(uintptr_t)15);
+    unsigned mask = 0xffffu << (p - a);
+
+    for (;; a += 16) {
+        __m128i v = _mm_load_si128((const __m128i *)a);
+        __m128i m = _mm_or_si128(_mm_or_si128(
+            _mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmpeq_epi8(v, zero));
+        mask &= (unsigned)_mm_movemask_epi8(m);
+        if (mask)
+            return a + __builtin_ctz(mask);
+        mask = 0xffffu;
+    }
+}
+
+static const char *json_skip_whitespace_sse2(const char *p)
+{
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const char *a = (const char *)((uintptr_t)p & ~(uintptr_t)15);
+    unsigned mask = 0xffffu << (p - a);
+
+    for (;; a += 16) {
+        __m128i v = _mm_load_si128((const __m128i *)a);
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+        mask &= ~(unsigned)_mm_movemask_epi8(m);
+        if (mask)
+            return a + __builtin_ctz(mask);
+        mask = 0xffffu;
+    }
+}
+
+__attribute__((target("avx2")))
+static const char *json_scan_string_avx2(const char *p)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i zero = _mm256_setzero_si256();
+    const char *a = (const char *)((uintptr_t)p & ~(uintptr_t)31);
+    unsigned mask = 0xffffffffu << (p - a);
+
+    for (;; a += 32) {
+        __m256i v = _mm256_load_si256((const __m256i *)a);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpeq_epi8(v, zero));
+        mask &= (unsigned)_mm256_movemask_epi8(m);
+        if (mask)
+            return a + __builtin_ctz(mask);
+        mask = 0xffffffffu;
+    }
+}
+
+__attribute__((target("avx2")))
+static const char *json_skip_whitespace_avx2(const char *p)
+{
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const char *a = (const char *)((uintptr_t)p & ~(uintptr_t)31);
+    unsigned mask = 0xffffffffu << (p - a);
+
+    for (;; a += 32) {
+        __m256i v = _mm256_load_si256((const __m256i *)a);
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, nl)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, cr)));
+        mask &= ~(unsigned)_mm256_movemask_epi8(m);
+        if (mask)
+            return a + __builtin_ctz(mask);
+        mask = 0xffffffffu;
+    }
+}
+
+static const char *(*json_scan_string)(const char *) = json_scan_string_sse2;
+static const char *(*json_skip_whitespace)(const char *) = json_skip_whitespace_sse2;
+
+static void json_simd_init()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        json_scan_string = json_scan_string_avx2;
+        json_skip_whitespace = json_skip_whitespace_avx2;
+    }
+}
+
+#else
+
+static const char *json_scan_string(const char *p)
+{
+    while (*p != '"' && *p != '\\' && *p)
+        p++;
+    return p;
+}
+
+static const char *json_skip_whitespace(const char *p)
+{
+    while (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')
+        p++;
+    return p;
+}
+
+static void json_simd_init()
+{
+    /* Do nothing - not supported */
+}
+
+#endif
+
 static int hexdigit2int(char hex)
 {
     if ('0' <= hex  && hex <= '9')
@@ -901,13 +1036,24 @@ static void json_set_token_error(json_token_t *token, json_parse_t *json,
 static void json_next_string_token(json_parse_t *json, json_token_t *token)
 {
     char *escape2char = json->cfg->escape2char;
+    const char *run, *end;
     char ch;
 
     /* Caller must ensure a string is next */
     assert(*json->ptr == '"');
 
     /* Skip " */
-    json->ptr++;
+    run = ++json->ptr;
+    end = json_scan_string(run);
+
+    /* Strings without escapes are returned from the JSON text itself */
+    if (*end == '"') {
+        json->ptr = end + 1;
+        token->type = T_STRING;
+        token->value.string = run;
+        token->string_len = end - run;
+        return;
+    }
 
     /* json->tmp is the temporary strbuf used to accumulate the
      * decoded string value.
@@ -915,7 +1061,14 @@ static void json_next_string_token(json_parse_t *json, json_token_t *token)
      */
     strbuf_reset(json->tmp);
 
-    while ((ch = *json->ptr) != '"') {
+    while (1) {
+        /* Append the run of normal characters up to the next '"', '\\'
+         * or end of string */
+        strbuf_append_mem_unsafe(json->tmp, run, end - run);
+        json->ptr = end;
+        if ((ch = *json->ptr) == '"')
+            break;
+
         if (!ch) {
             /* Premature end of the string */
             json_set_token_error(token, json, "unexpected end of string");
@@ -930,8 +1083,11 @@ static void json_next_string_token(json_parse_t *json, json_token_t *token)
             /* Translate escape code and append to tmp string */
             ch = escape2char[(unsigned char)ch];
             if (ch == 'u') {
-                if (json_append_unicode_escape(json) == 0)
+                if (json_append_unicode_escape(json) == 0) {
+                    run = json->ptr;
+                    end = json_scan_string(run);
                     continue;
+                }
 
                 json_set_token_error(token, json,
                                      "invalid unicode escape code");
@@ -945,10 +1101,12 @@ static void json_next_string_token(json_parse_t *json, json_token_t *token)
             /* Skip '\' */
             json->ptr++;
         }
-        /* Append normal character or translated single character
+        /* Append translated single character
          * Unicode escapes are handled above */
         strbuf_append_char_unsafe(json->tmp, ch);
         json->ptr++;
+        run = json->ptr;
+        end = json_scan_string(run);
     }
     json->ptr++;    /* Eat final quote (") */
 
@@ -1039,6 +1197,9 @@ static void json_next_token(json_parse_t *json, json_token_t *token)
         if (token->type != T_WHITESPACE)
             break;
         json->ptr++;
+        /* Skip runs of whitespace (eg. indentation) vectorised */
+        if (ch2token[(unsigned char)*json->ptr] == T_WHITESPACE)
+            json->ptr = json_skip_whitespace(json->ptr);
     }
 
     /* Store location of new token. Required when throwing errors
@@ -1377,6 +1538,9 @@ static int lua_cjson_new(lua_State *l)
     /* Initialise number conversions */
     fpconv_init();
 
+    /* Select the vectorised scanning functions for this CPU */
+    json_simd_init();
+
     /* cjson module table */
     lua_newtable(l);
 
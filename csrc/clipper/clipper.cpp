@@ -652,19 +652,6 @@ void ReversePolyPtLinks(OutPt *pp)
 }
 //------------------------------------------------------------------------------
 
-void DisposeOutPts(OutPt*& pp)
-{
-  if (pp == 0) return;
-  pp->prev->next = 0;
-  while( pp )
-  {
-    OutPt *tmpPp = pp;
-    pp = pp->next;
-    delete tmpPp;
-  }
-}
-//------------------------------------------------------------------------------
-
 void InitEdge(TEdge *e, TEdge *eNext,
   TEdge *ePrev, const IntPoint &pt, PolyType polyType)
 {
@@ -821,10 +808,10 @@ bool Pt3IsBetweenPt1AndPt2(const IntPoint pt1,
 }
 //------------------------------------------------------------------------------
 
-OutPt* InsertPolyPtBetween(OutPt* p1, OutPt* p2, const IntPoint pt)
+OutPt* InsertPolyPtBetween(Arena& arena, OutPt* p1, OutPt* p2, const IntPoint pt)
 {
   if (p1 == p2) throw "JoinError";
-  OutPt* result = new OutPt;
+  OutPt* result = arena.New<OutPt>();
   result->pt = pt;
   if (p2 == p1->next)
   {
@@ -842,6 +829,46 @@ OutPt* InsertPolyPtBetween(OutPt* p1, OutPt* p2, const IntPoint pt)
   return result;
 }
 
+//------------------------------------------------------------------------------
+// Arena methods ...
+//------------------------------------------------------------------------------
+
+void* Arena::Alloc(size_t size)
+{
+  size = (size + 15) & ~(size_t)15;
+  while (m_Block < m_Blocks.size())
+  {
+    if (m_Pos + size <= m_Sizes[m_Block])
+    {
+      void* result = m_Blocks[m_Block] + m_Pos;
+      m_Pos += size;
+      return result;
+    }
+    m_Block++;
+    m_Pos = 0;
+  }
+  //out of blocks: add one twice the size of the last one (4K to 1M) ...
+  size_t blockSize = m_Sizes.empty() ? 4096 : m_Sizes.back() * 2;
+  if (blockSize > 0x100000) blockSize = 0x100000;
+  if (blockSize < size) blockSize = size;
+  char* block = (char*)malloc(blockSize);
+  if (!block) throw std::bad_alloc();
+  m_Blocks.push_back(block);
+  m_Sizes.push_back(blockSize);
+  m_Block = m_Blocks.size() - 1;
+  m_Pos = size;
+  return block;
+}
+//------------------------------------------------------------------------------
+
+void Arena::Release()
+{
+  for (size_t i = 0; i < m_Blocks.size(); ++i) free(m_Blocks[i]);
+  m_Blocks.clear();
+  m_Sizes.clear();
+  Reset();
+}
+
 //------------------------------------------------------------------------------
 // ClipperBase class methods ...
 //------------------------------------------------------------------------------
@@ -851,6 +878,7 @@ ClipperBase::ClipperBase() //constructor
   m_MinimaList = 0;
   m_CurrentLM = 0;
   m_UseFullRange = true;
+  m_ReuseMemory = false;
 }
 //------------------------------------------------------------------------------
 
@@ -886,7 +914,8 @@ bool ClipperBase::AddPolygon(const Polygon &pg, PolyType polyType)
   if (m_UseFullRange) maxVal = hiRange; else maxVal = loRange;
   RangeTest(pg[0], maxVal);
 
-  Polygon p(len);
+  Polygon &p = m_TmpPoly;
+  if ((int)p.size() < len) p.resize(len);
   p[0] = pg[0];
   int j = 0;
 
@@ -923,7 +952,7 @@ bool ClipperBase::AddPolygon(const Polygon &pg, PolyType polyType)
   if (len < 3) return false;
 
   //create a new edge array ...
-  TEdge *edges = new TEdge [len];
+  TEdge *edges = m_Arena.NewArray<TEdge>(len);
   m_edges.push_back(edges);
 
   //convert vertices to a double-linked-list of edges and initialize ...
@@ -1006,7 +1035,7 @@ TEdge* ClipperBase::AddBoundsToLML(TEdge *e)
   }
 
   //e and e.prev are now at a local minima ...
-  LocalMinima* newLm = new LocalMinima;
+  LocalMinima* newLm = m_Arena.New<LocalMinima>();
   newLm->next = 0;
   newLm->Y = e->prev->ybot;
 
@@ -1051,8 +1080,12 @@ bool ClipperBase::AddPolygons(const Polygons &ppg, PolyType polyType)
 void ClipperBase::Clear()
 {
   DisposeLocalMinimaList();
-  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i) delete [] m_edges[i];
   m_edges.clear();
+  if (m_ReuseMemory) m_Arena.Reset(); else
+  {
+    m_Arena.Release();
+    Polygon().swap(m_TmpPoly);
+  }
   m_UseFullRange = false;
 }
 //------------------------------------------------------------------------------
@@ -1091,12 +1124,7 @@ void ClipperBase::Reset()
 
 void ClipperBase::DisposeLocalMinimaList()
 {
-  while( m_MinimaList )
-  {
-    LocalMinima* tmpLm = m_MinimaList->next;
-    delete m_MinimaList;
-    m_MinimaList = tmpLm;
-  }
+  m_MinimaList = 0; //owned by m_Arena
   m_CurrentLM = 0;
 }
 //------------------------------------------------------------------------------
@@ -1155,7 +1183,6 @@ IntRect ClipperBase::GetBounds()
 
 Clipper::Clipper() : ClipperBase() //constructor
 {
-  m_Scanbeam = 0;
   m_ActiveEdges = 0;
   m_SortedEdges = 0;
   m_IntersectNodes = 0;
@@ -1169,7 +1196,6 @@ Clipper::Clipper() : ClipperBase() //constructor
 Clipper::~Clipper() //destructor
 {
   Clear();
-  DisposeScanbeamList();
 }
 //------------------------------------------------------------------------------
 
@@ -1177,27 +1203,23 @@ void Clipper::Clear()
 {
   if (m_edges.empty()) return; //avoids problems with ClipperBase destructor
   DisposeAllPolyPts();
-  ClipperBase::Clear();
-}
-//------------------------------------------------------------------------------
-
-void Clipper::DisposeScanbeamList()
-{
-  while ( m_Scanbeam ) {
-  Scanbeam* sb2 = m_Scanbeam->next;
-  delete m_Scanbeam;
-  m_Scanbeam = sb2;
+  if (m_ReuseMemory) m_OutArena.Reset(); else
+  {
+    m_OutArena.Release();
+    ScanbeamList().swap(m_Scanbeam);
   }
+  ClipperBase::Clear();
 }
 //------------------------------------------------------------------------------
 
 void Clipper::Reset()
 {
   ClipperBase::Reset();
-  m_Scanbeam = 0;
+  m_Scanbeam.clear();
   m_ActiveEdges = 0;
   m_SortedEdges = 0;
   DisposeAllPolyPts();
+  m_OutArena.Reset();
   LocalMinima* lm = m_MinimaList;
   while (lm)
   {
@@ -1212,13 +1234,12 @@ bool Clipper::Execute(ClipType clipType, Polygons &solution,
 {
   if( m_ExecuteLocked ) return false;
   m_ExecuteLocked = true;
-  solution.resize(0);
   m_SubjFillType = subjFillType;
   m_ClipFillType = clipFillType;
   m_ClipType = clipType;
   m_UsingPolyTree = false;
   bool succeeded = ExecuteInternal();
-  if (succeeded) BuildResult(solution);
+  if (succeeded) BuildResult(solution); else solution.resize(0);
   m_ExecuteLocked = false;
   return succeeded;
 }
@@ -1271,7 +1292,7 @@ bool Clipper::ExecuteInternal()
       if (!succeeded) break;
       ProcessEdgesAtTopOfScanbeam(topY);
       botY = topY;
-    } while( m_Scanbeam );
+    } while( !m_Scanbeam.empty() );
   }
   catch(...) {
     succeeded = false;
@@ -1303,37 +1324,19 @@ bool Clipper::ExecuteInternal()
 
 void Clipper::InsertScanbeam(const long64 Y)
 {
-  if( !m_Scanbeam )
-  {
-    m_Scanbeam = new Scanbeam;
-    m_Scanbeam->next = 0;
-    m_Scanbeam->Y = Y;
-  }
-  else if(  Y > m_Scanbeam->Y )
-  {
-    Scanbeam* newSb = new Scanbeam;
-    newSb->Y = Y;
-    newSb->next = m_Scanbeam;
-    m_Scanbeam = newSb;
-  } else
-  {
-    Scanbeam* sb2 = m_Scanbeam;
-    while( sb2->next  && ( Y <= sb2->next->Y ) ) sb2 = sb2->next;
-    if(  Y == sb2->Y ) return; //ie ignores duplicates
-    Scanbeam* newSb = new Scanbeam;
-    newSb->Y = Y;
-    newSb->next = sb2->next;
-    sb2->next = newSb;
-  }
+  //duplicates are allowed in the heap and skipped by PopScanbeam() ...
+  m_Scanbeam.push_back(Y);
+  std::push_heap(m_Scanbeam.begin(), m_Scanbeam.end());
 }
 //------------------------------------------------------------------------------
 
 long64 Clipper::PopScanbeam()
 {
-  long64 Y = m_Scanbeam->Y;
-  Scanbeam* sb2 = m_Scanbeam;
-  m_Scanbeam = m_Scanbeam->next;
-  delete sb2;
+  long64 Y = m_Scanbeam.front();
+  do {
+    std::pop_heap(m_Scanbeam.begin(), m_Scanbeam.end());
+    m_Scanbeam.pop_back();
+  } while (!m_Scanbeam.empty() && m_Scanbeam.front() == Y);
   return Y;
 }
 //------------------------------------------------------------------------------
@@ -1347,10 +1350,7 @@ void Clipper::DisposeAllPolyPts(){
 
 void Clipper::DisposeOutRec(PolyOutList::size_type index)
 {
-  OutRec *outRec = m_PolyOuts[index];
-  if (outRec->pts) DisposeOutPts(outRec->pts);
-  delete outRec;
-  m_PolyOuts[index] = 0;
+  m_PolyOuts[index] = 0; //OutRec and OutPts are owned by m_OutArena
 }
 //------------------------------------------------------------------------------
 
@@ -1592,7 +1592,7 @@ void Clipper::CopyAELToSEL()
 
 void Clipper::AddJoin(TEdge *e1, TEdge *e2, int e1OutIdx, int e2OutIdx)
 {
-  JoinRec* jr = new JoinRec;
+  JoinRec* jr = m_OutArena.New<JoinRec>();
   if (e1OutIdx >= 0)
     jr->poly1Idx = e1OutIdx; else
     jr->poly1Idx = e1->outIdx;
@@ -1609,15 +1609,13 @@ void Clipper::AddJoin(TEdge *e1, TEdge *e2, int e1OutIdx, int e2OutIdx)
 
 void Clipper::ClearJoins()
 {
-  for (JoinList::size_type i = 0; i < m_Joins.size(); i++)
-    delete m_Joins[i];
   m_Joins.resize(0);
 }
 //------------------------------------------------------------------------------
 
 void Clipper::AddHorzJoin(TEdge *e, int idx)
 {
-  HorzJoinRec* hj = new HorzJoinRec;
+  HorzJoinRec* hj = m_OutArena.New<HorzJoinRec>();
   hj->edge = e;
   hj->savedIdx = idx;
   m_HorizJoins.push_back(hj);
@@ -1626,8 +1624,6 @@ void Clipper::AddHorzJoin(TEdge *e, int idx)
 
 void Clipper::ClearHorzJoins()
 {
-  for (HorzJoinList::size_type i = 0; i < m_HorizJoins.size(); i++)
-    delete m_HorizJoins[i];
   m_HorizJoins.resize(0);
 }
 //------------------------------------------------------------------------------
@@ -2047,7 +2043,7 @@ void Clipper::AppendPolygon(TEdge *e1, TEdge *e2)
 
 OutRec* Clipper::CreateOutRec()
 {
-  OutRec* result = new OutRec;
+  OutRec* result = m_OutArena.New<OutRec>();
   result->isHole = false;
   result->FirstLeft = 0;
   result->pts = 0;
@@ -2066,7 +2062,7 @@ void Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
   {
     OutRec *outRec = CreateOutRec();
     e->outIdx = outRec->idx;
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = m_OutArena.New<OutPt>();
     outRec->pts = newOp;
     newOp->pt = pt;
     newOp->idx = outRec->idx;
@@ -2080,7 +2076,7 @@ void Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
     if ((ToFront && PointsEqual(pt, op->pt)) ||
       (!ToFront && PointsEqual(pt, op->prev->pt))) return;
 
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = m_OutArena.New<OutPt>();
     newOp->pt = pt;
     newOp->idx = outRec->idx;
     newOp->next = op;
@@ -2384,12 +2380,7 @@ bool Clipper::ProcessIntersections(const long64 botY, const long64 topY)
 
 void Clipper::DisposeIntersectNodes()
 {
-  while ( m_IntersectNodes )
-  {
-    IntersectNode* iNode = m_IntersectNodes->next;
-    delete m_IntersectNodes;
-    m_IntersectNodes = iNode;
-  }
+  m_IntersectNodes = 0; //owned by m_OutArena
 }
 //------------------------------------------------------------------------------
 
@@ -2444,7 +2435,7 @@ void Clipper::BuildIntersectList(const long64 botY, const long64 topY)
 
 void Clipper::InsertIntersectNode(TEdge *e1, TEdge *e2, const IntPoint &pt)
 {
-  IntersectNode* newNode = new IntersectNode;
+  IntersectNode* newNode = m_OutArena.New<IntersectNode>();
   newNode->edge1 = e1;
   newNode->edge2 = e2;
   newNode->pt = pt;
@@ -2476,7 +2467,6 @@ void Clipper::ProcessIntersectList()
         m_IntersectNodes->edge2 , m_IntersectNodes->pt, ipBoth );
       SwapPositionsInAEL( m_IntersectNodes->edge1 , m_IntersectNodes->edge2 );
     }
-    delete m_IntersectNodes;
     m_IntersectNodes = iNode;
   }
 }
@@ -2615,7 +2605,6 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
   {
     if (pp->prev == pp || pp->prev == pp->next )
     {
-      DisposeOutPts(pp);
       outrec.pts = 0;
       return;
     }
@@ -2624,11 +2613,9 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
       SlopesEqual(pp->prev->pt, pp->pt, pp->next->pt, m_UseFullRange) )
     {
       lastOK = 0;
-      OutPt *tmp = pp;
       pp->prev->next = pp->next;
       pp->next->prev = pp->prev;
       pp = pp->prev;
-      delete tmp;
     }
     else if (pp == lastOK) break;
     else
@@ -2643,22 +2630,26 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
 
 void Clipper::BuildResult(Polygons &polys)
 {
-  polys.reserve(m_PolyOuts.size());
+  //the polygons already in 'polys' are overwritten in place so that
+  //their buffers get reused when executing repeatedly into the same solution.
+  Polygons::size_type k = 0;
   for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
   {
     if (m_PolyOuts[i]->pts)
     {
-      Polygon pg;
+      if (k == polys.size()) polys.resize(k + 1);
+      Polygon &pg = polys[k];
+      pg.clear();
       OutPt* p = m_PolyOuts[i]->pts;
       do
       {
         pg.push_back(p->pt);
         p = p->prev;
       } while (p != m_PolyOuts[i]->pts);
-      if (pg.size() > 2)
-        polys.push_back(pg);
+      if (pg.size() > 2) k++;
     }
   }
+  polys.resize(k);
 }
 //------------------------------------------------------------------------------
 
@@ -2826,29 +2817,29 @@ bool Clipper::JoinPoints(const JoinRec *j, OutPt *&p1, OutPt *&p2)
   //get p1 & p2 polypts - the overlap start & endpoints on poly1
   if (PointsEqual(pp1a->pt, pt1)) p1 = pp1a;
   else if (PointsEqual(prev->pt, pt1)) p1 = prev;
-  else p1 = InsertPolyPtBetween(pp1a, prev, pt1);
+  else p1 = InsertPolyPtBetween(m_OutArena, pp1a, prev, pt1);
 
   if (PointsEqual(pp1a->pt, pt2)) p2 = pp1a;
   else if (PointsEqual(prev->pt, pt2)) p2 = prev;
   else if ((p1 == pp1a) || (p1 == prev))
-    p2 = InsertPolyPtBetween(pp1a, prev, pt2);
+    p2 = InsertPolyPtBetween(m_OutArena, pp1a, prev, pt2);
   else if (Pt3IsBetweenPt1AndPt2(pp1a->pt, p1->pt, pt2))
-    p2 = InsertPolyPtBetween(pp1a, p1, pt2); else
-    p2 = InsertPolyPtBetween(p1, prev, pt2);
+    p2 = InsertPolyPtBetween(m_OutArena, pp1a, p1, pt2); else
+    p2 = InsertPolyPtBetween(m_OutArena, p1, prev, pt2);
 
   //get p3 & p4 polypts - the overlap start & endpoints on poly2
   prev = pp2a->prev;
   if (PointsEqual(pp2a->pt, pt1)) p3 = pp2a;
   else if (PointsEqual(prev->pt, pt1)) p3 = prev;
-  else p3 = InsertPolyPtBetween(pp2a, prev, pt1);
+  else p3 = InsertPolyPtBetween(m_OutArena, pp2a, prev, pt1);
 
   if (PointsEqual(pp2a->pt, pt2)) p4 = pp2a;
   else if (PointsEqual(prev->pt, pt2)) p4 = prev;
   else if ((p3 == pp2a) || (p3 == prev))
-    p4 = InsertPolyPtBetween(pp2a, prev, pt2);
+    p4 = InsertPolyPtBetween(m_OutArena, pp2a, prev, pt2);
   else if (Pt3IsBetweenPt1AndPt2(pp2a->pt, p3->pt, pt2))
-    p4 = InsertPolyPtBetween(pp2a, p3, pt2); else
-    p4 = InsertPolyPtBetween(p3, prev, pt2);
+    p4 = InsertPolyPtBetween(m_OutArena, pp2a, p3, pt2); else
+    p4 = InsertPolyPtBetween(m_OutArena, p3, prev, pt2);
 
   //p1.pt == p3.pt and p2.pt == p4.pt so join p1 to p3 and p2 to p4 ...
   if (p1->next == p2 && p3->prev == p4)
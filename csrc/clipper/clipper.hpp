@@ -39,6 +39,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <ostream>
+#include <new>
 
 namespace ClipperLib {
 
@@ -169,11 +170,6 @@ struct LocalMinima {
   LocalMinima  *next;
 };
 
-struct Scanbeam {
-  long64    Y;
-  Scanbeam *next;
-};
-
 struct OutPt; //forward declaration
 
 struct OutRec {
@@ -212,6 +208,31 @@ typedef std::vector < OutRec* > PolyOutList;
 typedef std::vector < TEdge* > EdgeList;
 typedef std::vector < JoinRec* > JoinList;
 typedef std::vector < HorzJoinRec* > HorzJoinList;
+typedef std::vector < long64 > ScanbeamList; //binary max-heap of Y values
+
+//Arena is a bump allocator for the clipper's internal records (edges, local
+//minima, output points, joins, intersections). Records are never freed one
+//by one: Reset() rewinds the arena while keeping its blocks for reuse, and
+//Release() gives the blocks back to the heap.
+class Arena
+{
+public:
+  Arena(): m_Block(0), m_Pos(0) {};
+  ~Arena() {Release();};
+  void* Alloc(size_t size);
+  template <class T> T* New() {return new (Alloc(sizeof(T))) T;};
+  template <class T> T* NewArray(size_t n)
+    {return static_cast<T*>(Alloc(sizeof(T) * n));}; //POD types only
+  void Reset() {m_Block = 0; m_Pos = 0;};
+  void Release();
+private:
+  std::vector < char* > m_Blocks;
+  std::vector < size_t > m_Sizes;
+  size_t m_Block;
+  size_t m_Pos;
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
 
 //ClipperBase is the ancestor to the Clipper class. It should not be
 //instantiated directly. This class simply abstracts the conversion of sets of
@@ -225,6 +246,10 @@ public:
   bool AddPolygons( const Polygons &ppg, PolyType polyType);
   virtual void Clear();
   IntRect GetBounds();
+  //when set, Clear() keeps the allocated memory for the next batch of
+  //polygons instead of returning it to the heap.
+  bool ReuseMemory() {return m_ReuseMemory;};
+  void ReuseMemory(bool value) {m_ReuseMemory = value;};
 protected:
   void DisposeLocalMinimaList();
   TEdge* AddBoundsToLML(TEdge *e);
@@ -234,7 +259,10 @@ protected:
   LocalMinima      *m_CurrentLM;
   LocalMinima      *m_MinimaList;
   bool              m_UseFullRange;
+  bool              m_ReuseMemory;
   EdgeList          m_edges;
+  Arena             m_Arena;    //edges and local minima; reset by Clear()
+  Polygon           m_TmpPoly;  //scratch buffer for AddPolygon()
 };
 
 class Clipper : public virtual ClipperBase
@@ -263,7 +291,7 @@ private:
   JoinList          m_Joins;
   HorzJoinList      m_HorizJoins;
   ClipType          m_ClipType;
-  Scanbeam         *m_Scanbeam;
+  ScanbeamList      m_Scanbeam;
   TEdge           *m_ActiveEdges;
   TEdge           *m_SortedEdges;
   IntersectNode   *m_IntersectNodes;
@@ -273,7 +301,7 @@ private:
   bool             m_ReverseOutput;
   bool             m_UsingPolyTree; 
   bool             m_ForceSimple;
-  void DisposeScanbeamList();
+  Arena            m_OutArena; //output records; reset by each Execute()
   void SetWindingCount(TEdge& edge);
   bool IsEvenOddFillType(const TEdge& edge) const;
   bool IsEvenOddAltFillType(const TEdge& edge) const;
@@ -1,6 +1,15 @@
 //Clipper C wrapper by Cosmin Apreutesei (public domain)
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600 // for SRW locks and condition variables
+#endif
 #include <stdint.h>
 #include "clipper.cpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 using namespace ClipperLib;
 
@@ -182,6 +191,20 @@ export Polygons* clipper_execute(Clipper* clipper, ClipType clipType,
 	}
 }
 
+// execute into an existing solution, reusing its memory; returns 1 on success.
+export int clipper_execute_into(Clipper* clipper, ClipType clipType,
+									PolyFillType subjFillType,
+									PolyFillType clipFillType,
+									Polygons* solution) {
+	try {
+		return clipper->Execute(ClipType(clipType), *solution,
+											PolyFillType(subjFillType),
+											PolyFillType(clipFillType));
+	} catch(...) {
+		return 0;
+	}
+}
+
 export void clipper_clear(Clipper* clipper) {
 	clipper->Clear();
 }
@@ -194,3 +217,484 @@ export void clipper_set_reverse_solution(Clipper* clipper, int reverse) {
 	clipper->ReverseSolution(reverse);
 }
 
+export int clipper_get_reuse_memory(Clipper* clipper) {
+	return clipper->ReuseMemory();
+}
+
+export void clipper_set_reuse_memory(Clipper* clipper, int reuse) {
+	clipper->ReuseMemory(reuse);
+}
+
+// batch API on flat arrays
+
+// a set of rings in flat arrays, optionally grouped in regions.
+// ring i is points rings[i] .. rings[i+1]-1; region i is rings regions[i] ..
+// regions[i+1]-1. if regions is NULL, all the rings make up a single region.
+struct clipper_flat {
+	int64_t* xy;      // x1, y1, x2, y2, ... (2 * npoints)
+	int*     rings;   // nrings + 1 point offsets
+	int*     regions; // nregions + 1 ring offsets, or NULL
+	int      npoints;
+	int      nrings;
+	int      nregions;
+};
+
+static int flat_region_count(const clipper_flat* f) {
+	return f->regions ? f->nregions : 1;
+}
+
+static void flat_region(const clipper_flat* f, int r, int& i1, int& i2) {
+	if (f->regions) {
+		i1 = f->regions[r];
+		i2 = f->regions[r+1];
+	} else {
+		i1 = 0;
+		i2 = f->nrings;
+	}
+}
+
+static void flat_get_ring(const clipper_flat* f, int i, Polygon& p) {
+	int j1 = f->rings[i];
+	int j2 = f->rings[i+1];
+	p.resize(j2 - j1);
+	for (int j = j1; j < j2; j++)
+		p[j - j1] = IntPoint(f->xy[2*j], f->xy[2*j+1]);
+}
+
+static void flat_get_region(const clipper_flat* f, int r, Polygons& pp) {
+	int i1, i2;
+	flat_region(f, r, i1, i2);
+	pp.resize(i2 - i1);
+	for (int i = i1; i < i2; i++)
+		flat_get_ring(f, i, pp[i - i1]);
+}
+
+static IntRect ring_bounds(const Polygon& p) {
+	IntRect r;
+	r.left = r.right = p.empty() ? 0 : p[0].X;
+	r.top = r.bottom = p.empty() ? 0 : p[0].Y;
+	for (Polygon::size_type i = 1; i < p.size(); i++) {
+		if (p[i].X < r.left) r.left = p[i].X;
+		if (p[i].X > r.right) r.right = p[i].X;
+		if (p[i].Y < r.top) r.top = p[i].Y;
+		if (p[i].Y > r.bottom) r.bottom = p[i].Y;
+	}
+	return r;
+}
+
+static bool rects_overlap(const IntRect& a, const IntRect& b) {
+	return a.left <= b.right && b.left <= a.right &&
+		a.top <= b.bottom && b.top <= a.bottom;
+}
+
+// flatten a list of results (one per region) into a malloc'ed clipper_flat.
+static clipper_flat* flat_create(const std::vector<Polygons>& results) {
+	int nrings = 0, npoints = 0;
+	for (size_t r = 0; r < results.size(); r++) {
+		nrings += results[r].size();
+		for (size_t i = 0; i < results[r].size(); i++)
+			npoints += results[r][i].size();
+	}
+	clipper_flat* f = (clipper_flat*)malloc(sizeof(clipper_flat));
+	if (!f) return 0;
+	f->xy = (int64_t*)malloc(sizeof(int64_t) * 2 * (npoints > 0 ? npoints : 1));
+	f->rings = (int*)malloc(sizeof(int) * (nrings + 1));
+	f->regions = (int*)malloc(sizeof(int) * (results.size() + 1));
+	if (!f->xy || !f->rings || !f->regions) {
+		free(f->xy); free(f->rings); free(f->regions); free(f);
+		return 0;
+	}
+	f->npoints = npoints;
+	f->nrings = nrings;
+	f->nregions = results.size();
+	int ri = 0, pi = 0;
+	for (size_t r = 0; r < results.size(); r++) {
+		f->regions[r] = ri;
+		for (size_t i = 0; i < results[r].size(); i++) {
+			const Polygon& p = results[r][i];
+			f->rings[ri++] = pi;
+			for (size_t j = 0; j < p.size(); j++, pi++) {
+				f->xy[2*pi  ] = p[j].X;
+				f->xy[2*pi+1] = p[j].Y;
+			}
+		}
+	}
+	f->regions[results.size()] = ri;
+	f->rings[ri] = pi;
+	return f;
+}
+
+export void clipper_flat_free(clipper_flat* f) {
+	if (!f) return;
+	free(f->xy);
+	free(f->rings);
+	free(f->regions);
+	free(f);
+}
+
+// region -1 means all the rings.
+export Polygons* clipper_flat_polygons(const clipper_flat* f, int region) {
+	try {
+		Polygons* out = new Polygons();
+		if (region < 0) {
+			out->resize(f->nrings);
+			for (int i = 0; i < f->nrings; i++)
+				flat_get_ring(f, i, (*out)[i]);
+		} else
+			flat_get_region(f, region, *out);
+		return out;
+	} catch(...) {
+		return 0;
+	}
+}
+
+export clipper_flat* clipper_polygons_flat(Polygons* poly) {
+	try {
+		std::vector<Polygons> results(1, *poly);
+		return flat_create(results);
+	} catch(...) {
+		return 0;
+	}
+}
+
+// Sutherland-Hodgman clipping of a ring against one side of a rectangle.
+// side: 0 = left, 1 = right, 2 = top, 3 = bottom.
+static bool rect_inside(const IntPoint& p, int side, long64 v) {
+	switch (side) {
+		case 0: return p.X >= v;
+		case 1: return p.X <= v;
+		case 2: return p.Y >= v;
+		default: return p.Y <= v;
+	}
+}
+
+static IntPoint rect_intersect(const IntPoint& a, const IntPoint& b, int side, long64 v) {
+	if (side < 2) {
+		double t = (double)(v - a.X) / (double)(b.X - a.X);
+		return IntPoint(v, a.Y + Round(t * (double)(b.Y - a.Y)));
+	} else {
+		double t = (double)(v - a.Y) / (double)(b.Y - a.Y);
+		return IntPoint(a.X + Round(t * (double)(b.X - a.X)), v);
+	}
+}
+
+static void rect_clip_side(const Polygon& in, Polygon& out, int side, long64 v) {
+	out.clear();
+	if (in.empty()) return;
+	IntPoint prev = in[in.size()-1];
+	bool prev_in = rect_inside(prev, side, v);
+	for (size_t i = 0; i < in.size(); i++) {
+		const IntPoint& p = in[i];
+		bool p_in = rect_inside(p, side, v);
+		if (p_in != prev_in)
+			out.push_back(rect_intersect(prev, p, side, v));
+		if (p_in)
+			out.push_back(p);
+		prev = p;
+		prev_in = p_in;
+	}
+}
+
+static void rect_clip_ring(const Polygon& p, const IntRect& pr, const IntRect& r,
+	Polygon& tmp1, Polygon& tmp2, Polygons& out)
+{
+	if (!rects_overlap(pr, r)) return;
+	if (pr.left >= r.left && pr.right <= r.right &&
+		pr.top >= r.top && pr.bottom <= r.bottom)
+	{
+		out.push_back(p); // fully inside
+		return;
+	}
+	rect_clip_side(p, tmp1, 0, r.left);
+	rect_clip_side(tmp1, tmp2, 1, r.right);
+	rect_clip_side(tmp2, tmp1, 2, r.top);
+	rect_clip_side(tmp1, tmp2, 3, r.bottom);
+	// remove consecutive duplicates (intersections landing on vertices).
+	size_t n = 0;
+	for (size_t i = 0; i < tmp2.size(); i++)
+		if (n == 0 || !PointsEqual(tmp2[i], tmp2[n-1]))
+			tmp2[n++] = tmp2[i];
+	while (n > 1 && PointsEqual(tmp2[n-1], tmp2[0])) n--;
+	if (n < 3) return;
+	tmp2.resize(n);
+	out.push_back(tmp2);
+}
+
+// work queue for the batch functions: one job, many regions, any number of
+// threads pulling region indices from a shared counter.
+
+enum { BATCH_CLIP, BATCH_RECTS, BATCH_OFFSET };
+
+struct batch_job {
+	int kind;
+	Polygons subject;               // all the subject rings
+	std::vector<IntRect> bounds;    // bounds of each subject ring
+	const clipper_flat* clip;       // BATCH_CLIP: clip regions
+	const int64_t* rects;           // BATCH_RECTS: x1, y1, x2, y2 per rect
+	ClipType clipType;
+	PolyFillType subjFillType;
+	PolyFillType clipFillType;
+	double delta;                   // BATCH_OFFSET
+	JoinType joinType;
+	double limit;
+	const clipper_flat* subj;       // BATCH_OFFSET: subject regions
+	std::vector<Polygons> results;  // one result per region
+	volatile int next;
+	volatile int failed;
+};
+
+static void batch_clip_region(batch_job* job, int r, Clipper& clipper,
+	Polygons& clip, Polygons& subj)
+{
+	Polygons& out = job->results[r];
+	flat_get_region(job->clip, r, clip);
+	clipper.Clear();
+	if (job->clipType == ctIntersection) {
+		// subject rings outside the clip region's bounds can't contribute.
+		IntRect cr;
+		bool first = true;
+		for (size_t i = 0; i < clip.size(); i++) {
+			if (clip[i].empty()) continue;
+			IntRect b = ring_bounds(clip[i]);
+			if (first) { cr = b; first = false; continue; }
+			if (b.left < cr.left) cr.left = b.left;
+			if (b.right > cr.right) cr.right = b.right;
+			if (b.top < cr.top) cr.top = b.top;
+			if (b.bottom > cr.bottom) cr.bottom = b.bottom;
+		}
+		if (first) { out.clear(); return; }
+		subj.clear();
+		for (size_t i = 0; i < job->subject.size(); i++)
+			if (rects_overlap(job->bounds[i], cr))
+				subj.push_back(job->subject[i]);
+		if (subj.empty()) { out.clear(); return; }
+		clipper.AddPolygons(subj, ptSubject);
+	} else
+		clipper.AddPolygons(job->subject, ptSubject);
+	clipper.AddPolygons(clip, ptClip);
+	if (!clipper.Execute(job->clipType, out, job->subjFillType, job->clipFillType))
+		job->failed = 1;
+}
+
+static void batch_rects_region(batch_job* job, int r, Polygon& tmp1, Polygon& tmp2) {
+	Polygons& out = job->results[r];
+	IntRect rr;
+	rr.left   = job->rects[4*r  ];
+	rr.top    = job->rects[4*r+1];
+	rr.right  = job->rects[4*r+2];
+	rr.bottom = job->rects[4*r+3];
+	for (size_t i = 0; i < job->subject.size(); i++)
+		rect_clip_ring(job->subject[i], job->bounds[i], rr, tmp1, tmp2, out);
+}
+
+static void batch_offset_region(batch_job* job, int r, Polygons& in) {
+	flat_get_region(job->subj, r, in);
+	OffsetPolygons(in, job->results[r], job->delta, job->joinType, job->limit, false);
+}
+
+static void batch_worker(void* arg) {
+	batch_job* job = (batch_job*)arg;
+	int n = job->results.size();
+	try {
+		Clipper clipper;
+		clipper.ReuseMemory(true);
+		Polygons tmps1, tmps2;
+		Polygon tmp1, tmp2;
+		for (;;) {
+			if (job->failed) return;
+			int r = __sync_fetch_and_add(&job->next, 1);
+			if (r >= n) return;
+			switch (job->kind) {
+				case BATCH_CLIP:   batch_clip_region(job, r, clipper, tmps1, tmps2); break;
+				case BATCH_RECTS:  batch_rects_region(job, r, tmp1, tmp2); break;
+				case BATCH_OFFSET: batch_offset_region(job, r, tmps1); break;
+			}
+		}
+	} catch(...) {
+		job->failed = 1;
+	}
+}
+
+static int cpu_count() {
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+// thread pool for the batch functions: workers are started as needed and
+// are kept for the life of the process, waiting for the next job. jobs from
+// different threads are run one at a time.
+
+#ifdef _WIN32
+static SRWLOCK pool_job_lock = SRWLOCK_INIT;
+static SRWLOCK pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE pool_work = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE pool_done = CONDITION_VARIABLE_INIT;
+#define mutex_lock(m)     AcquireSRWLockExclusive(&m)
+#define mutex_unlock(m)   ReleaseSRWLockExclusive(&m)
+#define cond_wait(c, m)   SleepConditionVariableSRW(&c, &m, INFINITE, 0)
+#define cond_signal(c)    WakeConditionVariable(&c)
+#define cond_broadcast(c) WakeAllConditionVariable(&c)
+#else
+static pthread_mutex_t pool_job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+#define mutex_lock(m)     pthread_mutex_lock(&m)
+#define mutex_unlock(m)   pthread_mutex_unlock(&m)
+#define cond_wait(c, m)   pthread_cond_wait(&c, &m)
+#define cond_signal(c)    pthread_cond_signal(&c)
+#define cond_broadcast(c) pthread_cond_broadcast(&c)
+#endif
+
+static int pool_size;         // number of workers started
+static batch_job* pool_job;   // current job
+static int pool_nt;           // workers 1..pool_nt-1 work on the current job
+static unsigned pool_gen;     // job number
+static int pool_running;      // workers still working on the current job
+
+static void pool_worker(int id) {
+	unsigned gen = 0;
+	mutex_lock(pool_lock);
+	for (;;) {
+		while (pool_gen == gen)
+			cond_wait(pool_work, pool_lock);
+		gen = pool_gen;
+		if (id >= pool_nt) continue; // not needed for this job
+		batch_job* job = pool_job;
+		mutex_unlock(pool_lock);
+		batch_worker(job);
+		mutex_lock(pool_lock);
+		if (--pool_running == 0)
+			cond_signal(pool_done);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_thread(void* arg) { pool_worker((int)(intptr_t)arg); return 0; }
+#else
+static void* pool_thread(void* arg) { pool_worker((int)(intptr_t)arg); return 0; }
+#endif
+
+// start workers until there are n-1 of them. returns the number of threads
+// that can work on a job, including the calling thread.
+static int pool_grow(int n) {
+	while (pool_size < n-1) {
+		void* id = (void*)(intptr_t)(pool_size + 1);
+#ifdef _WIN32
+		HANDLE th = CreateThread(0, 0, pool_thread, id, 0, 0);
+		if (!th) break;
+		CloseHandle(th);
+#else
+		pthread_t th;
+		if (pthread_create(&th, 0, pool_thread, id) != 0) break;
+		pthread_detach(th);
+#endif
+		pool_size++;
+	}
+	return pool_size + 1 < n ? pool_size + 1 : n;
+}
+
+// run the job on the calling thread plus threads-1 workers (0 = one per cpu).
+static clipper_flat* batch_run(batch_job* job, int threads) {
+	int n = job->results.size();
+	int nt = threads > 0 ? threads : cpu_count();
+	if (nt > n) nt = n;
+	if (nt > 256) nt = 256;
+	if (nt < 1) nt = 1;
+	job->next = 0;
+	job->failed = 0;
+	if (nt == 1) {
+		batch_worker(job);
+	} else {
+		mutex_lock(pool_job_lock);
+		mutex_lock(pool_lock);
+		nt = pool_grow(nt);
+		pool_job = job;
+		pool_nt = nt;
+		pool_running = nt - 1;
+		pool_gen++;
+		cond_broadcast(pool_work);
+		mutex_unlock(pool_lock);
+		batch_worker(job);
+		mutex_lock(pool_lock);
+		while (pool_running > 0)
+			cond_wait(pool_done, pool_lock);
+		mutex_unlock(pool_lock);
+		mutex_unlock(pool_job_lock);
+	}
+	if (job->failed) return 0;
+	return flat_create(job->results);
+}
+
+static void batch_set_subject(batch_job* job, const clipper_flat* subj) {
+	job->subject.resize(subj->nrings);
+	job->bounds.resize(subj->nrings);
+	for (int i = 0; i < subj->nrings; i++) {
+		flat_get_ring(subj, i, job->subject[i]);
+		job->bounds[i] = ring_bounds(job->subject[i]);
+	}
+}
+
+// clip all the rings of subj against each region of clip, in parallel.
+// returns one region of results for each clip region.
+export clipper_flat* clipper_clip_batch(const clipper_flat* subj, const clipper_flat* clip,
+									ClipType clipType,
+									PolyFillType subjFillType,
+									PolyFillType clipFillType,
+									int threads) {
+	try {
+		batch_job job;
+		job.kind = BATCH_CLIP;
+		batch_set_subject(&job, subj);
+		job.clip = clip;
+		job.clipType = ClipType(clipType);
+		job.subjFillType = PolyFillType(subjFillType);
+		job.clipFillType = PolyFillType(clipFillType);
+		job.results.resize(flat_region_count(clip));
+		return batch_run(&job, threads);
+	} catch(...) {
+		return 0;
+	}
+}
+
+// intersect all the rings of subj with each of nrects axis-aligned rectangles
+// given as x1, y1, x2, y2, in parallel. rings are clipped independently
+// (Sutherland-Hodgman) so they keep their orientation and fill rule, and
+// concave rings may come out with zero-width edges along the rectangle's sides.
+export clipper_flat* clipper_clip_rects(const clipper_flat* subj,
+									const int64_t* rects, int nrects,
+									int threads) {
+	try {
+		batch_job job;
+		job.kind = BATCH_RECTS;
+		batch_set_subject(&job, subj);
+		job.rects = rects;
+		job.results.resize(nrects);
+		return batch_run(&job, threads);
+	} catch(...) {
+		return 0;
+	}
+}
+
+// offset each region of subj separately, in parallel.
+export clipper_flat* clipper_offset_batch(const clipper_flat* subj,
+									double delta, JoinType jointype, double miter_limit,
+									int threads) {
+	try {
+		batch_job job;
+		job.kind = BATCH_OFFSET;
+		job.subj = subj;
+		job.delta = delta;
+		job.joinType = JoinType(jointype);
+		job.limit = miter_limit;
+		job.results.resize(flat_region_count(subj));
+		return batch_run(&job, threads);
+	} catch(...) {
+		return 0;
+	}
+}
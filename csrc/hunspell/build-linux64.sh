@@ -1,2 +1,2 @@
-P=linux64 C="-fPIC" L="-s -static-libgcc" \
+P=linux64 C="-fPIC -fno-sized-deallocation" L="-s -static-libgcc -lpthread" \
 	D=libhunspell.so A=libhunspell.a ./build.sh
@@ -10,6 +10,7 @@ files="
 	src/filemgr.cxx
 	src/hunzip.cxx
 	src/replist.cxx
+	src/sugindex.cxx
 	extras.cxx
 "
 ${X}g++ -c -O2 $C $files -DHAVE_CONFIG_H -DBUILDING_LIBHUNSPELL=1 -Isrc -fvisibility=hidden
@@ -1,6 +1,215 @@
 // extra hunspell API exposures
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "hunspell.hxx"
 #include "hunspell.h"
+#include "hashmgr.hxx"
+#include "csutil.hxx"
+#include "atypes.hxx"
+
+// batch spell-checking of a text buffer ------------------------------------
+
+// a Hunspell instance is safe to use from many threads at the same time for
+// spell() and suggest() (the affix checker's scratch state is thread-local),
+// so a batch is checked by splitting its words between threads.
+
+typedef struct {
+	int    offset; // byte offset of the word in the text
+	int    len;    // word length in bytes
+	int    nsug;   // number of suggestions
+	char **sug;    // suggestions (NULL if not asked for)
+} Hunspell_misspelling;
+
+struct text_tokenizer {
+	int utf8;
+	struct cs_info * csconv;
+	const char * wordchars;
+	unsigned short * wordchars_utf16;
+	int wordchars_utf16_len;
+};
+
+// decode the char at p; returns its length in bytes.
+static int decode_char(const text_tokenizer * tk, const unsigned char * p,
+	const unsigned char * e, unsigned int * c)
+{
+	if (!tk->utf8 || p[0] < 0x80) { *c = p[0]; return 1; }
+	int n = p[0] >= 0xF0 ? 4 : p[0] >= 0xE0 ? 3 : p[0] >= 0xC0 ? 2 : 1;
+	if (p + n > e) n = e - p;
+	unsigned int v = n == 4 ? p[0] & 0x07 : n == 3 ? p[0] & 0x0F : p[0] & 0x1F;
+	for (int i = 1; i < n; i++) v = (v << 6) | (p[i] & 0x3F);
+	*c = v;
+	return n;
+}
+
+static int is_letter(const text_tokenizer * tk, unsigned int c)
+{
+	if (c < 0x80) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	if (tk->utf8) return c < 0x10000 ? unicodeisalpha((unsigned short) c) : 1;
+	return tk->csconv && tk->csconv[c & 0xFF].clower != tk->csconv[c & 0xFF].cupper;
+}
+
+static int is_wordchar(const text_tokenizer * tk, unsigned int c)
+{
+	if (is_letter(tk, c) || (c >= '0' && c <= '9')) return 1;
+	if (tk->utf8) {
+		for (int i = 0; i < tk->wordchars_utf16_len; i++)
+			if (tk->wordchars_utf16[i] == c) return 1;
+		return 0;
+	}
+	return c && tk->wordchars && strchr(tk->wordchars, (int) c) != NULL;
+}
+
+// split text into words: runs of letters, digits and WORDCHARS of the
+// affix file, without leading and trailing punctuation (a trailing dot is
+// kept only in abbreviations like "e.g."). words without letters are skipped.
+static int tokenize(const text_tokenizer * tk, const char * text, int len,
+	int ** out_words)
+{
+	int cap = 256, n = 0;
+	int * words = (int *) malloc(cap * 2 * sizeof(int));
+	if (!words) return -1;
+	const unsigned char * s = (const unsigned char *) text;
+	const unsigned char * e = s + len;
+	const unsigned char * p = s;
+	while (p < e) {
+		unsigned int c;
+		int cl = decode_char(tk, p, e, &c);
+		if (!is_wordchar(tk, c)) { p += cl; continue; }
+		// find the extent of the word and its first and last alnum chars
+		const unsigned char * first = NULL;
+		const unsigned char * last_end = NULL;
+		int letters = 0, dots = 0;
+		while (p < e) {
+			cl = decode_char(tk, p, e, &c);
+			if (!is_wordchar(tk, c)) break;
+			int alpha = is_letter(tk, c);
+			if (alpha || (c >= '0' && c <= '9')) {
+				if (!first) first = p;
+				last_end = p + cl;
+				letters += alpha;
+			} else if (c == '.' && first)
+				dots++;
+			p += cl;
+		}
+		if (!letters) continue;
+		const unsigned char * we = last_end;
+		// keep the trailing dot of abbreviations with inner dots (e.g.)
+		if (we < p && *we == '.' && dots > 1) we++;
+		if (n == cap) {
+			cap *= 2;
+			int * w2 = (int *) realloc(words, cap * 2 * sizeof(int));
+			if (!w2) { free(words); return -1; }
+			words = w2;
+		}
+		words[2*n  ] = first - s;
+		words[2*n+1] = we - first;
+		n++;
+	}
+	*out_words = words;
+	return n;
+}
+
+enum { JOB_SPELL, JOB_SUGGEST };
+
+struct check_job {
+	Hunspell * h;
+	const char * text;
+	int * words;       // offset, len pairs
+	int nwords;
+	char * bad;        // JOB_SPELL: 1 for each misspelled word
+	Hunspell_misspelling * ms; // JOB_SUGGEST
+	int nms;
+	int kind;
+	volatile int next; // next block of words to do
+};
+
+#define CHECK_BLOCK 64
+
+static void check_worker(check_job * job)
+{
+	char w[MAXWORDUTF8LEN];
+	int n = job->kind == JOB_SPELL ? job->nwords : job->nms;
+	for (;;) {
+		int i1 = __sync_fetch_and_add(&job->next, CHECK_BLOCK);
+		if (i1 >= n) return;
+		int i2 = i1 + CHECK_BLOCK < n ? i1 + CHECK_BLOCK : n;
+		for (int i = i1; i < i2; i++) {
+			int offset, len;
+			if (job->kind == JOB_SPELL) {
+				offset = job->words[2*i];
+				len = job->words[2*i+1];
+			} else {
+				offset = job->ms[i].offset;
+				len = job->ms[i].len;
+			}
+			if (len >= MAXWORDUTF8LEN) { // too long to be a word
+				if (job->kind == JOB_SPELL) job->bad[i] = 1;
+				continue;
+			}
+			memcpy(w, job->text + offset, len);
+			w[len] = 0;
+			if (job->kind == JOB_SPELL)
+				job->bad[i] = !job->h->spell(w);
+			else
+				job->ms[i].nsug = job->h->suggest(&job->ms[i].sug, w);
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI check_thread(void * arg) { check_worker((check_job *) arg); return 0; }
+#else
+static void * check_thread(void * arg) { check_worker((check_job *) arg); return 0; }
+#endif
+
+static int cpu_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+// run a job on the calling thread plus threads-1 workers (0 = one per cpu).
+static void check_run(check_job * job, int n, int threads)
+{
+	int nt = threads > 0 ? threads : cpu_count();
+	int nb = (n + CHECK_BLOCK - 1) / CHECK_BLOCK;
+	if (job->kind == JOB_SUGGEST) nb = n; // suggest() is slow: no point in waiting
+	if (nt > nb) nt = nb;
+	if (nt > 256) nt = 256;
+	if (nt < 1) nt = 1;
+	job->next = 0;
+#ifdef _WIN32
+	HANDLE th[256];
+	for (int i = 1; i < nt; i++)
+		th[i] = CreateThread(0, 0, check_thread, job, 0, 0);
+	check_worker(job);
+	for (int i = 1; i < nt; i++)
+		if (th[i]) {
+			WaitForSingleObject(th[i], INFINITE);
+			CloseHandle(th[i]);
+		}
+#else
+	pthread_t th[256];
+	bool ok[256];
+	for (int i = 1; i < nt; i++)
+		ok[i] = pthread_create(&th[i], 0, check_thread, job) == 0;
+	check_worker(job);
+	for (int i = 1; i < nt; i++)
+		if (ok[i])
+			pthread_join(th[i], 0);
+#endif
+}
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,6 +219,89 @@ LIBHUNSPELL_DLL_EXPORTED int Hunspell_add_dic(Hunhandle *pHunspell, const char *
 	return ((Hunspell*)pHunspell)->add_dic(dpath, key);
 }
 
+// compile a dictionary into an image file which can be loaded instead of it
+LIBHUNSPELL_DLL_EXPORTED int Hunspell_compile_dic(const char * affpath, const char * dpath,
+	const char * outpath, const char * key)
+{
+	HashMgr hm(dpath, affpath, key);
+	return hm.save_image(outpath);
+}
+
+// index the dictionary for Hunspell_suggest_timed() (maxdist is 1 or 2)
+LIBHUNSPELL_DLL_EXPORTED int Hunspell_build_suggest_index(Hunhandle *pHunspell, int maxdist) {
+	return ((Hunspell*)pHunspell)->build_suggest_index(maxdist);
+}
+
+// ranked suggestions with a wall-clock deadline of timeout seconds
+LIBHUNSPELL_DLL_EXPORTED int Hunspell_suggest_timed(Hunhandle *pHunspell, char *** slst,
+	const char * word, double timeout)
+{
+	return ((Hunspell*)pHunspell)->suggest_timed(slst, word, timeout);
+}
+
+// check the words of a text in the dictionary's encoding and return the
+// misspelled ones, in text order. the first max_sug misspelled words
+// (all if max_sug < 0) also get suggestions. returns the number of
+// misspelled words or -1 on allocation failure.
+LIBHUNSPELL_DLL_EXPORTED int Hunspell_check_text(Hunhandle *pHunspell,
+	const char * text, int len, int max_sug, int threads,
+	Hunspell_misspelling ** out)
+{
+	Hunspell * h = (Hunspell *) pHunspell;
+	*out = NULL;
+	text_tokenizer tk;
+	const char * enc = h->get_dic_encoding();
+	tk.utf8 = enc && strcmp(enc, "UTF-8") == 0;
+	tk.csconv = h->get_csconv();
+	tk.wordchars = h->get_wordchars();
+	tk.wordchars_utf16 = h->get_wordchars_utf16(&tk.wordchars_utf16_len);
+	if (!tk.wordchars_utf16) tk.wordchars_utf16_len = 0;
+
+	check_job job;
+	memset(&job, 0, sizeof(job));
+	job.h = h;
+	job.text = text;
+	job.nwords = tokenize(&tk, text, len, &job.words);
+	if (job.nwords < 0) return -1;
+	job.bad = (char *) calloc(job.nwords + 1, 1);
+	if (!job.bad) { free(job.words); return -1; }
+	job.kind = JOB_SPELL;
+	check_run(&job, job.nwords, threads);
+
+	int n = 0;
+	for (int i = 0; i < job.nwords; i++) n += job.bad[i];
+	Hunspell_misspelling * ms = (Hunspell_misspelling *)
+		calloc(n + 1, sizeof(Hunspell_misspelling));
+	if (!ms) { free(job.words); free(job.bad); return -1; }
+	for (int i = 0, j = 0; i < job.nwords; i++) {
+		if (!job.bad[i]) continue;
+		ms[j].offset = job.words[2*i];
+		ms[j].len = job.words[2*i+1];
+		j++;
+	}
+	free(job.words);
+	free(job.bad);
+
+	if (max_sug != 0 && n > 0) {
+		job.kind = JOB_SUGGEST;
+		job.ms = ms;
+		job.nms = max_sug < 0 || max_sug > n ? n : max_sug;
+		check_run(&job, job.nms, threads);
+	}
+	*out = ms;
+	return n;
+}
+
+LIBHUNSPELL_DLL_EXPORTED void Hunspell_free_misspellings(Hunhandle *pHunspell,
+	Hunspell_misspelling * ms, int n)
+{
+	if (!ms) return;
+	for (int i = 0; i < n; i++)
+		if (ms[i].sug)
+			((Hunspell *) pHunspell)->free_list(&ms[i].sug, ms[i].nsug);
+	free(ms);
+}
+
 #ifdef __cplusplus
 }
 #endif
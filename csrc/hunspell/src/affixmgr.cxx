@@ -14,6 +14,16 @@
 
 #include "csutil.hxx"
 
+// state of the current affix check. It is set by the checking functions
+// and read back by their callers (eg. get_prefix()) on the same thread, so
+// keeping it per thread instead of per instance lets one AffixMgr (and one
+// Hunspell instance) be used by many threads at the same time.
+static THREAD_LOCAL const char * pfxappnd;
+static THREAD_LOCAL const char * sfxappnd;
+static THREAD_LOCAL FLAG         sfxflag;
+static THREAD_LOCAL SfxEntry *   sfx;
+static THREAD_LOCAL PfxEntry *   pfx;
+
 AffixMgr::AffixMgr(const char * affpath, HashMgr** ptr, int * md, const char * key) 
 {
   // register hash manager and load affix data from aff file
@@ -3015,6 +3025,7 @@ char * AffixMgr::morphgen(char * ts, int wl, const unsigned short * ap,
 }
 
 
+// bad == NULL: all the forms, not only the ones matching the affixes of bad
 int AffixMgr::expand_rootword(struct guessword * wlst, int maxn, const char * ts,
     int wl, const unsigned short * ap, unsigned short al, char * bad, int badl,
     char * phon)
@@ -3044,7 +3055,7 @@ int AffixMgr::expand_rootword(struct guessword * wlst, int maxn, const char * ts
        const unsigned char c = (unsigned char) (ap[i] & 0x00FF);
        SfxEntry * sptr = sFlag[c];
        while (sptr) {
-         if ((sptr->getFlag() == ap[i]) && (!sptr->getKeyLen() || ((badl > sptr->getKeyLen()) &&
+         if ((sptr->getFlag() == ap[i]) && (!sptr->getKeyLen() || !bad || ((badl > sptr->getKeyLen()) &&
                 (strcmp(sptr->getAffix(), bad + badl - sptr->getKeyLen()) == 0))) &&
                 // check needaffix flag
                 !(sptr->getCont() && ((needaffix && 
@@ -3092,7 +3103,7 @@ int AffixMgr::expand_rootword(struct guessword * wlst, int maxn, const char * ts
              const unsigned char c = (unsigned char) (ap[k] & 0x00FF);
              PfxEntry * cptr = pFlag[c];
              while (cptr) {
-                if ((cptr->getFlag() == ap[k]) && cptr->allowCross() && (!cptr->getKeyLen() || ((badl > cptr->getKeyLen()) &&
+                if ((cptr->getFlag() == ap[k]) && cptr->allowCross() && (!cptr->getKeyLen() || !bad || ((badl > cptr->getKeyLen()) &&
                         (strncmp(cptr->getKey(), bad, cptr->getKeyLen()) == 0)))) {
                     int l1 = strlen(wlst[j].word);
                     char * newword = cptr->add(wlst[j].word, l1);
@@ -3118,7 +3129,7 @@ int AffixMgr::expand_rootword(struct guessword * wlst, int maxn, const char * ts
        const unsigned char c = (unsigned char) (ap[m] & 0x00FF);
        PfxEntry * ptr = pFlag[c];
        while (ptr) {
-         if ((ptr->getFlag() == ap[m]) && (!ptr->getKeyLen() || ((badl > ptr->getKeyLen()) &&
+         if ((ptr->getFlag() == ap[m]) && (!ptr->getKeyLen() || !bad || ((badl > ptr->getKeyLen()) &&
                 (strncmp(ptr->getKey(), bad, ptr->getKeyLen()) == 0))) &&
                 // check needaffix flag
                 !(ptr->getCont() && ((needaffix && 
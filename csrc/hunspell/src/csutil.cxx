@@ -672,17 +672,19 @@ void mkallcap_utf(w_char * u, int nc, int langnum) {
  }
 
  // conversion function for protected memory
+ // (the pointer is stored relative to dest, see relptr in htypes.hxx)
  void store_pointer(char * dest, char * source)
  {
-    memcpy(dest, &source, sizeof(char *));
+    long long off = source - dest;
+    memcpy(dest, &off, sizeof(long long));
  }
 
  // conversion function for protected memory
  char * get_stored_pointer(const char * s)
  {
-    char * p;
-    memcpy(&p, s, sizeof(char *));
-    return p;
+    long long off;
+    memcpy(&off, s, sizeof(long long));
+    return (char *) s + off;
  }
 
 #ifndef MOZILLA_CLIENT
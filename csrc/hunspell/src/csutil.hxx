@@ -47,6 +47,13 @@
 #define MSEP_REC '\n'
 #define MSEP_ALT '\v'
 
+// thread-local storage class
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 // default flags
 #define DEFAULTFLAGS   65510
 #define FORBIDDENWORD  65510
@@ -5,6 +5,14 @@
 #include <string.h>
 #include <stdio.h> 
 #include <ctype.h>
+#include <map>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "hashmgr.hxx"
 #include "csutil.hxx"
@@ -16,6 +24,8 @@ HashMgr::HashMgr(const char * tpath, const char * apath, const char * key)
 {
   tablesize = 0;
   tableptr = NULL;
+  image = NULL;
+  image_size = 0;
   flag_mode = FLAG_CHAR;
   complexprefixes = 0;
   utf8 = 0;
@@ -32,14 +42,13 @@ HashMgr::HashMgr(const char * tpath, const char * apath, const char * key)
   aliasm = NULL;
   forbiddenword = FORBIDDENWORD; // forbidden word signing flag
   load_config(apath, key);
-  int ec = load_tables(tpath, key);
+  int ec = is_image(tpath) ? load_image(tpath) : load_tables(tpath, key);
   if (ec) {
     /* error condition - what should we do here */
     HUNSPELL_WARNING(stderr, "Hash Manager Error : %d\n",ec);
-    if (tableptr) {
-      free(tableptr);
-      tableptr = NULL;
-    }
+    if (image) unload_image();
+    else if (tableptr) free(tableptr);
+    tableptr = NULL;
     tablesize = 0;
   }
 }
@@ -55,12 +64,13 @@ HashMgr::~HashMgr()
       struct hentry * nt = NULL;
       while(pt) {
         nt = pt->next;
-        if (pt->astr && (!aliasf || TESTAFF(pt->astr, ONLYUPCASEFLAG, pt->alen))) free(pt->astr);
-        free(pt);
+        if (pt->astr && !in_image(pt->astr) &&
+          (!aliasf || TESTAFF(pt->astr, ONLYUPCASEFLAG, pt->alen))) free(pt->astr);
+        if (!in_image(pt)) free(pt);
         pt = nt;
       }
     }
-    free(tableptr);
+    if (image) unload_image(); else free(tableptr);
   }
   tablesize = 0;
 
@@ -116,7 +126,7 @@ int HashMgr::add_word(const char * word, int wbl, int wcl, unsigned short * aff,
     int al, const char * desc, bool onlyupcase)
 {
     bool upcasehomonym = false;
-    int descl = desc ? (aliasm ? sizeof(short) : strlen(desc) + 1) : 0;
+    int descl = desc ? (aliasm ? sizeof(long long) : strlen(desc) + 1) : 0;
     // variable-length hash record with word and optional fields
     struct hentry* hp = 
 	(struct hentry *) malloc (sizeof(struct hentry) + wbl + descl);
@@ -169,7 +179,7 @@ int HashMgr::add_word(const char * word, int wbl, int wcl, unsigned short * aff,
     	    // remove hidden onlyupcase homonym
             if (!onlyupcase) {
 		if ((dp->astr) && TESTAFF(dp->astr, ONLYUPCASEFLAG, dp->alen)) {
-		    free(dp->astr);
+		    if (!in_image(dp->astr)) free(dp->astr);
 		    dp->astr = hp->astr;
 		    dp->alen = hp->alen;
 		    free(hp);
@@ -187,7 +197,7 @@ int HashMgr::add_word(const char * word, int wbl, int wcl, unsigned short * aff,
     	    // remove hidden onlyupcase homonym
             if (!onlyupcase) {
 		if ((dp->astr) && TESTAFF(dp->astr, ONLYUPCASEFLAG, dp->alen)) {
-		    free(dp->astr);
+		    if (!in_image(dp->astr)) free(dp->astr);
 		    dp->astr = hp->astr;
 		    dp->alen = hp->alen;
 		    free(hp);
@@ -386,7 +396,7 @@ int HashMgr::load_tables(const char * tpath, const char * key)
   if ((tablesize %2) == 0) tablesize++;
 
   // allocate the hash table
-  tableptr = (struct hentry **) malloc(tablesize * sizeof(struct hentry *));
+  tableptr = (relptr<hentry> *) malloc(tablesize * sizeof(relptr<hentry>));
   if (! tableptr) {
     delete dict;
     return 3;
@@ -474,6 +484,201 @@ int HashMgr::load_tables(const char * tpath, const char * key)
   return 0;
 }
 
+// dictionary images: the hash table of a loaded dictionary saved as is,
+// with self-relative pointers, so that it can be memory-mapped instead of
+// parsed. The affix file is still needed and must match the one the image
+// was made with.
+
+#define IMAGE_MAGIC   "HUNDIC01"
+#define IMAGE_ALIGN(n) (((n) + 7) & ~(long long) 7)
+
+struct image_header {
+  char      magic[8];
+  int       byte_order;  // 0x01020304 in the writer's byte order
+  int       hentry_size; // sizeof(hentry) of the writer
+  int       tablesize;
+  int       flag_mode;   // config which the words depend on
+  int       utf8;
+  int       complexprefixes;
+  int       langnum;
+  int       numaliasf;
+  int       numaliasm;
+  int       reserved;
+  long long table;       // offset of the table of relptr<hentry>
+  long long size;        // size of the image
+};
+
+static int hentry_data_size(struct hentry * he)
+{
+  if (!he->var) return 0;
+  if (he->var & H_OPT_ALIASM) return sizeof(long long);
+  return strlen(HENTRY_DATA(he)) + 1;
+}
+
+int HashMgr::is_image(const char * path)
+{
+  char magic[8];
+  FILE * f = fopen(path, "rb");
+  if (!f) return 0;
+  int ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, IMAGE_MAGIC, 8) == 0;
+  fclose(f);
+  return ok;
+}
+
+// save the hash table to a dictionary image file
+int HashMgr::save_image(const char * path)
+{
+  if (!tableptr) return 1;
+  std::map<const void *, long long> entries;  // hentry -> offset
+  std::map<const void *, long long> flags;    // flag vector -> offset
+  std::map<const void *, long long> morphs;   // morph alias -> offset
+
+  // assign offsets: header, table, entries, flag vectors, morph aliases
+  long long size = IMAGE_ALIGN(sizeof(image_header));
+  long long table = size;
+  size += IMAGE_ALIGN(tablesize * sizeof(relptr<hentry>));
+  for (int i = 0; i < tablesize; i++) {
+    for (struct hentry * he = tableptr[i]; he; he = he->next) {
+      entries[he] = size;
+      size += IMAGE_ALIGN(sizeof(struct hentry) + he->blen + hentry_data_size(he));
+    }
+  }
+  for (int i = 0; i < tablesize; i++) {
+    for (struct hentry * he = tableptr[i]; he; he = he->next) {
+      if (he->astr && flags.find(he->astr) == flags.end()) {
+        flags[he->astr] = size;
+        // same vector, same length (alias vectors are shared as a whole)
+        size += IMAGE_ALIGN(he->alen * sizeof(unsigned short));
+      }
+      if (he->var & H_OPT_ALIASM) {
+        char * m = HENTRY_DATA(he);
+        if (morphs.find(m) == morphs.end()) {
+          morphs[m] = size;
+          size += IMAGE_ALIGN(strlen(m) + 1);
+        }
+      }
+    }
+  }
+
+  char * buf = (char *) calloc(1, size);
+  if (!buf) return 2;
+  image_header * h = (image_header *) buf;
+  memcpy(h->magic, IMAGE_MAGIC, 8);
+  h->byte_order = 0x01020304;
+  h->hentry_size = sizeof(struct hentry);
+  h->tablesize = tablesize;
+  h->flag_mode = flag_mode;
+  h->utf8 = utf8;
+  h->complexprefixes = complexprefixes;
+  h->langnum = langnum;
+  h->numaliasf = numaliasf;
+  h->numaliasm = numaliasm;
+  h->table = table;
+  h->size = size;
+
+  relptr<hentry> * t = (relptr<hentry> *) (buf + table);
+  int ec = 0;
+  for (int i = 0; i < tablesize; i++) {
+    if (tableptr[i]) t[i] = (struct hentry *) (buf + entries[tableptr[i]]);
+    for (struct hentry * he = tableptr[i]; he; he = he->next) {
+      struct hentry * ne = (struct hentry *) (buf + entries[he]);
+      ne->blen = he->blen;
+      ne->clen = he->clen;
+      ne->alen = he->alen;
+      ne->var = he->var;
+      memcpy(ne->word, he->word, he->blen + 1);
+      if (he->next) ne->next = (struct hentry *) (buf + entries[he->next]);
+      if (he->next_homonym) {
+        if (entries.find(he->next_homonym) == entries.end()) { ec = 3; break; }
+        ne->next_homonym = (struct hentry *) (buf + entries[he->next_homonym]);
+      }
+      if (he->astr) {
+        unsigned short * a = (unsigned short *) (buf + flags[he->astr]);
+        memcpy(a, he->astr, he->alen * sizeof(unsigned short));
+        ne->astr = a;
+      }
+      if (he->var & H_OPT_ALIASM) {
+        char * m = HENTRY_DATA(he);
+        char * nm = buf + morphs[m];
+        strcpy(nm, m);
+        store_pointer(HENTRY_WORD(ne) + ne->blen + 1, nm);
+      } else if (he->var) {
+        strcpy(HENTRY_WORD(ne) + ne->blen + 1, HENTRY_DATA(he));
+      }
+    }
+  }
+
+  if (!ec) {
+    FILE * f = fopen(path, "wb");
+    if (!f) ec = 4;
+    else {
+      if (fwrite(buf, 1, size, f) != (size_t) size) ec = 5;
+      if (fclose(f)) ec = 5;
+    }
+  }
+  free(buf);
+  return ec;
+}
+
+// map a dictionary image copy-on-write: the pages are shared between all
+// the processes that load the same image unless a word is added or removed.
+int HashMgr::load_image(const char * path)
+{
+  image_header h;
+  FILE * f = fopen(path, "rb");
+  if (!f) return 1;
+  int ok = fread(&h, 1, sizeof(h), f) == sizeof(h);
+  fseek(f, 0, SEEK_END);
+  long long fsize = ftell(f);
+  fclose(f);
+  if (!ok || memcmp(h.magic, IMAGE_MAGIC, 8) || h.byte_order != 0x01020304 ||
+    h.hentry_size != sizeof(struct hentry) || h.size > fsize)
+  {
+    HUNSPELL_WARNING(stderr, "error: %s: incompatible dictionary image\n", path);
+    return 7;
+  }
+  if (h.flag_mode != flag_mode || h.utf8 != utf8 ||
+    h.complexprefixes != complexprefixes || h.langnum != langnum ||
+    h.numaliasf != numaliasf || h.numaliasm != numaliasm)
+  {
+    HUNSPELL_WARNING(stderr, "error: %s: dictionary image made with a different affix file\n", path);
+    return 8;
+  }
+#ifdef _WIN32
+  HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fh == INVALID_HANDLE_VALUE) return 1;
+  HANDLE mh = CreateFileMapping(fh, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(fh);
+  if (!mh) return 9;
+  void * p = MapViewOfFile(mh, FILE_MAP_COPY, 0, 0, (SIZE_T) h.size);
+  CloseHandle(mh);
+  if (!p) return 9;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return 1;
+  void * p = mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return 9;
+#endif
+  image = (char *) p;
+  image_size = h.size;
+  tablesize = h.tablesize;
+  tableptr = (relptr<hentry> *) (image + h.table);
+  return 0;
+}
+
+void HashMgr::unload_image()
+{
+#ifdef _WIN32
+  UnmapViewOfFile(image);
+#else
+  munmap(image, image_size);
+#endif
+  image = NULL;
+  image_size = 0;
+}
+
 // the hash function is a simple load and rotate
 // algorithm borrowed
 
@@ -13,7 +13,9 @@ enum flag { FLAG_CHAR, FLAG_LONG, FLAG_NUM, FLAG_UNI };
 class LIBHUNSPELL_DLL_EXPORTED HashMgr
 {
   int               tablesize;
-  struct hentry **  tableptr;
+  relptr<hentry> *  tableptr;
+  char *            image;      // memory-mapped dictionary image, if any
+  size_t            image_size;
   int               userword;
   flag              flag_mode;
   int               complexprefixes;
@@ -51,10 +53,17 @@ public:
   int get_aliasf(int index, unsigned short ** fvec, FileMgr * af);
   int is_aliasm();
   char * get_aliasm(int index);
+  int save_image(const char * path);
+  static int is_image(const char * path);
 
 private:
   int get_clen_and_captype(const char * word, int wbl, int * captype);
   int load_tables(const char * tpath, const char * key);
+  int load_image(const char * path);
+  void unload_image();
+  int in_image(const void * p) const {
+    return image && (const char *) p >= image && (const char *) p < image + image_size;
+  }
   int add_word(const char * word, int wbl, int wcl, unsigned short * ap,
     int al, const char * desc, bool onlyupcase);
   int load_config(const char * affpath, const char * key);
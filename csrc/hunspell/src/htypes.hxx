@@ -17,14 +17,32 @@
 // approx. number  of user defined words
 #define USERWORD 1000
 
+// self-relative pointer: stores the distance to the target from its own
+// address, so hash entries work the same on the heap and inside a
+// memory-mapped dictionary image (see HashMgr::save_image()).
+// It must not be copied by value (the distance would be wrong).
+template <class T> class relptr
+{
+  long long off;
+  relptr(const relptr &);
+public:
+  operator T * () const { return off ? (T *) ((char *) this + off) : 0; }
+  T * operator -> () const { return (T *) ((char *) this + off); }
+  relptr & operator = (T * p) {
+    off = p ? (char *) p - (char *) this : 0;
+    return *this;
+  }
+  relptr & operator = (const relptr & p) { return *this = (T *) p; }
+};
+
 struct hentry
 {
   unsigned char blen; // word length in bytes
   unsigned char clen; // word length in characters (different for UTF-8 enc.)
   short    alen;      // length of affix flag vector
-  unsigned short * astr;  // affix flag vector
-  struct   hentry * next; // next word with same hash code
-  struct   hentry * next_homonym; // next homonym word (with same hash code)
+  relptr<unsigned short> astr;  // affix flag vector
+  relptr<hentry> next; // next word with same hash code
+  relptr<hentry> next_homonym; // next homonym word (with same hash code)
   char     var;       // variable fields (only for special pronounciation yet)
   char     word[1];   // variable-length word (8-bit or UTF-8 encoding)
 };
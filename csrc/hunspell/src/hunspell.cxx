@@ -1020,6 +1020,131 @@ int Hunspell::suggest(char*** slst, const char * word)
   return l;
 }
 
+int Hunspell::build_suggest_index(int maxdist)
+{
+  if (!pSMgr) return -1;
+  return pSMgr->build_index(pHMgr, maxdic, maxdist);
+}
+
+// suggestions from the deletion index, in the capitalization of the word
+int Hunspell::index_suggest(char*** slst, const char * word, int * near)
+{
+  char cw[MAXWORDUTF8LEN];
+  char wspace[MAXWORDUTF8LEN];
+  w_char unicw[MAXWORDLEN];
+  *slst = NULL;
+  *near = 0;
+  int nc = strlen(word);
+  if (utf8) {
+    if (nc >= MAXWORDUTF8LEN) return 0;
+  } else {
+    if (nc >= MAXWORDLEN) return 0;
+  }
+  int captype = 0;
+  int abbv = 0;
+  int wl = 0;
+
+  // input conversion
+  RepList * rl = (pAMgr) ? pAMgr->get_iconvtable() : NULL;
+  if (rl && rl->conv(word, wspace)) wl = cleanword2(cw, wspace, unicw, &nc, &captype, &abbv);
+  else wl = cleanword2(cw, word, unicw, &nc, &captype, &abbv);
+
+  if (wl == 0) return 0;
+  int ns = pSMgr->index_suggest(slst, cw, near);
+  if (ns <= 0) return ns;
+
+  // capitalize like the word (Helo -> Hello, HELO -> HELLO) when allowed
+  if (captype == INITCAP || captype == ALLCAP) {
+    for (int j = 0; j < ns; j++) {
+      if (strlen((*slst)[j]) >= MAXWORDUTF8LEN) continue;
+      strcpy(wspace, (*slst)[j]);
+      if (captype == INITCAP) mkinitcap(wspace); else mkallcap(wspace);
+      if (strcmp(wspace, (*slst)[j]) && spell(wspace)) {
+        char * s = mystrdup(wspace);
+        if (s) {
+          free((*slst)[j]);
+          (*slst)[j] = s;
+        }
+      }
+    }
+  }
+
+  // expand suggestions with dot(s)
+  if (abbv && pAMgr && pAMgr->get_sugswithdots()) {
+    for (int j = 0; j < ns; j++) {
+      (*slst)[j] = (char *) realloc((*slst)[j], strlen((*slst)[j]) + 1 + abbv);
+      strcat((*slst)[j], word + strlen(word) - abbv);
+    }
+  }
+
+  // remove duplications
+  int l = 0;
+  for (int j = 0; j < ns; j++) {
+    (*slst)[l] = (*slst)[j];
+    for (int k = 0; k < l; k++) {
+      if (strcmp((*slst)[k], (*slst)[j]) == 0) {
+        free((*slst)[j]);
+        l--;
+        break;
+      }
+    }
+    l++;
+  }
+  ns = l;
+
+  // output conversion
+  rl = (pAMgr) ? pAMgr->get_oconvtable() : NULL;
+  for (int j = 0; rl && j < ns; j++) {
+    if (rl->conv((*slst)[j], wspace)) {
+      free((*slst)[j]);
+      (*slst)[j] = mystrdup(wspace);
+    }
+  }
+  return ns;
+}
+
+int Hunspell::suggest_timed(char*** slst, const char * word, double timeout)
+{
+  *slst = NULL;
+  if (!pSMgr || maxdic == 0) return 0;
+  SuggestMgr::set_deadline(timeout);
+
+  // typical typos: found in the index in microseconds
+  char ** ilst = NULL;
+  int near = 0;
+  int ni = index_suggest(&ilst, word, &near);
+  if (ni < 0) ni = 0;
+
+  // anything else: the suggest() strategies, until the deadline
+  int ns = 0;
+  if (!near && !SuggestMgr::timed_out()) ns = suggest(slst, word);
+  SuggestMgr::set_deadline(-1);
+  if (ns < 0) ns = 0;
+
+  // add the index suggestions not found by the strategies
+  if (ni > 0) {
+    if (!*slst) {
+      *slst = (char **) malloc(MAXSUGGESTION * sizeof(char *));
+      if (!*slst) {
+        freelist(&ilst, ni);
+        return 0;
+      }
+    }
+    for (int i = 0; i < ni; i++) {
+      int dup = 0;
+      for (int j = 0; j < ns && !dup; j++)
+        dup = strcmp((*slst)[j], ilst[i]) == 0;
+      if (!dup && ns < MAXSUGGESTION) {
+        (*slst)[ns++] = ilst[i];
+      } else {
+        free(ilst[i]);
+      }
+    }
+    free(ilst);
+  }
+  return ns;
+}
+
 void Hunspell::free_list(char *** slst, int n) {
         freelist(slst, n);
 }
@@ -65,6 +65,19 @@ public:
 
   int suggest(char*** slst, const char * word);
 
+  /* suggest_timed(suggestions, word, timeout) - fast, ranked suggestions
+   * with a single wall-clock deadline of timeout seconds: the words within
+   * 1-2 edits are looked up in the index made by build_suggest_index() and
+   * ranked by edit distance; if none is within 1 edit, the suggest()
+   * strategies run until the deadline and their results come first.
+   */
+
+  int suggest_timed(char*** slst, const char * word, double timeout);
+
+  /* build_suggest_index(maxdist) - index the dictionary for suggest_timed() */
+
+  int build_suggest_index(int maxdist = 2);
+
   /* deallocate suggestion lists */
 
   void free_list(char *** slst, int n);
@@ -159,6 +172,7 @@ private:
    hentry * spellsharps(char * base, char *, int, int, char * tmp, int * info, char **root);
    int    is_keepcase(const hentry * rv);
    int    insert_sug(char ***slst, char * word, int ns);
+   int    index_suggest(char ***slst, const char * word, int * near);
    void   cat_result(char * result, char * st);
    char * stem_description(const char * desc);
    int    spellml(char*** slst, const char * word);
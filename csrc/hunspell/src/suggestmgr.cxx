@@ -6,6 +6,14 @@
 #include <stdio.h> 
 #include <ctype.h>
 
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
 #include "suggestmgr.hxx"
 #include "htypes.hxx"
 #include "csutil.hxx"
@@ -33,6 +41,7 @@ SuggestMgr::SuggestMgr(const char * tryme, int maxn,
   utf8 = 0;
   langnum = 0;
   complexprefixes = 0;  
+  sugindex = NULL;
   
   maxSug = maxn;
   nosplitsugs = 0;
@@ -97,6 +106,8 @@ SuggestMgr::~SuggestMgr()
   ctry_utf = NULL;
   ctryl = 0;
   maxSug = 0;
+  delete sugindex;
+  sugindex = NULL;
 #ifdef MOZILLA_CLIENT
   delete [] csconv;
 #endif
@@ -1080,6 +1091,11 @@ int SuggestMgr::ngsuggest(char** wlst, char * w, int ns, HashMgr** pHMgr, int md
 
   for (i = 0; i < md; i++) {  
   while (0 != (hp = (pHMgr[i])->walk_hashtable(col, hp))) {
+    // out of time: skip the ngram suggestions
+    if (timed_out()) {
+      if (nonbmp) utf8 = 1;
+      return ns;
+    }
     if ((hp->astr) && (pAMgr) && 
        (TESTAFF(hp->astr, forbiddenword, hp->alen) ||
           TESTAFF(hp->astr, ONLYUPCASEFLAG, hp->alen) ||
@@ -1388,6 +1404,9 @@ int SuggestMgr::checkword(const char * word, int len, int cpdsuggest, int * time
   struct hentry * rv2=NULL;
   int nosuffix = 0;
 
+  // check the deadline of the whole suggestion
+  if (timed_out()) return 0;
+
   // check time limit
   if (timer) {
     (*timer)--;
@@ -2002,3 +2021,192 @@ int SuggestMgr::lcslen(const char * s, const char* s2) {
   free(result);
   return len;
 }
+
+// deadline ------------------------------------------------------------------
+
+static THREAD_LOCAL int    has_deadline;
+static THREAD_LOCAL int    deadline_passed;
+static THREAD_LOCAL double deadline;
+
+static double wall_clock()
+{
+#ifdef _WIN32
+  LARGE_INTEGER t, f;
+  QueryPerformanceCounter(&t);
+  QueryPerformanceFrequency(&f);
+  return (double) t.QuadPart / (double) f.QuadPart;
+#else
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec * 1e-6;
+#endif
+}
+
+void SuggestMgr::set_deadline(double timeout)
+{
+  has_deadline = timeout >= 0;
+  deadline_passed = 0;
+  if (has_deadline) deadline = wall_clock() + timeout;
+}
+
+int SuggestMgr::timed_out()
+{
+  if (!has_deadline) return 0;
+  if (!deadline_passed && wall_clock() >= deadline) deadline_passed = 1;
+  return deadline_passed;
+}
+
+// deletion index ------------------------------------------------------------
+
+// lowercase key of a word for the index: UTF-16 or 8-bit chars
+static int index_key(const char * word, unsigned short * key, int utf8,
+  int langnum, struct cs_info * csconv)
+{
+  if (utf8) {
+    w_char w[SUGINDEX_MAXWORDLEN];
+    int wl = u8_u16(w, SUGINDEX_MAXWORDLEN, word);
+    if (wl <= 0) return 0;
+    mkallsmall_utf(w, wl, langnum);
+    for (int i = 0; i < wl; i++) key[i] = (w[i].h << 8) | w[i].l;
+    return wl;
+  }
+  int wl = strlen(word);
+  if (wl > SUGINDEX_MAXWORDLEN) return 0;
+  char w[SUGINDEX_MAXWORDLEN + 1];
+  strcpy(w, word);
+  mkallsmall(w, csconv);
+  for (int i = 0; i < wl; i++) key[i] = (unsigned char) w[i];
+  return wl;
+}
+
+// index all the suggestable word forms (roots expanded with their affixes)
+int SuggestMgr::build_index(HashMgr** pHMgr, int md, int maxdist)
+{
+  if (!pAMgr) return -1;
+  delete sugindex;
+  sugindex = new SugIndex(maxdist);
+
+  struct guessword * glst;
+  glst = (struct guessword *) calloc(MAX_WORDS, sizeof(struct guessword));
+  if (!glst) return -1;
+
+  FLAG forbiddenword = pAMgr->get_forbiddenword();
+  FLAG nosuggest = pAMgr->get_nosuggest();
+  FLAG onlyincompound = pAMgr->get_onlyincompound();
+
+  unsigned short key[SUGINDEX_MAXWORDLEN];
+  for (int i = 0; i < md; i++) {
+    struct hentry * hp = NULL;
+    int col = -1;
+    while (0 != (hp = (pHMgr[i])->walk_hashtable(col, hp))) {
+      if ((hp->astr) &&
+         (TESTAFF(hp->astr, forbiddenword, hp->alen) ||
+            TESTAFF(hp->astr, ONLYUPCASEFLAG, hp->alen) ||
+            TESTAFF(hp->astr, nosuggest, hp->alen) ||
+            TESTAFF(hp->astr, onlyincompound, hp->alen))) continue;
+      int nw = pAMgr->expand_rootword(glst, MAX_WORDS, HENTRY_WORD(hp), hp->blen,
+        hp->astr, hp->alen, NULL, 0, NULL);
+      for (int k = 0; k < nw; k++) {
+        char * w = glst[k].word;
+        if (checkword(w, strlen(w), 0, NULL, NULL)) {
+          if (complexprefixes) {
+            if (utf8) reverseword_utf(w); else reverseword(w);
+          }
+          int kl = index_key(w, key, utf8, langnum, csconv);
+          if (kl > 0) sugindex->add(key, kl, w);
+        }
+        free(glst[k].word);
+        glst[k].word = NULL;
+        if (glst[k].orig) free(glst[k].orig);
+        glst[k].orig = NULL;
+      }
+    }
+  }
+  free(glst);
+  return sugindex->build();
+}
+
+int SuggestMgr::has_index()
+{
+  return sugindex != NULL;
+}
+
+struct ranked_sug {
+  int word;
+  int dist;
+  int anagram;
+  int score;
+};
+
+struct ranked_sug_less {
+  bool operator()(const ranked_sug & a, const ranked_sug & b) const {
+    if (a.dist != b.dist) return a.dist < b.dist;
+    if (a.anagram != b.anagram) return a.anagram > b.anagram;
+    if (a.score != b.score) return a.score > b.score;
+    return a.word < b.word;
+  }
+};
+
+// suggestions from the deletion index, ranked by edit distance, then
+// anagrams first (swapped letters are the most common typo), then by ngram
+// similarity. near is set to the number of suggestions within one edit
+// (case differences don't count).
+int SuggestMgr::index_suggest(char*** slst, const char * w, int * near)
+{
+  *near = 0;
+  if (!sugindex) return 0;
+  char word[MAXSWUTF8L];
+  if (strlen(w) >= MAXSWUTF8L) return 0;
+  strcpy(word, w);
+  unsigned short key[SUGINDEX_MAXWORDLEN];
+  int kl = index_key(word, key, utf8, langnum, csconv);
+  if (kl <= 0) return 0;
+
+  std::vector<sugmatch> matches;
+  sugindex->lookup(key, kl, sugindex->get_maxdist(), matches);
+  unsigned short sorted[SUGINDEX_MAXWORDLEN];
+  unsigned short sorted2[SUGINDEX_MAXWORDLEN];
+  memcpy(sorted, key, kl * sizeof(unsigned short));
+  std::sort(sorted, sorted + kl);
+
+  // score the candidates of the distances that can make it in the list
+  std::vector<ranked_sug> ranked;
+  int lastdist = -1;
+  for (size_t i = 0; i < matches.size(); i++) {
+    if (ranked.size() >= (size_t) maxSug && matches[i].dist > lastdist) break;
+    const char * cand = sugindex->get_word(matches[i].word);
+    if (strcmp(cand, word) == 0) continue;
+    ranked_sug r;
+    r.word = matches[i].word;
+    r.dist = matches[i].dist;
+    int cl;
+    const unsigned short * ckey = sugindex->get_key(matches[i].word, &cl);
+    r.anagram = 0;
+    if (cl == kl) {
+      memcpy(sorted2, ckey, cl * sizeof(unsigned short));
+      std::sort(sorted2, sorted2 + cl);
+      r.anagram = memcmp(sorted, sorted2, cl * sizeof(unsigned short)) == 0;
+    }
+    r.score = ngram(3, word, cand, NGRAM_LONGER_WORSE + NGRAM_LOWERING) +
+      leftcommonsubstring(word, cand);
+    ranked.push_back(r);
+    lastdist = r.dist;
+  }
+  std::sort(ranked.begin(), ranked.end(), ranked_sug_less());
+
+  int ns = ranked.size() < (size_t) maxSug ? ranked.size() : maxSug;
+  if (ns == 0) return 0;
+  char ** wlst = (char **) malloc(maxSug * sizeof(char *));
+  if (!wlst) return -1;
+  for (int i = 0; i < ns; i++) {
+    wlst[i] = mystrdup(sugindex->get_word(ranked[i].word));
+    if (!wlst[i]) {
+      for (int j = 0; j < i; j++) free(wlst[j]);
+      free(wlst);
+      return -1;
+    }
+    if (ranked[i].dist <= 1) (*near)++;
+  }
+  *slst = wlst;
+  return ns;
+}
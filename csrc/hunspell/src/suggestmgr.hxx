@@ -26,6 +26,7 @@
 #include "affixmgr.hxx"
 #include "hashmgr.hxx"
 #include "langnum.hxx"
+#include "sugindex.hxx"
 #include <time.h>
 
 enum { LCS_UP, LCS_LEFT, LCS_UPLEFT };
@@ -49,6 +50,7 @@ class LIBHUNSPELL_DLL_EXPORTED SuggestMgr
   int             maxngramsugs;
   int             maxcpdsugs;
   int             complexprefixes;
+  SugIndex *      sugindex;
 
 
 public:
@@ -65,6 +67,16 @@ public:
   char * suggest_gen(char ** pl, int pln, char * pattern);
   char * suggest_morph_for_spelling_error(const char * word);
 
+  // SymSpell-style index for fast suggestions within maxdist edits
+  int build_index(HashMgr** pHMgr, int md, int maxdist);
+  int has_index();
+  int index_suggest(char*** slst, const char * word, int * near);
+
+  // wall-clock deadline (in seconds from now, < 0 for none) for all the
+  // suggestion strategies run on the current thread
+  static void set_deadline(double timeout);
+  static int timed_out();
+
 private:
    int testsug(char** wlst, const char * candidate, int wl, int ns, int cpdsuggest,
      int * timer, clock_t * timelimit);
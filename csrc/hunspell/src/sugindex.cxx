@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "sugindex.hxx"
+
+SugIndex::SugIndex(int maxd)
+{
+  maxdist = maxd < 1 ? 1 : (maxd > SUGINDEX_MAXDIST ? SUGINDEX_MAXDIST : maxd);
+}
+
+int SugIndex::get_maxdist() const
+{
+  return maxdist;
+}
+
+int SugIndex::get_count() const
+{
+  return entries.size();
+}
+
+const char * SugIndex::get_word(int i) const
+{
+  return &words[entries[i].word];
+}
+
+const unsigned short * SugIndex::get_key(int i, int * len) const
+{
+  *len = entries[i].keylen;
+  return &keys[entries[i].key];
+}
+
+int SugIndex::add(const unsigned short * key, int keylen, const char * word)
+{
+  if (keylen <= 0 || keylen > SUGINDEX_MAXWORDLEN) return 0;
+  entry e;
+  e.key = keys.size();
+  e.keylen = keylen;
+  e.word = words.size();
+  keys.insert(keys.end(), key, key + keylen);
+  words.insert(words.end(), word, word + strlen(word) + 1);
+  entries.push_back(e);
+  return 0;
+}
+
+// FNV-1a hash of a key with the chars at positions i and j left out
+static unsigned int del_hash(const unsigned short * key, int len, int i, int j)
+{
+  unsigned int h = 2166136261u;
+  for (int k = 0; k < len; k++) {
+    if (k == i || k == j) continue;
+    h = (h ^ (key[k] & 0xff)) * 16777619u;
+    h = (h ^ (key[k] >> 8)) * 16777619u;
+  }
+  return h;
+}
+
+// hashes of the key prefix with up to maxdist chars deleted, sorted and
+// without duplicates (eg. "aab" has only one deletion "ab").
+int SugIndex::deletions(const unsigned short * key, int len, unsigned int * hashes) const
+{
+  if (len > SUGINDEX_PREFIXLEN) len = SUGINDEX_PREFIXLEN;
+  int n = 0;
+  hashes[n++] = del_hash(key, len, -1, -1);
+  for (int i = 0; i < len; i++) {
+    hashes[n++] = del_hash(key, len, i, -1);
+    if (maxdist > 1)
+      for (int j = i + 1; j < len; j++)
+        hashes[n++] = del_hash(key, len, i, j);
+  }
+  std::sort(hashes, hashes + n);
+  return std::unique(hashes, hashes + n) - hashes;
+}
+
+struct delentry_less {
+  template <class T> bool operator()(const T & a, const T & b) const {
+    return a.hash < b.hash || (a.hash == b.hash && a.entry < b.entry);
+  }
+};
+
+struct entry_word_less {
+  const SugIndex * idx;
+  bool operator()(int a, int b) const {
+    int c = strcmp(idx->get_word(a), idx->get_word(b));
+    return c < 0 || (c == 0 && a < b);
+  }
+};
+
+int SugIndex::build()
+{
+  // remove duplicate words (keeping the first one added)
+  std::vector<int> order(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) order[i] = i;
+  entry_word_less less = { this };
+  std::sort(order.begin(), order.end(), less);
+  std::vector<char> keep(entries.size(), 0);
+  for (size_t i = 0; i < order.size(); i++)
+    if (i == 0 || strcmp(get_word(order[i]), get_word(order[i - 1])) != 0)
+      keep[order[i]] = 1;
+  std::vector<unsigned short> keys2;
+  std::vector<char> words2;
+  std::vector<entry> entries2;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (!keep[i]) continue;
+    const entry & e = entries[i];
+    entry e2;
+    e2.key = keys2.size();
+    e2.keylen = e.keylen;
+    e2.word = words2.size();
+    keys2.insert(keys2.end(), &keys[e.key], &keys[e.key] + e.keylen);
+    const char * w = &words[e.word];
+    words2.insert(words2.end(), w, w + strlen(w) + 1);
+    entries2.push_back(e2);
+  }
+  keys.swap(keys2);
+  words.swap(words2);
+  entries.swap(entries2);
+
+  // index each word under its deletions
+  unsigned int hashes[1 + SUGINDEX_PREFIXLEN * SUGINDEX_PREFIXLEN];
+  dels.clear();
+  for (size_t i = 0; i < entries.size(); i++) {
+    int n = deletions(&keys[entries[i].key], entries[i].keylen, hashes);
+    for (int k = 0; k < n; k++) {
+      delentry d;
+      d.hash = hashes[k];
+      d.entry = i;
+      dels.push_back(d);
+    }
+  }
+  std::sort(dels.begin(), dels.end(), delentry_less());
+  return 0;
+}
+
+struct match_less {
+  bool operator()(const sugmatch & a, const sugmatch & b) const {
+    return a.dist < b.dist || (a.dist == b.dist && a.word < b.word);
+  }
+};
+
+int SugIndex::lookup(const unsigned short * key, int len, int maxd,
+  std::vector<sugmatch> & out) const
+{
+  out.clear();
+  if (len <= 0 || len > SUGINDEX_MAXWORDLEN) return 0;
+  if (maxd > maxdist) maxd = maxdist;
+  unsigned int hashes[1 + SUGINDEX_PREFIXLEN * SUGINDEX_PREFIXLEN];
+  int n = deletions(key, len, hashes);
+  std::vector<int> cands;
+  for (int k = 0; k < n; k++) {
+    delentry d;
+    d.hash = hashes[k];
+    d.entry = -1;
+    std::vector<delentry>::const_iterator it =
+      std::lower_bound(dels.begin(), dels.end(), d, delentry_less());
+    for (; it != dels.end() && it->hash == hashes[k]; ++it)
+      cands.push_back(it->entry);
+  }
+  std::sort(cands.begin(), cands.end());
+  cands.erase(std::unique(cands.begin(), cands.end()), cands.end());
+  for (size_t i = 0; i < cands.size(); i++) {
+    const entry & e = entries[cands[i]];
+    int d = distance(key, len, &keys[e.key], e.keylen, maxd);
+    if (d <= maxd) {
+      sugmatch m;
+      m.word = cands[i];
+      m.dist = d;
+      out.push_back(m);
+    }
+  }
+  std::sort(out.begin(), out.end(), match_less());
+  return out.size();
+}
+
+int SugIndex::distance(const unsigned short * s1, int l1,
+  const unsigned short * s2, int l2, int max)
+{
+  if (abs(l1 - l2) > max) return max + 1;
+  if (l1 > SUGINDEX_MAXWORDLEN || l2 > SUGINDEX_MAXWORDLEN) return max + 1;
+  int rows[3][SUGINDEX_MAXWORDLEN + 1];
+  int * prev2 = rows[0];
+  int * prev = rows[1];
+  int * cur = rows[2];
+  for (int j = 0; j <= l2; j++) prev[j] = j;
+  for (int i = 1; i <= l1; i++) {
+    cur[0] = i;
+    int rowmin = i;
+    for (int j = 1; j <= l2; j++) {
+      int cost = s1[i - 1] == s2[j - 1] ? 0 : 1;
+      int d = prev[j - 1] + cost;
+      if (prev[j] + 1 < d) d = prev[j] + 1;
+      if (cur[j - 1] + 1 < d) d = cur[j - 1] + 1;
+      if (i > 1 && j > 1 && s1[i - 1] == s2[j - 2] && s1[i - 2] == s2[j - 1]
+          && prev2[j - 2] + 1 < d)
+        d = prev2[j - 2] + 1;
+      cur[j] = d;
+      if (d < rowmin) rowmin = d;
+    }
+    if (rowmin > max) return max + 1;
+    int * t = prev2; prev2 = prev; prev = cur; cur = t;
+  }
+  return prev[l2] > max ? max + 1 : prev[l2];
+}
@@ -0,0 +1,71 @@
+#ifndef _SUGINDEX_HXX_
+#define _SUGINDEX_HXX_
+
+#include "hunvisapi.h"
+
+#include <vector>
+
+// only the deletions of the first SUGINDEX_PREFIXLEN characters of the
+// words are indexed: the rest of the word is checked by the edit distance
+#define SUGINDEX_PREFIXLEN 7
+#define SUGINDEX_MAXDIST 2
+#define SUGINDEX_MAXWORDLEN 100
+
+// a match of the index: a word and its edit distance from the lookup key
+struct sugmatch {
+  int word;
+  int dist;
+};
+
+// SymSpell-style deletion index: every word is stored under all the strings
+// obtained by deleting up to maxdist characters from its (lowercase) key,
+// so the words within maxdist edits of a misspelled word are found by
+// looking up the deletions of the misspelled word only, instead of
+// generating and checking all of its possible edits.
+// Keys are strings of 16 bit chars (UTF-16 or 8-bit chars), words are
+// the surface forms in the dictionary encoding.
+
+class LIBHUNSPELL_DLL_EXPORTED SugIndex
+{
+  struct entry {
+    int key;      // offset in keys
+    int keylen;
+    int word;     // offset in words
+  };
+  struct delentry {
+    unsigned int hash;
+    int entry;
+  };
+
+  int maxdist;
+  std::vector<unsigned short> keys;
+  std::vector<char> words;
+  std::vector<entry> entries;
+  std::vector<delentry> dels;   // sorted by hash after build()
+
+  int deletions(const unsigned short * key, int len, unsigned int * hashes) const;
+
+public:
+  SugIndex(int maxdist);
+
+  // add a word with its lowercase key; words can be added more than once.
+  int add(const unsigned short * key, int keylen, const char * word);
+  // remove duplicates and make the index; no more words can be added after.
+  int build();
+
+  int get_maxdist() const;
+  int get_count() const;
+  const char * get_word(int i) const;
+  const unsigned short * get_key(int i, int * len) const;
+
+  // find the words within maxd edits of key, sorted by distance.
+  int lookup(const unsigned short * key, int len, int maxd,
+    std::vector<sugmatch> & out) const;
+
+  // optimal string alignment distance (Damerau-Levenshtein without
+  // substring edits), or max + 1 if it is bigger than max.
+  static int distance(const unsigned short * s1, int l1,
+    const unsigned short * s2, int l2, int max);
+};
+
+#endif
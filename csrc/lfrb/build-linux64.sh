@@ -0,0 +1 @@
+P=linux64 C=-fPIC L="-s -static-libgcc" D=liblfrb.so A=liblfrb.a ./build.sh
@@ -39,3 +39,236 @@ int lfrb_free_count(struct lfrb_state *rb) {
 void lfrb_clear(struct lfrb_state *rb) {
 	return rb->write_offset.store(rb->read_offset.load());
 }
+
+// power-of-two rings with reserve/commit -------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+static void yield() { SwitchToThread(); }
+static size_t page_size() {
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwAllocationGranularity; // views must be aligned to this.
+}
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+static void yield() { sched_yield(); }
+static size_t page_size() { return sysconf(_SC_PAGESIZE); }
+#endif
+
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+// map the same memory twice in a row so that a range which wraps around
+// the end of the buffer can be accessed as one contiguous slice.
+static bool mirror_alloc(struct lfrb_ring *rb, size_t size) {
+#ifdef _WIN32
+	HANDLE h = CreateFileMapping(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE,
+		(DWORD)((uint64_t)size >> 32), (DWORD)size, 0);
+	if (!h) return false;
+	for (int retries = 0; retries < 100; retries++) {
+		// find a free 2*size region then map into it, which can race with
+		// other threads allocating memory, hence the retries.
+		void *p = VirtualAlloc(0, 2 * size, MEM_RESERVE, PAGE_NOACCESS);
+		if (!p) break;
+		VirtualFree(p, 0, MEM_RELEASE);
+		void *p1 = MapViewOfFileEx(h, FILE_MAP_ALL_ACCESS, 0, 0, size, p);
+		if (!p1) continue;
+		void *p2 = MapViewOfFileEx(h, FILE_MAP_ALL_ACCESS, 0, 0, size, (char*)p + size);
+		if (!p2) {
+			UnmapViewOfFile(p1);
+			continue;
+		}
+		rb->data = (char*)p;
+		rb->handle = h;
+		return true;
+	}
+	CloseHandle(h);
+	return false;
+#else
+#ifdef __linux__
+	int fd = syscall(SYS_memfd_create, "lfrb", 0);
+#else
+	char name[64];
+	snprintf(name, sizeof(name), "/lfrb-%d-%p", (int)getpid(), (void*)rb);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1) shm_unlink(name);
+#endif
+	if (fd == -1) return false;
+	if (ftruncate(fd, size) != 0) {
+		close(fd);
+		return false;
+	}
+	// reserve 2*size of address space then map the file over both halves.
+	char *p = (char*)mmap(0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	bool ok = p != MAP_FAILED
+		&& mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+		&& mmap(p + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+	close(fd);
+	if (!ok) {
+		if (p != MAP_FAILED) munmap(p, 2 * size);
+		return false;
+	}
+	rb->data = p;
+	return true;
+#endif
+}
+
+static void mirror_free(struct lfrb_ring *rb) {
+#ifdef _WIN32
+	UnmapViewOfFile(rb->data);
+	UnmapViewOfFile(rb->data + rb->data_size);
+	CloseHandle((HANDLE)rb->handle);
+#else
+	munmap(rb->data, 2 * rb->data_size);
+#endif
+}
+
+struct lfrb_ring* lfrb_ring_new(uint32_t capacity, uint32_t elem_size, int flags) {
+	if (capacity < 1 || capacity > 0x80000000u)
+		return 0;
+	uint64_t cap = 1;
+	while (cap < capacity) cap <<= 1;
+	if (flags & LFRB_MIRROR) {
+		if (!elem_size)
+			return 0;
+		// each mapping must be a whole number of pages.
+		while ((cap * elem_size) % page_size())
+			cap <<= 1;
+		if (cap > 0x80000000u)
+			return 0;
+	}
+	void *mem = malloc(sizeof(lfrb_ring) + LFRB_CACHE_LINE);
+	if (!mem) return 0;
+	void *p = (void*)(((uintptr_t)mem + LFRB_CACHE_LINE - 1)
+		& ~(uintptr_t)(LFRB_CACHE_LINE - 1));
+	struct lfrb_ring *rb = new (p) lfrb_ring();
+	rb->write_head = 0;
+	rb->write_tail = 0;
+	rb->read_head  = 0;
+	rb->read_tail  = 0;
+	rb->capacity   = (uint32_t)cap;
+	rb->mask       = (uint32_t)(cap - 1);
+	rb->elem_size  = elem_size;
+	rb->flags      = flags;
+	rb->data       = 0;
+	rb->data_size  = cap * elem_size;
+	rb->mem        = mem;
+	rb->handle     = 0;
+	if (flags & LFRB_MIRROR) {
+		if (!mirror_alloc(rb, rb->data_size)) {
+			free(mem);
+			return 0;
+		}
+	} else if (elem_size) {
+		rb->data = (char*)malloc(rb->data_size);
+		if (!rb->data) {
+			free(mem);
+			return 0;
+		}
+	}
+	return rb;
+}
+
+void lfrb_ring_free(struct lfrb_ring *rb) {
+	if (!rb) return;
+	if (rb->flags & LFRB_MIRROR)
+		mirror_free(rb);
+	else
+		free(rb->data);
+	free(rb->mem);
+}
+
+uint32_t lfrb_ring_capacity(struct lfrb_ring *rb) {
+	return rb->capacity;
+}
+
+char* lfrb_ring_data(struct lfrb_ring *rb) {
+	return rb->data;
+}
+
+// reserve up to n slots (exactly n if `exact`) from `head`, given how many
+// are available relative to `limit`, with CAS when there are multiple
+// threads on this side. returns the number of slots reserved.
+static inline uint32_t reserve(atomic<uint64_t> &head, atomic<uint64_t> &limit,
+	uint64_t bias, bool multi, uint32_t n, int exact, uint32_t mask,
+	uint32_t *index)
+{
+	uint64_t h = head.load(memory_order_relaxed);
+	for (;;) {
+		uint32_t avail = (uint32_t)(limit.load(memory_order_acquire) + bias - h);
+		uint32_t k = n < avail ? n : avail;
+		if (!k || (exact && k < n))
+			return 0;
+		if (!multi) {
+			head.store(h + k, memory_order_relaxed);
+			*index = (uint32_t)h & mask;
+			return k;
+		}
+		if (head.compare_exchange_weak(h, h + k,
+				memory_order_relaxed, memory_order_relaxed)) {
+			*index = (uint32_t)h & mask;
+			return k;
+		}
+	}
+}
+
+// publish reserved slots. with multiple threads on this side the ranges
+// must be published in reservation order, so wait for the previous ones.
+// the position is recovered from the index since it must be within one
+// lap of the current tail.
+static inline void commit(atomic<uint64_t> &tail, bool multi,
+	uint32_t index, uint32_t n, uint32_t mask)
+{
+	if (!n) return;
+	uint64_t t = tail.load(memory_order_relaxed);
+	uint64_t pos = t + ((index - (uint32_t)t) & mask);
+	if (multi) {
+		for (int spins = 0; t != pos; spins++) {
+			if (spins > 64)
+				yield();
+			t = tail.load(memory_order_relaxed);
+			pos = t + ((index - (uint32_t)t) & mask);
+		}
+	}
+	tail.store(pos + n, memory_order_release);
+}
+
+uint32_t lfrb_ring_write_reserve(struct lfrb_ring *rb, uint32_t n, int exact, uint32_t *index) {
+	return reserve(rb->write_head, rb->read_tail, rb->capacity,
+		rb->flags & LFRB_MP, n, exact, rb->mask, index);
+}
+
+void lfrb_ring_write_commit(struct lfrb_ring *rb, uint32_t index, uint32_t n) {
+	commit(rb->write_tail, rb->flags & LFRB_MP, index, n, rb->mask);
+}
+
+uint32_t lfrb_ring_read_reserve(struct lfrb_ring *rb, uint32_t n, int exact, uint32_t *index) {
+	return reserve(rb->read_head, rb->write_tail, 0,
+		rb->flags & LFRB_MC, n, exact, rb->mask, index);
+}
+
+void lfrb_ring_read_commit(struct lfrb_ring *rb, uint32_t index, uint32_t n) {
+	commit(rb->read_tail, rb->flags & LFRB_MC, index, n, rb->mask);
+}
+
+uint32_t lfrb_ring_fill_count(struct lfrb_ring *rb) {
+	return (uint32_t)(rb->write_tail.load(memory_order_acquire)
+		- rb->read_head.load(memory_order_acquire));
+}
+
+uint32_t lfrb_ring_free_count(struct lfrb_ring *rb) {
+	return rb->capacity - (uint32_t)(rb->write_head.load(memory_order_acquire)
+		- rb->read_tail.load(memory_order_acquire));
+}
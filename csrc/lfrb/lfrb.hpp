@@ -7,7 +7,10 @@
 #define LFRB_H
 
 #include <atomic>
+#include <stddef.h>
+#include <stdint.h>
 using std::atomic_long;
+using std::atomic;
 
 #if ATOMIC_LONG_LOCK_FREE != 2
 #error "require atomic_long to be lock free"
@@ -19,6 +22,36 @@ struct lfrb_state {
 	int capacity;
 };
 
+/* Ring with power-of-two capacity, padded indices, batched reserve/commit
+   and optional multi-producer / multi-consumer modes and owned data buffer.
+   Writers reserve a range of slots by advancing `write_head`, fill them,
+   then publish them by advancing `write_tail` (in reservation order when
+   there are multiple producers). Readers do the same with `read_head` and
+   `read_tail`, which in turn publish the freed slots back to the writers. */
+
+#define LFRB_CACHE_LINE 64
+
+enum {
+	LFRB_MP     = 1, /* multiple producers (CAS on write_head) */
+	LFRB_MC     = 2, /* multiple consumers (CAS on read_head) */
+	LFRB_MIRROR = 4, /* double-map the data buffer */
+};
+
+struct lfrb_ring {
+	alignas(LFRB_CACHE_LINE) atomic<uint64_t> write_head;
+	alignas(LFRB_CACHE_LINE) atomic<uint64_t> write_tail;
+	alignas(LFRB_CACHE_LINE) atomic<uint64_t> read_head;
+	alignas(LFRB_CACHE_LINE) atomic<uint64_t> read_tail;
+	alignas(LFRB_CACHE_LINE) uint32_t capacity;
+	uint32_t mask;
+	uint32_t elem_size;
+	int flags;
+	char* data;
+	size_t data_size;
+	void* mem;     /* unaligned allocation of this struct */
+	void* handle;  /* file mapping handle of mirrored buffers on Windows */
+};
+
 extern "C" {
 	int lfrb_write_index(struct lfrb_state*);
 	void lfrb_advance_write_index(struct lfrb_state*, int count);
@@ -27,6 +60,17 @@ extern "C" {
 	int lfrb_fill_count(struct lfrb_state*);
 	int lfrb_free_count(struct lfrb_state*);
 	void lfrb_clear(struct lfrb_state*);
+
+	struct lfrb_ring* lfrb_ring_new(uint32_t capacity, uint32_t elem_size, int flags);
+	void lfrb_ring_free(struct lfrb_ring*);
+	uint32_t lfrb_ring_capacity(struct lfrb_ring*);
+	char* lfrb_ring_data(struct lfrb_ring*);
+	uint32_t lfrb_ring_write_reserve(struct lfrb_ring*, uint32_t n, int exact, uint32_t* index);
+	void lfrb_ring_write_commit(struct lfrb_ring*, uint32_t index, uint32_t n);
+	uint32_t lfrb_ring_read_reserve(struct lfrb_ring*, uint32_t n, int exact, uint32_t* index);
+	void lfrb_ring_read_commit(struct lfrb_ring*, uint32_t index, uint32_t n);
+	uint32_t lfrb_ring_fill_count(struct lfrb_ring*);
+	uint32_t lfrb_ring_free_count(struct lfrb_ring*);
 };
 
 #endif
@@ -1 +1 @@
-P=linux64 C="-fPIC" L="-s -static-libgcc -L../../bin/linux64" D=liblz4.so A=liblz4.a ./build.sh
+P=linux64 C="-fPIC" L="-s -static-libgcc -L../../bin/linux64 -lpthread" D=liblz4.so A=liblz4.a ./build.sh
@@ -0,0 +1,480 @@
+/*
+   LZ4 frame compression on multiple threads (see lz4frame_mt.h).
+*/
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600 /* for condition variables */
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define LZ4F_STATIC_LINKING_ONLY
+#include "lz4frame_mt.h"
+#include "lz4.h"
+#include "lz4hc.h"
+#include "xxhash.h"
+
+#define LZ4F_MAGICNUMBER 0x184D2204U
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
+#define MAX_THREADS 256
+#define KB *(1<<10)
+#define MB *(1<<20)
+
+#define RETURN_ERROR(e) return (size_t)-(ptrdiff_t)LZ4F_ERROR_##e
+
+#ifdef _WIN32
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+#define mutex_init(m)    InitializeCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+#define mutex_lock(m)    EnterCriticalSection(m)
+#define mutex_unlock(m)  LeaveCriticalSection(m)
+#define cond_init(c)     InitializeConditionVariable(c)
+#define cond_destroy(c)
+#define cond_wait(c, m)  SleepConditionVariableCS(c, m, INFINITE)
+#define cond_signal(c)   WakeConditionVariable(c)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+#define mutex_init(m)    pthread_mutex_init(m, 0)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m)    pthread_mutex_lock(m)
+#define mutex_unlock(m)  pthread_mutex_unlock(m)
+#define cond_init(c)     pthread_cond_init(c, 0)
+#define cond_destroy(c)  pthread_cond_destroy(c)
+#define cond_wait(c, m)  pthread_cond_wait(c, m)
+#define cond_signal(c)   pthread_cond_signal(c)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+typedef struct { LZ4F_cctx_mt* cctx; int tid; } worker_arg;
+
+struct LZ4F_cctx_mt_s {
+    LZ4F_preferences_t prefs;
+    int threads;
+    int started;
+    size_t blockSize;
+    size_t slotSize;         /* worst case size of a written block */
+    char* inBuff;            /* buffered input: up to one block per thread */
+    size_t inSize;
+    char* outBuff;           /* one slot per block */
+    size_t* outSizes;        /* written size of each block */
+    void* states[MAX_THREADS]; /* compression state of each thread */
+    XXH32_state_t* xxh;
+    unsigned long long totalInSize;
+
+    /* current batch */
+    const char* src;
+    int nbBlocks;
+    size_t lastBlockSize;
+    volatile int nextBlock;
+
+    /* worker threads, started on the first batch and kept until
+     * LZ4F_freeCompressionContext_mt(). the calling thread is worker 0. */
+    int nbWorkers;
+    thread_t th[MAX_THREADS];
+    worker_arg args[MAX_THREADS];
+    mutex_t lock;
+    cond_t work;             /* signaled when a batch is ready or on quit */
+    cond_t done;             /* signaled when the last worker is done */
+    unsigned batch;          /* batch number */
+    int batchThreads;        /* workers 0..batchThreads-1 work on the batch */
+    int running;             /* workers still working on the batch */
+    int quit;
+};
+
+static void writeLE32(void* dst, unsigned v)
+{
+    unsigned char* p = (unsigned char*)dst;
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void writeLE64(void* dst, unsigned long long v)
+{
+    writeLE32(dst, (unsigned)v);
+    writeLE32((char*)dst + 4, (unsigned)(v >> 32));
+}
+
+static int cpuCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+LZ4F_errorCode_t LZ4F_createCompressionContext_mt(LZ4F_cctx_mt** cctxPtr, int threads)
+{
+    LZ4F_cctx_mt* cctx = (LZ4F_cctx_mt*)calloc(1, sizeof(LZ4F_cctx_mt));
+    *cctxPtr = NULL;
+    if (!cctx) RETURN_ERROR(allocation_failed);
+    cctx->threads = threads > 0 ? threads : cpuCount();
+    if (cctx->threads < 1) cctx->threads = 1;
+    if (cctx->threads > MAX_THREADS) cctx->threads = MAX_THREADS;
+    cctx->xxh = XXH32_createState();
+    if (!cctx->xxh) { free(cctx); RETURN_ERROR(allocation_failed); }
+    *cctxPtr = cctx;
+    return 0;
+}
+
+static void freeBuffers(LZ4F_cctx_mt* cctx)
+{
+    int i;
+    free(cctx->inBuff);
+    free(cctx->outBuff);
+    free(cctx->outSizes);
+    cctx->inBuff = NULL;
+    cctx->outBuff = NULL;
+    cctx->outSizes = NULL;
+    for (i = 0; i < MAX_THREADS; i++) {
+        free(cctx->states[i]);
+        cctx->states[i] = NULL;
+    }
+}
+
+static void stopWorkers(LZ4F_cctx_mt* cctx);
+
+LZ4F_errorCode_t LZ4F_freeCompressionContext_mt(LZ4F_cctx_mt* cctx)
+{
+    if (!cctx) return 0;
+    stopWorkers(cctx);
+    freeBuffers(cctx);
+    XXH32_freeState(cctx->xxh);
+    free(cctx);
+    return 0;
+}
+
+static size_t blockSizeOf(LZ4F_blockSizeID_t id)
+{
+    switch (id) {
+    case LZ4F_max64KB:  return 64 KB;
+    case LZ4F_max256KB: return 256 KB;
+    case LZ4F_max1MB:   return 1 MB;
+    case LZ4F_max4MB:   return 4 MB;
+    default: return 0;
+    }
+}
+
+size_t LZ4F_compressBegin_mt(LZ4F_cctx_mt* cctx,
+                             void* dstBuffer, size_t dstCapacity,
+                             const LZ4F_preferences_t* prefsPtr)
+{
+    unsigned char* const dst = (unsigned char*)dstBuffer;
+    unsigned char* p = dst;
+    unsigned char* headerStart;
+    LZ4F_preferences_t prefs;
+    size_t blockSize;
+    int level;
+
+    if (dstCapacity < LZ4F_HEADER_SIZE_MAX) RETURN_ERROR(dstMaxSize_tooSmall);
+    if (prefsPtr) prefs = *prefsPtr; else memset(&prefs, 0, sizeof(prefs));
+    if (prefs.frameInfo.blockSizeID == LZ4F_default)
+        prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+    prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+    prefs.frameInfo.dictID = 0;
+    blockSize = blockSizeOf(prefs.frameInfo.blockSizeID);
+    if (!blockSize) RETURN_ERROR(maxBlockSize_invalid);
+    level = prefs.compressionLevel;
+
+    /* (re)allocate the buffers on the first frame or when the block size
+     * or the compression mode change. */
+    if (blockSize != cctx->blockSize
+        || (level < LZ4HC_CLEVEL_MIN) != (cctx->prefs.compressionLevel < LZ4HC_CLEVEL_MIN)) {
+        int const n = cctx->threads;
+        freeBuffers(cctx);
+        cctx->blockSize = blockSize;
+        cctx->slotSize = LZ4F_BLOCK_HEADER_SIZE + blockSize + 4 /* block checksum */;
+        cctx->inBuff = (char*)malloc(n * blockSize);
+        cctx->outBuff = (char*)malloc(n * cctx->slotSize);
+        cctx->outSizes = (size_t*)malloc(n * sizeof(size_t));
+        if (!cctx->inBuff || !cctx->outBuff || !cctx->outSizes) {
+            freeBuffers(cctx);
+            cctx->blockSize = 0;
+            RETURN_ERROR(allocation_failed);
+        }
+    }
+    cctx->prefs = prefs;
+    cctx->inSize = 0;
+    cctx->totalInSize = 0;
+    XXH32_reset(cctx->xxh, 0);
+
+    writeLE32(p, LZ4F_MAGICNUMBER); p += 4;
+    headerStart = p;
+    *p++ = (unsigned char)((1 << 6)   /* version */
+        + (1 << 5)                    /* independent blocks */
+        + ((prefs.frameInfo.blockChecksumFlag & 1) << 4)
+        + ((prefs.frameInfo.contentSize > 0) << 3)
+        + ((prefs.frameInfo.contentChecksumFlag & 1) << 2));
+    *p++ = (unsigned char)((prefs.frameInfo.blockSizeID & 7) << 4);
+    if (prefs.frameInfo.contentSize) {
+        writeLE64(p, prefs.frameInfo.contentSize);
+        p += 8;
+    }
+    *p = (unsigned char)(XXH32(headerStart, (size_t)(p - headerStart), 0) >> 8);
+    p++;
+
+    cctx->started = 1;
+    return (size_t)(p - dst);
+}
+
+size_t LZ4F_compressBound_mt(const LZ4F_cctx_mt* cctx, size_t srcSize)
+{
+    size_t const batchSize = cctx->threads * cctx->blockSize;
+    size_t const total = cctx->inSize + srcSize;
+    size_t nbBlocks;
+    if (srcSize == 0) /* flush or end: the buffered blocks + end mark + checksum */
+        nbBlocks = (cctx->inSize + cctx->blockSize - 1) / cctx->blockSize;
+    else
+        nbBlocks = (total / batchSize) * cctx->threads;
+    return nbBlocks * cctx->slotSize + 4 + 4;
+}
+
+/* compress the blocks of the current batch pulling block indices from a
+ * shared counter. incompressible blocks are stored uncompressed. */
+static void compressBlocks(LZ4F_cctx_mt* cctx, int tid)
+{
+    int const level = cctx->prefs.compressionLevel;
+    int const blockChecksum = cctx->prefs.frameInfo.blockChecksumFlag;
+    void* state = cctx->states[tid];
+    for (;;) {
+        int const i = __sync_fetch_and_add(&cctx->nextBlock, 1);
+        const char* src;
+        char* dst;
+        int srcSize, n;
+        unsigned header;
+        if (i >= cctx->nbBlocks) return;
+        src = cctx->src + (size_t)i * cctx->blockSize;
+        srcSize = (int)(i == cctx->nbBlocks - 1 ? cctx->lastBlockSize : cctx->blockSize);
+        dst = cctx->outBuff + (size_t)i * cctx->slotSize;
+        if (level < LZ4HC_CLEVEL_MIN) {
+            int const acceleration = level < 0 ? -level + 1 : 1;
+            n = LZ4_compress_fast_extState(state, src, dst + 4, srcSize, srcSize - 1, acceleration);
+        } else {
+            n = LZ4_compress_HC_extStateHC(state, src, dst + 4, srcSize, srcSize - 1, level);
+        }
+        if (n <= 0) {
+            memcpy(dst + 4, src, srcSize);
+            n = srcSize;
+            header = (unsigned)n | LZ4F_BLOCKUNCOMPRESSED_FLAG;
+        } else {
+            header = (unsigned)n;
+        }
+        writeLE32(dst, header);
+        if (blockChecksum)
+            writeLE32(dst + 4 + n, XXH32(dst + 4, n, 0));
+        cctx->outSizes[i] = 4 + n + (blockChecksum ? 4 : 0);
+    }
+}
+
+/* worker loop: wait for the next batch, work on it, repeat. */
+static void worker(LZ4F_cctx_mt* cctx, int tid)
+{
+    unsigned batch = 0;
+    mutex_lock(&cctx->lock);
+    for (;;) {
+        while (!cctx->quit && cctx->batch == batch)
+            cond_wait(&cctx->work, &cctx->lock);
+        if (cctx->quit) break;
+        batch = cctx->batch;
+        if (tid >= cctx->batchThreads) continue; /* not needed for this batch */
+        mutex_unlock(&cctx->lock);
+        compressBlocks(cctx, tid);
+        mutex_lock(&cctx->lock);
+        if (--cctx->running == 0)
+            cond_signal(&cctx->done);
+    }
+    mutex_unlock(&cctx->lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerThread(void* arg)
+{
+    worker_arg* a = (worker_arg*)arg;
+    worker(a->cctx, a->tid);
+    return 0;
+}
+#else
+static void* workerThread(void* arg)
+{
+    worker_arg* a = (worker_arg*)arg;
+    worker(a->cctx, a->tid);
+    return 0;
+}
+#endif
+
+/* start threads-1 workers. if some can't be created, the batches are
+ * compressed by the workers that could, or by the calling thread. */
+static void startWorkers(LZ4F_cctx_mt* cctx)
+{
+    int i;
+    mutex_init(&cctx->lock);
+    cond_init(&cctx->work);
+    cond_init(&cctx->done);
+    cctx->nbWorkers = 1;
+    for (i = 1; i < cctx->threads; i++) {
+        worker_arg* a = &cctx->args[i];
+        a->cctx = cctx;
+        a->tid = i;
+#ifdef _WIN32
+        cctx->th[i] = CreateThread(0, 0, workerThread, a, 0, 0);
+        if (!cctx->th[i]) break;
+#else
+        if (pthread_create(&cctx->th[i], 0, workerThread, a) != 0) break;
+#endif
+        cctx->nbWorkers++;
+    }
+}
+
+static void stopWorkers(LZ4F_cctx_mt* cctx)
+{
+    int i;
+    if (!cctx->nbWorkers) return;
+    mutex_lock(&cctx->lock);
+    cctx->quit = 1;
+    cond_broadcast(&cctx->work);
+    mutex_unlock(&cctx->lock);
+    for (i = 1; i < cctx->nbWorkers; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(cctx->th[i], INFINITE);
+        CloseHandle(cctx->th[i]);
+#else
+        pthread_join(cctx->th[i], 0);
+#endif
+    }
+    cond_destroy(&cctx->work);
+    cond_destroy(&cctx->done);
+    mutex_destroy(&cctx->lock);
+    cctx->nbWorkers = 0;
+}
+
+/* compress size bytes at src in parallel and write the blocks in order.
+ * the content checksum is updated on the calling thread meanwhile. */
+static size_t compressBatch(LZ4F_cctx_mt* cctx, char* dst, const char* src, size_t size)
+{
+    int nt, i;
+    size_t written = 0;
+    int const stateSize = cctx->prefs.compressionLevel < LZ4HC_CLEVEL_MIN
+        ? LZ4_sizeofState() : LZ4_sizeofStateHC();
+
+    if (size == 0) return 0;
+    cctx->src = src;
+    cctx->nbBlocks = (int)((size + cctx->blockSize - 1) / cctx->blockSize);
+    cctx->lastBlockSize = size - (cctx->nbBlocks - 1) * cctx->blockSize;
+    cctx->nextBlock = 0;
+    if (cctx->nbBlocks > 1 && cctx->threads > 1 && !cctx->nbWorkers)
+        startWorkers(cctx);
+    nt = cctx->nbBlocks < cctx->nbWorkers ? cctx->nbBlocks : cctx->nbWorkers;
+    if (nt < 1) nt = 1;
+    for (i = 0; i < nt; i++) {
+        if (!cctx->states[i]) {
+            cctx->states[i] = malloc(stateSize);
+            if (!cctx->states[i]) RETURN_ERROR(allocation_failed);
+        }
+    }
+    if (nt > 1) {
+        mutex_lock(&cctx->lock);
+        cctx->batch++;
+        cctx->batchThreads = nt;
+        cctx->running = nt - 1;
+        cond_broadcast(&cctx->work);
+        mutex_unlock(&cctx->lock);
+    }
+    if (cctx->prefs.frameInfo.contentChecksumFlag)
+        XXH32_update(cctx->xxh, src, size);
+    compressBlocks(cctx, 0);
+    if (nt > 1) {
+        mutex_lock(&cctx->lock);
+        while (cctx->running > 0)
+            cond_wait(&cctx->done, &cctx->lock);
+        mutex_unlock(&cctx->lock);
+    }
+    for (i = 0; i < cctx->nbBlocks; i++) {
+        memcpy(dst + written, cctx->outBuff + (size_t)i * cctx->slotSize, cctx->outSizes[i]);
+        written += cctx->outSizes[i];
+    }
+    cctx->totalInSize += size;
+    return written;
+}
+
+size_t LZ4F_compressUpdate_mt(LZ4F_cctx_mt* cctx,
+                              void* dstBuffer, size_t dstCapacity,
+                              const void* srcBuffer, size_t srcSize)
+{
+    size_t const batchSize = cctx->threads * cctx->blockSize;
+    const char* src = (const char*)srcBuffer;
+    char* const dst = (char*)dstBuffer;
+    size_t written = 0;
+
+    if (!cctx->started) RETURN_ERROR(GENERIC);
+    if (dstCapacity < LZ4F_compressBound_mt(cctx, srcSize)) RETURN_ERROR(dstMaxSize_tooSmall);
+
+    /* complete the buffered batch */
+    if (cctx->inSize > 0) {
+        size_t n = batchSize - cctx->inSize;
+        if (n > srcSize) n = srcSize;
+        memcpy(cctx->inBuff + cctx->inSize, src, n);
+        cctx->inSize += n;
+        src += n;
+        srcSize -= n;
+        if (cctx->inSize < batchSize) return 0;
+        written = compressBatch(cctx, dst, cctx->inBuff, batchSize);
+        if (LZ4F_isError(written)) return written;
+        cctx->inSize = 0;
+    }
+    /* compress whole batches directly from the input */
+    while (srcSize >= batchSize) {
+        size_t const r = compressBatch(cctx, dst + written, src, batchSize);
+        if (LZ4F_isError(r)) return r;
+        written += r;
+        src += batchSize;
+        srcSize -= batchSize;
+    }
+    memcpy(cctx->inBuff, src, srcSize);
+    cctx->inSize = srcSize;
+    return written;
+}
+
+size_t LZ4F_flush_mt(LZ4F_cctx_mt* cctx, void* dstBuffer, size_t dstCapacity)
+{
+    size_t r;
+    if (!cctx->started) RETURN_ERROR(GENERIC);
+    if (dstCapacity < LZ4F_compressBound_mt(cctx, 0)) RETURN_ERROR(dstMaxSize_tooSmall);
+    r = compressBatch(cctx, (char*)dstBuffer, cctx->inBuff, cctx->inSize);
+    if (LZ4F_isError(r)) return r;
+    cctx->inSize = 0;
+    return r;
+}
+
+size_t LZ4F_compressEnd_mt(LZ4F_cctx_mt* cctx, void* dstBuffer, size_t dstCapacity)
+{
+    char* const dst = (char*)dstBuffer;
+    size_t written = LZ4F_flush_mt(cctx, dstBuffer, dstCapacity);
+    if (LZ4F_isError(written)) return written;
+    writeLE32(dst + written, 0); /* end mark */
+    written += 4;
+    if (cctx->prefs.frameInfo.contentChecksumFlag) {
+        writeLE32(dst + written, XXH32_digest(cctx->xxh));
+        written += 4;
+    }
+    cctx->started = 0;
+    if (cctx->prefs.frameInfo.contentSize
+        && cctx->prefs.frameInfo.contentSize != cctx->totalInSize)
+        RETURN_ERROR(frameSize_wrong);
+    return written;
+}
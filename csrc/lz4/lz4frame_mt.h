@@ -0,0 +1,59 @@
+/*
+   LZ4 frame compression on multiple threads.
+
+   The input is cut into independent blocks which are compressed in parallel
+   and written in order, so the output is a standard LZ4 frame which can be
+   read with LZ4F_decompress() or the lz4 command line tool.
+
+   The API mirrors the LZ4F_compress*() streaming API, with these differences:
+   - blocks are always independent (frameInfo.blockMode is ignored).
+   - the default block size is 4 MB (frameInfo.blockSizeID = LZ4F_max4MB).
+   - input is buffered until there is one block for each thread, so
+     LZ4F_compressUpdate_mt() writes either nothing or a whole batch of
+     blocks. LZ4F_flush_mt() compresses whatever is buffered.
+   - dictionaries are not supported.
+   - the threads are started on the first batch and are kept, waiting for
+     the next batch, until LZ4F_freeCompressionContext_mt(). a context can
+     be reused for many frames without starting threads again.
+*/
+
+#ifndef LZ4F_MT_H
+#define LZ4F_MT_H
+
+#include "lz4frame.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+typedef struct LZ4F_cctx_mt_s LZ4F_cctx_mt;
+
+/* threads <= 0 means one thread per CPU. */
+LZ4FLIB_API LZ4F_errorCode_t LZ4F_createCompressionContext_mt(LZ4F_cctx_mt** cctxPtr, int threads);
+LZ4FLIB_API LZ4F_errorCode_t LZ4F_freeCompressionContext_mt(LZ4F_cctx_mt* cctx);
+
+/* writes the frame header (at most LZ4F_HEADER_SIZE_MAX bytes). */
+LZ4FLIB_API size_t LZ4F_compressBegin_mt(LZ4F_cctx_mt* cctx,
+                                         void* dstBuffer, size_t dstCapacity,
+                                         const LZ4F_preferences_t* prefsPtr);
+
+/* minimum dstCapacity for LZ4F_compressUpdate_mt() with srcSize bytes
+ * of input, or for LZ4F_flush_mt() and LZ4F_compressEnd_mt() if srcSize is 0. */
+LZ4FLIB_API size_t LZ4F_compressBound_mt(const LZ4F_cctx_mt* cctx, size_t srcSize);
+
+LZ4FLIB_API size_t LZ4F_compressUpdate_mt(LZ4F_cctx_mt* cctx,
+                                          void* dstBuffer, size_t dstCapacity,
+                                          const void* srcBuffer, size_t srcSize);
+
+LZ4FLIB_API size_t LZ4F_flush_mt(LZ4F_cctx_mt* cctx,
+                                 void* dstBuffer, size_t dstCapacity);
+
+/* flushes, then writes the end mark and the content checksum. */
+LZ4FLIB_API size_t LZ4F_compressEnd_mt(LZ4F_cctx_mt* cctx,
+                                       void* dstBuffer, size_t dstCapacity);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif  /* LZ4F_MT_H */
@@ -0,0 +1 @@
+P=linux64 C=-fPIC L="-s -static-libgcc" D=libmpmcq.so A=libmpmcq.a ./build.sh
@@ -0,0 +1 @@
+P=mingw64 C="-D_WIN32_WINNT=0x0602" L="-s -static-libgcc -lsynchronization" D=mpmcq.dll A=mpmcq.a ./build.sh
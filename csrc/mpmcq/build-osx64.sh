@@ -0,0 +1,3 @@
+[ `uname` = Linux ] && export X=x86_64-apple-darwin11-
+P=osx64 C="-arch x86_64" L="-arch x86_64 -install_name @rpath/libmpmcq.dylib" \
+	D=libmpmcq.dylib A=libmpmcq.a ./build.sh
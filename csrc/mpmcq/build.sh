@@ -0,0 +1,5 @@
+${X}gcc -c -O2 -std=gnu99 -Wall $C mpmcq.c
+${X}gcc *.o -shared -o ../../bin/$P/$D $L
+rm -f      ../../bin/$P/$A
+${X}ar rcs ../../bin/$P/$A *.o
+rm *.o
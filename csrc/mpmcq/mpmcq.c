@@ -0,0 +1,260 @@
+/* Bounded lock-free MPMC queue.
+   Written by Cosmin Apreutesei. Public Domain.
+
+   Dmitry Vyukov's algorithm: each cell carries a sequence number which tells
+   producers and consumers if the cell is free for the lap they are in, so
+   head and tail are claimed with a single CAS each and no locks are taken.
+   Head and tail live on separate cache lines to avoid false sharing.
+
+   Blocking is done with a futex per direction: a waiter announces itself
+   in `waiters`, re-checks the queue and sleeps on the `seq` word which the
+   other side bumps only when there are waiters, so the uncontended path
+   has no syscalls.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "mpmcq.h"
+
+#define CACHE_LINE 64
+
+#define load(p)          __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define load_relaxed(p)  __atomic_load_n(p, __ATOMIC_RELAXED)
+#define store(p, v)      __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define cas(p, e, v)     __atomic_compare_exchange_n(p, e, v, 1, \
+                             __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define inc(p)           __atomic_fetch_add(p, 1, __ATOMIC_SEQ_CST)
+#define dec(p)           __atomic_fetch_sub(p, 1, __ATOMIC_SEQ_CST)
+#define fence()          __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/* futex ------------------------------------------------------------------ */
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static void futex_wait(uint32_t* addr, uint32_t val, double expires) {
+	struct timespec ts, *pts = 0;
+	if (expires >= 0) {
+		ts.tv_sec  = (time_t)expires;
+		ts.tv_nsec = (long)((expires - (double)ts.tv_sec) * 1e9);
+		pts = &ts;
+	}
+	syscall(SYS_futex, addr, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+		val, pts, 0, FUTEX_BITSET_MATCH_ANY);
+}
+
+static void futex_wake(uint32_t* addr) {
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+
+static double now(void) {
+	FILETIME ft;
+	ULARGE_INTEGER t;
+	GetSystemTimeAsFileTime(&ft);
+	t.LowPart  = ft.dwLowDateTime;
+	t.HighPart = ft.dwHighDateTime;
+	return (t.QuadPart - 116444736000000000ULL) * 1e-7; /* to Unix epoch */
+}
+
+static void futex_wait(uint32_t* addr, uint32_t val, double expires) {
+	DWORD ms = INFINITE;
+	if (expires >= 0) {
+		double dt = expires - now();
+		ms = dt > 0 ? (DWORD)(dt * 1000) : 0;
+	}
+	WaitOnAddress(addr, &val, sizeof(val), ms);
+}
+
+static void futex_wake(uint32_t* addr) {
+	WakeByAddressSingle(addr);
+}
+
+#else /* no futex: sleep-poll */
+
+#include <time.h>
+#include <sys/time.h>
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void futex_wait(uint32_t* addr, uint32_t val, double expires) {
+	struct timespec ts = {0, 100000};
+	(void)addr; (void)val; (void)expires;
+	nanosleep(&ts, 0);
+}
+
+static void futex_wake(uint32_t* addr) {
+	(void)addr;
+}
+
+#endif
+
+/* queue ------------------------------------------------------------------ */
+
+typedef struct {
+	uint32_t seq;     /* futex word, bumped to wake a waiter */
+	uint32_t waiters; /* number of threads sleeping (or about to) on seq */
+} waitq;
+
+struct mpmcq {
+	char      pad0[CACHE_LINE];
+	uint64_t  head; /* enqueue position */
+	char      pad1[CACHE_LINE - sizeof(uint64_t)];
+	uint64_t  tail; /* dequeue position */
+	char      pad2[CACHE_LINE - sizeof(uint64_t)];
+	waitq     not_empty;
+	char      pad3[CACHE_LINE - sizeof(waitq)];
+	waitq     not_full;
+	char      pad4[CACHE_LINE - sizeof(waitq)];
+	uint64_t  mask;
+	uint32_t  item_size;
+	uint32_t  cell_size;
+	char*     cells; /* each cell: uint64_t seq followed by the item */
+	void*     mem;   /* unaligned allocation */
+};
+
+#define CELL_SEQ(q, pos)  ((uint64_t*)((q)->cells + ((pos) & (q)->mask) * (q)->cell_size))
+#define CELL_DATA(q, pos) ((char*)CELL_SEQ(q, pos) + sizeof(uint64_t))
+
+mpmcq* mpmcq_new(uint32_t capacity, uint32_t item_size) {
+	mpmcq* q;
+	void* mem;
+	uint64_t n = 2, i;
+	if (capacity < 1 || capacity > 0x80000000u || item_size < 1)
+		return 0;
+	while (n < capacity) n <<= 1;
+	mem = malloc(sizeof(mpmcq) + CACHE_LINE);
+	if (!mem) return 0;
+	q = (mpmcq*)(((uintptr_t)mem + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+	memset(q, 0, sizeof(mpmcq));
+	q->mem = mem;
+	q->mask = n - 1;
+	q->item_size = item_size;
+	q->cell_size = (sizeof(uint64_t) + item_size + 7) & ~7u;
+	q->cells = (char*)malloc(n * q->cell_size);
+	if (!q->cells) {
+		free(mem);
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+		*CELL_SEQ(q, i) = i;
+	return q;
+}
+
+void mpmcq_free(mpmcq* q) {
+	if (!q) return;
+	free(q->cells);
+	free(q->mem);
+}
+
+static void wake(waitq* w) {
+	/* pairs with the fence in wait(): either the waiter sees our change
+	   to the queue on its re-check or we see its waiters count. */
+	fence();
+	if (load_relaxed(&w->waiters)) {
+		inc(&w->seq);
+		futex_wake(&w->seq);
+	}
+}
+
+int mpmcq_trypush(mpmcq* q, const void* item) {
+	uint64_t pos = load_relaxed(&q->head);
+	for (;;) {
+		uint64_t seq = load(CELL_SEQ(q, pos));
+		int64_t dif = (int64_t)(seq - pos);
+		if (dif == 0) {
+			if (cas(&q->head, &pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return 0; /* full */
+		} else {
+			pos = load_relaxed(&q->head);
+		}
+	}
+	memcpy(CELL_DATA(q, pos), item, q->item_size);
+	store(CELL_SEQ(q, pos), pos + 1);
+	wake(&q->not_empty);
+	return 1;
+}
+
+int mpmcq_trypop(mpmcq* q, void* item) {
+	uint64_t pos = load_relaxed(&q->tail);
+	for (;;) {
+		uint64_t seq = load(CELL_SEQ(q, pos));
+		int64_t dif = (int64_t)(seq - (pos + 1));
+		if (dif == 0) {
+			if (cas(&q->tail, &pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return 0; /* empty */
+		} else {
+			pos = load_relaxed(&q->tail);
+		}
+	}
+	memcpy(item, CELL_DATA(q, pos), q->item_size);
+	store(CELL_SEQ(q, pos), pos + q->mask + 1);
+	wake(&q->not_full);
+	return 1;
+}
+
+typedef int (*try_func)(mpmcq*, void*);
+
+static int wait(mpmcq* q, waitq* w, try_func try, void* item, double expires) {
+	for (;;) {
+		uint32_t seq;
+		int ok;
+		if (try(q, item))
+			return 1;
+		if (expires >= 0 && now() >= expires)
+			return 0;
+		seq = load(&w->seq);
+		inc(&w->waiters);
+		fence();
+		ok = try(q, item);
+		if (!ok)
+			futex_wait(&w->seq, seq, expires);
+		dec(&w->waiters);
+		if (ok)
+			return 1;
+	}
+}
+
+int mpmcq_push(mpmcq* q, const void* item, double expires) {
+	return wait(q, &q->not_full, (try_func)mpmcq_trypush, (void*)item, expires);
+}
+
+int mpmcq_pop(mpmcq* q, void* item, double expires) {
+	return wait(q, &q->not_empty, mpmcq_trypop, item, expires);
+}
+
+uint32_t mpmcq_capacity(mpmcq* q) {
+	return (uint32_t)(q->mask + 1);
+}
+
+uint32_t mpmcq_item_size(mpmcq* q) {
+	return q->item_size;
+}
+
+uint32_t mpmcq_length(mpmcq* q) {
+	uint64_t tail = load(&q->tail);
+	uint64_t head = load(&q->head);
+	return head > tail ? (uint32_t)(head - tail) : 0;
+}
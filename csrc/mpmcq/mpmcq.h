@@ -0,0 +1,28 @@
+#ifndef MPMCQ_H
+#define MPMCQ_H
+
+#include <stdint.h>
+
+/* Bounded lock-free multi-producer multi-consumer queue of fixed-size items.
+   Threads only block (on a futex) when the queue is empty or full. */
+
+typedef struct mpmcq mpmcq;
+
+mpmcq*   mpmcq_new      (uint32_t capacity, uint32_t item_size);
+void     mpmcq_free     (mpmcq* q);
+
+/* Non-blocking: return 1 on success, 0 if the queue is full/empty. */
+int      mpmcq_trypush  (mpmcq* q, const void* item);
+int      mpmcq_trypop   (mpmcq* q, void* item);
+
+/* Blocking: `expires` is an absolute time as returned by time(), with
+   fractional seconds; a negative value means wait forever.
+   Return 1 on success, 0 on timeout. */
+int      mpmcq_push     (mpmcq* q, const void* item, double expires);
+int      mpmcq_pop      (mpmcq* q, void* item, double expires);
+
+uint32_t mpmcq_capacity (mpmcq* q);
+uint32_t mpmcq_item_size(mpmcq* q);
+uint32_t mpmcq_length   (mpmcq* q); /* approximate when not quiescent */
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * xxHash - hashing many buffers in one call.
+ * See xxhash_batch.h.
+ */
+
+#include "xxhash_batch.h"
+
+XXH_PUBLIC_API void XXH3_64bits_batch(const void* const* bufs, const size_t* lens,
+                                      size_t n, XXH64_hash_t seed,
+                                      XXH64_hash_t* hashes)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        hashes[i] = XXH3_64bits_withSeed(bufs[i], lens[i], seed);
+}
+
+XXH_PUBLIC_API void XXH3_128bits_batch(const void* const* bufs, const size_t* lens,
+                                       size_t n, XXH64_hash_t seed,
+                                       XXH128_hash_t* hashes)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        hashes[i] = XXH3_128bits_withSeed(bufs[i], lens[i], seed);
+}
+
+XXH_PUBLIC_API size_t XXH3_64bits_blocks(const void* data, size_t len,
+                                         size_t blockSize, XXH64_hash_t seed,
+                                         XXH64_hash_t* hashes)
+{
+    const char* p = (const char*)data;
+    size_t i = 0;
+    if (blockSize == 0) return 0;
+    for (; len > 0; i++) {
+        size_t n = len < blockSize ? len : blockSize;
+        hashes[i] = XXH3_64bits_withSeed(p, n, seed);
+        p += n;
+        len -= n;
+    }
+    return i;
+}
+
+XXH_PUBLIC_API size_t XXH3_128bits_blocks(const void* data, size_t len,
+                                          size_t blockSize, XXH64_hash_t seed,
+                                          XXH128_hash_t* hashes)
+{
+    const char* p = (const char*)data;
+    size_t i = 0;
+    if (blockSize == 0) return 0;
+    for (; len > 0; i++) {
+        size_t n = len < blockSize ? len : blockSize;
+        hashes[i] = XXH3_128bits_withSeed(p, n, seed);
+        p += n;
+        len -= n;
+    }
+    return i;
+}
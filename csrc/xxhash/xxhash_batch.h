@@ -0,0 +1,43 @@
+/*
+ * xxHash - hashing many buffers in one call.
+ *
+ * Hashing small buffers one call at a time is dominated by the call
+ * overhead when calling from a scripting language through a FFI.
+ * These functions hash N buffers with XXH3 in a single call, either
+ * independent buffers or the consecutive blocks of a single buffer
+ * (eg. the blocks of a file for rsync-style deduplication).
+ */
+
+#ifndef XXHASH_BATCH_H
+#define XXHASH_BATCH_H
+
+#include "xxhash.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* hashes[i] = hash of the lens[i] bytes at bufs[i], for i in 0..n-1. */
+XXH_PUBLIC_API void XXH3_64bits_batch(const void* const* bufs, const size_t* lens,
+                                      size_t n, XXH64_hash_t seed,
+                                      XXH64_hash_t* hashes);
+XXH_PUBLIC_API void XXH3_128bits_batch(const void* const* bufs, const size_t* lens,
+                                       size_t n, XXH64_hash_t seed,
+                                       XXH128_hash_t* hashes);
+
+/* hashes[i] = hash of the i-th block of blockSize bytes of data, the last
+ * block being shorter if len is not a multiple of blockSize. hashes must
+ * have room for (len + blockSize - 1) / blockSize hashes, which is the
+ * returned value. */
+XXH_PUBLIC_API size_t XXH3_64bits_blocks(const void* data, size_t len,
+                                         size_t blockSize, XXH64_hash_t seed,
+                                         XXH64_hash_t* hashes);
+XXH_PUBLIC_API size_t XXH3_128bits_blocks(const void* data, size_t len,
+                                          size_t blockSize, XXH64_hash_t seed,
+                                          XXH128_hash_t* hashes);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* XXHASH_BATCH_H */
@@ -6,6 +6,7 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "simd.h"
 
 local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 
@@ -99,6 +100,16 @@ uLong ZEXPORT adler32_z(adler, buf, len)
         return adler | (sum2 << 16);
     }
 
+#ifdef X86_SIMD
+    if (len >= ADLER32_SIMD_MIN_LEN) {
+        cpu_check_features();
+        if (x86_cpu_has_avx2)
+            return adler32_avx2(adler | (sum2 << 16), buf, len);
+        if (x86_cpu_has_ssse3)
+            return adler32_ssse3(adler | (sum2 << 16), buf, len);
+    }
+#endif
+
     /* do length NMAX blocks -- requires just one modulo operation */
     while (len >= NMAX) {
         len -= NMAX;
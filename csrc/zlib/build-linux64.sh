@@ -1 +1 @@
-P=linux64 C="-fPIC -include _memcpy.h -DHAVE_UNISTD_H" L="-s -static-libgcc" D=libz.so A=libz.a ./build.sh
+P=linux64 C="-fPIC -include _memcpy.h -DHAVE_UNISTD_H" L="-s -static-libgcc -lpthread" D=libz.so A=libz.a ./build.sh
@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "simd.h"
 
 /* Definitions for doing the crc four data bytes at a time. */
 #if !defined(NOBYFOUR) && defined(Z_U4)
@@ -211,6 +212,20 @@ unsigned long ZEXPORT crc32_z(crc, buf, len)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+#ifdef X86_SIMD
+    if (len >= CRC32_SIMD_MIN_LEN) {
+        cpu_check_features();
+        if (x86_cpu_has_pclmul) {
+            z_size_t n = len & ~(z_size_t)15;
+            crc = crc32_pclmul(crc ^ 0xffffffffUL, buf, n) ^ 0xffffffffUL;
+            buf += n;
+            len -= n;
+            if (len == 0)
+                return crc;
+        }
+    }
+#endif /* X86_SIMD */
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         z_crc_t endian;
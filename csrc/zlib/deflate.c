@@ -50,6 +50,7 @@
 /* @(#) $Id$ */
 
 #include "deflate.h"
+#include "simd.h"
 
 const char deflate_copyright[] =
    " deflate 1.2.11 Copyright 1995-2017 Jean-loup Gailly and Mark Adler ";
@@ -205,6 +206,16 @@ local void slide_hash(s)
     Posf *p;
     uInt wsize = s->w_size;
 
+#ifdef X86_SIMD
+    cpu_check_features();
+    if (x86_cpu_has_sse2) {
+        slide_hash_sse2(s->head, s->hash_size, wsize);
+#ifndef FASTEST
+        slide_hash_sse2(s->prev, wsize, wsize);
+#endif
+        return;
+    }
+#endif
     n = s->hash_size;
     p = &s->head[n];
     do {
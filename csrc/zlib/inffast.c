@@ -12,6 +12,25 @@
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+#ifdef INFLATE_FAST_WIDE
+typedef unsigned long long bitbuf_t;
+
+/* Fill the bit buffer up to 56..63 bits with an unaligned little-endian load
+   of the next 8 input bytes, advancing in only past the whole bytes that fit.
+   The bits above bits are either zero or the same input bits loaded before,
+   so or-ing the new load over them is harmless. */
+#  define REFILL() \
+    do { \
+        bitbuf_t next; \
+        zmemcpy((Bytef *)&next, in, sizeof(next)); \
+        hold |= next << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#else
+typedef unsigned long bitbuf_t;
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -23,7 +42,7 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE (6, or 8 with INFLATE_FAST_WIDE)
         strm->avail_out >= 258
         start >= strm->avail_out
         state->bits < 8
@@ -42,6 +61,10 @@
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
       checking for available input while decoding.
 
+    - With INFLATE_FAST_WIDE the bit buffer is refilled to at least 56 bits
+      once per loop, which covers a whole length/distance pair, so there are
+      no other refills. The refill reads 8 bytes, hence the 8 bytes minimum.
+
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
@@ -64,7 +87,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
-    unsigned long hold;         /* local strm->hold */
+    bitbuf_t hold;              /* local strm->hold */
     unsigned bits;              /* local strm->bits */
     code const FAR *lcode;      /* local strm->lencode */
     code const FAR *dcode;      /* local strm->distcode */
@@ -80,7 +103,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
@@ -101,12 +124,16 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#ifdef INFLATE_FAST_WIDE
+        REFILL();
+#else
         if (bits < 15) {
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
         }
+#endif
         here = lcode[hold & lmask];
       dolen:
         op = (unsigned)(here.bits);
@@ -123,21 +150,25 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
             len = (unsigned)(here.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
+#ifndef INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(*in++) << bits;
                     bits += 8;
                 }
+#endif
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
+#ifndef INFLATE_FAST_WIDE
             if (bits < 15) {
                 hold += (unsigned long)(*in++) << bits;
                 bits += 8;
                 hold += (unsigned long)(*in++) << bits;
                 bits += 8;
             }
+#endif
             here = dcode[hold & dmask];
           dodist:
             op = (unsigned)(here.bits);
@@ -147,6 +178,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(here.val);
                 op &= 15;                       /* number of extra bits */
+#ifndef INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(*in++) << bits;
                     bits += 8;
@@ -155,6 +187,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         bits += 8;
                     }
                 }
+#endif
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -293,15 +326,17 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     len = bits >> 3;
     in -= len;
     bits -= len << 3;
-    hold &= (1U << bits) - 1;
+    hold &= ((bitbuf_t)1 << bits) - 1;
 
     /* update state and return */
     strm->next_in = in;
     strm->next_out = out;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
-    state->hold = hold;
+    state->hold = (unsigned long)hold;
     state->bits = bits;
     return;
 }
@@ -8,4 +8,16 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* On 64-bit little-endian CPUs inflate_fast() refills its bit buffer with
+   one unaligned 8-byte load instead of a byte at a time, so it needs two
+   more bytes of input to be available than the six it can consume. */
+#if !defined(NO_INFLATE_FAST_WIDE) && \
+    (defined(__x86_64__) || defined(_M_X64) || \
+     (defined(__aarch64__) && !defined(__AARCH64EB__)))
+#  define INFLATE_FAST_WIDE
+#  define INFLATE_FAST_MIN_HAVE 8
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
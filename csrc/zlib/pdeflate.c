@@ -0,0 +1,417 @@
+/* pdeflate.c -- parallel deflate (pigz-style) on top of zlib
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#if defined(_WIN32) && !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600 /* for condition variables */
+#endif
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "pdeflate.h"
+
+#define DICT_SIZE 32768
+#define MAX_THREADS 256
+#define BATCH_BLOCKS 4      /* blocks per thread in a batch */
+
+#ifdef _WIN32
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+#define mutex_init(m)    InitializeCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+#define mutex_lock(m)    EnterCriticalSection(m)
+#define mutex_unlock(m)  LeaveCriticalSection(m)
+#define cond_init(c)     InitializeConditionVariable(c)
+#define cond_destroy(c)
+#define cond_wait(c, m)  SleepConditionVariableCS(c, m, INFINITE)
+#define cond_signal(c)   WakeConditionVariable(c)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+#define mutex_init(m)    pthread_mutex_init(m, 0)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m)    pthread_mutex_lock(m)
+#define mutex_unlock(m)  pthread_mutex_unlock(m)
+#define cond_init(c)     pthread_cond_init(c, 0)
+#define cond_destroy(c)  pthread_cond_destroy(c)
+#define cond_wait(c, m)  pthread_cond_wait(c, m)
+#define cond_signal(c)   pthread_cond_signal(c)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+typedef struct { pdeflate_state *s; int tid; } worker_arg;
+
+struct pdeflate_state_s {
+    int level, format, strategy, threads;
+    long block_size;
+    long batch_size;        /* threads * BATCH_BLOCKS blocks */
+    long slot_size;         /* worst-case compressed size of a block */
+    char *in;               /* last DICT_SIZE bytes of input, then the batch */
+    long dict_len;          /* bytes of the dictionary area filled */
+    long in_len;            /* bytes of the batch filled */
+    char *out;              /* one slot per block */
+    long *out_len;          /* compressed size of each block */
+    uLong *check;           /* crc32 or adler32 of each block */
+    z_stream *strm[MAX_THREADS];
+    uLong total_check;
+    uLong total_len;        /* mod 2^32 */
+    int started;
+    int error;
+
+    /* current batch */
+    int nblocks;
+    volatile int next;
+
+    /* worker threads, started on the first batch and kept until
+       pdeflateEnd(). the calling thread is worker 0. */
+    int nworkers;
+    thread_t th[MAX_THREADS];
+    worker_arg args[MAX_THREADS];
+    mutex_t lock;
+    cond_t work;            /* signaled when a batch is ready or on quit */
+    cond_t done;            /* signaled when the last worker is done */
+    unsigned batch;         /* batch number */
+    int running;            /* workers still working on the batch */
+    int quit;
+};
+
+static int cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+pdeflate_state * ZEXPORT pdeflateInit(int level, int format, int strategy,
+    int threads, int block_size)
+{
+    pdeflate_state *s = (pdeflate_state *)calloc(1, sizeof(pdeflate_state));
+    int n;
+    if (!s) return NULL;
+    s->level = level;
+    s->format = format;
+    s->strategy = strategy;
+    n = threads > 0 ? threads : cpu_count();
+    s->threads = n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+    s->block_size = block_size > 0 ? block_size : PDEFLATE_BLOCK_SIZE;
+    s->batch_size = s->threads * BATCH_BLOCKS * s->block_size;
+    /* compressBound() plus the empty stored block of the sync flush */
+    s->slot_size = (long)compressBound((uLong)s->block_size) + 16;
+    s->in = (char *)malloc(DICT_SIZE + s->batch_size);
+    s->out = (char *)malloc(s->threads * BATCH_BLOCKS * s->slot_size);
+    s->out_len = (long *)malloc(s->threads * BATCH_BLOCKS * sizeof(long));
+    s->check = (uLong *)malloc(s->threads * BATCH_BLOCKS * sizeof(uLong));
+    if (!s->in || !s->out || !s->out_len || !s->check) {
+        pdeflateEnd(s);
+        return NULL;
+    }
+    s->total_check = format == PDEFLATE_ZLIB ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+    return s;
+}
+
+static void stop_workers(pdeflate_state *s);
+
+void ZEXPORT pdeflateEnd(pdeflate_state *s)
+{
+    int i;
+    if (!s) return;
+    stop_workers(s);
+    for (i = 0; i < MAX_THREADS; i++)
+        if (s->strm[i]) {
+            deflateEnd(s->strm[i]);
+            free(s->strm[i]);
+        }
+    free(s->in);
+    free(s->out);
+    free(s->out_len);
+    free(s->check);
+    free(s);
+}
+
+long ZEXPORT pdeflateBound(pdeflate_state *s, long len)
+{
+    long nblocks = len > 0
+        ? (s->in_len + len) / s->batch_size * s->threads * BATCH_BLOCKS
+        : (s->in_len + s->block_size - 1) / s->block_size;
+    return nblocks * s->slot_size + 10 /* header */ + 2 /* last block */ + 8 /* trailer */;
+}
+
+/* compress the blocks of the batch pulling block indices from a shared
+   counter. each block is a raw deflate stream primed with the 32K of input
+   before it and ended with a sync flush. the deflate stream of a worker is
+   created when it gets its first block. */
+static void deflate_blocks(pdeflate_state *s, int tid)
+{
+    char *batch = s->in + DICT_SIZE;
+    for (;;) {
+        int i = __sync_fetch_and_add(&s->next, 1);
+        z_stream *strm;
+        char *p;
+        long len, dict_len;
+        if (i >= s->nblocks) return;
+        if (!s->strm[tid]) {
+            strm = (z_stream *)calloc(1, sizeof(z_stream));
+            if (!strm || deflateInit2(strm, s->level, Z_DEFLATED,
+                -MAX_WBITS, 8, s->strategy) != Z_OK) {
+                free(strm);
+                s->error = Z_MEM_ERROR;
+                return;
+            }
+            s->strm[tid] = strm;
+        }
+        strm = s->strm[tid];
+        p = batch + i * s->block_size;
+        len = i == s->nblocks - 1 ? s->in_len - i * s->block_size : s->block_size;
+        dict_len = (long)(p - batch) + s->dict_len;
+        if (dict_len > DICT_SIZE) dict_len = DICT_SIZE;
+        if (deflateReset(strm) != Z_OK
+            || (dict_len > 0 && deflateSetDictionary(strm,
+                (const Bytef *)(p - dict_len), (uInt)dict_len) != Z_OK)) {
+            s->error = Z_STREAM_ERROR;
+            return;
+        }
+        strm->next_in = (Bytef *)p;
+        strm->avail_in = (uInt)len;
+        strm->next_out = (Bytef *)(s->out + i * s->slot_size);
+        strm->avail_out = (uInt)s->slot_size;
+        if (deflate(strm, Z_SYNC_FLUSH) != Z_OK
+            || strm->avail_in != 0 || strm->avail_out == 0) {
+            s->error = Z_BUF_ERROR;
+            return;
+        }
+        s->out_len[i] = s->slot_size - strm->avail_out;
+        if (s->format == PDEFLATE_GZIP)
+            s->check[i] = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)p, (uInt)len);
+        else if (s->format == PDEFLATE_ZLIB)
+            s->check[i] = adler32(adler32(0L, Z_NULL, 0), (const Bytef *)p, (uInt)len);
+    }
+}
+
+/* worker loop: wait for the next batch, work on it, repeat. */
+static void worker(pdeflate_state *s, int tid)
+{
+    unsigned batch = 0;
+    mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->quit && s->batch == batch)
+            cond_wait(&s->work, &s->lock);
+        if (s->quit) break;
+        batch = s->batch;
+        mutex_unlock(&s->lock);
+        deflate_blocks(s, tid);
+        mutex_lock(&s->lock);
+        if (--s->running == 0)
+            cond_signal(&s->done);
+    }
+    mutex_unlock(&s->lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_thread(void *arg)
+{
+    worker_arg *a = (worker_arg *)arg;
+    worker(a->s, a->tid);
+    return 0;
+}
+#else
+static void *worker_thread(void *arg)
+{
+    worker_arg *a = (worker_arg *)arg;
+    worker(a->s, a->tid);
+    return 0;
+}
+#endif
+
+/* start threads-1 workers. if some can't be created, the batches are
+   compressed by the workers that could, or by the calling thread. */
+static void start_workers(pdeflate_state *s)
+{
+    int i;
+    mutex_init(&s->lock);
+    cond_init(&s->work);
+    cond_init(&s->done);
+    s->nworkers = 1;
+    for (i = 1; i < s->threads; i++) {
+        worker_arg *a = &s->args[i];
+        a->s = s;
+        a->tid = i;
+#ifdef _WIN32
+        s->th[i] = CreateThread(0, 0, worker_thread, a, 0, 0);
+        if (!s->th[i]) break;
+#else
+        if (pthread_create(&s->th[i], 0, worker_thread, a) != 0) break;
+#endif
+        s->nworkers++;
+    }
+}
+
+static void stop_workers(pdeflate_state *s)
+{
+    int i;
+    if (!s->nworkers) return;
+    mutex_lock(&s->lock);
+    s->quit = 1;
+    cond_broadcast(&s->work);
+    mutex_unlock(&s->lock);
+    for (i = 1; i < s->nworkers; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(s->th[i], INFINITE);
+        CloseHandle(s->th[i]);
+#else
+        pthread_join(s->th[i], 0);
+#endif
+    }
+    cond_destroy(&s->work);
+    cond_destroy(&s->done);
+    mutex_destroy(&s->lock);
+    s->nworkers = 0;
+}
+
+static long write_header(pdeflate_state *s, unsigned char *out)
+{
+    if (s->format == PDEFLATE_GZIP) {
+        out[0] = 0x1f; out[1] = 0x8b; out[2] = Z_DEFLATED; out[3] = 0;
+        out[4] = out[5] = out[6] = out[7] = 0; /* mtime */
+        out[8] = s->level == 9 ? 2 : s->level == 1 ? 4 : 0;
+        out[9] = 3; /* unix */
+        return 10;
+    } else if (s->format == PDEFLATE_ZLIB) {
+        int level = s->level == Z_DEFAULT_COMPRESSION ? 6 : s->level;
+        unsigned h = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+        h |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+        h += 31 - h % 31;
+        out[0] = (unsigned char)(h >> 8);
+        out[1] = (unsigned char)h;
+        return 2;
+    }
+    return 0;
+}
+
+/* compress the buffered batch in parallel and write the blocks in order. */
+static long deflate_batch(pdeflate_state *s, char *out)
+{
+    int i;
+    long n = 0, keep;
+
+    if (s->in_len == 0) return 0;
+    s->nblocks = (int)((s->in_len + s->block_size - 1) / s->block_size);
+    s->next = 0;
+    if (s->nblocks > 1 && s->threads > 1 && !s->nworkers)
+        start_workers(s);
+    if (s->nworkers > 1) {
+        mutex_lock(&s->lock);
+        s->batch++;
+        s->running = s->nworkers - 1;
+        cond_broadcast(&s->work);
+        mutex_unlock(&s->lock);
+        deflate_blocks(s, 0);
+        mutex_lock(&s->lock);
+        while (s->running > 0)
+            cond_wait(&s->done, &s->lock);
+        mutex_unlock(&s->lock);
+    } else
+        deflate_blocks(s, 0);
+    if (s->error) return s->error;
+
+    for (i = 0; i < s->nblocks; i++) {
+        long len = i == s->nblocks - 1 ? s->in_len - i * s->block_size : s->block_size;
+        memcpy(out + n, s->out + i * s->slot_size, s->out_len[i]);
+        n += s->out_len[i];
+        if (s->format == PDEFLATE_GZIP)
+            s->total_check = crc32_combine(s->total_check, s->check[i], len);
+        else if (s->format == PDEFLATE_ZLIB)
+            s->total_check = adler32_combine(s->total_check, s->check[i], len);
+        s->total_len += (uLong)len;
+    }
+
+    /* keep the last 32K of input as dictionary for the next batch */
+    keep = s->dict_len + s->in_len;
+    if (keep > DICT_SIZE) keep = DICT_SIZE;
+    memmove(s->in + DICT_SIZE - keep, s->in + DICT_SIZE + s->in_len - keep, keep);
+    s->dict_len = keep;
+    s->in_len = 0;
+    return n;
+}
+
+long ZEXPORT pdeflateWrite(pdeflate_state *s, const void *in, long len,
+    void *out, long outlen)
+{
+    const char *p = (const char *)in;
+    char *o = (char *)out;
+    long n = 0;
+    if (s->error) return s->error;
+    if (outlen < pdeflateBound(s, len)) return Z_BUF_ERROR;
+    if (!s->started) {
+        n += write_header(s, (unsigned char *)o);
+        s->started = 1;
+    }
+    while (len > 0) {
+        long m = s->batch_size - s->in_len;
+        if (m > len) m = len;
+        memcpy(s->in + DICT_SIZE + s->in_len, p, m);
+        s->in_len += m;
+        p += m;
+        len -= m;
+        if (s->in_len == s->batch_size) {
+            long r = deflate_batch(s, o + n);
+            if (r < 0) return r;
+            n += r;
+        }
+    }
+    return n;
+}
+
+static void put_le32(unsigned char *p, uLong v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+long ZEXPORT pdeflateFinish(pdeflate_state *s, void *out, long outlen)
+{
+    unsigned char *o = (unsigned char *)out;
+    long n = 0, r;
+    if (s->error) return s->error;
+    if (outlen < pdeflateBound(s, 0)) return Z_BUF_ERROR;
+    if (!s->started) {
+        n += write_header(s, o);
+        s->started = 1;
+    }
+    r = deflate_batch(s, (char *)o + n);
+    if (r < 0) return r;
+    n += r;
+    /* an empty final block with fixed codes */
+    o[n++] = 0x03;
+    o[n++] = 0x00;
+    if (s->format == PDEFLATE_GZIP) {
+        put_le32(o + n, s->total_check);
+        put_le32(o + n + 4, s->total_len);
+        n += 8;
+    } else if (s->format == PDEFLATE_ZLIB) {
+        uLong a = s->total_check;
+        o[n++] = (unsigned char)(a >> 24);
+        o[n++] = (unsigned char)(a >> 16);
+        o[n++] = (unsigned char)(a >> 8);
+        o[n++] = (unsigned char)a;
+    }
+    /* ready for a new stream */
+    s->started = 0;
+    s->dict_len = 0;
+    s->total_len = 0;
+    s->total_check = s->format == PDEFLATE_ZLIB ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+    return n;
+}
@@ -0,0 +1,55 @@
+/* pdeflate.h -- parallel deflate (pigz-style) on top of zlib
+
+  The input is cut into blocks which are compressed on multiple threads,
+  each block using the last 32K of input before it as preset dictionary,
+  so the compression ratio is close to that of a single deflate stream.
+  Blocks are ended with a sync flush so that they can be concatenated into
+  a single deflate stream, which is wrapped into a gzip member or a zlib
+  stream with a checksum combined from the checksums of the blocks.
+
+  Input is buffered until there are 4 blocks for each thread, so
+  pdeflateWrite() writes either nothing or a whole batch of blocks.
+  The threads are started on the first batch and kept until pdeflateEnd().
+*/
+
+#ifndef PDEFLATE_H
+#define PDEFLATE_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PDEFLATE_RAW  0
+#define PDEFLATE_ZLIB 1
+#define PDEFLATE_GZIP 2
+
+#define PDEFLATE_BLOCK_SIZE (128 * 1024)
+
+typedef struct pdeflate_state_s pdeflate_state;
+
+/* level: 0..9 or Z_DEFAULT_COMPRESSION; threads: 0 = one per CPU;
+   block_size: 0 = PDEFLATE_BLOCK_SIZE. returns NULL on allocation failure. */
+ZEXTERN pdeflate_state * ZEXPORT pdeflateInit OF((int level, int format,
+    int strategy, int threads, int block_size));
+ZEXTERN void ZEXPORT pdeflateEnd OF((pdeflate_state *s));
+
+/* max. output of pdeflateWrite() for len bytes of input, or of
+   pdeflateFinish() if len is 0. */
+ZEXTERN long ZEXPORT pdeflateBound OF((pdeflate_state *s, long len));
+
+/* compress len bytes of input and return the number of bytes written to
+   out, which must have at least pdeflateBound(len) bytes, or a Z_* error. */
+ZEXTERN long ZEXPORT pdeflateWrite OF((pdeflate_state *s,
+    const void *in, long len, void *out, long outlen));
+
+/* compress the buffered input and write the stream trailer. */
+ZEXTERN long ZEXPORT pdeflateFinish OF((pdeflate_state *s,
+    void *out, long outlen));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PDEFLATE_H */
@@ -0,0 +1,279 @@
+/* simd.c -- runtime-dispatched x86 SIMD versions of zlib's hot loops
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The CRC-32 folding follows "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction" by V. Gopal et al. (Intel, 2009) and the
+ * Adler-32 kernels the approach of the Chromium zlib fork: sums of bytes
+ * with psadbw and sums of weighted bytes with pmaddubsw.
+ */
+
+#include "zutil.h"
+#include "simd.h"
+
+#ifdef X86_SIMD
+
+#include <immintrin.h>
+
+int ZLIB_INTERNAL x86_cpu_has_sse2;
+int ZLIB_INTERNAL x86_cpu_has_ssse3;
+int ZLIB_INTERNAL x86_cpu_has_pclmul;
+int ZLIB_INTERNAL x86_cpu_has_avx2;
+
+local int cpu_checked = 0;
+
+void ZLIB_INTERNAL cpu_check_features()
+{
+    if (cpu_checked)
+        return;
+    __builtin_cpu_init();
+    x86_cpu_has_sse2 = __builtin_cpu_supports("sse2");
+    x86_cpu_has_ssse3 = __builtin_cpu_supports("ssse3");
+    x86_cpu_has_pclmul = __builtin_cpu_supports("pclmul") &&
+                         __builtin_cpu_supports("sse4.1");
+    x86_cpu_has_avx2 = __builtin_cpu_supports("avx2");
+    cpu_checked = 1;
+}
+
+/* check the features when the library is loaded, before any threads can
+   call it, so that the calls above are only reads after that. */
+__attribute__((constructor))
+local void cpu_check_features_at_load()
+{
+    cpu_check_features();
+}
+
+/* ========================================================================= */
+__attribute__((target("pclmul,sse4.1")))
+unsigned long ZLIB_INTERNAL crc32_pclmul(crc, buf, len)
+    unsigned long crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    /* the bit-reflected folding constants x^(4*128+32) mod P,
+       x^(4*128-32) mod P, x^(128+32) mod P, x^(128-32) mod P, x^64 mod P,
+       and the Barrett reduction constants P' and mu */
+    static const unsigned long long k1k2[2] = {0x0154442bd4ULL, 0x01c6e41596ULL};
+    static const unsigned long long k3k4[2] = {0x01751997d0ULL, 0x00ccaa009eULL};
+    static const unsigned long long k5k0[2] = {0x0163cd6124ULL, 0x0000000000ULL};
+    static const unsigned long long poly[2] = {0x01db710641ULL, 0x01f7011641ULL};
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    /* fold 64 bytes at a time into four 128-bit accumulators */
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_loadu_si128((const __m128i *)k1k2);
+    buf += 64;
+    len -= 64;
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold the four accumulators into one */
+    x0 = _mm_loadu_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* fold the remaining 16 byte blocks */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_loadu_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (unsigned long)(unsigned)_mm_extract_epi32(x1, 1);
+}
+
+/* ========================================================================= */
+#define BASE 65521U     /* largest prime smaller than 65536 */
+#define NMAX 5552
+/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
+
+/* add the remaining (less than a block of) bytes and reduce */
+local uLong adler32_tail(s1, s2, buf, len)
+    unsigned long s1;
+    unsigned long s2;
+    const Bytef *buf;
+    z_size_t len;
+{
+    while (len--) {
+        s1 += *buf++;
+        s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+    return s1 | (s2 << 16);
+}
+
+/* For each block of 32 bytes b[0..31], s1 grows by the sum of the bytes and
+   s2 by 32*s1 (s1 before the block) plus the sum of (32-i)*b[i]. The s1
+   before each block is accumulated in ps and multiplied by 32 at the end. */
+__attribute__((target("ssse3")))
+uLong ZLIB_INTERNAL adler32_ssse3(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    z_size_t blocks = len / 32;
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                       24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                       8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * 32;
+    while (blocks) {
+        unsigned n = NMAX / 32;
+        __m128i v_ps, v_s1, v_s2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+        v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        v_s1 = zero;
+        do {
+            const __m128i b1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i b2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b1, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b2, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+            buf += 32;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        /* horizontal sums */
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (unsigned)_mm_cvtsi128_si32(v_s1);
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (unsigned)_mm_cvtsi128_si32(v_s2);
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+    return adler32_tail(s1, s2, buf, len);
+}
+
+/* same as adler32_ssse3() with one 32 byte load per block. */
+__attribute__((target("avx2")))
+uLong ZLIB_INTERNAL adler32_avx2(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    z_size_t blocks = len / 32;
+    const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                         24, 23, 22, 21, 20, 19, 18, 17,
+                                         16, 15, 14, 13, 12, 11, 10, 9,
+                                         8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    len -= blocks * 32;
+    while (blocks) {
+        unsigned n = NMAX / 32;
+        __m256i v_ps, v_s1, v_s2;
+        __m128i h1, h2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+        v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+        v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+        v_s1 = zero;
+        do {
+            const __m256i b = _mm256_loadu_si256((const __m256i *)buf);
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(b, zero));
+            v_s2 = _mm256_add_epi32(v_s2,
+                _mm256_madd_epi16(_mm256_maddubs_epi16(b, tap), ones));
+            buf += 32;
+        } while (--n);
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+        /* horizontal sums */
+        h1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1),
+                           _mm256_extracti128_si256(v_s1, 1));
+        h1 = _mm_add_epi32(h1, _mm_shuffle_epi32(h1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (unsigned)_mm_cvtsi128_si32(h1);
+        h2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2),
+                           _mm256_extracti128_si256(v_s2, 1));
+        h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(2, 3, 0, 1)));
+        h2 = _mm_add_epi32(h2, _mm_shuffle_epi32(h2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (unsigned)_mm_cvtsi128_si32(h2);
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+    return adler32_tail(s1, s2, buf, len);
+}
+
+/* ========================================================================= */
+__attribute__((target("sse2")))
+void ZLIB_INTERNAL slide_hash_sse2(p, n, wsize)
+    ush FAR *p;
+    unsigned n;
+    uInt wsize;
+{
+    const __m128i w = _mm_set1_epi16((short)wsize);
+    do {
+        __m128i v = _mm_loadu_si128((__m128i *)p);
+        _mm_storeu_si128((__m128i *)p, _mm_subs_epu16(v, w));
+        p += 8;
+    } while (n -= 8);
+}
+
+#endif /* X86_SIMD */
@@ -0,0 +1,51 @@
+/* simd.h -- runtime-dispatched x86 SIMD versions of zlib's hot loops
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+/* The SIMD functions are compiled with gcc/clang target attributes so that
+   the rest of the library can still be built for the baseline CPU. They are
+   only called after checking the CPU features at runtime and they produce
+   the same results as the portable code. Define NO_SIMD to leave them out.
+ */
+#if !defined(NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#  define X86_SIMD
+#endif
+
+#ifdef X86_SIMD
+
+extern int ZLIB_INTERNAL x86_cpu_has_sse2;
+extern int ZLIB_INTERNAL x86_cpu_has_ssse3;
+extern int ZLIB_INTERNAL x86_cpu_has_pclmul;   /* and SSE4.1 */
+extern int ZLIB_INTERNAL x86_cpu_has_avx2;
+
+/* set the x86_cpu_has_* flags. cheap after the first call. */
+void ZLIB_INTERNAL cpu_check_features OF((void));
+
+/* crc is the crc register, ie. not pre- or post-conditioned.
+   len must be at least 64 and a multiple of 16. */
+#define CRC32_SIMD_MIN_LEN 64
+unsigned long ZLIB_INTERNAL crc32_pclmul OF((unsigned long crc,
+    const unsigned char FAR *buf, z_size_t len));
+
+#define ADLER32_SIMD_MIN_LEN 64
+uLong ZLIB_INTERNAL adler32_ssse3 OF((uLong adler, const Bytef *buf,
+    z_size_t len));
+uLong ZLIB_INTERNAL adler32_avx2 OF((uLong adler, const Bytef *buf,
+    z_size_t len));
+
+/* subtract wsize from the n entries of the hash table at p, going down to
+   NIL for entries that would become negative. n must be a multiple of 8. */
+void ZLIB_INTERNAL slide_hash_sse2 OF((ush FAR *p, unsigned n, uInt wsize));
+
+#endif /* X86_SIMD */
+
+#endif /* SIMD_H */
@@ -28,9 +28,37 @@ end
 
 --low-level I/O API ----------------------------------------------------------
 
+--send_later() queues small buffers (status line, headers, chunk headers)
+--which are then sent together with the next send() in a single vectored
+--write. queued buffers must stay alive until then. send() with no args
+--flushes the queue.
 function http:create_send_function()
+	local queue = {} --{buf1, len1, ...}
+	function self:send_later(buf, sz)
+		queue[#queue+1] = buf
+		queue[#queue+1] = sz or #buf
+	end
 	function self:send(buf, sz)
-		self:check_io(self.tcp:send(buf, sz, self.send_expires))
+		if #queue > 0 then
+			if buf then
+				self:send_later(buf, sz)
+			end
+			--NOTE: the queue is replaced instead of cleared to avoid a LuaJIT
+			--bug in ALEN forwarding: appending to a reused table through
+			--send_later() made `#t` in sendv() return the length from the
+			--`#queue > 0` check above, so the body was not sent.
+			local tcp, t = self.tcp, queue
+			queue = {}
+			if tcp.sendv then
+				self:check_io(tcp:sendv(t, self.send_expires))
+			else --TLS sockets: send buffers one by one.
+				for i = 1, #t, 2 do
+					self:check_io(tcp:send(t[i], t[i+1], self.send_expires))
+				end
+			end
+		elseif buf then
+			self:check_io(self.tcp:send(buf, sz, self.send_expires))
+		end
 	end
 end
 
@@ -82,6 +110,7 @@ end
 --only useful (i.e. that browsers act on) status codes are listed here.
 http.status_messages = {
 	[200] = 'OK',
+	[206] = 'Partial Content',       --for Range requests on file content.
 	[500] = 'Internal Server Error', --crash handler.
 	[406] = 'Not Acceptable',        --basically 400, based on `accept-encoding`.
 	[405] = 'Method Not Allowed',    --basically 400, based on `allowed_methods`.
@@ -106,7 +135,7 @@ function http:send_request_line(method, uri, http_version)
 	assert(method and method == method:upper())
 	assert(uri)
 	self:dp('=>', '%s %s HTTP/%s', method, uri, http_version)
-	self:send(_('%s %s HTTP/%s\r\n', method, uri, http_version))
+	self:send_later(_('%s %s HTTP/%s\r\n', method, uri, http_version))
 	return true
 end
 
@@ -126,7 +155,7 @@ function http:send_status_line(status, message, http_version)
 	assert(http_version == '1.1' or http_version == '1.0')
 	local s = _('HTTP/%s %d %s\r\n', http_version, status, message)
 	self:dp('=>', '%s %s %s', status, message, http_version)
-	self:send(s)
+	self:send_later(s)
 end
 
 function http:read_status_line()
@@ -158,7 +187,9 @@ http.remove = {}
 --header names and values must not contain newlines.
 --passing a table as value will generate duplicate headers for each value
 --  (set-cookie will come like that because it's not safe to send it folded).
+--headers are queued with send_later() to go out with the first body chunk.
 function http:send_headers(headers)
+	local t = {}
 	for k, v in glue.sortedpairs(headers) do
 		if v ~= http.remove then
 			k, v = self:format_header(k, v)
@@ -166,16 +197,17 @@ function http:send_headers(headers)
 				if type(v) == 'table' then --must be sent unfolded.
 					for i,v in ipairs(v) do
 						self:dp('->', '%-17s %s', k, v)
-						self:send(_('%s: %s\r\n', k, v))
+						t[#t+1] = _('%s: %s\r\n', k, v)
 					end
 				else
 					self:dp('->', '%-17s %s', k, v)
-					self:send(_('%s: %s\r\n', k, v))
+					t[#t+1] = _('%s: %s\r\n', k, v)
 				end
 			end
 		end
 	end
-	self:send'\r\n'
+	t[#t+1] = '\r\n'
+	self:send_later(table.concat(t))
 end
 
 function http:read_headers(rawheaders)
@@ -215,7 +247,7 @@ function http:set_body_headers(headers, content, content_size, close)
 	if type(content) == 'string' then
 		assert(not content_size, 'content_size would be ignored')
 		headers['content-length'] = #content
-	elseif type(content) == 'cdata' then
+	elseif type(content) == 'cdata' or type(content) == 'table' then --buffer or file
 		headers['content-length'] = assert(content_size, 'content_size missing')
 	elseif type(content) == 'function' then
 		if content_size then
@@ -256,8 +288,8 @@ function http:send_chunked(read_content)
 			local len = len or #chunk
 			total = total + len
 			self:dp('>>', '%7d bytes; chunk %d', len, chunk_num)
-			self:send(_('%X\r\n', len))
-			self:send(chunk, len)
+			self:send_later(_('%X\r\n', len))
+			self:send_later(chunk, len)
 			self:send'\r\n'
 		else
 			self:dp('>>', '%7d bytes; chunk %d', 0, chunk_num)
@@ -310,12 +342,61 @@ function http:zlib_encoder(format, content, content_size)
 	end
 end
 
-function http:send_body(content, content_size, transfer_encoding, close)
+--file content is an open file object from fs.open() which is sent from
+--`content_offset` (default 0) for `content_size` bytes (default: until eof).
+local function file_size(f, offset, size)
+	return size or assert(f:attr'size') - (offset or 0)
+end
+
+--reader for file content that has to be encoded or copied through TLS.
+function http:file_reader(f, offset, size)
+	local bufsize = math.min(size, 64 * 1024)
+	local buf = ffi.new('uint8_t[?]', bufsize)
+	self:check_io(f:seek('set', offset or 0))
+	return function()
+		if size == 0 then return end
+		local len = self:check_io(f:read(buf, math.min(size, bufsize)))
+		self:check(len > 0, 'file truncated')
+		size = size - len
+		return buf, len
+	end
+end
+
+--file content is sent straight from the page cache with tcp:sendfile()
+--when the socket has it (i.e. it's not a TLS socket).
+function http:send_file(f, offset, size)
+	if size == 0 then return end
+	self:dp('>>', '%7d bytes from file', size)
+	if self.tcp.sendfile then
+		self:send() --flush the headers.
+		self:check_io(self.tcp:sendfile(f, offset or 0, size, self.send_expires))
+	else
+		local read = self:file_reader(f, offset, size)
+		while true do
+			local buf, len = read()
+			if not buf then break end
+			self:send(buf, len)
+		end
+	end
+end
+
+function http:send_body(content, content_size, transfer_encoding, close, content_offset)
 	if transfer_encoding == 'chunked' then
-		self:send_chunked(content)
+		if type(content) == 'table' then --file: send it as a single chunk.
+			if content_size > 0 then
+				self:send_later(_('%X\r\n', content_size))
+				self:send_file(content, content_offset, content_size)
+				self:send_later'\r\n'
+			end
+			self:send'0\r\n\r\n'
+		else
+			self:send_chunked(content)
+		end
 	else
 		assert(not transfer_encoding, 'invalid transfer-encoding')
-		if type(content) == 'function' then
+		if type(content) == 'table' then
+			self:send_file(content, content_offset, content_size)
+		elseif type(content) == 'function' then
 			local total = 0
 			while true do
 				local chunk, len = content()
@@ -333,6 +414,7 @@ function http:send_body(content, content_size, transfer_encoding, close)
 				self:send(content, len)
 			end
 		end
+		self:send() --flush the headers if there was no body.
 	end
 	self:dp('  ', '')
 	if close then
@@ -424,8 +506,16 @@ function http:build_request(t, cookies)
 	req.headers['cookie'] = cookies
 
 	req.content, req.content_size = t.content, t.content_size
+	if type(req.content) == 'table' then --file
+		req.content_offset = t.content_offset
+		req.content_size = file_size(req.content, t.content_offset, t.content_size)
+	end
 	if self.zlib and t.compress ~= false then
 		req.headers['content-encoding'] = 'gzip'
+		if type(req.content) == 'table' then --can't sendfile() an encoded file.
+			req.content, req.content_size, req.content_offset =
+				self:file_reader(req.content, req.content_offset, req.content_size)
+		end
 		req.content, req.content_size =
 			self:encode_content(req.content, req.content_size, 'gzip')
 	end
@@ -446,7 +536,8 @@ function http:send_request(req)
 	self.send_expires = dt and self.start_time + dt or nil
 	self:send_request_line(req.method, req.uri, req.http_version)
 	self:send_headers(req.headers)
-	self:send_body(req.content, req.content_size, req.headers['transfer-encoding'])
+	self:send_body(req.content, req.content_size, req.headers['transfer-encoding'],
+		nil, req.content_offset)
 	return true
 end
 http:protect'send_request'
@@ -572,6 +663,8 @@ http:protect'read_request_body'
 
 local function content_size(opt)
 	return type(opt.content) == 'string' and #opt.content
+		or type(opt.content) == 'table'
+			and file_size(opt.content, opt.content_offset, opt.content_size)
 		or opt.content_size
 end
 
@@ -580,6 +673,20 @@ local function no_body(res, status)
 	res.content, res.content_size = ''
 end
 
+--resolve a parsed Range header against the content size.
+--returns nothing if the range is not satisfiable.
+local function byte_range(range, size)
+	local from, to
+	if range.last then --suffix range
+		from, to = math.max(0, size - range.last), size - 1
+		if range.last == 0 then return end
+	else
+		from, to = range.from, math.min(range.to or 1/0, size - 1)
+	end
+	if from > to then return end
+	return from, to - from + 1
+end
+
 local function q0(t)
 	return type(t) == 'table' and t.q == 0
 end
@@ -679,8 +786,37 @@ function http:build_response(req, opt, time)
 		res.headers['content-encoding'] = content_encoding
 	end
 
+	local content, content_size = opt.content, opt.content_size
+	if type(content) == 'table' then --file
+		res.content_offset = opt.content_offset or 0
+		content_size = file_size(content, res.content_offset, content_size)
+		if content_encoding then --can't sendfile() or seek into an encoded file.
+			content, content_size, res.content_offset =
+				self:file_reader(content, res.content_offset, content_size)
+		else
+			res.headers['accept-ranges'] = 'bytes'
+			local range = res.status == 200 and not req.headers['if-range']
+				and req.headers['range']
+			if range and (range.from or range.last) then
+				local from, len = byte_range(range, content_size)
+				if not from then
+					res.headers['content-range'] = {total = content_size}
+					no_body(res, 416) --range not satisfiable
+					res.headers['date'] = time
+					self:set_body_headers(res.headers, res.content, res.content_size, res.close)
+					return res
+				end
+				res.status = 206
+				res.headers['content-range'] =
+					{from = from, size = len, total = content_size}
+				res.content_offset = res.content_offset + from
+				content_size = len
+			end
+		end
+	end
+
 	res.content, res.content_size =
-		self:encode_content(opt.content, opt.content_size, content_encoding)
+		self:encode_content(content, content_size, content_encoding)
 
 	res.headers['date'] = time
 
@@ -693,7 +829,8 @@ end
 function http:send_response(res)
 	self:send_status_line(res.status, res.status_message, res.http_version)
 	self:send_headers(res.headers)
-	self:send_body(res.content, res.content_size, res.headers['transfer-encoding'], res.close)
+	self:send_body(res.content, res.content_size, res.headers['transfer-encoding'],
+		res.close, res.content_offset)
 	return true
 end
 http:protect'send_response'
@@ -751,6 +888,17 @@ function http:new(t)
 			return sz
 		end)
 
+		if self.tcp.sendv then
+			glue.override(self.tcp, 'sendv', function(inherited, self, t, ...)
+				local ok, err, errcode = inherited(self, t, ...)
+				if not ok then return nil, err, errcode end
+				for i = 1, #t, 2 do
+					ds('>', ffi.string(t[i], t[i+1]))
+				end
+				return ok
+			end)
+		end
+
 		glue.override(self.tcp, 'close', function(inherited, self, ...)
 			local ok, err, errcode = inherited(self, ...)
 			if not ok then return nil, err, errcode  end
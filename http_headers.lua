@@ -391,11 +391,13 @@ function parse.pragma(s) -- 1#( "no-cache" | token [ "=" ( token | quoted-string
 	return propertylist(s, pragma_parse)
 end
 
-function parse.range(s) --bytes=<from>-<to> -> {from=,to=,size=}
-	local from,to = s:match'bytes=(%d+)%-(%d+)'
+--NOTE: multi-range requests are not supported and result in an empty table.
+function parse.range(s) --bytes=<from>-[<to>] | bytes=-<last> -> {from=,to=,last=,size=}
+	local from,to = s:match'^bytes=(%d*)%-(%d*)$'
 	local t = {}
 	t.from = tonumber(from)
 	t.to = tonumber(to)
+	if not t.from then t.last, t.to = t.to, nil end
 	if t.from and t.to then t.size = t.to - t.from + 1 end
 	return t
 end
@@ -732,13 +734,22 @@ end
 local format = {}
 headers.format = format
 
---{from=,to=,size=} -> bytes=<from>-<to>
+--{from=,to=,last=,size=} -> bytes=<from>-[<to>] | bytes=-<last>
 function format.range(v)
+	if v.last then
+		return _('bytes=-%d', v.last)
+	end
+	local to = v.to or v.size and v.from + v.size - 1
+	return _('bytes=%d-%s', v.from, to or '')
 end
 
---{from=,to=,total=,size=} -> bytes <from>-<to>/<total>
+--{from=,to=,total=,size=} -> bytes <from>-<to>/<total> | bytes */<total>
 function format.content_range(v)
-
+	if not v.from then --for 416 responses.
+		return _('bytes */%d', v.total)
+	end
+	local to = v.to or v.from + v.size - 1
+	return _('bytes %d-%d/%s', v.from, to, v.total or '*')
 end
 
 function format.host(t)
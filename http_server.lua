@@ -188,6 +188,9 @@ function server:new(t)
 
 		local tcp = assert(self.tcp())
 		assert(tcp:setopt('reuseaddr', true))
+		if t.reuseport then --one listener per worker loop, see sock.workers().
+			assert(tcp:setopt('reuseport', true))
+		end
 		local addr, port = t.addr or '*', t.port or (t.tls and 443 or 80)
 
 		local ok, err = tcp:listen(addr, port)
@@ -0,0 +1,179 @@
+--benchmark for serving static files: sendfile() vs buffered copying,
+--and for requests/s scaling with the number of event loops.
+--usage: luajit http_server_benchmark.lua [size_MB ... | workers [max_workers]]
+local ffi = require'ffi'
+local sock = require'sock'
+local fs = require'fs'
+local http_server = require'http_server'
+
+if ... == 'http_server_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local PORT = 18191
+local TOTAL = 2^30 --bytes to transfer per run
+
+local function make_file(size)
+	local file = os.tmpname()
+	local f = assert(fs.open(file, 'w'))
+	local bufsize = math.min(size, 2^20)
+	local buf = ffi.new('uint8_t[?]', bufsize)
+	for i = 0, bufsize-1 do buf[i] = i % 251 end
+	for i = 1, size / bufsize do
+		assert(f:write(buf, bufsize))
+	end
+	f:close()
+	return file
+end
+
+--GET the file `n` times with `connection: close` and discard the content.
+local function get(n)
+	local buf = ffi.new('char[?]', 2^16)
+	local total = 0
+	for i = 1, n do
+		local s = assert(sock.tcp())
+		assert(s:connect('127.0.0.1', PORT))
+		assert(s:send'GET / HTTP/1.1\r\nhost: localhost\r\nconnection: close\r\n\r\n')
+		while true do
+			local len = assert(s:recv(buf, 2^16))
+			if len == 0 then break end
+			total = total + len
+		end
+		s:close()
+	end
+	return total
+end
+
+local function bench(size, buffered)
+	local file = make_file(size)
+	local n = math.max(1, TOTAL / size)
+	PORT = PORT + 1
+	local server = http_server:new{
+		libs = 'sock',
+		listen = {{host = 'localhost', addr = '127.0.0.1', port = PORT}},
+		respond = function(req)
+			if buffered then
+				req.http.tcp.sendfile = false --as if it was a TLS socket.
+			end
+			local f = assert(fs.open(file))
+			req:respond{content = f, content_type = 'application/octet-stream'}
+			f:close()
+		end,
+	}
+	local total, t0, c0, t1, c1
+	sock.thread(function()
+		t0, c0 = sock.clock(), os.clock()
+		total = get(n)
+		t1, c1 = sock.clock(), os.clock()
+		server:stop()
+		for _,s in ipairs(server.sockets) do
+			s:close()
+		end
+		sock.stop()
+	end)
+	sock.start()
+	os.remove(file)
+	print(string.format('%-8s %-8s %6d MB x %4d: %8.0f MB/s  %6.2fs CPU  %6.2fs wall',
+		sock.backend, buffered and 'buffered' or 'sendfile',
+		size / 2^20, n, total / 2^20 / (t1 - t0), c1 - c0, t1 - t0))
+end
+
+--server worker: an http server with its own listening socket on the same
+--port as the other workers, until signaled to stop.
+local function server_worker(i, ev, port)
+	local server = require'http_server':new{
+		libs = 'sock',
+		listen = {{host = 'localhost', addr = '127.0.0.1', port = port,
+			reuseport = true}},
+		respond = function(req)
+			req:respond{content = 'hello'}
+		end,
+	}
+	ev:wait()
+	server:stop()
+	for _,s in ipairs(server.sockets) do
+		s:close()
+	end
+end
+
+--client worker: GET over `conns` persistent connections for `duration`
+--seconds and return the number of requests made.
+local function client_worker(i, ev, port, conns, duration)
+	local ffi = require'ffi'
+	local sock = require'sock'
+	local req = 'GET / HTTP/1.1\r\nhost: localhost\r\n\r\n'
+	local stop_at = sock.clock() + duration
+	local n, done = 0, 0
+	for j = 1, conns do
+		sock.thread(function()
+			local s = assert(sock.tcp())
+			while not s:connect('127.0.0.1', port) do --server not listening yet.
+				s:close()
+				sock.sleep(.01)
+				s = assert(sock.tcp())
+			end
+			local buf = ffi.new('char[?]', 4096)
+			local res_size --responses all have the same size.
+			while sock.clock() < stop_at do
+				assert(s:send(req))
+				if not res_size then
+					local len = 0
+					repeat
+						len = len + assert(s:recv(buf + len, 4096 - len))
+					until ffi.string(buf, len):find'\r\n\r\nhello$'
+					res_size = len
+				else
+					assert(s:recvn(buf, res_size))
+				end
+				n = n + 1
+			end
+			s:close()
+			done = done + 1
+		end)
+	end
+	while done < conns do
+		sock.sleep(.01)
+	end
+	return n
+end
+
+--requests/s with 1 to `max_workers` server event loops and as many
+--client event loops, each on its own OS thread.
+local function bench_workers(max_workers)
+	local conns, duration = 64, 2
+	local workers = 1
+	while workers <= max_workers do
+		PORT = PORT + 1
+		local servers = sock.workers(workers, server_worker, PORT)
+		local clients = sock.workers(workers, client_worker, PORT,
+			math.ceil(conns / workers), duration)
+		local n = 0
+		for _,cn in ipairs(clients:join()) do
+			n = n + cn
+		end
+		servers:signal()
+		servers:join()
+		print(string.format('%-8s %3d workers %4d conns: %10.0f req/s',
+			sock.backend, workers, conns, n / duration))
+		workers = workers * 2
+	end
+end
+
+if ... == 'workers' then
+	local ncpu = tonumber(io.popen'nproc':read'*l') or 1
+	bench_workers(tonumber((select(2, ...))) or ncpu)
+	return
+end
+
+local sizes = {}
+for i = 1, select('#', ...) do
+	sizes[i] = tonumber((select(i, ...))) * 2^20
+end
+if #sizes == 0 then
+	sizes = {2^20, 2^30}
+end
+
+for _,size in ipairs(sizes) do
+	bench(size, false)
+	bench(size, true)
+end
@@ -33,9 +33,22 @@ void Hunspell_free_list(Hunhandle *pHunspell, char *** slst, int n);
 
 //extras from extras.cxx
 int Hunspell_add_dic(Hunhandle *pHunspell, const char * dpath, const char * key);
+int Hunspell_compile_dic(const char * affpath, const char * dpath, const char * outpath, const char * key);
+typedef struct {
+	int    offset;
+	int    len;
+	int    nsug;
+	char **sug;
+} Hunspell_misspelling;
+int Hunspell_check_text(Hunhandle *pHunspell, const char *text, int len,
+	int max_sug, int threads, Hunspell_misspelling **out);
+void Hunspell_free_misspellings(Hunhandle *pHunspell, Hunspell_misspelling *ms, int n);
+int Hunspell_build_suggest_index(Hunhandle *pHunspell, int maxdist);
+int Hunspell_suggest_timed(Hunhandle *pHunspell, char*** slst, const char * word, double timeout);
 
 ]]
 
+--dpath can also be a dictionary image made with M.compile().
 function M.new(affpath, dpath, key) --key is for hzip-encrypted dictionary files
 	local h = key and
 		assert(C.Hunspell_create_key(affpath, dpath, key)) or
@@ -43,6 +56,11 @@ function M.new(affpath, dpath, key) --key is for hzip-encrypted dictionary files
 	return ffi.gc(h, C.Hunspell_destroy)
 end
 
+--compile a dictionary into an image file which loads (memory-mapped) instantly.
+function M.compile(affpath, dpath, outpath, key)
+	assert(C.Hunspell_compile_dic(affpath, dpath, outpath, key) == 0)
+end
+
 function M.free(h)
 	C.Hunspell_destroy(h)
 	ffi.gc(h, nil)
@@ -72,9 +90,15 @@ local function free_list(h, list, n)
 	return t
 end
 
-function M.suggest(h, word)
+--timeout (in seconds) selects the fast, deadline-bounded suggestion mode.
+function M.suggest(h, word, timeout)
 	local list = output_list()
-	local n = C.Hunspell_suggest(h, list, word)
+	local n
+	if timeout then
+		n = C.Hunspell_suggest_timed(h, list, word, timeout)
+	else
+		n = C.Hunspell_suggest(h, list, word)
+	end
 	return free_list(h, list, n)
 end
 
@@ -126,6 +150,36 @@ function M.add_dic(h, dpath, key)
 	assert(C.Hunspell_add_dic(h, dpath, key) == 0)
 end
 
+--index the dictionary words for fast suggestions within maxdist (1 or 2) edits.
+function M.build_suggest_index(h, maxdist)
+	assert(C.Hunspell_build_suggest_index(h, maxdist or 2) == 0)
+end
+
+--check all the words of a text in one call, on multiple threads.
+--returns {{i = byte_index, len = byte_length, word = s[, suggest = words_t]}, ...}
+--for the misspelled words; only the first max_suggest words get suggestions.
+function M.check_text(h, s, max_suggest, threads)
+	local out = ffi.new'Hunspell_misspelling*[1]'
+	local n = C.Hunspell_check_text(h, s, #s, max_suggest or 0, threads or 0, out)
+	assert(n >= 0, 'out of memory')
+	local t = {}
+	local ms = out[0]
+	for i = 0, n-1 do
+		local m = ms[i]
+		local e = {i = m.offset + 1, len = m.len, word = s:sub(m.offset + 1, m.offset + m.len)}
+		if m.sug ~= nil then
+			local sug = {}
+			for j = 0, m.nsug-1 do
+				sug[j+1] = ffi.string(m.sug[j])
+			end
+			e.suggest = sug
+		end
+		t[i+1] = e
+	end
+	C.Hunspell_free_misspellings(h, ms, n)
+	return t
+end
+
 ffi.metatype('Hunhandle', {__index = {
 	free = M.free,
 
@@ -142,6 +196,8 @@ ffi.metatype('Hunhandle', {__index = {
 
 	--extras
 	add_dic = M.add_dic,
+	check_text = M.check_text,
+	build_suggest_index = M.build_suggest_index,
 }})
 
 
@@ -175,6 +231,28 @@ if not ... then
 	h:add_dic('media/hunspell/en_US/en_US.dic')
 
 	h:free()
+
+	local h = hunspell.new(
+		'media/hunspell/en_US/en_US.aff',
+		'media/hunspell/en_US/en_US.dic')
+	pp('check_text', h:check_text("The quik brown fox jumpd over the lazy dog's back etc. in 2010.", 1))
+	h:build_suggest_index()
+	pp('fast suggest for "Helo"', h:suggest('Helo', 0.01))
+	pp('fast suggest for "thecat"', h:suggest('thecat', 0.01))
+	h:free()
+
+	--dictionary images
+	local img = os.tmpname()
+	hunspell.compile(
+		'media/hunspell/en_US/en_US.aff',
+		'media/hunspell/en_US/en_US.dic', img)
+	local h = hunspell.new('media/hunspell/en_US/en_US.aff', img)
+	assert(h:spell('dog'))
+	assert(not h:spell('dawg'))
+	h:add_word('asdf')
+	assert(h:spell('asdf'))
+	h:free()
+	os.remove(img)
 end
 
 return M
@@ -0,0 +1,88 @@
+--benchmark for hunspell: words/sec of h:spell() in a loop vs h:check_text()
+--on 1..N threads, on a text made of dictionary words with 5% typos, and
+--the latency of h:suggest() with and without the deadline-bounded mode.
+--usage: luajit hunspell_benchmark.lua [max_threads] [dic_file]
+local hunspell = require'hunspell'
+local time = require'time'
+
+if ... == 'hunspell_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local max_threads = tonumber((...)) or 4
+local aff = 'media/hunspell/en_US/en_US.aff'
+local dic = select(2, ...) or 'media/hunspell/en_US/en_US.dic'
+
+--make a text of random dictionary words with some typos.
+local words = {}
+for w in io.open('media/hunspell/en_US/en_US.dic'):read'*a':gmatch'\n([^/\t\n]+)' do
+	words[#words+1] = w
+end
+math.randomseed(1)
+local t = {}
+for i = 1, 200000 do
+	local w = words[math.random(#words)]
+	if math.random() < .05 then
+		local p = math.random(#w)
+		w = w:sub(1, p-1) .. string.char(math.random(97, 122)) .. w:sub(p+1)
+	end
+	t[i] = w
+end
+local text = table.concat(t, ' ')
+local nwords = #t
+
+local h = hunspell.new(aff, dic)
+
+local function bench(name, f)
+	local t0 = time.clock()
+	local n = f()
+	local dt = time.clock() - t0
+	print(string.format('%-28s %8.0f words/s  (%d misspelled)', name, nwords / dt, n))
+end
+
+bench('spell() loop', function()
+	local n = 0
+	for i = 1, nwords do
+		if not h:spell(t[i]) then n = n + 1 end
+	end
+	return n
+end)
+
+for threads = 1, max_threads do
+	bench(string.format('check_text() %d threads', threads), function()
+		return #h:check_text(text, 0, threads)
+	end)
+end
+
+--suggestions are much slower: check a smaller text with a suggestion budget.
+local text = table.concat(t, ' ', 1, 2000)
+for threads = 1, max_threads do
+	local t0 = time.clock()
+	local ms = h:check_text(text, 50, threads)
+	local dt = time.clock() - t0
+	print(string.format('check_text() 2000 words, 50 suggestions, %d threads: %7.1f ms', threads, dt * 1000))
+end
+
+--suggestions for single words: the classic strategies vs the deletion index
+--with a deadline, average and worst latency over typos of 200 words.
+local t0 = time.clock()
+h:build_suggest_index()
+print(string.format('build_suggest_index(): %7.1f ms', (time.clock() - t0) * 1000))
+local typos = {}
+for i = 1, 200 do
+	local w = words[math.random(#words)]
+	local p = math.random(#w)
+	typos[i] = w:sub(1, p-1) .. string.char(math.random(97, 122)) .. w:sub(p+1)
+end
+for _,timeout in ipairs{false, 0.05, 0.01, 0} do
+	local total, worst = 0, 0
+	for i = 1, #typos do
+		local t0 = time.clock()
+		h:suggest(typos[i], timeout or nil)
+		local dt = time.clock() - t0
+		total = total + dt
+		worst = math.max(worst, dt)
+	end
+	print(string.format('suggest(), %-14s avg: %8.3f ms  max: %8.3f ms',
+		timeout and 'timeout '..timeout..'s' or 'classic', total / #typos * 1000, worst * 1000))
+end
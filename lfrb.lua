@@ -19,6 +19,23 @@ void lfrb_advance_read_index(struct lfrb_state*, int count);
 int lfrb_fill_count(struct lfrb_state*);
 int lfrb_free_count(struct lfrb_state*);
 void lfrb_clear(struct lfrb_state*);
+
+enum {
+	LFRB_MP     = 1,
+	LFRB_MC     = 2,
+	LFRB_MIRROR = 4,
+};
+struct lfrb_ring;
+struct lfrb_ring* lfrb_ring_new(uint32_t capacity, uint32_t elem_size, int flags);
+void lfrb_ring_free(struct lfrb_ring*);
+uint32_t lfrb_ring_capacity(struct lfrb_ring*);
+char* lfrb_ring_data(struct lfrb_ring*);
+uint32_t lfrb_ring_write_reserve(struct lfrb_ring*, uint32_t n, int exact, uint32_t* index);
+void lfrb_ring_write_commit(struct lfrb_ring*, uint32_t index, uint32_t n);
+uint32_t lfrb_ring_read_reserve(struct lfrb_ring*, uint32_t n, int exact, uint32_t* index);
+void lfrb_ring_read_commit(struct lfrb_ring*, uint32_t index, uint32_t n);
+uint32_t lfrb_ring_fill_count(struct lfrb_ring*);
+uint32_t lfrb_ring_free_count(struct lfrb_ring*);
 ]]
 
 local C = ffi.load'lfrb'
@@ -46,6 +63,57 @@ ffi.metatype('struct lfrb_state', {__index = {
 	clear = C.lfrb_clear,
 }})
 
+--power-of-two rings with batched reserve/commit -----------------------------
+
+local ring = {}
+
+local index_buf = ffi.new'uint32_t[1]'
+
+--opt: {capacity=, elem_size=|ctype=, multi_producer=, multi_consumer=, mirror=}
+function M.ring(opt)
+	if type(opt) == 'number' then
+		opt = {capacity = opt}
+	end
+	local elem_size = opt.elem_size
+		or (opt.ctype and ffi.sizeof(opt.ctype)) or 0
+	local flags = bit.bor(
+		opt.multi_producer and C.LFRB_MP or 0,
+		opt.multi_consumer and C.LFRB_MC or 0,
+		opt.mirror and C.LFRB_MIRROR or 0)
+	local rb = C.lfrb_ring_new(opt.capacity, elem_size, flags)
+	assert(rb ~= nil, 'lfrb_ring_new() failed')
+	return rb
+end
+
+--wrap a ring created in another thread.
+function M.wrap_ring(ring_addr)
+	return ffi.cast('struct lfrb_ring*', ring_addr)
+end
+
+ring.free = C.lfrb_ring_free
+ring.capacity = C.lfrb_ring_capacity
+ring.data = C.lfrb_ring_data
+ring.fill_count = C.lfrb_ring_fill_count
+ring.free_count = C.lfrb_ring_free_count
+ring.write_commit = C.lfrb_ring_write_commit
+ring.read_commit = C.lfrb_ring_read_commit
+
+--reserve up to n (or exactly n) slots for writing. returns the number of
+--slots reserved and the index of the first one, or 0 if the ring is full.
+function ring:write_reserve(n, exact)
+	local n = C.lfrb_ring_write_reserve(self, n, exact and 1 or 0, index_buf)
+	return n, index_buf[0]
+end
+
+--reserve up to n (or exactly n) slots for reading. returns the number of
+--slots reserved and the index of the first one, or 0 if the ring is empty.
+function ring:read_reserve(n, exact)
+	local n = C.lfrb_ring_read_reserve(self, n, exact and 1 or 0, index_buf)
+	return n, index_buf[0]
+end
+
+ffi.metatype('struct lfrb_ring', {__index = ring})
+
 if not ... then
 	io.stdout:setvbuf'full'
 	local lfrb = M
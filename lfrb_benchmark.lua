@@ -0,0 +1,145 @@
+--throughput benchmark for lfrb rings: moves 32bit integers between threads
+--in batches and checks that they arrive intact.
+--usage: luajit lfrb_benchmark.lua [max_producers]
+local ffi = require'ffi'
+local glue = require'glue'
+local thread = require'thread'
+local time = require'time'
+local lfrb = require'lfrb'
+
+if ... == 'lfrb_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local TOTAL = 2^22 --elements per run
+local CAPACITY = 2^12
+
+--producers write i = 1..m in batches; consumers sum what they read.
+local function producer(rb_addr, m, batch, mirror)
+	local ffi = require'ffi'
+	local lfrb = require'lfrb'
+	local time = require'time'
+	local rb = lfrb.wrap_ring(rb_addr)
+	local p = ffi.cast('int32_t*', rb:data())
+	local mask = rb:capacity() - 1
+	local v = 1
+	while v <= m do
+		local n, i = rb:write_reserve(math.min(batch, m - v + 1))
+		if n > 0 then
+			if mirror then
+				for k = 0, n-1 do p[i+k] = v + k end
+			else
+				for k = 0, n-1 do p[bit.band(i+k, mask)] = v + k end
+			end
+			rb:write_commit(i, n)
+			v = v + n
+		else
+			time.sleep(0) --let the consumers run if they share our CPU.
+		end
+	end
+end
+
+local function consumer(rb_addr, m, batch, mirror)
+	local ffi = require'ffi'
+	local lfrb = require'lfrb'
+	local time = require'time'
+	local rb = lfrb.wrap_ring(rb_addr)
+	local p = ffi.cast('int32_t*', rb:data())
+	local mask = rb:capacity() - 1
+	local sum, got = 0, 0
+	while got < m do
+		local n, i = rb:read_reserve(math.min(batch, m - got))
+		if n > 0 then
+			if mirror then
+				for k = 0, n-1 do sum = sum + p[i+k] end
+			else
+				for k = 0, n-1 do sum = sum + p[bit.band(i+k, mask)] end
+			end
+			rb:read_commit(i, n)
+			got = got + n
+		else
+			time.sleep(0)
+		end
+	end
+	return sum
+end
+
+local function bench(producers, consumers, batch, mirror)
+	local rb = lfrb.ring{capacity = CAPACITY, ctype = 'int32_t',
+		multi_producer = producers > 1, multi_consumer = consumers > 1,
+		mirror = mirror}
+	local addr = glue.addr(rb)
+	local pm = TOTAL / producers
+	local t0 = time.clock()
+	local ths = {}
+	for i = 1, producers do
+		ths[#ths+1] = thread.new(producer, addr, pm, batch, mirror)
+	end
+	local cts = {}
+	for i = 1, consumers do
+		cts[i] = thread.new(consumer, addr, TOTAL / consumers, batch, mirror)
+	end
+	local sum = 0
+	for i = 1, consumers do
+		sum = sum + cts[i]:join()
+	end
+	for i = 1, producers do
+		ths[i]:join()
+	end
+	local dt = time.clock() - t0
+	assert(sum == producers * pm * (pm + 1) / 2)
+	rb:free()
+	print(string.format('%2d producers %2d consumers batch %4d %-8s: %8.1f M elements/s',
+		producers, consumers, batch, mirror and 'mirror' or 'wrap',
+		TOTAL / dt / 1e6))
+end
+
+--the old single-producer/single-consumer state with index/advance calls.
+local function bench_spsc_state()
+	local rb = lfrb.new(CAPACITY)
+	local addr = glue.addr(rb)
+	local t0 = time.clock()
+	local th = thread.new(function(addr, m)
+		local lfrb = require'lfrb'
+		local time = require'time'
+		local rb = lfrb.wrap(addr)
+		local got = 0
+		while got < m do
+			local n = rb:fill_count()
+			if n > 0 then
+				rb:advance_read_index(n)
+				got = got + n
+			else
+				time.sleep(0)
+			end
+		end
+	end, addr, TOTAL)
+	local put = 0
+	while put < TOTAL do
+		local n = math.min(rb:free_count(), TOTAL - put)
+		if n > 0 then
+			rb:write_index()
+			rb:advance_write_index(n)
+			put = put + n
+		else
+			time.sleep(0)
+		end
+	end
+	th:join()
+	local dt = time.clock() - t0
+	print(string.format('lfrb_state (indices only)              : %8.1f M elements/s',
+		TOTAL / dt / 1e6))
+end
+
+bench_spsc_state()
+for _,batch in ipairs{1, 16, 256} do
+	bench(1, 1, batch, false)
+	bench(1, 1, batch, true)
+end
+local max_producers = tonumber((...)) or 4
+local n = 2
+while n <= max_producers do
+	bench(n, 1, 256, true)
+	bench(n, n, 256, true)
+	n = n * 2
+end
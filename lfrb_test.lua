@@ -0,0 +1,204 @@
+local ffi = require'ffi'
+local glue = require'glue'
+local thread = require'thread'
+local lfrb = require'lfrb'
+
+local function test_capacity()
+	local rb = lfrb.ring{capacity = 1000, ctype = 'int32_t'}
+	assert(rb:capacity() == 1024)
+	assert(rb:fill_count() == 0)
+	assert(rb:free_count() == 1024)
+	rb:free()
+	local rb = lfrb.ring(1)
+	assert(rb:capacity() == 1)
+	assert(rb:data() == nil) --index-only ring
+	rb:free()
+	--mirrored buffers are a whole number of pages.
+	local rb = lfrb.ring{capacity = 3, ctype = 'int32_t', mirror = true}
+	assert(rb:capacity() >= 1024 and bit.band(rb:capacity(), rb:capacity() - 1) == 0)
+	rb:free()
+	print'capacity ok'
+end
+
+--a full ring refuses writes, and exact reserves refuse partial room.
+local function test_full()
+	local rb = lfrb.ring{capacity = 8, ctype = 'int32_t'}
+	local p = ffi.cast('int32_t*', rb:data())
+	local n, i = rb:write_reserve(5)
+	assert(n == 5 and i == 0)
+	for k = 0, n-1 do p[i+k] = k end
+	rb:write_commit(i, n)
+	assert(rb:write_reserve(4, true) == 0) --only 3 left
+	local n, i = rb:write_reserve(4)
+	assert(n == 3 and i == 5)
+	for k = 0, n-1 do p[i+k] = 5 + k end
+	rb:write_commit(i, n)
+	assert(rb:fill_count() == 8 and rb:free_count() == 0)
+	assert(rb:write_reserve(1) == 0)
+	assert(rb:read_reserve(9, true) == 0)
+	local n, i = rb:read_reserve(100)
+	assert(n == 8 and i == 0)
+	for k = 0, n-1 do assert(p[i+k] == k) end
+	rb:read_commit(i, n)
+	assert(rb:read_reserve(1) == 0)
+	assert(rb:fill_count() == 0 and rb:free_count() == 8)
+	rb:free()
+	print'full ok'
+end
+
+--committing part of a reservation publishes only that part, and the rest
+--can be committed later.
+local function test_partial_commit()
+	local rb = lfrb.ring{capacity = 16, ctype = 'int32_t'}
+	local p = ffi.cast('int32_t*', rb:data())
+	local n, i = rb:write_reserve(10)
+	assert(n == 10)
+	for k = 0, n-1 do p[i+k] = 100 + k end
+	rb:write_commit(i, 4)
+	assert(rb:fill_count() == 4)
+	assert(rb:free_count() == 6) --reserved slots are not free
+	local rn, ri = rb:read_reserve(10)
+	assert(rn == 4 and ri == 0)
+	rb:read_commit(ri, 1)
+	assert(rb:free_count() == 7)
+	rb:read_commit(ri + 1, 3)
+	assert(rb:free_count() == 10)
+	rb:write_commit(i + 4, 6)
+	local rn, ri = rb:read_reserve(10)
+	assert(rn == 6 and ri == 4)
+	for k = 0, rn-1 do assert(p[ri+k] == 104 + k) end
+	rb:read_commit(ri, rn)
+	assert(rb:fill_count() == 0 and rb:free_count() == 16)
+	rb:free()
+	print'partial commit ok'
+end
+
+--with the mirror, batches that wrap around the end of the ring can be
+--accessed contiguously, and both halves of the mapping are the same memory.
+local function test_mirror_wrap()
+	local rb = lfrb.ring{capacity = 1024, ctype = 'int32_t', mirror = true}
+	local cap = rb:capacity()
+	local mask = cap - 1
+	local p = ffi.cast('int32_t*', rb:data())
+	p[cap + 5] = 12345
+	assert(p[5] == 12345)
+	p[7] = 54321
+	assert(p[cap + 7] == 54321)
+	math.randomseed(1)
+	local wv, rv, wrapped = 0, 0, 0
+	while rv < 50 * cap do
+		--write contiguously past the end of the ring.
+		local n, i = rb:write_reserve(math.random(1, cap))
+		for k = 0, n-1 do p[i+k] = wv + k end
+		if i + n > cap then wrapped = wrapped + 1 end
+		--commit in two parts.
+		local m = math.random(0, n)
+		rb:write_commit(i, m)
+		rb:write_commit(i + m, n - m)
+		wv = wv + n
+		--read back through the first half only.
+		local n, i = rb:read_reserve(math.random(1, cap))
+		for k = 0, n-1 do
+			assert(p[bit.band(i+k, mask)] == rv + k)
+			assert(p[i+k] == rv + k)
+		end
+		rb:read_commit(i, n)
+		rv = rv + n
+	end
+	assert(wrapped > 10)
+	rb:free()
+	print'mirror wrap ok'
+end
+
+--2 producers and 2 consumers: every item arrives exactly once, and the items
+--of each producer arrive in order at each consumer.
+local function producer(rb_addr, id, m)
+	local ffi = require'ffi'
+	local lfrb = require'lfrb'
+	local time = require'time'
+	local rb = lfrb.wrap_ring(rb_addr)
+	local p = ffi.cast('int32_t*', rb:data())
+	math.randomseed(id + 1)
+	local v = 0
+	while v < m do
+		local want = math.min(math.random(1, 64), m - v)
+		local n, i = rb:write_reserve(want, math.random() < .3)
+		if n > 0 then
+			for k = 0, n-1 do p[i+k] = id * m + v + k end
+			rb:write_commit(i, n)
+			v = v + n
+		else
+			time.sleep(0)
+		end
+	end
+end
+
+local function consumer(rb_addr, m, seen_addr, stop_addr)
+	local ffi = require'ffi'
+	local lfrb = require'lfrb'
+	local time = require'time'
+	local rb = lfrb.wrap_ring(rb_addr)
+	local p = ffi.cast('int32_t*', rb:data())
+	local seen = ffi.cast('uint8_t*', seen_addr)
+	local stop = ffi.cast('volatile int32_t*', stop_addr)
+	local last = {[0] = -1, -1}
+	local got = 0
+	while true do
+		--stop is set after the producers are joined, so if it's set before
+		--we find the ring empty, nothing else is coming.
+		local stopping = stop[0] == 1
+		local n, i = rb:read_reserve(math.random(1, 64))
+		if n > 0 then
+			for k = 0, n-1 do
+				local v = p[i+k]
+				local from = math.floor(v / m)
+				assert(v > last[from], 'out of order')
+				last[from] = v
+				seen[v] = seen[v] + 1
+			end
+			rb:read_commit(i, n)
+			got = got + n
+		elseif stopping then
+			break
+		else
+			time.sleep(0)
+		end
+	end
+	return got
+end
+
+local function test_mpmc()
+	local M = 100000 --items per producer
+	local rb = lfrb.ring{capacity = 256, ctype = 'int32_t',
+		multi_producer = true, multi_consumer = true, mirror = true}
+	local addr = glue.addr(rb)
+	local stop = ffi.new'int32_t[1]'
+	local seen = {}
+	local cs = {}
+	for c = 1, 2 do
+		seen[c] = ffi.new('uint8_t[?]', 2 * M)
+		cs[c] = thread.new(consumer, addr, M, glue.addr(seen[c]), glue.addr(stop))
+	end
+	local ps = {}
+	for id = 0, 1 do
+		ps[id+1] = thread.new(producer, addr, id, M)
+	end
+	for i = 1, 2 do ps[i]:join() end
+	stop[0] = 1
+	local got = 0
+	for c = 1, 2 do got = got + cs[c]:join() end
+	assert(got == 2 * M)
+	for v = 0, 2 * M - 1 do
+		local n = seen[1][v] + seen[2][v]
+		assert(n == 1, string.format('item %d arrived %d times', v, n))
+	end
+	assert(rb:fill_count() == 0 and rb:free_count() == rb:capacity())
+	rb:free()
+	print'mpmc ok'
+end
+
+test_capacity()
+test_full()
+test_partial_commit()
+test_mirror_wrap()
+test_mpmc()
@@ -144,6 +144,84 @@ int LZ4_compress_HC_continue(
 	char* dst,
 	int srcSize,
 	int maxDstSize);
+
+// lz4frame.h
+
+typedef size_t LZ4F_errorCode_t;
+
+unsigned    LZ4F_isError(LZ4F_errorCode_t code);
+const char* LZ4F_getErrorName(LZ4F_errorCode_t code);
+
+typedef struct {
+	int blockSizeID;         // 4..7: 64KB, 256KB, 1MB, 4MB; 0 == default
+	int blockMode;           // 0: linked blocks, 1: independent blocks
+	int contentChecksumFlag;
+	int frameType;
+	unsigned long long contentSize;
+	unsigned dictID;
+	int blockChecksumFlag;
+} LZ4F_frameInfo_t;
+
+typedef struct {
+	LZ4F_frameInfo_t frameInfo;
+	int      compressionLevel;
+	unsigned autoFlush;
+	unsigned favorDecSpeed;
+	unsigned reserved[3];
+} LZ4F_preferences_t;
+
+typedef struct LZ4F_cctx_s LZ4F_cctx;
+
+LZ4F_errorCode_t LZ4F_createCompressionContext(LZ4F_cctx** cctxPtr, unsigned version);
+LZ4F_errorCode_t LZ4F_freeCompressionContext(LZ4F_cctx* cctx);
+
+size_t LZ4F_compressBegin(LZ4F_cctx* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const LZ4F_preferences_t* prefsPtr);
+size_t LZ4F_compressBound(size_t srcSize, const LZ4F_preferences_t* prefsPtr);
+size_t LZ4F_compressUpdate(LZ4F_cctx* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const void* srcBuffer, size_t srcSize,
+	const void* cOptPtr);
+size_t LZ4F_flush(LZ4F_cctx* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const void* cOptPtr);
+size_t LZ4F_compressEnd(LZ4F_cctx* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const void* cOptPtr);
+
+typedef struct LZ4F_dctx_s LZ4F_dctx;
+
+LZ4F_errorCode_t LZ4F_createDecompressionContext(LZ4F_dctx** dctxPtr, unsigned version);
+LZ4F_errorCode_t LZ4F_freeDecompressionContext(LZ4F_dctx* dctx);
+
+size_t LZ4F_getFrameInfo(LZ4F_dctx* dctx,
+	LZ4F_frameInfo_t* frameInfoPtr,
+	const void* srcBuffer, size_t* srcSizePtr);
+size_t LZ4F_decompress(LZ4F_dctx* dctx,
+	void* dstBuffer, size_t* dstSizePtr,
+	const void* srcBuffer, size_t* srcSizePtr,
+	const void* dOptPtr);
+void LZ4F_resetDecompressionContext(LZ4F_dctx* dctx);
+
+// lz4frame_mt.h
+
+typedef struct LZ4F_cctx_mt_s LZ4F_cctx_mt;
+
+LZ4F_errorCode_t LZ4F_createCompressionContext_mt(LZ4F_cctx_mt** cctxPtr, int threads);
+LZ4F_errorCode_t LZ4F_freeCompressionContext_mt(LZ4F_cctx_mt* cctx);
+
+size_t LZ4F_compressBegin_mt(LZ4F_cctx_mt* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const LZ4F_preferences_t* prefsPtr);
+size_t LZ4F_compressBound_mt(const LZ4F_cctx_mt* cctx, size_t srcSize);
+size_t LZ4F_compressUpdate_mt(LZ4F_cctx_mt* cctx,
+	void* dstBuffer, size_t dstCapacity,
+	const void* srcBuffer, size_t srcSize);
+size_t LZ4F_flush_mt(LZ4F_cctx_mt* cctx,
+	void* dstBuffer, size_t dstCapacity);
+size_t LZ4F_compressEnd_mt(LZ4F_cctx_mt* cctx,
+	void* dstBuffer, size_t dstCapacity);
 ]]
 
 local C = ffi.load'lz4'
@@ -300,11 +378,255 @@ ffi.metatype('LZ4_streamHC_t', enchc)
 ffi.metatype('LZ4_streamDecode_t', dec)
 
 
+--frame API ------------------------------------------------------------------
+
+local LZ4F_VERSION = 100
+local LZ4F_HEADER_SIZE_MAX = 19
+
+local function checkf(ret)
+	if C.LZ4F_isError(ret) ~= 0 then
+		return nil, ffi.string(C.LZ4F_getErrorName(ret))
+	end
+	return tonumber(ret)
+end
+
+local block_size_ids = {
+	[64 * 1024] = 4, [256 * 1024] = 5, [1024^2] = 6, [4 * 1024^2] = 7,
+}
+
+local function frame_prefs(opt)
+	local prefs = ffi.new'LZ4F_preferences_t'
+	local fi = prefs.frameInfo
+	fi.blockSizeID = opt.block_size
+		and assert(block_size_ids[opt.block_size], 'invalid block_size')
+		or (opt.threads and 7 or 0)
+	fi.blockMode = opt.linked and 0 or 1
+	fi.contentChecksumFlag = opt.content_checksum ~= false and 1 or 0
+	fi.blockChecksumFlag = opt.block_checksum and 1 or 0
+	fi.contentSize = opt.content_size or 0
+	prefs.compressionLevel = opt.level or 0
+	return prefs
+end
+
+local fenc = {}
+fenc.__index = fenc
+
+--frame encoder: single-threaded with LZ4F or multi-threaded with LZ4F_*_mt.
+function M.frame_encoder(opt)
+	opt = opt or {}
+	local self = setmetatable({}, fenc)
+	self.prefs = frame_prefs(opt)
+	self.mt = opt.threads ~= nil
+	if self.mt then
+		local ctxp = ffi.new'LZ4F_cctx_mt*[1]'
+		local ok, err = checkf(C.LZ4F_createCompressionContext_mt(ctxp, opt.threads))
+		if not ok then return nil, err end
+		self.ctx = ffi.gc(ctxp[0], C.LZ4F_freeCompressionContext_mt)
+	else
+		local ctxp = ffi.new'LZ4F_cctx*[1]'
+		local ok, err = checkf(C.LZ4F_createCompressionContext(ctxp, LZ4F_VERSION))
+		if not ok then return nil, err end
+		self.ctx = ffi.gc(ctxp[0], C.LZ4F_freeCompressionContext)
+	end
+	return self
+end
+
+function fenc:free()
+	if not self.ctx then return end
+	ffi.gc(self.ctx, nil)
+	if self.mt then
+		C.LZ4F_freeCompressionContext_mt(self.ctx)
+	else
+		C.LZ4F_freeCompressionContext(self.ctx)
+	end
+	self.ctx = false
+end
+
+--minimum dstlen for compress() (or for flush() and finish() if srclen is 0).
+function fenc:bound(srclen)
+	if self.mt then
+		return tonumber(C.LZ4F_compressBound_mt(self.ctx, srclen))
+	else
+		return tonumber(C.LZ4F_compressBound(srclen, self.prefs))
+	end
+end
+
+function fenc:begin(dst, dstlen)
+	local f = self.mt and C.LZ4F_compressBegin_mt or C.LZ4F_compressBegin
+	return checkf(f(self.ctx, dst, dstlen or LZ4F_HEADER_SIZE_MAX, self.prefs))
+end
+
+function fenc:compress(src, srclen, dst, dstlen)
+	srclen = srclen or #src
+	dstlen = dstlen or self:bound(srclen)
+	if self.mt then
+		return checkf(C.LZ4F_compressUpdate_mt(self.ctx, dst, dstlen, src, srclen))
+	else
+		return checkf(C.LZ4F_compressUpdate(self.ctx, dst, dstlen, src, srclen, nil))
+	end
+end
+
+function fenc:flush(dst, dstlen)
+	dstlen = dstlen or self:bound(0)
+	if self.mt then
+		return checkf(C.LZ4F_flush_mt(self.ctx, dst, dstlen))
+	else
+		return checkf(C.LZ4F_flush(self.ctx, dst, dstlen, nil))
+	end
+end
+
+function fenc:finish(dst, dstlen)
+	dstlen = dstlen or self:bound(0)
+	if self.mt then
+		return checkf(C.LZ4F_compressEnd_mt(self.ctx, dst, dstlen))
+	else
+		return checkf(C.LZ4F_compressEnd(self.ctx, dst, dstlen, nil))
+	end
+end
+
+local fdec = {}
+fdec.__index = fdec
+
+function M.frame_decoder()
+	local ctxp = ffi.new'LZ4F_dctx*[1]'
+	local ok, err = checkf(C.LZ4F_createDecompressionContext(ctxp, LZ4F_VERSION))
+	if not ok then return nil, err end
+	local self = setmetatable({}, fdec)
+	self.ctx = ffi.gc(ctxp[0], C.LZ4F_freeDecompressionContext)
+	self.sizes = ffi.new'size_t[2]'
+	return self
+end
+
+function fdec:free()
+	if not self.ctx then return end
+	ffi.gc(self.ctx, nil)
+	C.LZ4F_freeDecompressionContext(self.ctx)
+	self.ctx = false
+end
+
+function fdec:reset()
+	C.LZ4F_resetDecompressionContext(self.ctx)
+end
+
+--decompress as much as possible of src into dst. returns the number of
+--bytes read from src and written to dst and a hint for how many bytes to
+--feed next (0 when the frame is complete).
+function fdec:decompress(src, srclen, dst, dstlen)
+	local sizes = self.sizes
+	sizes[0] = dstlen
+	sizes[1] = srclen or #src
+	local hint, err = checkf(C.LZ4F_decompress(self.ctx,
+		dst, sizes, src, sizes + 1, nil))
+	if not hint then return nil, err end
+	return tonumber(sizes[1]), tonumber(sizes[0]), hint
+end
+
+--frame streaming with read and write functions (see zlib.deflate()).
+
+local function reader(read)
+	if type(read) == 'string' then
+		local s = read
+		read = function()
+			local s1 = s
+			s = nil
+			return s1
+		end
+	elseif type(read) == 'table' then
+		local t, i = read, 0
+		read = function()
+			i = i + 1
+			return t[i]
+		end
+	end
+	return read
+end
+
+local function writer(write)
+	local t
+	local asstring = write == ''
+	if type(write) == 'table' or asstring then
+		t = asstring and {} or write
+		write = function(data, sz)
+			t[#t+1] = ffi.string(data, sz)
+		end
+	end
+	return write, function()
+		if asstring then return table.concat(t) end
+		return t
+	end
+end
+
+local function grow(buf, bufsize, size)
+	if bufsize >= size then return buf, bufsize end
+	return ffi.new('char[?]', size), size
+end
+
+function M.frame_compress(read, write, opt)
+	local read = reader(read)
+	local write, result = writer(write)
+	local enc = assert(M.frame_encoder(opt))
+	local bufsize = 65536
+	local buf = ffi.new('char[?]', bufsize)
+	local n = assert(enc:begin(buf, bufsize))
+	write(buf, n)
+	while true do
+		local data, size = read()
+		if not data then break end
+		size = size or #data
+		buf, bufsize = grow(buf, bufsize, enc:bound(size))
+		local n, err = enc:compress(data, size, buf, bufsize)
+		if not n then enc:free(); error(err) end
+		if n > 0 then write(buf, n) end
+	end
+	buf, bufsize = grow(buf, bufsize, enc:bound(0))
+	local n, err = enc:finish(buf, bufsize)
+	enc:free()
+	if not n then error(err) end
+	write(buf, n)
+	return result()
+end
+
+function M.frame_decompress(read, write, bufsize)
+	local read = reader(read)
+	local write, result = writer(write)
+	local dec = assert(M.frame_decoder())
+	bufsize = bufsize or 4 * 1024^2
+	local buf = ffi.new('char[?]', bufsize)
+	local hint = 1
+	while true do
+		local data, size = read()
+		if not data then break end
+		size = size or #data
+		local p = ffi.cast('const char*', data)
+		repeat
+			local nr, nw
+			nr, nw, hint = dec:decompress(p, size, buf, bufsize)
+			if not nr then dec:free(); error(nw) end
+			if nw > 0 then write(buf, nw) end
+			p, size = p + nr, size - nr
+		until size == 0 and (hint == 0 or nw < bufsize)
+	end
+	dec:free()
+	if hint ~= 0 then
+		error'truncated lz4 frame'
+	end
+	return result()
+end
+
 if not ... then
 	local lz = M--require'lz4'
 	local s = lz.compress_stream()
 	--TODO
 	--local n = s:compress(src, srclen, dst, dstlen)
 	s:free()
+
+	local s = ('hello lz4 frame '):rep(1e6)
+	for _,threads in ipairs{false, 1, 4} do
+		local c = lz.frame_compress(s, '', {threads = threads or nil})
+		assert(lz.frame_decompress(c, '') == s)
+		print(threads or 'LZ4F', #s, '->', #c)
+	end
 end
 
+
+return M
@@ -0,0 +1,77 @@
+--benchmark for lz4: MB/s of frame compression of a log-like text with the
+--LZ4F encoder vs the multi-threaded encoder on 1..N threads (4 MB blocks),
+--and of frame decompression.
+--usage: luajit lz4_benchmark.lua [size_MB] [max_threads] [level]
+local ffi = require'ffi'
+local time = require'time'
+local lz4 = require'lz4'
+
+if ... == 'lz4_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local size = (tonumber((...)) or 64) * 1024^2
+local max_threads = tonumber((select(2, ...))) or 4
+local level = tonumber((select(3, ...)))
+
+--make a log-like text.
+math.randomseed(1234)
+local words = {'GET', 'POST', '/index.html', '/api/v1/users', '200', '404',
+	'500', 'Mozilla/5.0', 'curl/7.68', 'ms', 'bytes', 'user', 'session'}
+local t = {}
+local n = 0
+local i = 0
+while n < size do
+	i = i + 1
+	local s = string.format('2021-03-%02d %02d:%02d:%02d.%03d %s %s %d\n',
+		i % 28 + 1, i % 24, i % 60, (i * 7) % 60, i % 1000,
+		words[math.random(#words)], words[math.random(#words)],
+		math.random(1, 100000))
+	t[#t+1] = s
+	n = n + #s
+end
+local text = table.concat(t):sub(1, size)
+t = nil
+
+--feed the input in 1 MB chunks like a file reader would.
+local chunk_size = 1024^2
+local function chunks()
+	local i = 0
+	return function()
+		if i >= size then return end
+		local p = ffi.cast('const char*', text) + i
+		local n = math.min(chunk_size, size - i)
+		i = i + n
+		return p, n
+	end
+end
+
+local function count_writer()
+	local n = 0
+	return function(buf, sz) n = n + sz end, function() return n end
+end
+
+local function bench_compress(name, opt)
+	local write, written = count_writer()
+	local t0 = time.clock()
+	lz4.frame_compress(chunks(), write, opt)
+	local dt = time.clock() - t0
+	print(string.format('%-28s %8.0f MB/s  ratio %.3f',
+		name, size / 1024^2 / dt, written() / size))
+end
+
+bench_compress('LZ4F, 64 KB blocks', {level = level})
+bench_compress('LZ4F, 4 MB blocks', {level = level, block_size = 4 * 1024^2})
+local threads = 1
+while threads <= max_threads do
+	bench_compress('mt, '..threads..' thread(s)', {level = level, threads = threads})
+	threads = threads * 2
+end
+
+local c = lz4.frame_compress(chunks(), '', {level = level, threads = max_threads})
+local write, written = count_writer()
+local t0 = time.clock()
+lz4.frame_decompress(c, write)
+local dt = time.clock() - t0
+assert(written() == size)
+print(string.format('%-28s %8.0f MB/s', 'decompress', size / 1024^2 / dt))
@@ -12,7 +12,6 @@ local ffi = require'ffi'
 local bit = require'bit'
 
 local glue  = require'glue'
-local heap  = require'heap'
 local coro  = require'coro'
 local clock = require'time'.clock
 
@@ -28,10 +27,15 @@ assert(Windows or Linux or OSX, 'unsupported platform')
 local C = Windows and ffi.load'ws2_32' or ffi.C
 local M = {C = C, clock = clock}
 
+--the I/O backend can be chosen at load time with the SOCK_BACKEND env var.
+--the only choice right now is between 'epoll' (default) and 'io_uring' on Linux.
+M.backend = Windows and 'iocp' or Linux and 'epoll' or OSX and 'kqueue'
+
 local socket = {debug_prefix = 'S'} --common socket methods
 local tcp = {type = 'tcp_socket'}
 local udp = {type = 'udp_socket'}
 local raw = {type = 'raw_socket'}
+local eventfd = {type = 'eventfd', debug_prefix = 'E'}
 
 --forward declarations
 local check, poll, wait, create_socket, wrap_socket
@@ -44,6 +48,224 @@ end
 local currentthread = coro.running
 local transfer = coro.transfer
 
+--timer wheel ----------------------------------------------------------------
+
+--Hierarchical timing wheel for I/O timeouts and sleeping threads: O(1) arm
+--and cancel, so that many sockets with a timeout each stay cheap. Timers fire
+--at most one tick late and never early. Level n has 256 slots of 256^(n-1)
+--ticks each, for a total range of ~50 days, beyond which timers are parked
+--in the last level and re-placed when their slot is cascaded down.
+--Slots are circular doubly-linked lists threaded through the objects, with
+--link keys derived from EXPIRES so that an object can be in multiple wheels
+--at the same time (a socket has a send and a recv timeout).
+
+local TPS    = 1000 --ticks per second
+local SLOTS  = 256
+local LEVELS = 4
+
+local floor, ceil, max = math.floor, math.ceil, math.max
+
+--the wheel works in integer ticks. tick_time() is the only conversion from
+--ticks to seconds, and time_tick() is its exact inverse: the last tick whose
+--time is <= t, so advancing to a tick's time always reaches that tick.
+local function tick_time(tick)
+	return tick / TPS
+end
+
+local function time_tick(t)
+	local tick = floor(t * TPS)
+	if tick_time(tick) > t then
+		return tick - 1
+	elseif tick_time(tick + 1) <= t then
+		return tick + 1
+	end
+	return tick
+end
+
+--timerwheel(EXPIRES, fire, [t0]) -> tw; fire(obj) is called for each expired
+--object. t0 is the start time (defaults to clock()).
+--tw:add(obj, expires) sets obj[EXPIRES]; tw:remove(obj) clears it.
+local function timerwheel(EXPIRES, fire, t0)
+	local NEXT = EXPIRES .. '_next'
+	local PREV = EXPIRES .. '_prev'
+
+	local function list()
+		local t = {}
+		t[NEXT] = t
+		t[PREV] = t
+		return t
+	end
+
+	local function link(list, obj)
+		local last = list[PREV]
+		obj[PREV] = last
+		obj[NEXT] = list
+		last[NEXT] = obj
+		list[PREV] = obj
+	end
+
+	local function unlink(obj)
+		local prev, next = obj[PREV], obj[NEXT]
+		prev[NEXT] = next
+		next[PREV] = prev
+		obj[PREV] = nil
+		obj[NEXT] = nil
+	end
+
+	--move all objects from `slot` to a new list that can be iterated while
+	--objects are removed from it and new objects are added to the wheel.
+	local function detach(slot)
+		local t = list()
+		local first, last = slot[NEXT], slot[PREV]
+		t[NEXT], t[PREV] = first, last
+		first[PREV], last[NEXT] = t, t
+		slot[NEXT], slot[PREV] = slot, slot
+		return t
+	end
+
+	local levels = {}
+	for level = 1, LEVELS do
+		local slots = {}
+		for i = 0, SLOTS-1 do
+			slots[i] = list()
+		end
+		levels[level] = slots
+	end
+	local wheel1 = levels[1]
+	local now = time_tick(t0 or clock()) --last processed tick.
+	local count = 0
+	local due = 1/0 --lower bound of the next tick that has timers to process.
+
+	local function place(obj, tick)
+		local delta = tick - now
+		if delta < SLOTS then --fast path
+			link(wheel1[tick % SLOTS], obj)
+			if tick < due then due = tick end
+			return
+		end
+		local w = SLOTS
+		for level = 2, LEVELS do
+			local span = w * SLOTS
+			if delta < span or level == LEVELS then
+				if delta >= span then --too far away: park it.
+					tick = now + span - 1
+				end
+				local i = floor(tick / w)
+				link(levels[level][i % SLOTS], obj)
+				local t = i * w --when this slot is due for cascading.
+				if t < due then due = t end
+				return
+			end
+			w = span
+		end
+	end
+
+	local function cascade(level, i)
+		local slot = levels[level][i]
+		if slot[NEXT] == slot then return end
+		--no callbacks here so we can walk the list while re-linking its objects.
+		local obj = slot[NEXT]
+		slot[NEXT], slot[PREV] = slot, slot
+		while obj ~= slot do
+			local next_obj = obj[NEXT]
+			place(obj, ceil(obj[EXPIRES] * TPS))
+			obj = next_obj
+		end
+	end
+
+	--find the first non-empty slot on each level, stopping at the first level
+	--whose slots all start after the earliest one found so far.
+	local function scan()
+		local t = 1/0
+		local w = 1
+		for level = 1, LEVELS do
+			local slots = levels[level]
+			local b = floor(now / w)
+			if t <= (b + 1) * w then break end
+			for d = 1, SLOTS do
+				local i = b + d
+				local slot = slots[i % SLOTS]
+				if slot[NEXT] ~= slot then
+					if i * w < t then t = i * w end
+					break
+				end
+			end
+			w = w * SLOTS
+		end
+		return t
+	end
+
+	--cascade the slots which start at `now` and fire the timers due at `now`.
+	local function process()
+		local w = SLOTS^(LEVELS-1)
+		for level = LEVELS, 2, -1 do
+			if now % w == 0 then
+				cascade(level, floor(now / w) % SLOTS)
+			end
+			w = w / SLOTS
+		end
+		local slot = wheel1[now % SLOTS]
+		if slot[NEXT] ~= slot then
+			local t = detach(slot)
+			while t[NEXT] ~= t do
+				local obj = t[NEXT]
+				unlink(obj)
+				obj[EXPIRES] = nil
+				count = count - 1
+				fire(obj)
+			end
+		end
+		due = now --stale: rescan.
+	end
+
+	local tw = {}
+
+	function tw:add(obj, expires)
+		if obj[NEXT] then
+			unlink(obj)
+		else
+			count = count + 1
+		end
+		obj[EXPIRES] = expires
+		place(obj, max(ceil(expires * TPS), now + 1))
+	end
+
+	function tw:remove(obj)
+		if not obj[NEXT] then return false end
+		unlink(obj)
+		obj[EXPIRES] = nil
+		count = count - 1
+		if count == 0 then due = 1/0 end
+		return true
+	end
+
+	--the time of the next tick that has timers to fire or cascade.
+	function tw:next_expires()
+		if count == 0 then return nil end
+		if due <= now then due = scan() end
+		return tick_time(due)
+	end
+
+	--fire all timers that expired at time t.
+	function tw:advance(t)
+		local target = time_tick(t)
+		while count > 0 do
+			if due <= now then due = scan() end
+			if due > target then break end
+			now = due
+			process()
+		end
+		if now < target then now = target end
+	end
+
+	function tw:count()
+		return count
+	end
+
+	return tw
+end
+M.timerwheel = timerwheel
+
 --getaddrinfo() --------------------------------------------------------------
 
 ffi.cdef[[
@@ -393,6 +615,12 @@ typedef struct _WSABUF {
 	CHAR  *buf;
 } WSABUF, *LPWSABUF;
 
+// WSABUF with POSIX field names, used by tcp:sendv().
+struct iovec {
+	ULONG iov_len;
+	CHAR  *iov_base;
+};
+
 int WSAIoctl(
 	SOCKET        s,
 	DWORD         dwIoControlCode,
@@ -637,25 +865,44 @@ function socket:closed()
 	return not self.s
 end
 
-local expires_heap = heap.valueheap{
-	cmp = function(job1, job2)
-		return job1.expires < job2.expires
-	end,
-	index_key = 'index', --enable O(log n) removal.
-}
+local overlapped, free_overlapped
+
+local void_ptr_c = ffi.typeof'void*'
+local ERROR_NOT_FOUND = 1168
+
+--cancel timed-out jobs. even if we cancel them all, we still have to wait
+--for the OS to abort them. until then we can't recycle the OVERLAPPED
+--structures so their threads are woken up on completion.
+local timers = timerwheel('expires', function(job)
+	if job.socket then
+		local s = job.socket.s --pipe or socket
+		local o = job.overlapped.overlapped
+		local ok = ffi.C.CancelIoEx(ffi.cast(void_ptr_c, s), o) ~= 0
+		if not ok then
+			local err = C.WSAGetLastError()
+			if err == ERROR_NOT_FOUND then --too late, already gone
+				free_overlapped(o)
+				transfer(job.thread, nil, 'timeout')
+			else
+				assert(check(ok, err))
+			end
+		end
+	else --sleep
+		transfer(job.thread)
+	end
+end)
 
 do
 local function sleep_until(job, expires)
 	job.thread = currentthread()
-	job.expires = expires
-	expires_heap:push(job)
+	timers:add(job, expires)
 	return wait(false)
 end
 local function sleep(job, timeout)
 	return sleep_until(job, clock() + timeout)
 end
 local function wakeup(job, ...)
-	if not expires_heap:remove(job) then
+	if not timers:remove(job) then
 		return false
 	end
 	M.resume(job.thread, ...)
@@ -666,7 +913,6 @@ function M.sleep_job()
 end
 end
 
-local overlapped, free_overlapped
 do
 	local jobs = {} --{job1, ...}
 	local freed = {} --{job_index1, ...}
@@ -716,17 +962,14 @@ do
 
 	local WAIT_TIMEOUT = 258
 	local ERROR_OPERATION_ABORTED = 995
-	local ERROR_NOT_FOUND = 1168
 	local INFINITE = 0xffffffff
 
-	local void_ptr_c = ffi.typeof'void*'
-
 	--[[local]] function poll()
 
-		local job = expires_heap:peek()
-		local timeout = job and math.max(0, job.expires - clock()) or 1/0
+		local expires = timers:next_expires()
+		local timeout = expires and math.max(0, expires - clock()) or 1/0
 
-		local timeout_ms = math.max(timeout * 1000, 0)
+		local timeout_ms = math.ceil(timeout * 1000)
 		--we're going infinite after 0x7fffffff for compat. with Linux.
 		if timeout_ms > 0x7fffffff then timeout_ms = INFINITE end
 
@@ -738,65 +981,28 @@ do
 		if o == nil then
 			assert(not ok)
 			local err = C.WSAGetLastError()
-			if err == WAIT_TIMEOUT then
-				--cancel all timed-out jobs.
-				local t = clock()
-				while true do
-					local job = expires_heap:peek()
-					if not job then
-						break
-					end
-					if math.abs(t - job.expires) <= .05 then --arbitrary threshold.
-						expires_heap:pop()
-						job.expires = nil
-						if job.socket then
-							local s = job.socket.s --pipe or socket
-							local o = job.overlapped.overlapped
-							local ok = ffi.C.CancelIoEx(ffi.cast(void_ptr_c, s), o) ~= 0
-							if not ok then
-								local err = C.WSAGetLastError()
-								if err == ERROR_NOT_FOUND then --too late, already gone
-									free_overlapped(o)
-									transfer(job.thread, nil, 'timeout')
-								else
-									assert(check(ok, err))
-								end
-							end
-						else --sleep
-							transfer(job.thread)
-						end
-					else
-						--jobs are popped in expire-order so no point looking beyond this.
-						break
-					end
-				end
-				--even if we canceled them all, we still have to wait for the OS
-				--to abort them. until then we can't recycle the OVERLAPPED structures.
-				return true
-			else
+			if err ~= WAIT_TIMEOUT then
 				return check(nil, err)
 			end
 		else
 			local n = nbuf[0]
 			local job = free_overlapped(o)
 			if ok then
-				if job.expires then
-					assert(expires_heap:remove(job))
-				end
+				timers:remove(job)
 				transfer(job.thread, job:done(n))
 			else
 				local err = C.WSAGetLastError()
 				if err == ERROR_OPERATION_ABORTED then --canceled
 					transfer(job.thread, nil, 'timeout')
 				else
-					if job.expires then
-						assert(expires_heap:remove(job))
-					end
+					timers:remove(job)
 					transfer(job.thread, check(nil, err))
 				end
 			end
-			return true
 		end
+		--handle timed-out ops, also when busy.
+		timers:advance(clock())
+		return true
 	end
 end
 
@@ -806,7 +1012,7 @@ do
 	local function check_pending(ok, job)
 		if ok or C.WSAGetLastError() == WSA_IO_PENDING then
 			if job.expires then
-				expires_heap:push(job)
+				timers:add(job, job.expires)
 			end
 			job.thread = currentthread()
 			return wait()
@@ -886,6 +1092,14 @@ do
 		return socket_send(self, buf, len, expires)
 	end
 
+	local LPWSABUF = ffi.typeof'LPWSABUF'
+
+	function tcp:_sendv(iov, n, expires)
+		local o, job = overlapped(self, io_done, expires)
+		local ok = C.WSASend(self.s, ffi.cast(LPWSABUF, iov), n, nil, 0, o, nil) == 0
+		return check_pending(ok, job)
+	end
+
 	function udp:send(buf, len, expires)
 		return socket_send(self, buf, len or #buf, expires)
 	end
@@ -968,6 +1182,20 @@ int sendto(int s, const char *buf, int len, int flags, const struct sockaddr *to
 // for async pipes
 ssize_t read(int fd, void *buf, size_t count);
 ssize_t write(int fd, const void *buf, size_t count);
+struct iovec {
+	void  *iov_base;
+	size_t iov_len;
+};
+struct msghdr {
+	void         *msg_name;
+	unsigned int  msg_namelen;
+	struct iovec *msg_iov;
+	size_t        msg_iovlen;
+	void         *msg_control;
+	size_t        msg_controllen;
+	int           msg_flags;
+};
+ssize_t sendmsg(int s, const struct msghdr *msg, int flags);
 ]]
 
 --error handling.
@@ -1014,35 +1242,35 @@ local EAGAIN      = 11
 local EWOULDBLOCK = 11
 local EINPROGRESS = 115
 
-local recv_expires_heap = heap.valueheap{
-	cmp = function(s1, s2)
-		return s1.recv_expires < s2.recv_expires
-	end,
-	index_key = 'index', --enable O(log n) removal.
-}
+--timed-out sockets and sleep jobs are woken up with `nil, 'timeout'`.
+local recv_timers = timerwheel('recv_expires', function(socket)
+	local thread = socket.recv_thread
+	socket.recv_thread = nil
+	transfer(thread, nil, 'timeout')
+end)
 
-local send_expires_heap = heap.valueheap{
-	cmp = function(s1, s2)
-		return s1.send_expires < s2.send_expires
-	end,
-	index_key = 'index', --enable O(log n) removal.
-}
+local send_timers = timerwheel('send_expires', function(socket)
+	local thread = socket.send_thread
+	socket.send_thread = nil
+	transfer(thread, nil, 'timeout')
+end)
 
 do
 local function sleep_until(job, expires)
 	job.recv_thread = currentthread()
-	job.recv_expires = expires
-	recv_expires_heap:push(job)
+	recv_timers:add(job, expires)
 	return wait(false)
 end
 local function sleep(job, timeout)
 	return sleep_until(job, clock() + timeout)
 end
-local function wakeup(thread, ...)
-	if not recv_expires_heap:remove(job) then
+local function wakeup(job, ...)
+	if not recv_timers:remove(job) then
 		return false
 	end
-	M.resume(job.thread, ...)
+	local thread = job.recv_thread
+	job.recv_thread = nil
+	M.resume(thread, ...)
 	return true
 end
 function M.sleep_job()
@@ -1057,15 +1285,13 @@ local function make_async(for_writing, func, wait_errno)
 		if ret >= 0 then return ret end
 		if ffi.errno() == wait_errno then
 			if for_writing then
-				self.send_expires = expires
 				if expires then
-					send_expires_heap:push(self)
+					send_timers:add(self, expires)
 				end
 				self.send_thread = currentthread()
 			else
-				self.recv_expires = expires
 				if expires then
-					recv_expires_heap:push(self)
+					recv_timers:add(self, expires)
 				end
 				self.recv_thread = currentthread()
 			end
@@ -1137,6 +1363,23 @@ function udp:send(buf, len, expires, flags)
 	return socket_send(self, expires, buf, len or #buf, flags)
 end
 
+local socket_sendmsg = make_async(true, function(self, msg, flags)
+	return tonumber(C.sendmsg(self.s, msg, flags or MSG_NOSIGNAL))
+end, EWOULDBLOCK)
+
+local msghdr_ct = ffi.typeof'struct msghdr'
+
+function tcp:_sendv(iov, n, expires, flags)
+	local msg = self._sendv_msghdr
+	if not msg then
+		msg = msghdr_ct()
+		self._sendv_msghdr = msg
+	end
+	msg.msg_iov = iov
+	msg.msg_iovlen = n
+	return socket_sendmsg(self, expires, msg, flags)
+end
+
 local socket_recv = make_async(false, function(self, buf, len, flags)
 	return C.recv(self.s, buf, len, flags or 0)
 end, EWOULDBLOCK)
@@ -1198,7 +1441,9 @@ end
 
 if Linux then
 
-ffi.cdef[[
+--NOTE: struct epoll_event is packed on x86-64 (12 bytes instead of 16),
+--which doesn't matter for reading the first item but it does for the rest.
+ffi.cdef(string.format([[
 typedef union epoll_data {
 	void *ptr;
 	int fd;
@@ -1206,7 +1451,7 @@ typedef union epoll_data {
 	uint64_t u64;
 } epoll_data_t;
 
-struct epoll_event {
+struct %s epoll_event {
 	uint32_t events;
 	epoll_data_t data;
 };
@@ -1214,7 +1459,7 @@ struct epoll_event {
 int epoll_create1(int flags);
 int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
 int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
-]]
+]], ffi.arch == 'x64' and '__attribute__((packed))' or ''))
 
 local EPOLLIN    = 0x0001
 local EPOLLOUT   = 0x0004
@@ -1257,6 +1502,11 @@ do
 
 	local ENOENT = 2
 
+	--threads waiting on a socket that got closed, to be woken up with
+	--`nil, 'closed'` on the next poll() since epoll won't report anything
+	--for them anymore.
+	local closed = {} --{thread1, ...}
+
 	function M._unregister(s)
 		local i = s._i
 		if not i then return true end --closing before bind() was called.
@@ -1267,6 +1517,17 @@ do
 		end
 		sockets[i] = false
 		push(free_indices, i)
+		s._i = nil
+		if s.recv_thread then
+			recv_timers:remove(s)
+			push(closed, s.recv_thread)
+			s.recv_thread = nil
+		end
+		if s.send_thread then
+			send_timers:remove(s)
+			push(closed, s.send_thread)
+			s.send_thread = nil
+		end
 		return true
 	end
 
@@ -1279,16 +1540,10 @@ do
 		end
 		if not thread then return end --misfire.
 		if for_writing then
-			if socket.send_expires then
-				assert(send_expires_heap:remove(socket))
-				socket.send_expires = nil
-			end
+			send_timers:remove(socket)
 			socket.send_thread = nil
 		else
-			if socket.recv_expires then
-				assert(recv_expires_heap:remove(socket))
-				socket.recv_expires = nil
-			end
+			recv_timers:remove(socket)
 			socket.recv_thread = nil
 		end
 		if has_err then
@@ -1299,73 +1554,698 @@ do
 		end
 	end
 
-	local function check_heap(heap, EXPIRES, THREAD, t)
-		while true do
-			local socket = heap:peek() --gets a socket or sleep job
-			if not socket then
-				break
-			end
-			if math.abs(t - socket[EXPIRES]) <= .05 then --arbitrary threshold.
-				assert(heap:pop())
-				socket[EXPIRES] = nil
-				local thread = socket[THREAD]
-				socket[THREAD] = nil
-				transfer(thread, nil, 'timeout')
-			else
-				--socket are popped in expire-order so no point looking beyond this.
-				break
-			end
-		end
-	end
-
-	--NOTE: If you think of making maxevents > 1 for a modest perf gain,
-	--note that epoll_wait() will coalesce multiple events affecting the same
-	--fd in a single epoll_event item, and it returns the number of events,
-	--not the number of epoll_event items that were filled, contrary to what
-	--the epoll man page says, so it's not trivial to parse the result.
-	local maxevents = 1
+	--NOTE: epoll_wait() reports at most one epoll_event item per fd per call,
+	--with all the fd's pending events or-ed into that item's `events` mask,
+	--so each item must be split into its recv and send readiness before
+	--dispatching. A wake() can close or re-register sockets
+	--which show up later in the same batch: a closed socket's slot is `false`
+	--so we skip it, and a slot re-used by a new socket can at worst cause
+	--a misfire, which make_async() handles by retrying the call.
+	local maxevents = 64
 	local events = ffi.new('struct epoll_event[?]', maxevents)
 	local RECV_MASK = EPOLLIN  + EPOLLERR + EPOLLHUP + EPOLLRDHUP
 	local SEND_MASK = EPOLLOUT + EPOLLERR + EPOLLHUP + EPOLLRDHUP
 
+	function M.epoll_maxevents(n)
+		if n then
+			assert(n >= 1 and n <= 0x7fffffff, 'invalid maxevents')
+			if n > maxevents then
+				events = ffi.new('struct epoll_event[?]', n)
+			end
+			maxevents = n
+		end
+		return maxevents
+	end
+
 	--[[local]] function poll()
 
-		local ss = send_expires_heap:peek()
-		local rs = recv_expires_heap:peek()
-		local sx = ss and ss.send_expires
-		local rx = rs and rs.recv_expires
-		local expires = math.min(sx or 1/0, rx or 1/0)
-		local timeout = expires < 1/0 and math.max(0, expires - clock()) or 1/0
+		local expires = math.min(
+			send_timers:next_expires() or 1/0,
+			recv_timers:next_expires() or 1/0)
+		local timeout = math.max(0, expires - clock())
 
-		local timeout_ms = math.max(timeout * 1000, 0)
+		local timeout_ms = math.ceil(timeout * 1000)
 		if timeout_ms > 0x7fffffff then timeout_ms = -1 end --infinite
+		if #closed > 0 then timeout_ms = 0 end
 
+		local events = events --in case it gets reallocated while dispatching.
 		local n = C.epoll_wait(M.epoll_fd(), events, maxevents, timeout_ms)
 		if n > 0 then
-			assert(n == 1)
-			local e = events[0].events
-			local si = events[0].data.u32
-			local socket = sockets[si]
-			--if EPOLLHUP/RDHUP/ERR arrives (and it'll arrive alone because maxevents == 1),
-			--we need to wake up all waiting threads because EPOLLIN/OUT might never follow!
-			local has_err = bit.band(e, EPOLLERR) ~= 0
-			if bit.band(e, RECV_MASK) ~= 0 then wake(socket, false, has_err) end
-			if bit.band(e, SEND_MASK) ~= 0 then wake(socket, true , has_err) end
-			return true
-		elseif n == 0 then
-			--handle timed-out ops.
-			local t = clock()
-			check_heap(send_expires_heap, 'send_expires', 'send_thread', t)
-			check_heap(recv_expires_heap, 'recv_expires', 'recv_thread', t)
-			return true
-		else
+			for i = 0, n-1 do
+				local e = events[i].events
+				local socket = sockets[events[i].data.u32]
+				if socket then --not closed by a previous wake() in this batch.
+					--if EPOLLHUP/RDHUP/ERR arrives we need to wake up all waiting
+					--threads because EPOLLIN/OUT might never follow!
+					local has_err = bit.band(e, EPOLLERR) ~= 0
+					if bit.band(e, RECV_MASK) ~= 0 then wake(socket, false, has_err) end
+					if bit.band(e, SEND_MASK) ~= 0 then wake(socket, true , has_err) end
+				end
+			end
+		elseif n < 0 then
 			return check()
 		end
+		while #closed > 0 do
+			transfer(table.remove(closed, 1), nil, 'closed')
+		end
+		--handle timed-out ops, also when busy.
+		local t = clock()
+		send_timers:advance(t)
+		recv_timers:advance(t)
+		return true, n
+	end
+end
+
+--sendfile() -----------------------------------------------------------------
+
+ffi.cdef[[
+ssize_t sendfile(int out_fd, int in_fd, int64_t *offset, size_t count);
+typedef struct { unsigned long val[1024 / (8 * sizeof(long))]; } sock_sigset_t;
+int sock_sigemptyset(sock_sigset_t *set) asm("sigemptyset");
+int sock_sigaddset(sock_sigset_t *set, int signum) asm("sigaddset");
+int sock_sigismember(const sock_sigset_t *set, int signum) asm("sigismember");
+int sock_sigprocmask(int how, const sock_sigset_t *set, sock_sigset_t *oldset) asm("sigprocmask");
+int sock_sigpending(sock_sigset_t *set) asm("sigpending");
+int sock_sigwait(const sock_sigset_t *set, int *sig) asm("sigwait");
+]]
+
+--sendfile() has no MSG_NOSIGNAL flag so writing to a socket closed by the
+--peer raises SIGPIPE. Instead of ignoring it process-wide we block it in the
+--calling thread around the call and consume the one we raised, if any.
+local SIGPIPE = 13
+local SIG_BLOCK, SIG_SETMASK = 0, 2
+local EPIPE = 32
+local sigpipe_set = ffi.new'sock_sigset_t'
+C.sock_sigemptyset(sigpipe_set)
+C.sock_sigaddset(sigpipe_set, SIGPIPE)
+local old_mask = ffi.new'sock_sigset_t'
+local pending_set = ffi.new'sock_sigset_t'
+local sigbuf = ffi.new'int[1]'
+
+local function sigpipe_pending()
+	C.sock_sigpending(pending_set)
+	return C.sock_sigismember(pending_set, SIGPIPE) == 1
+end
+
+local socket_sendfile = make_async(true, function(self, fd, offset, len)
+	C.sock_sigprocmask(SIG_BLOCK, sigpipe_set, old_mask)
+	local was_pending = sigpipe_pending()
+	local n = tonumber(C.sendfile(self.s, fd, offset, len))
+	local err = ffi.errno()
+	if n == -1 and err == EPIPE and not was_pending and sigpipe_pending() then
+		C.sock_sigwait(sigpipe_set, sigbuf)
 	end
+	C.sock_sigprocmask(SIG_SETMASK, old_mask, nil)
+	ffi.errno(err)
+	return n
+end, EAGAIN)
+
+local offset_ct = ffi.typeof'int64_t[1]'
+
+function tcp:_sendfile(fd, offset, len, expires)
+	local offbuf = self._sendfile_offset
+	if not offbuf then
+		offbuf = offset_ct()
+		self._sendfile_offset = offbuf
+	end
+	offbuf[0] = offset
+	return socket_sendfile(self, expires, fd, offbuf, math.min(len, 0x7ffff000))
+end
+
+--eventfd() ------------------------------------------------------------------
+
+ffi.cdef'int sock_eventfd(unsigned int initval, int flags) asm("eventfd");'
+
+local EFD_NONBLOCK = tonumber(4000, 8)
+local EFD_CLOEXEC  = tonumber(2000000, 8)
+
+function M._eventfd()
+	local fd = C.sock_eventfd(0, bit.bor(EFD_NONBLOCK, EFD_CLOEXEC))
+	if fd == -1 then
+		return check()
+	end
+	return fd
+end
+
+local eventfd_read = make_async(false, function(self)
+	return tonumber(C.read(self.s, self._buf, 8))
+end, EAGAIN)
+
+function eventfd:_read(expires)
+	return eventfd_read(self, expires)
 end
 
 end --if Linux
 
+--io_uring -------------------------------------------------------------------
+
+--io_uring is completion-based like IOCP: I/O requests are queued into a ring
+--shared with the kernel and completions are harvested in batches from another
+--ring, so an I/O op doesn't cost a readiness syscall plus an I/O syscall.
+--Queued requests are submitted and completions are waited for with a single
+--io_uring_enter() call in poll(). Needs Linux 5.11+ (for IORING_FEAT_EXT_ARG)
+--and falls back to epoll if that's not available.
+
+if Linux and os.getenv'SOCK_BACKEND' == 'io_uring' then
+
+ffi.cdef[[
+struct io_sqring_offsets {
+	uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1;
+	uint64_t user_addr;
+};
+
+struct io_cqring_offsets {
+	uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1;
+	uint64_t user_addr;
+};
+
+struct io_uring_params {
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	uint32_t flags;
+	uint32_t sq_thread_cpu;
+	uint32_t sq_thread_idle;
+	uint32_t features;
+	uint32_t wq_fd;
+	uint32_t resv[3];
+	struct io_sqring_offsets sq_off;
+	struct io_cqring_offsets cq_off;
+};
+
+struct io_uring_sqe {
+	uint8_t  opcode;
+	uint8_t  flags;
+	uint16_t ioprio;
+	int32_t  fd;
+	uint64_t off;      // also addr2
+	uint64_t addr;
+	uint32_t len;
+	uint32_t op_flags; // msg_flags, accept_flags, cancel_flags, etc.
+	uint64_t user_data;
+	uint16_t buf_index;
+	uint16_t personality;
+	int32_t  splice_fd_in;
+	uint64_t addr3;
+	uint64_t _pad;
+};
+
+struct io_uring_cqe {
+	uint64_t user_data;
+	int32_t  res;
+	uint32_t flags;
+};
+
+struct io_uring_getevents_arg {
+	uint64_t sigmask;
+	uint32_t sigmask_sz;
+	uint32_t pad;
+	uint64_t ts;
+};
+
+typedef struct {
+	int64_t tv_sec;
+	int64_t tv_nsec;
+} sock_timespec;
+
+long sock_syscall(long number, ...) asm("syscall");
+int sock_pipe2(int *fds, int flags) asm("pipe2");
+int sock_fcntl(int fd, int cmd, int arg) asm("fcntl");
+void *sock_mmap(void *addr, size_t length, int prot, int flags, int fd, int64_t offset) asm("mmap");
+]]
+
+local SYS_io_uring_setup = 425
+local SYS_io_uring_enter = 426
+
+local IORING_FEAT_SINGLE_MMAP = 0x001
+local IORING_FEAT_EXT_ARG     = 0x100
+
+local IORING_OFF_SQ_RING = 0
+local IORING_OFF_CQ_RING = 0x8000000
+local IORING_OFF_SQES    = 0x10000000
+
+local IORING_ENTER_GETEVENTS = 1
+local IORING_ENTER_EXT_ARG   = 8
+
+local IORING_OP_SENDMSG      = 9
+local IORING_OP_RECVMSG      = 10
+local IORING_OP_ACCEPT       = 13
+local IORING_OP_ASYNC_CANCEL = 14
+local IORING_OP_CONNECT      = 16
+local IORING_OP_READ         = 22
+local IORING_OP_WRITE        = 23
+local IORING_OP_SEND         = 26
+local IORING_OP_RECV         = 27
+local IORING_OP_SPLICE       = 30
+
+local PROT_READ_WRITE   = 3
+local MAP_SHARED        = 0x01
+local MAP_POPULATE      = 0x8000
+local MAP_FAILED        = ffi.cast('void*', -1)
+
+local EINTR     = 4
+local EBUSY     = 16
+local ETIME     = 62
+local ECANCELED = 125
+
+local u32p_ct  = ffi.typeof'uint32_t*'
+local u8p_ct   = ffi.typeof'uint8_t*'
+local sqes_ct  = ffi.typeof'struct io_uring_sqe*'
+local cqes_ct  = ffi.typeof'struct io_uring_cqe*'
+local uintptr_ct = ffi.typeof'uintptr_t'
+local voidp_ct = ffi.typeof'void*'
+
+local function mmap(fd, size, offset)
+	local p = C.sock_mmap(nil, size, PROT_READ_WRITE,
+		MAP_SHARED + MAP_POPULATE, fd, offset)
+	if p == MAP_FAILED then return nil end
+	return ffi.cast(u8p_ct, p)
+end
+
+local function setup_ring(entries)
+	local pbuf = ffi.new'struct io_uring_params[1]'
+	local p = pbuf[0]
+	local fd = tonumber(C.sock_syscall(SYS_io_uring_setup, ffi.cast('unsigned', entries), pbuf))
+	if fd < 0 then return nil end
+	local features = p.features
+	if bit.band(features, IORING_FEAT_SINGLE_MMAP) == 0
+		or bit.band(features, IORING_FEAT_EXT_ARG) == 0
+	then
+		C.close(fd)
+		return nil
+	end
+	local so, co = p.sq_off, p.cq_off
+	local ring_size = math.max(
+		so.array + p.sq_entries * 4,
+		co.cqes  + p.cq_entries * ffi.sizeof'struct io_uring_cqe')
+	local ring = mmap(fd, ring_size, IORING_OFF_SQ_RING)
+	local sqes = ring and mmap(fd, p.sq_entries * ffi.sizeof'struct io_uring_sqe', IORING_OFF_SQES)
+	if not sqes then
+		C.close(fd)
+		return nil
+	end
+	return {
+		fd = fd,
+		sq_entries = p.sq_entries,
+		sq_head  = ffi.cast(u32p_ct, ring + so.head),
+		sq_tail  = ffi.cast(u32p_ct, ring + so.tail),
+		sq_mask  = ffi.cast(u32p_ct, ring + so.ring_mask)[0],
+		sq_array = ffi.cast(u32p_ct, ring + so.array),
+		sqes     = ffi.cast(sqes_ct, sqes),
+		cq_head  = ffi.cast(u32p_ct, ring + co.head),
+		cq_tail  = ffi.cast(u32p_ct, ring + co.tail),
+		cq_mask  = ffi.cast(u32p_ct, ring + co.ring_mask)[0],
+		cqes     = ffi.cast(cqes_ct, ring + co.cqes),
+	}
+end
+
+local ring = setup_ring(4096)
+
+if ring then
+
+M.backend = 'io_uring'
+
+local ring_fd  = ring.fd
+local sq_head  = ring.sq_head
+local sq_tail  = ring.sq_tail
+local sq_mask  = ring.sq_mask
+local sq_array = ring.sq_array
+local sqes     = ring.sqes
+local cq_head  = ring.cq_head
+local cq_tail  = ring.cq_tail
+local cq_mask  = ring.cq_mask
+local cqes     = ring.cqes
+local sq_entries = ring.sq_entries
+
+--NOTE: syscall() is variadic so all args must be cast to their exact types.
+local function enter(to_submit, min_complete, flags, arg, argsz)
+	return tonumber(C.sock_syscall(SYS_io_uring_enter, ffi.cast('int', ring_fd),
+		ffi.cast('unsigned', to_submit), ffi.cast('unsigned', min_complete),
+		ffi.cast('unsigned', flags), ffi.cast(voidp_ct, arg),
+		ffi.cast('size_t', argsz or 0)))
+end
+
+local function pending_sqes()
+	return (sq_tail[0] - sq_head[0]) % 2^32
+end
+
+--get a zeroed sqe from the submission queue, making room by submitting
+--the queued sqes if the queue is full.
+local function get_sqe()
+	while pending_sqes() >= sq_entries do
+		if enter(pending_sqes(), 0, 0) < 0 and ffi.errno() ~= EINTR then
+			assert(check())
+		end
+	end
+	local tail = sq_tail[0]
+	local i = bit.band(tail, sq_mask)
+	local sqe = sqes[i]
+	ffi.fill(sqe, ffi.sizeof(sqe))
+	sq_array[i] = i
+	sq_tail[0] = (tail + 1) % 2^32
+	return sqe
+end
+
+local jobs = {} --{job1, ...}; job.n is the sqe's user_data.
+local freed = {} --{job_n1, ...}
+
+local function new_job()
+	local n = pop(freed)
+	if n then return jobs[n] end
+	local job = {n = #jobs + 1}
+	jobs[job.n] = job
+	return job
+end
+
+local function cancel(job)
+	local sqe = get_sqe()
+	sqe.opcode = IORING_OP_ASYNC_CANCEL
+	sqe.fd = -1
+	sqe.addr = job.n
+	--user_data = 0 marks the cancel's own completion which we ignore.
+end
+
+--cancel timed-out requests. like with IOCP, we have to wait for the kernel
+--to abort them before waking up their threads because it may still
+--write into their buffers until then.
+local timers = timerwheel('expires', function(job)
+	job.timedout = true
+	cancel(job)
+end)
+
+--queue an I/O request and wait for its completion.
+local function io(self, for_writing, expires, opcode, fd, addr, len, off, op_flags, fd_in)
+	local job = new_job()
+	job.socket = self
+	job.for_writing = for_writing
+	job.thread = currentthread()
+	if expires then
+		timers:add(job, expires)
+	end
+	if for_writing then
+		self._send_job = job
+	else
+		self._recv_job = job
+	end
+	local sqe = get_sqe()
+	sqe.opcode = opcode
+	sqe.fd = fd
+	sqe.addr = ffi.cast(uintptr_ct, ffi.cast(voidp_ct, addr))
+	sqe.len = len or 0
+	sqe.off = off or 0
+	sqe.op_flags = op_flags or 0
+	sqe.splice_fd_in = fd_in or 0
+	sqe.user_data = job.n
+	return wait()
+end
+
+local function complete(job, res)
+	timers:remove(job)
+	local socket = job.socket
+	if job.for_writing then
+		socket._send_job = nil
+	else
+		socket._recv_job = nil
+	end
+	local thread, timedout, closed = job.thread, job.timedout, job.closed
+	job.socket = nil
+	job.thread = nil
+	job.timedout = nil
+	job.closed = nil
+	push(freed, job.n)
+	if res >= 0 then
+		transfer(thread, res)
+	elseif closed then --canceled or failed because the fd was closed.
+		transfer(thread, nil, 'closed')
+	elseif res == -ECANCELED and timedout then
+		transfer(thread, nil, 'timeout')
+	else
+		transfer(thread, nil, error_classes[-res] or str(C.strerror(-res)))
+	end
+end
+
+function M._register(s)
+	return true --no need.
+end
+
+local function close_pipe(s)
+	local pipe = s._sendfile_pipe
+	if not pipe then return end
+	C.close(pipe[0])
+	C.close(pipe[1])
+	s._sendfile_pipe = nil
+end
+
+--the ring keeps a reference to the file of a pending request so closing
+--the socket doesn't abort it: we have to cancel it ourselves.
+function M._unregister(s)
+	local job = s._recv_job
+	if job then
+		job.closed = true
+		cancel(job)
+	end
+	local job = s._send_job
+	if job then
+		job.closed = true
+		cancel(job)
+	end
+	close_pipe(s)
+	return true
+end
+
+local EINPROGRESS = 115
+
+function socket:connect(host, port, expires, addr_flags, ...)
+	local ai, ext_ai = self:addr(host, port, addr_flags)
+	if not ai then return nil, ext_ai end
+	if not self._bound then
+		local ok, err = self:bind(...)
+		if not ok then
+			if not ext_ai then ai:free() end
+			return nil, err
+		end
+	end
+	--ai must stay alive until the request completes.
+	local ok, err = io(self, true, expires, IORING_OP_CONNECT,
+		self.s, ai.addr, 0, ai.addrlen)
+	if not ext_ai then ai:free() end
+	if not ok then return nil, err end
+	return true
+end
+
+function tcp:accept(expires)
+	local job_sa = self._accept_sa
+	if not job_sa then
+		job_sa = sockaddr_ct()
+		self._accept_sa = job_sa
+		self._accept_sa_len = ffi.new'int[1]'
+	end
+	self._accept_sa_len[0] = ffi.sizeof(job_sa)
+	local s, err = io(self, false, expires, IORING_OP_ACCEPT, self.s,
+		job_sa, 0, ffi.cast(uintptr_ct, self._accept_sa_len), SOCK_NONBLOCK)
+	if not s then return nil, err end
+	return wrap_socket(tcp, s, self._st, self._af, self._pr), job_sa
+end
+
+local pchar_t = ffi.typeof'char*'
+
+function tcp:_send(buf, len, expires, flags)
+	len = len or #buf
+	if len == 0 then return 0 end --mask-out null-writes
+	if type(buf) == 'string' then buf = ffi.cast(pchar_t, buf) end
+	return io(self, true, expires, IORING_OP_SEND, self.s,
+		buf, len, 0, flags or MSG_NOSIGNAL)
+end
+
+function udp:send(buf, len, expires, flags)
+	len = len or #buf
+	if type(buf) == 'string' then buf = ffi.cast(pchar_t, buf) end
+	return io(self, true, expires, IORING_OP_SEND, self.s,
+		buf, len, 0, flags or MSG_NOSIGNAL)
+end
+
+local msghdr_ct = ffi.typeof'struct msghdr'
+
+function tcp:_sendv(iov, n, expires, flags)
+	local msg = self._sendv_msghdr
+	if not msg then
+		msg = msghdr_ct()
+		self._sendv_msghdr = msg
+	end
+	msg.msg_iov = iov
+	msg.msg_iovlen = n
+	return io(self, true, expires, IORING_OP_SENDMSG, self.s,
+		msg, 1, 0, flags or MSG_NOSIGNAL)
+end
+
+function socket:recv(buf, len, expires, flags)
+	assert(len > 0)
+	return io(self, false, expires, IORING_OP_RECV, self.s,
+		buf, len, 0, flags or 0)
+end
+
+local function msghdr(self, k, buf, len)
+	local mh = self[k]
+	if not mh then
+		mh = ffi.new[[
+			struct {
+				struct msghdr msg;
+				struct iovec iov;
+			}
+		]]
+		mh.msg.msg_iov = mh.iov
+		mh.msg.msg_iovlen = 1
+		self[k] = mh
+	end
+	mh.iov.iov_base = type(buf) == 'string' and ffi.cast(pchar_t, buf) or buf
+	mh.iov.iov_len = len
+	return mh
+end
+
+function udp:sendto(host, port, buf, len, expires, flags, addr_flags)
+	len = len or #buf
+	local ai, ext_ai = self:addr(host, port, addr_flags)
+	if not ai then return nil, ext_ai end
+	local mh = msghdr(self, '_send_msghdr', buf, len)
+	mh.msg.msg_name = ai.addr
+	mh.msg.msg_namelen = ai.addrlen
+	local len, err = io(self, true, expires, IORING_OP_SENDMSG, self.s,
+		mh.msg, 1, 0, flags or 0)
+	mh.msg.msg_name = nil
+	if not ext_ai then ai:free() end
+	if not len then return nil, err end
+	return len
+end
+
+function udp:recvnext(buf, len, expires, flags)
+	assert(len > 0)
+	local mh = msghdr(self, '_recv_msghdr', buf, len)
+	local sa = self._recv_sa
+	if not sa then
+		sa = sockaddr_ct()
+		self._recv_sa = sa
+	end
+	mh.msg.msg_name = sa
+	mh.msg.msg_namelen = ffi.sizeof(sa)
+	local len, err = io(self, false, expires, IORING_OP_RECVMSG, self.s,
+		mh.msg, 1, 0, flags or 0)
+	if not len then return nil, err end
+	assert(mh.msg.msg_namelen <= ffi.sizeof(sa)) --not truncated
+	return len, sa
+end
+
+local CUR_POS = 0xffffffffffffffffULL --read/write at the file position.
+
+function M._file_async_write(f, buf, len, expires)
+	return io(f, true, expires, IORING_OP_WRITE, f.fd, buf, len, CUR_POS)
+end
+function M._file_async_read(f, buf, len, expires)
+	return io(f, false, expires, IORING_OP_READ, f.fd, buf, len, CUR_POS)
+end
+
+--there's no sendfile op in io_uring so we splice file->pipe->socket through
+--a per-socket pipe instead, which is what sendfile() does internally anyway.
+--splice ops always run on io_uring's worker threads which have all signals
+--blocked, so a peer closing the socket doesn't raise SIGPIPE in our process.
+local pipe_ct = ffi.typeof'int[2]'
+local O_CLOEXEC    = 0x80000
+local F_SETPIPE_SZ = 1031
+local PIPE_SIZE    = 1024 * 1024
+local SPLICE_F_MOVE = 1
+
+local function splice(self, expires, fd_in, off_in, fd_out, len)
+	return io(self, true, expires, IORING_OP_SPLICE,
+		fd_out, off_in, len, CUR_POS, SPLICE_F_MOVE, fd_in)
+end
+
+function tcp:_sendfile(fd, offset, len, expires)
+	local pipe = self._sendfile_pipe
+	if not pipe then
+		pipe = pipe_ct()
+		if C.sock_pipe2(pipe, O_CLOEXEC) ~= 0 then
+			return check()
+		end
+		--fails if over /proc/sys/fs/pipe-max-size, leaving the default 64K.
+		C.sock_fcntl(pipe[1], F_SETPIPE_SZ, PIPE_SIZE)
+		self._sendfile_pipe = pipe
+	end
+	local n, err = splice(self, expires, fd, offset, pipe[1], math.min(len, PIPE_SIZE))
+	if not n or n == 0 then
+		return n, err
+	end
+	local left = n
+	while left > 0 do
+		local m, err = splice(self, expires, pipe[0], CUR_POS, self.s, left)
+		if not m then
+			close_pipe(self) --drop whatever's left in it.
+			return nil, err
+		end
+		left = left - m
+	end
+	return n
+end
+
+function eventfd:_read(expires)
+	return io(self, false, expires, IORING_OP_READ, self.s, self._buf, 8, CUR_POS)
+end
+
+--NOTE: a ref like tsbuf[0] doesn't keep tsbuf alive, so both buffers must
+--be referenced from poll() or they get collected while still in use.
+local tsbuf = ffi.new'sock_timespec[1]'
+local argbuf = ffi.new'struct io_uring_getevents_arg[1]'
+local argsz = ffi.sizeof'struct io_uring_getevents_arg'
+argbuf[0].ts = ffi.cast(uintptr_ct, tsbuf)
+
+--[[local]] function poll()
+
+	local expires = math.min(
+		timers:next_expires() or 1/0,
+		recv_timers:next_expires() or 1/0) --sleep jobs
+	local timeout = math.max(0, expires - clock())
+
+	local flags = IORING_ENTER_GETEVENTS
+	if timeout < 0x7fffffff then
+		flags = flags + IORING_ENTER_EXT_ARG
+		local ts = tsbuf[0]
+		ts.tv_sec = math.floor(timeout)
+		ts.tv_nsec = (timeout - math.floor(timeout)) * 1e9
+	end
+
+	--submit all queued requests and wait for at least one completion.
+	local ret = enter(pending_sqes(), 1, flags, flags ~= IORING_ENTER_GETEVENTS and argbuf or nil, argsz)
+	if ret < 0 then
+		local err = ffi.errno()
+		if err ~= ETIME and err ~= EINTR and err ~= EBUSY then
+			return check()
+		end
+	end
+
+	--dispatch all completions that are available.
+	local head = cq_head[0]
+	local tail = cq_tail[0]
+	local n = 0
+	while head ~= tail do
+		local cqe = cqes[bit.band(head, cq_mask)]
+		local job_n = tonumber(cqe.user_data)
+		local res = cqe.res
+		head = (head + 1) % 2^32
+		cq_head[0] = head
+		if job_n ~= 0 then
+			complete(jobs[job_n], res)
+		end
+		n = n + 1
+	end
+
+	local t = clock()
+	timers:advance(t)
+	recv_timers:advance(t) --sleep jobs
+
+	return true, n
+end
+
+end --if ring
+
+end --if io_uring
+
 --kqueue ---------------------------------------------------------------------
 
 if OSX then
@@ -1659,10 +2539,12 @@ OPT = {
 get_opt = {
 	error              = get_str,
 	reuseaddr          = get_bool,
+	reuseport          = get_bool,
 }
 
 set_opt = {
 	reuseaddr          = set_bool,
+	reuseport          = set_bool,
 }
 
 elseif OSX then --TODO
@@ -1735,6 +2617,74 @@ function tcp:send(buf, sz, expires)
 	return true
 end
 
+--iovecs are cached per socket because only one thread can send at a time.
+local iovec_ct = ffi.typeof'struct iovec[?]'
+local IOV_MAX = 1024
+
+function tcp:sendv(t, expires)
+	local n = math.ceil(#t / 2)
+	local iov = self._iov
+	if not iov or self._iov_n < n then
+		iov = iovec_ct(n)
+		self._iov, self._iov_n = iov, n
+	end
+	local sz0 = 0
+	for i = 0, n-1 do
+		local buf = t[2*i+1]
+		local len = t[2*i+2] or #buf
+		iov[i].iov_base = type(buf) == 'string' and ffi.cast(pchar_t, buf) or buf
+		iov[i].iov_len = len
+		sz0 = sz0 + len
+	end
+	local i, sz = 0, 0 --first unsent buffer, bytes sent so far
+	while true do
+		while i < n and iov[i].iov_len == 0 do --skip empty buffers
+			i = i + 1
+		end
+		if i == n then
+			break
+		end
+		local len, err = self:_sendv(iov + i, math.min(n - i, IOV_MAX), expires)
+		if not len then --short write
+			return nil, err, sz
+		end
+		sz = sz + len
+		--skip fully-sent buffers and advance into the partially-sent one.
+		while i < n and len >= iov[i].iov_len do
+			len = len - iov[i].iov_len
+			i = i + 1
+		end
+		if len > 0 then
+			iov[i].iov_base = ffi.cast(pchar_t, iov[i].iov_base) + len
+			iov[i].iov_len = iov[i].iov_len - len
+		end
+	end
+	assert(sz == sz0)
+	return true
+end
+
+if Linux then
+
+function tcp:sendfile(f, offset, len, expires)
+	local fd = type(f) == 'table' and f.fd or f
+	offset = offset or 0
+	local sz = 0
+	while len > 0 do
+		local n, err = self:_sendfile(fd, offset, len, expires)
+		if not n then --short write
+			return nil, err, sz
+		elseif n == 0 then --file got truncated
+			return nil, 'eof', sz
+		end
+		offset = offset + n
+		len = len - n
+		sz  = sz  + n
+	end
+	return true
+end
+
+end
+
 function tcp:recvn(buf, sz, expires)
 	local buf0, sz0 = buf, sz
 	while sz > 0 do
@@ -1811,6 +2761,103 @@ glue.update(tcp, socket)
 glue.update(udp, socket)
 glue.update(raw, socket)
 
+--multi-loop -----------------------------------------------------------------
+
+--Each Lua state has its own event loop, so to use all the CPU cores we run
+--a loop per OS thread, each with its own listening socket bound to the same
+--address with the `reuseport` option, letting the kernel spread connections
+--between them. An eventfd is how a loop wakes up a thread in another loop.
+
+if Linux then
+
+local u64_ct = ffi.typeof'uint64_t[1]'
+local sigbuf = u64_ct()
+
+--wrap an eventfd created by another Lua state, in which case we don't own it.
+function M.eventfd(fd)
+	local owned = not fd
+	if not fd then
+		local err
+		fd, err = M._eventfd()
+		if not fd then return nil, err end
+	end
+	local ev = {s = fd, fd = fd, _buf = u64_ct(), _owned = owned,
+		__index = eventfd}
+	return setmetatable(ev, ev)
+end
+
+--wait until signaled, returning the sum of all the signals since last time.
+function eventfd:wait(expires)
+	if not self._registered then
+		local ok, err = M._register(self)
+		if not ok then return nil, err end
+		self._registered = true
+	end
+	local n, err = self:_read(expires)
+	if not n then return nil, err end
+	return tonumber(self._buf[0])
+end
+
+--can be called from any thread, no event loop needed.
+function eventfd:signal(n)
+	sigbuf[0] = n or 1
+	return check(C.write(self.fd, sigbuf, 8) == 8)
+end
+
+function eventfd:close()
+	if not self.s then return true end
+	M._unregister(self)
+	local s = self.s; self.s = nil
+	return not self._owned or check(C.close(s) == 0)
+end
+
+function eventfd:closed()
+	return not self.s
+end
+
+local workers = {}
+workers.__index = workers
+
+--run `func(i, ev, ...)` in sock.run() in `n` OS threads, each with its own
+--Lua state and event loop. `ev` is the worker's eventfd, signaled with
+--pool:signal(). func and args must be copiable (see thread.new()).
+function M.workers(n, func, ...)
+	local thread = require'thread'
+	local pool = setmetatable({}, workers)
+	for i = 1, n do
+		local ev = assert(M.eventfd())
+		local th = thread.new(function(func, i, fd, ...)
+			local sock = require'sock'
+			return sock.run(func, i, sock.eventfd(fd), ...)
+		end, func, i, ev.fd, ...)
+		pool[i] = {thread = th, ev = ev}
+	end
+	return pool
+end
+
+--signal worker `i` or all workers.
+function workers:signal(i, n)
+	if i then
+		return self[i].ev:signal(n)
+	end
+	for _,w in ipairs(self) do
+		assert(w.ev:signal(n))
+	end
+	return true
+end
+
+--wait for all workers to finish, returning the first return value of each.
+function workers:join()
+	local t = {}
+	for i,w in ipairs(self) do
+		t[i] = w.thread:join()
+		w.ev:close()
+	end
+	return t
+end
+
+end --if Linux
+
 --coroutine-based scheduler --------------------------------------------------
 
 M.save_thread_context    = glue.noop --stub
@@ -0,0 +1,179 @@
+--benchmark for the sock poll loop: ping-pong over N loopback connections.
+--usage: luajit sock_benchmark.lua [poll | echo | timers]
+local ffi = require'ffi'
+local sock = require'sock'
+local glue = require'glue'
+
+if ... == 'sock_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+io.stderr:setvbuf'no'
+
+local PORT = 18091 --incremented for each run to avoid TIME_WAIT collisions.
+local DURATION = 1 --seconds per run
+
+--run `active` client/server pairs for DURATION seconds. each client sends
+--`size` bytes which the server echoes back and calls pong(latency).
+local function pingpong(active, size, pong)
+	local t0, t1
+	PORT = PORT + 1
+	sock.run(function()
+		local ls = assert(sock.tcp())
+		assert(ls:listen('127.0.0.1', PORT))
+		sock.thread(function()
+			for i = 1, active do
+				local cs = assert(ls:accept())
+				sock.thread(function()
+					local buf = ffi.new('char[?]', size)
+					while true do
+						local n = cs:recv(buf, size)
+						if not n or n == 0 then break end
+						assert(cs:send(buf, n))
+					end
+					cs:close()
+				end)
+			end
+			ls:close()
+		end)
+		local clients = {}
+		for i = 1, active do
+			local s = assert(sock.tcp())
+			assert(s:connect('127.0.0.1', PORT))
+			clients[i] = s
+		end
+		t0 = sock.clock()
+		local stop_at = t0 + DURATION
+		local done = 0
+		for i = 1, active do
+			local s = clients[i]
+			sock.thread(function()
+				local buf = ffi.new('char[?]', size)
+				while true do
+					local t = sock.clock()
+					if t >= stop_at then break end
+					assert(s:send(buf, size))
+					assert(s:recvn(buf, size))
+					pong(sock.clock() - t)
+				end
+				s:close()
+				done = done + 1
+				if done == active then
+					t1 = sock.clock()
+				end
+			end)
+		end
+	end)
+	collectgarbage()
+	return t1 - t0
+end
+
+--events harvested per epoll_wait() call.
+local function bench_poll(active, maxevents)
+	sock.epoll_maxevents(maxevents)
+
+	local polls, events, pongs = 0, 0, 0
+	local poll = sock.poll
+	sock.poll = function()
+		local ok, n = poll()
+		if ok then
+			polls = polls + 1
+			events = events + n
+		end
+		return ok, n
+	end
+
+	local dt = pingpong(active, 1, function()
+		pongs = pongs + 1
+	end)
+
+	sock.poll = poll
+
+	print(string.format('%5d sockets, maxevents %5d: %10.0f events/s %10.0f pings/s %7.3f syscalls/event',
+		active, maxevents, events / dt, pongs / dt, polls / events))
+end
+
+--requests/s and latency percentiles of a small-message echo server.
+local function bench_echo(active, size)
+	local lat = {}
+	local dt = pingpong(active, size, function(t)
+		lat[#lat+1] = t
+	end)
+	table.sort(lat)
+	local function pct(p)
+		return lat[math.max(1, math.floor(#lat * p))] * 1e6
+	end
+	print(string.format('%-8s %5d sockets, %4d bytes: %10.0f req/s  p50 %8.1fus  p99 %8.1fus',
+		sock.backend, active, size, #lat / dt, pct(.5), pct(.99)))
+end
+
+--arm and cancel `n` timers, like `n` sockets with a timeout each whose
+--I/O completes in time, plus arm and fire, on the timer wheel vs a heap.
+local function bench_timers(n)
+	local heap = require'heap'
+	local objs = {}
+	for i = 1, n do
+		objs[i] = {}
+	end
+	local now = sock.clock()
+	local function expires(i)
+		return now + 1 + (i * 7919) % 30000 / 1000 --spread over 30s
+	end
+
+	local tw = sock.timerwheel('expires', glue.noop)
+	local t0 = os.clock()
+	for i = 1, n do tw:add(objs[i], expires(i)) end
+	local t1 = os.clock()
+	for i = 1, n do tw:remove(objs[i]) end
+	local t2 = os.clock()
+	for i = 1, n do tw:add(objs[i], expires(i)) end
+	tw:advance(now + 60)
+	local t3 = os.clock()
+	assert(tw:count() == 0)
+	print(string.format('timer wheel: %7.0f ns/arm %7.0f ns/cancel %7.0f ns/arm+fire',
+		(t1 - t0) / n * 1e9, (t2 - t1) / n * 1e9, (t3 - t2) / n * 1e9))
+
+	local h = heap.valueheap{
+		cmp = function(o1, o2) return o1.expires < o2.expires end,
+		index_key = 'index',
+	}
+	local t0 = os.clock()
+	for i = 1, n do objs[i].expires = expires(i); h:push(objs[i]) end
+	local t1 = os.clock()
+	for i = 1, n do h:remove(objs[i]) end
+	local t2 = os.clock()
+	for i = 1, n do objs[i].expires = expires(i); h:push(objs[i]) end
+	for i = 1, n do h:pop() end
+	local t3 = os.clock()
+	print(string.format('binary heap: %7.0f ns/arm %7.0f ns/cancel %7.0f ns/arm+fire',
+		(t1 - t0) / n * 1e9, (t2 - t1) / n * 1e9, (t3 - t2) / n * 1e9))
+end
+
+local what = arg[1]
+PORT = tonumber(arg[2]) or PORT
+
+if not what or what == 'timers' then
+	bench_timers(1e6)
+end
+
+if not what or what == 'poll' then
+	if sock.backend == 'epoll' then
+		for _,active in ipairs{1, 64, 1024} do
+			for _,maxevents in ipairs{1, 64, 1024} do
+				bench_poll(active, maxevents)
+			end
+		end
+	end
+end
+
+if what == 'echo' then
+	for _,active in ipairs{1, 64, 1024} do
+		bench_echo(active, 64)
+	end
+elseif not what then
+	--compare the backends, which can only be chosen at load time.
+	for _,backend in ipairs{'epoll', 'io_uring'} do
+		PORT = PORT + 100
+		os.execute(string.format('SOCK_BACKEND=%s %s %s echo %d',
+			backend, arg[-1], arg[0], PORT))
+	end
+end
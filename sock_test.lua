@@ -167,6 +167,185 @@ local function test_http()
 
 end
 
+local function test_timerwheel()
+	local TICK = 0.001
+	local eps = 1e-9
+	local now --fake clock
+	local fired = {}
+	local function fire(t)
+		assert(now >= t.when - eps, 'fired early')
+		assert(t.late_ok or now - t.when < TICK + eps, 'fired late')
+		assert(not fired[t], 'fired twice')
+		fired[t] = true
+	end
+
+	--drive the wheel from one due time to the next, like the poll loop does.
+	local function run(tw, until_t)
+		local last_t
+		while true do
+			local t = tw:next_expires()
+			if not t or (until_t and t > until_t) then break end
+			assert(t ~= last_t, 'advancing to next_expires() made no progress')
+			now, last_t = t, t
+			tw:advance(now)
+		end
+	end
+
+	--timers at and around the level boundaries, and one beyond the range
+	--of the wheel (~50 days) which is parked and cascaded down later.
+	now = 0
+	local tw = sock.timerwheel('expires', fire, now)
+	local timers = {}
+	for _,ticks in ipairs{1, 2, 255, 256, 257, 511, 512,
+		65535, 65536, 65537, 65536 * 3 + 7,
+		256^3 - 1, 256^3, 256^3 + 1,
+		256^4 - 1, 256^4, 256^4 + 12345, 256^4 * 3,
+	} do
+		for _,d in ipairs{-0.5, 0} do
+			local t = {when = (ticks + d) * TICK}
+			tw:add(t, t.when)
+			timers[#timers+1] = t
+		end
+	end
+	assert(tw:count() == #timers)
+	run(tw)
+	assert(tw:count() == 0)
+	for _,t in ipairs(timers) do
+		assert(fired[t])
+		assert(t.expires == nil)
+	end
+
+	--random timers armed and cancelled while the clock moves.
+	math.randomseed(1)
+	now = 12345.6789
+	local tw = sock.timerwheel('expires', fire, now)
+	local live = {}
+	local cancelled = {}
+	local function add(dt)
+		local t = {when = now + dt}
+		tw:add(t, t.when)
+		live[#live+1] = t
+	end
+	for i = 1, 5000 do
+		add(10^(math.random() * 10 - 4)) --100us .. ~115 days
+	end
+	for round = 1, 200 do
+		for i = 1, 20 do
+			add(10^(math.random() * 8 - 4))
+		end
+		for i = 1, 10 do
+			local t = live[math.random(#live)]
+			if not fired[t] and not cancelled[t] then
+				assert(tw:remove(t))
+				assert(not tw:remove(t))
+				cancelled[t] = true
+			end
+		end
+		run(tw, now + 10^(math.random() * 6 - 3))
+	end
+	run(tw)
+	assert(tw:count() == 0)
+	for _,t in ipairs(live) do
+		assert(fired[t] or cancelled[t])
+		assert(not (fired[t] and cancelled[t]))
+	end
+
+	--arming while `now` is stale: the wheel was not advanced for a while
+	--(the loop was busy or blocked) and the clock moved past many slots.
+	now = 0
+	local tw = sock.timerwheel('expires', fire, now)
+	now = 5000
+	local t1 = {when = now + 0.0105}
+	--already expired: fires on the next advance.
+	local t2 = {when = now - 1, late_ok = true}
+	local t3 = {when = now + 300}
+	tw:add(t1, t1.when)
+	tw:add(t2, t2.when)
+	tw:add(t3, t3.when)
+	tw:advance(now + 0.01)
+	assert(fired[t2] and not fired[t1])
+	run(tw, now + 1)
+	assert(fired[t1] and not fired[t3])
+	run(tw)
+	assert(fired[t3])
+
+	--remove() is O(1): cancelling doesn't get slower with more timers
+	--(200x more timers only cost some cache misses).
+	local function cancel_time(n)
+		now = 0
+		local tw = sock.timerwheel('expires', fire, now)
+		local t = {}
+		for i = 1, n do
+			t[i] = {}
+			tw:add(t[i], math.random() * 1000)
+		end
+		local k = 1000
+		local t0 = sock.clock()
+		for i = 1, k do
+			tw:remove(t[i])
+		end
+		return (sock.clock() - t0) / k
+	end
+	cancel_time(1000) --warm up
+	local t_small = math.min(cancel_time(1000), cancel_time(1000))
+	local t_big = math.min(cancel_time(200000), cancel_time(200000))
+	assert(t_big < t_small * 10, 'cancel time grows with the number of timers')
+
+	print('timerwheel ok')
+end
+
+local function test_recv_timeout_busy()
+	--a recv with a timeout on an idle socket must time out on time while
+	--the loop is kept busy with I/O on other sockets.
+	local port = 18000 + math.random(0, 999)
+	local timeout = 0.2
+	local busy = true
+	local pingpongs = 0
+	local elapsed, ret, err
+	sock.run(function()
+		local server = assert(sock.tcp())
+		assert(server:listen('127.0.0.1', port))
+		sock.thread(function()
+			for i = 1, 2 do --the busy and the idle connection.
+				local cs = assert(server:accept())
+				sock.thread(function()
+					local buf = ffi.new'char[1]'
+					while (cs:recv(buf, 1) or 0) > 0 do
+						assert(cs:send(buf, 1))
+					end
+					cs:close()
+				end)
+			end
+			server:close()
+		end)
+		local busy_s = assert(sock.tcp())
+		assert(busy_s:connect('127.0.0.1', port))
+		sock.thread(function()
+			local buf = ffi.new'char[1]'
+			while busy do
+				assert(busy_s:send'x')
+				assert(busy_s:recv(buf, 1))
+				pingpongs = pingpongs + 1
+			end
+			busy_s:close()
+		end)
+		local idle_s = assert(sock.tcp())
+		assert(idle_s:connect('127.0.0.1', port))
+		local buf = ffi.new'char[1]'
+		local t0 = sock.clock()
+		ret, err = idle_s:recv(buf, 1, t0 + timeout)
+		elapsed = sock.clock() - t0
+		busy = false
+		idle_s:close()
+	end)
+	assert(ret == nil and err == 'timeout')
+	assert(pingpongs > 100, 'the loop was not busy')
+	assert(elapsed >= timeout, 'recv timed out early')
+	assert(elapsed < timeout + 0.1, 'recv timed out late')
+	print(string.format('recv timeout while busy ok: %.3fs, %d pingpongs',
+		elapsed, pingpongs))
+end
+
 local function test_timers()
 
 	sock.run(function()
@@ -184,6 +363,8 @@ local function test_timers()
 	os.exit()
 end
 
+test_timerwheel()
+test_recv_timeout_busy()
 test_timers()
 
 --test_addr()
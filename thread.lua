@@ -301,6 +301,110 @@ end
 
 M.shared_object('queue', queue)
 
+--lock-free queues -----------------------------------------------------------
+
+--bounded FIFO queues of fixed-size values (numbers, pointers, structs)
+--which are copied in and out of a ring buffer without taking any locks.
+--threads only sleep (on a futex) when the queue is empty or full.
+
+local C --mpmcq lib, loaded on first use.
+
+local function mpmcq_lib()
+	if C then return C end
+	ffi.cdef[[
+	typedef struct mpmcq mpmcq;
+	mpmcq*   mpmcq_new      (uint32_t capacity, uint32_t item_size);
+	void     mpmcq_free     (mpmcq* q);
+	int      mpmcq_push     (mpmcq* q, const void* item, double expires);
+	int      mpmcq_pop      (mpmcq* q, void* item, double expires);
+	uint32_t mpmcq_capacity (mpmcq* q);
+	uint32_t mpmcq_length   (mpmcq* q);
+	]]
+	C = ffi.load'mpmcq'
+	return C
+end
+
+local lfqueue = {}
+lfqueue.__index = lfqueue
+
+local function wrap_lfqueue(q, ctype)
+	local ct = ffi.typeof(ctype)
+	return setmetatable({
+		q = q,
+		ctype = ctype,
+		ct = ct,
+		buf = ffi.new(ffi.typeof('$[1]', ct)), --this state's transfer buffer
+	}, lfqueue)
+end
+
+function M.lfqueue(size, ctype)
+	assert(math.floor(size) == size and size >= 1, 'invalid queue size')
+	ctype = ctype or 'double'
+	assert(type(ctype) == 'string', 'ctype must be a string')
+	local C = mpmcq_lib()
+	local q = C.mpmcq_new(size, ffi.sizeof(ctype))
+	assert(q ~= nil, 'out of memory')
+	return wrap_lfqueue(q, ctype)
+end
+
+function lfqueue:free()
+	C.mpmcq_free(self.q)
+	self.q = nil
+end
+
+function lfqueue:maxlength()
+	return C.mpmcq_capacity(self.q)
+end
+
+--NOTE: the length is only a snapshot when other threads are using the queue.
+function lfqueue:length()
+	return C.mpmcq_length(self.q)
+end
+
+function lfqueue:isempty()
+	return self:length() == 0
+end
+
+function lfqueue:isfull()
+	return self:length() == self:maxlength()
+end
+
+function lfqueue:push(val, timeout)
+	self.buf[0] = val
+	if C.mpmcq_push(self.q, self.buf, timeout or -1) == 0 then
+		return false, 'timeout'
+	end
+	return true
+end
+
+function lfqueue:shift(timeout)
+	if C.mpmcq_pop(self.q, self.buf, timeout or -1) == 0 then
+		return false, 'timeout'
+	end
+	local val = self.buf[0]
+	if type(val) == 'cdata' then --a ref to buf for structs: copy it.
+		val = self.ct(val)
+	end
+	return true, val
+end
+
+--lock-free queues / shareable interface
+
+function lfqueue:identify()
+	return getmetatable(self) == lfqueue
+end
+
+function lfqueue:encode()
+	return {q_addr = addr(self.q), ctype = self.ctype}
+end
+
+function lfqueue.decode(t)
+	mpmcq_lib()
+	return wrap_lfqueue(ptr('mpmcq*', t.q_addr), t.ctype)
+end
+
+M.shared_object('lfqueue', lfqueue)
+
 --threads --------------------------------------------------------------------
 
 function M.init_state(state)
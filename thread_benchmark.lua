@@ -0,0 +1,49 @@
+--benchmark for thread queues: the mutex+condvar queue vs the lock-free queue.
+--usage: luajit thread_benchmark.lua [max_threads]
+local thread = require'thread'
+local time = require'time'
+
+if ... == 'thread_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local TOTAL = 2^18 --messages per run
+local QSIZE = 1024
+
+--move TOTAL numbers through `q` with `n` producer and `n` consumer threads.
+local function bench(name, q, n)
+	local per_thread = TOTAL / n
+	local start = thread.event() --so that thread creation is not timed.
+	local ths = {}
+	for i = 1, n do
+		ths[#ths+1] = thread.new(function(q, m, start)
+			start:wait()
+			for i = 1, m do
+				q:push(i)
+			end
+		end, q, per_thread, start)
+		ths[#ths+1] = thread.new(function(q, m, start)
+			start:wait()
+			for i = 1, m do
+				q:shift()
+			end
+		end, q, per_thread, start)
+	end
+	local t0 = time.clock()
+	start:set()
+	for i = 1, #ths do
+		ths[i]:join()
+	end
+	local dt = time.clock() - t0
+	q:free()
+	print(string.format('%-8s %3d producers %3d consumers: %10.0f ops/s',
+		name, n, n, TOTAL / dt))
+end
+
+local max_threads = tonumber((...)) or 32
+local n = 1
+while n <= max_threads do
+	bench('queue',   thread.queue(QSIZE), n)
+	bench('lfqueue', thread.lfqueue(QSIZE), n)
+	n = n * 2
+end
@@ -126,6 +126,53 @@ local function test_queue(qsize, pn, pm, cn, cm, msg)
 		pn, pm, cn, cm, qsize, (t1 - t0) * 1000))
 end
 
+--same for lock-free queues, with numbers; also checks that nothing is lost.
+local function test_lfqueue(qsize, pn, pm, cn, cm)
+
+	local q = thread.lfqueue(qsize)
+	local sums = thread.lfqueue(cn)
+
+	local pt = {}
+	for i = 1, pn do
+		pt[i] = thread.new(function(q, n)
+			for i = 1, n do
+				q:push(i)
+			end
+		end, q, pm)
+	end
+
+	local ct = {}
+	for i = 1, cn do
+		ct[i] = thread.new(function(q, n, sums)
+			local sum = 0
+			for i = 1, n do
+				local _, v = q:shift()
+				sum = sum + v
+			end
+			sums:push(sum)
+		end, q, cm, sums)
+	end
+
+	local t0 = time.clock()
+	for i = 1, #pt do pt[i]:join() end
+	for i = 1, #ct do ct[i]:join() end
+	local t1 = time.clock()
+
+	local sum = 0
+	for i = 1, cn do
+		local _, v = sums:shift()
+		sum = sum + v
+	end
+	assert(sum == pn * pm * (pm + 1) / 2)
+	assert(q:length() == 0)
+	assert(not q:shift(0))
+	q:free()
+	sums:free()
+
+	print(string.format('lfqueue test: %d*%d -> %d*%d, queue size: %d, time: %dms',
+		pn, pm, cn, cm, qsize, (t1 - t0) * 1000))
+end
+
 local function test_pool()
 	--local q = thread.queue(1)
 	--q:push('hi')
@@ -149,4 +196,9 @@ test_queue(1000,  1, 10000, 10,  1000)
 test_queue(1000, 10,  1000,  1, 10000)
 test_queue(1,     1, 10000, 10,  1000)
 test_queue(1,    10,  1000,  1, 10000)
+test_lfqueue(1000, 10,  1000, 10,  1000)
+test_lfqueue(1000,  1, 10000, 10,  1000)
+test_lfqueue(1000, 10,  1000,  1, 10000)
+test_lfqueue(1,     1, 10000, 10,  1000)
+test_lfqueue(1,    10,  1000,  1, 10000)
 --test_pool()
@@ -1502,29 +1502,6 @@ end
 
 --painting -------------------------------------------------------------------
 
---NOTE: clip_left and clip_right are relative to glyph run's origin.
-local function paint_glyph_run(cr, rs, run, i, j, ax, ay, clip_left, clip_right)
-	for i = i, j do
-
-		local glyph_index = run.info[i].codepoint
-		local px = i > 0 and run.pos[i-1].x_advance / 64 or 0
-		local ox = run.pos[i].x_offset / 64
-		local oy = run.pos[i].y_offset / 64
-
-		local glyph, bmpx, bmpy = rs:glyph(
-			run.font, run.font_size, glyph_index,
-			ax + px + ox,
-			ay - oy
-		)
-
-		--make clip_left and clip_right relative to bitmap's left edge.
-		clip_left = clip_left and clip_left + ax - bmpx
-		clip_right = clip_right and clip_right + ax - bmpx
-
-		rs:paint_glyph(cr, glyph, bmpx, bmpy, clip_left, clip_right)
-	end
-end
-
 function segments:paint(cr)
 	zone'paint'
 
@@ -1553,11 +1530,11 @@ function segments:paint(cr)
 						for i = 1, #seg, 5 do
 							local i, j, text_run, clip_left, clip_right = unpack(seg, i, i + 4)
 							rs:setcontext(cr, text_run)
-							paint_glyph_run(cr, rs, run, i, j, x, y, clip_left, clip_right)
+							rs:paint_glyph_run(cr, run, i, j, x, y, clip_left, clip_right)
 						end
 					else
 						rs:setcontext(cr, seg.text_run)
-						paint_glyph_run(cr, rs, run, 0, run.len-1, x, y)
+						rs:paint_glyph_run(cr, run, 0, run.len-1, x, y)
 					end
 
 				end
@@ -0,0 +1,212 @@
+
+--glyph atlas: shelf-packed bitmap pages with LRU page eviction.
+--Written by Cosmin Apreutesei. Public Domain.
+
+if not ... then require'tr0_demo'; return end
+
+local ffi = require'ffi'
+local glue = require'glue'
+local bitmap = require'bitmap'
+local lrucache = require'lrucache'
+
+local update = glue.update
+local max = math.max
+
+local atlas = {}
+setmetatable(atlas, atlas)
+
+atlas.max_size = 1024^2 * 10 --10MB of pages (arbitrary default)
+atlas.page_w = 512
+atlas.page_h = 512
+atlas.shelf_align = 4 --round up new shelf heights to make them reusable
+atlas.shelf_waste = 1.5 --max. shelf height / glyph height to reuse a shelf
+
+function atlas:__call(fields)
+	local self = update({}, self, fields)
+
+	self.entries = {} --{key -> entry}
+	self.format_pages = {} --{format -> {page1, ...}}
+	self.spare = {} --{format -> bitmap}: bitmap of the last evicted page
+	self.hits = 0
+	self.misses = 0
+	self.evictions = 0
+
+	local atlas = self
+	self.pages = lrucache{max_size = self.max_size}
+	function self.pages:value_size(page)
+		return page.bitmap.size
+	end
+	function self.pages:free_value(page)
+		atlas:_evict(page)
+	end
+
+	return self
+end
+
+function atlas:free()
+	if not self.pages then return end
+	self.pages:free()
+	self.pages = false
+	for format, bmp in pairs(self.spare) do
+		self:free_bitmap(bmp)
+	end
+	self.spare = false
+	self.entries = false
+end
+
+function atlas:free_bitmap(bmp) end --stub, eg. to free surfaces made on it
+function atlas:free_entry(e) end --stub, called when an entry is evicted
+
+--pages ----------------------------------------------------------------------
+
+function atlas:_new_page(format, w, h)
+	local bmp = self.spare[format]
+	if bmp and bmp.w == w and bmp.h == h then
+		self.spare[format] = nil
+	else
+		bmp = bitmap.new(w, h, format, false, true)
+	end
+	local page = {
+		format = format, w = w, h = h, bitmap = bmp,
+		shelves = {}, next_y = 0, used_area = 0, entries = {},
+	}
+	self.pages:put(page, page) --can evict other pages
+	local pages = self.format_pages[format]
+	if not pages then
+		pages = {}
+		self.format_pages[format] = pages
+	end
+	table.insert(pages, page)
+	return page
+end
+
+function atlas:_evict(page)
+	for _,e in ipairs(page.entries) do
+		self.entries[e.key] = nil
+		e.page = false --mark stale for users holding on to it
+		self:free_entry(e)
+	end
+	local pages = self.format_pages[page.format]
+	for i = 1, #pages do
+		if pages[i] == page then
+			table.remove(pages, i)
+			break
+		end
+	end
+	--keep one bitmap per format for reuse: pages of a format tend to be
+	--evicted to make room for a new page of the same format.
+	local old = self.spare[page.format]
+	if old then self:free_bitmap(old) end
+	self.spare[page.format] = page.bitmap
+	page.bitmap = false
+	self.evictions = self.evictions + 1
+end
+
+--shelf packing: rectangles are placed left-to-right on horizontal shelves
+--stacked top-to-bottom. A rectangle goes on the tightest shelf that fits it
+--(without wasting too much height) or on a new shelf.
+local function page_alloc(self, page, w, h)
+	if w > page.w then return end
+	local best
+	for _,shelf in ipairs(page.shelves) do
+		if shelf.h >= h and shelf.h <= h * self.shelf_waste + self.shelf_align
+			and page.w - shelf.x >= w
+			and (not best or shelf.h < best.h)
+		then
+			best = shelf
+		end
+	end
+	if not best then
+		local a = self.shelf_align
+		local sh = math.ceil(h / a) * a
+		if page.h - page.next_y < sh then
+			if page.h - page.next_y < h then return end
+			sh = page.h - page.next_y
+		end
+		best = {x = 0, y = page.next_y, h = sh}
+		page.next_y = page.next_y + sh
+		table.insert(page.shelves, best)
+	end
+	local x, y = best.x, best.y
+	best.x = best.x + w
+	page.used_area = page.used_area + w * h
+	return x, y
+end
+
+--entries --------------------------------------------------------------------
+
+--get an entry and mark its page as recently used.
+function atlas:get(key)
+	local e = self.entries[key]
+	if not e then
+		self.misses = self.misses + 1
+		return nil
+	end
+	self.hits = self.hits + 1
+	if self.pages.lru.first ~= e.page then
+		self.pages:get(e.page)
+	end
+	return e
+end
+
+--allocate a w x h rectangle for a new entry. The caller must then fill the
+--rectangle at e.x, e.y in e.page.bitmap. Entries bigger than a page get
+--a page of their own.
+function atlas:put(key, w, h, format)
+	assert(not self.entries[key])
+	local x, y, page
+	local pages = self.format_pages[format]
+	if pages then
+		for i = #pages, 1, -1 do --newest pages first: older ones are fuller
+			x, y = page_alloc(self, pages[i], w, h)
+			if x then
+				page = pages[i]
+				self.pages:get(page)
+				break
+			end
+		end
+	end
+	if not page then
+		page = self:_new_page(format, max(w, self.page_w), max(h, self.page_h))
+		x, y = page_alloc(self, page, w, h)
+	end
+	local e = {key = key, page = page, x = x, y = y, w = w, h = h}
+	table.insert(page.entries, e)
+	self.entries[key] = e
+	return e
+end
+
+--copy pixels into an entry's rectangle (only g8 and 32bpp formats).
+function atlas:fill(e, data, stride)
+	local bmp = e.page.bitmap
+	local bpp = bmp.format == 'g8' and 1 or 4
+	local dst = ffi.cast('uint8_t*', bmp.data) + e.y * bmp.stride + e.x * bpp
+	local src = ffi.cast('const uint8_t*', data)
+	local row_size = e.w * bpp
+	for i = 0, e.h-1 do
+		ffi.copy(dst + i * bmp.stride, src + i * stride, row_size)
+	end
+end
+
+--stats ----------------------------------------------------------------------
+
+function atlas:stats()
+	local page_count, area, used_area = 0, 0, 0
+	for page in pairs(self.pages.keys) do
+		page_count = page_count + 1
+		area = area + page.w * page.h
+		used_area = used_area + page.used_area
+	end
+	local lookups = self.hits + self.misses
+	return {
+		hits = self.hits,
+		misses = self.misses,
+		hit_rate = lookups > 0 and self.hits / lookups or 0,
+		pages = page_count,
+		size = self.pages.total_size,
+		occupancy = area > 0 and used_area / area or 0,
+		evictions = self.evictions,
+	}
+end
+
+return atlas
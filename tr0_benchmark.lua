@@ -0,0 +1,73 @@
+--benchmark for tr0's glyph rasterizer: ms/frame of painting a page of
+--shaped text with the per-glyph lru cache vs the glyph atlas, painting
+--glyph runs glyph-by-glyph or batched, and the atlas stats.
+--usage: luajit tr0_benchmark.lua [frames] [font_size]
+local tr0 = require'tr0'
+local glue = require'glue'
+local bitmap = require'bitmap'
+local cairo = require'cairo'
+local time = require'time'
+
+if ... == 'tr0_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local frames = tonumber((...)) or 20
+local font_size = tonumber((select(2, ...))) or 14
+
+local text = ('Lorem ipsum dolor sit amet, consectetur adipiscing elit, '
+	..'sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. ')
+	:rep(40)
+
+local bmp = bitmap.new(1000, 1000, 'bgra8', false, true)
+local sr = cairo.image_surface(bmp)
+local cr = sr:context()
+
+local function bench(name, glyph_atlas, batch_glyph_runs)
+	local cairo_rs = require'tr0_raster_cairo'
+	cairo_rs.glyph_atlas = glyph_atlas
+	cairo_rs.batch_glyph_runs = batch_glyph_runs
+	local tr = tr0()
+	--NOTE: using add_mem_font() because add_font_file() needs bundle.mmap().
+	local data = glue.readfile'OpenSans-Regular.ttf'
+	tr:add_mem_font(data, #data, 'open sans')
+	local segs = tr:shape(tr:flatten{
+		font_name = 'open sans,'..font_size, color = '#000', {text}})
+	local rs = tr.rs
+
+	--paint the glyph runs directly, wrapping words at the bitmap's width.
+	local function paint()
+		cr:rgb(1, 1, 1)
+		cr:paint()
+		local x, y = 10.3, font_size * 1.5
+		for _,seg in ipairs(segs) do
+			local run = seg.glyph_run
+			if x + run.advance_x > 990 then
+				x = 10.3
+				y = y + font_size * 1.4
+			end
+			rs:setcontext(cr, seg.text_run)
+			rs:paint_glyph_run(cr, run, 0, run.len-1, x, y)
+			x = x + run.advance_x
+		end
+	end
+
+	paint() --warm up the cache
+	local t0 = time.clock()
+	for i = 1, frames do
+		paint()
+	end
+	local dt = (time.clock() - t0) / frames
+	print(string.format('%-24s %8.2f ms/frame', name, dt * 1000))
+	if rs.atlas then
+		local s = rs.atlas:stats()
+		print(string.format('%-24s hit rate: %.2f%%, pages: %d, '
+			..'occupancy: %.1f%%, evictions: %d',
+			'', s.hit_rate * 100, s.pages, s.occupancy * 100, s.evictions))
+	end
+	tr:free()
+end
+
+bench('lru cache',               false, false)
+bench('atlas, glyph-by-glyph',   true,  false)
+bench('atlas, batched runs',     true,  true)
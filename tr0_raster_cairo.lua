@@ -4,18 +4,22 @@
 
 if not ... then require'tr0_demo'; return end
 
+local bit = require'bit'
 local ffi = require'ffi'
 local glue = require'glue'
 local box2d = require'box2d'
 local color = require'color'
 local ft = require'freetype'
 local cairo = require'cairo'
+local bitmap = require'bitmap'
 local rs_ft = require'tr0_raster_ft'
 local zone = require'jit.zone' --glue.noop
 
 local update = glue.update
 local memoize = glue.memoize
 local box_fit = box2d.fit
+local min, max, floor, ceil = math.min, math.max, math.floor, math.ceil
+local rshift = bit.rshift
 
 local cairo_rs = update({}, rs_ft)
 setmetatable(cairo_rs, cairo_rs)
@@ -55,6 +59,8 @@ function cairo_rs:rasterize_glyph(
 
 		local w = glyph.bitmap.width
 		local h = glyph.bitmap.rows
+		glyph.w = w
+		glyph.h = h
 
 		glyph.surface = cairo.image_surface{
 			data = glyph.bitmap.buffer,
@@ -82,6 +88,8 @@ function cairo_rs:rasterize_glyph(
 				cr:free()
 				sr0:free()
 				glyph.surface = sr1
+				glyph.w = sr1:width()
+				glyph.h = sr1:height()
 			end
 		end
 
@@ -101,6 +109,45 @@ function cairo_rs:rasterize_glyph(
 	return glyph
 end
 
+--atlas mode: pages get a cairo surface and entries a sub-surface of it.
+
+function cairo_rs:glyph_pixels(glyph) --scaled glyphs have their own surface
+	local sr = glyph.surface
+	sr:flush()
+	return sr:data(), sr:stride(), glyph.w, glyph.h, glyph.bitmap_format
+end
+
+cairo_rs.atlas_glyph_ft = rs_ft.atlas_glyph
+
+function cairo_rs:atlas_glyph(...)
+	local e = self:atlas_glyph_ft(...)
+	if not e.page then return e end --empty glyph
+	local bmp = e.page.bitmap
+	if not bmp.surface then
+		bmp.surface = cairo.image_surface(bmp)
+	else
+		bmp.surface:mark_dirty(e.x, e.y, e.w, e.h)
+	end
+	e.surface = bmp.surface:sub(e.x, e.y, e.w, e.h)
+	e.paint = e.bitmap_format == 'g8'
+		and self.paint_g8_glyph
+		or self.paint_bgra8_glyph
+	return e
+end
+
+function cairo_rs:free_atlas_glyph(e)
+	rs_ft.free_atlas_glyph(self, e)
+	e.surface:free()
+	e.surface = false
+end
+
+function cairo_rs:free_atlas_bitmap(bmp)
+	if bmp.surface then
+		bmp.surface:free()
+		bmp.surface = false
+	end
+end
+
 cairo_rs.color = '#888' --safe default not knowing the bg color
 cairo_rs.opacity = 1
 cairo_rs.operator = 'over'
@@ -108,8 +155,12 @@ cairo_rs.operator = 'over'
 function cairo_rs:setcontext(cr, text_run)
 	local r, g, b, a = self.rgba(text_run.color or self.color)
 	a = a * (text_run.opacity or self.opacity)
+	local operator = text_run.operator or self.operator
 	cr:rgba(r, g, b, a)
-	cr:operator(text_run.operator or self.operator)
+	cr:operator(operator)
+	--painting the union of glyph masks once is the same as painting each mask
+	--in turn only with an opaque source and the 'over' operator.
+	self.opaque_over = a >= 1 and operator == 'over'
 end
 
 --NOTE: clip_left and clip_right are relative to bitmap's left edge.
@@ -120,8 +171,8 @@ function cairo_rs:paint_glyph(cr, glyph, x, y, clip_left, clip_right)
 		cr:save()
 		cr:new_path()
 		local x1 = x + (clip_left or 0)
-		local x2 = x + glyph.bitmap.width + (clip_right or 0)
-		cr:rectangle(x1, y, x2 - x1, glyph.bitmap.rows)
+		local x2 = x + (clip_right or glyph.w)
+		cr:rectangle(x1, y, x2 - x1, glyph.h)
 		cr:clip()
 		paint(self, cr, glyph, x, y)
 		cr:restore()
@@ -140,4 +191,152 @@ function cairo_rs:paint_bgra8_glyph(cr, glyph, x, y)
 	cr:rgb(0, 0, 0) --clear source
 end
 
+--batched painting of glyph runs: in atlas mode, the g8 glyphs of a run are
+--composited into a scratch mask which is then painted with a single mask()
+--call instead of one call per glyph.
+
+cairo_rs.batch_glyph_runs = true
+cairo_rs.batch_max_font_size = 24 --compositing big glyphs in Lua doesn't pay
+
+function cairo_rs:batch_mask(w, h) --scratch mask, cleared after each use.
+	local bmp = self.batch_bitmap
+	if not bmp or bmp.w < w or bmp.h < h then
+		if bmp then
+			bmp.surface:free()
+		end
+		w = glue.nextpow2(max(w, bmp and bmp.w or 256))
+		h = glue.nextpow2(max(h, bmp and bmp.h or 64))
+		bmp = bitmap.new(w, h, 'g8', false, true)
+		ffi.fill(bmp.data, bmp.size)
+		bmp.surface = cairo.image_surface(bmp)
+		self.batch_bitmap = bmp
+	end
+	return bmp
+end
+
+--composite a glyph's mask into dst at (dx, dy). The first blend_w columns
+--overlap previous glyphs and are blended with the screen operator
+--(a + b - a * b), which is what painting the two masks in turn amounts to.
+--The rest of the columns are still blank so they are just copied.
+local function composite(dst, dst_stride, dx, dy, e, sx, w, h, blend_w)
+	local page = e.page.bitmap
+	local src_stride = page.stride
+	local src = ffi.cast('uint8_t*', page.data) + e.y * src_stride + e.x + sx
+	local dst = dst + dy * dst_stride + dx
+	for y = 0, h-1 do
+		for x = 0, blend_w-1 do
+			local b = src[x]
+			if b ~= 0 then
+				local a = dst[x]
+				local t = a * b + 128
+				dst[x] = a + b - rshift(t + rshift(t, 8), 8)
+			end
+		end
+		if blend_w < w then
+			ffi.copy(dst + blend_w, src + blend_w, w - blend_w)
+		end
+		src = src + src_stride
+		dst = dst + dst_stride
+	end
+end
+
+--NOTE: clip_left and clip_right are relative to glyph run's origin.
+function cairo_rs:paint_glyph_run(cr, run, i, j, ax, ay, clip_left, clip_right)
+	if not (self.glyph_atlas and self.batch_glyph_runs and self.opaque_over)
+		or i == j or run.font_size > self.batch_max_font_size
+	then
+		return rs_ft.paint_glyph_run(self, cr, run, i, j, ax, ay,
+			clip_left, clip_right)
+	end
+	zone'paint_glyph_run'
+
+	--find the g8 glyphs and their bounding box, clipped.
+	local cx1 = clip_left  and ax + clip_left  or -1/0
+	local cx2 = clip_right and ax + clip_right or  1/0
+	local t = self.batch_glyphs
+	if not t then
+		t = {}
+		self.batch_glyphs = t
+	end
+	local n = 0
+	local x1, y1, x2, y2 = 1/0, 1/0, -1/0, -1/0
+	local color_glyphs
+	for i = i, j do
+		local glyph, x, y = self:glyph_run_glyph(run, i, ax, ay)
+		if glyph.bitmap_format == 'g8' then
+			if x < cx2 and x + glyph.w > cx1 then
+				t[n+1], t[n+2], t[n+3], t[n+4] = glyph, x, y, i
+				n = n + 4
+				x1 = min(x1, x)
+				y1 = min(y1, y)
+				x2 = max(x2, x + glyph.w)
+				y2 = max(y2, y + glyph.h)
+			end
+		elseif glyph.paint then
+			color_glyphs = true
+		end
+	end
+	x1 = max(x1, floor(cx1))
+	x2 = min(x2, ceil(cx2))
+
+	if n == 4 then --single glyph: paint it directly.
+		local glyph, x, y, gi = t[1], t[2], t[3], t[4]
+		if not glyph.page then --evicted by a later glyph of the run
+			glyph, x, y = self:glyph_run_glyph(run, gi, ax, ay)
+		end
+		self:paint_glyph(cr, glyph, x, y,
+			clip_left and clip_left + ax - x,
+			clip_right and clip_right + ax - x)
+	elseif n > 0 and x2 > x1 then
+		local w, h = x2 - x1, y2 - y1
+		local bmp = self:batch_mask(w, h)
+		local data = ffi.cast('uint8_t*', bmp.data)
+		local stride = bmp.stride
+		local right = x1 --columns right of this are still blank
+		for k = 1, n, 4 do
+			local e, x, y = t[k], t[k+1], t[k+2]
+			if not e.page then --evicted by a later glyph of the run
+				e, x, y = self:glyph_run_glyph(run, t[k+3], ax, ay)
+			end
+			local gx1 = max(x, x1)
+			local gx2 = min(x + e.w, x2)
+			if gx2 > gx1 then
+				local blend_w = max(0, min(right, gx2) - gx1)
+				composite(data, stride, gx1 - x1, y - y1,
+					e, gx1 - x, gx2 - gx1, e.h, blend_w)
+				right = max(right, gx2)
+			end
+		end
+		bmp.surface:mark_dirty(0, 0, w, h)
+		cr:save()
+		cr:new_path()
+		local rx1 = max(x1, cx1)
+		local rx2 = min(x2, cx2)
+		cr:rectangle(rx1, y1, rx2 - rx1, h)
+		cr:clip()
+		cr:mask(bmp.surface, x1, y1)
+		cr:restore()
+		bmp.surface:flush()
+		for y = 0, h-1 do
+			ffi.fill(data + y * stride, w)
+		end
+	end
+	for k = 1, n do
+		t[k] = false --release glyph refs
+	end
+
+	if color_glyphs then
+		for i = i, j do
+			local glyph, x, y = self:glyph_run_glyph(run, i, ax, ay)
+			if glyph.paint and glyph.bitmap_format ~= 'g8' then
+				self:paint_glyph(cr, glyph, x, y,
+					clip_left and clip_left + ax - x,
+					clip_right and clip_right + ax - x)
+			end
+		end
+	end
+
+	zone()
+end
+
 return cairo_rs
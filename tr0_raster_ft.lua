@@ -8,6 +8,7 @@ local bit = require'bit'
 local ffi = require'ffi'
 local glue = require'glue'
 local lrucache = require'lrucache'
+local atlas = require'tr0_atlas'
 local ft = require'freetype'
 local font_db = require'font_db'
 local zone = require'jit.zone' --glue.noop
@@ -32,6 +33,8 @@ rs.glyph_cache_size = 1024^2 * 10 --10MB net (arbitrary default)
 rs.font_size_resolution = 1/8 --in pixels
 rs.subpixel_x_resolution = 1/16 --1/64 pixels is max with freetype
 rs.subpixel_y_resolution = 1 --no subpixel positioning with vertical hinting
+rs.glyph_atlas = false --pack glyph bitmaps into shared atlas pages
+rs.atlas_page_size = 512 --in pixels
 
 function rs:__call()
 	local self = update({}, self)
@@ -59,6 +62,11 @@ function rs:free()
 	self.glyphs:free()
 	self.glyphs = false
 
+	if self.atlas then
+		self.atlas:free()
+		self.atlas = false
+	end
+
 	self.freetype:free()
 	self.freetype = false
 
@@ -317,6 +325,61 @@ function rs:rasterize_glyph(font, font_size, glyph_index, offset_x, offset_y)
 	return glyph
 end
 
+--atlas mode: the glyph's pixels are copied into an atlas page and the
+--rasterized glyph is freed. atlas entries have the same fields as glyphs.
+
+function rs:create_atlas()
+	local rs = self
+	self.atlas = atlas{
+		max_size = self.glyph_cache_size,
+		page_w = self.atlas_page_size,
+		page_h = self.atlas_page_size,
+	}
+	function self.atlas:free_entry(e)
+		rs:free_atlas_glyph(e)
+	end
+	function self.atlas:free_bitmap(bmp)
+		rs:free_atlas_bitmap(bmp)
+	end
+	--empty glyphs don't take atlas space. weak keys because the keys are
+	--tuples of the font which go away when the font is unloaded.
+	self.empty_glyphs = setmetatable({}, {__mode = 'k'})
+	return self.atlas
+end
+
+function rs:glyph_pixels(glyph) --data, stride, w, h, format
+	local bmp = glyph.bitmap
+	return bmp.buffer, bmp.pitch, bmp.width, bmp.rows, glyph.bitmap_format
+end
+
+function rs:atlas_glyph(glyph_key, font, font_size, glyph_index, offset_x, offset_y)
+	local glyph = self:rasterize_glyph(
+		font, font_size, glyph_index,
+		offset_x, offset_y
+	)
+	if not glyph.bitmap then
+		self.empty_glyphs[glyph_key] = true
+		return glyph
+	end
+	local data, stride, w, h, format = self:glyph_pixels(glyph)
+	local e = self.atlas:put(glyph_key, w, h, format)
+	self.atlas:fill(e, data, stride)
+	e.bitmap_left = glyph.bitmap_left
+	e.bitmap_top = glyph.bitmap_top
+	e.bitmap_format = format
+	font:ref()
+	e.font = font
+	glyph:free()
+	return e
+end
+
+function rs:free_atlas_glyph(e)
+	e.font:unref()
+	e.font = false
+end
+
+function rs:free_atlas_bitmap(bmp) end --stub
+
 function rs:glyph(font, font_size, glyph_index, x, y)
 	if glyph_index == 0 then --freetype code for "missing glyph"
 		return empty_glyph, x, y
@@ -328,13 +391,24 @@ function rs:glyph(font, font_size, glyph_index, x, y)
 	local offset_x = snap(x - pixel_x, self.subpixel_x_resolution)
 	local offset_y = snap(y - pixel_y, self.subpixel_y_resolution)
 	local glyph_key = font.tuple(font_size, glyph_index, offset_x, offset_y)
-	local glyph = self.glyphs:get(glyph_key)
-	if not glyph then
-		glyph = self:rasterize_glyph(
-			font, font_size, glyph_index,
-			offset_x, offset_y
-		)
-		self.glyphs:put(glyph_key, glyph)
+	local glyph
+	if self.glyph_atlas then
+		local atlas = self.atlas or self:create_atlas()
+		glyph = self.empty_glyphs[glyph_key] and empty_glyph
+			or atlas:get(glyph_key)
+			or self:atlas_glyph(glyph_key,
+				font, font_size, glyph_index,
+				offset_x, offset_y
+			)
+	else
+		glyph = self.glyphs:get(glyph_key)
+		if not glyph then
+			glyph = self:rasterize_glyph(
+				font, font_size, glyph_index,
+				offset_x, offset_y
+			)
+			self.glyphs:put(glyph_key, glyph)
+		end
 	end
 	local x = pixel_x + glyph.bitmap_left
 	local y = pixel_y - glyph.bitmap_top
@@ -342,6 +416,30 @@ function rs:glyph(font, font_size, glyph_index, x, y)
 	return glyph, x, y
 end
 
+--glyph i of a shaped glyph run with the origin at (ax, ay).
+function rs:glyph_run_glyph(run, i, ax, ay)
+	local glyph_index = run.info[i].codepoint
+	local px = i > 0 and run.pos[i-1].x_advance / 64 or 0
+	local ox = run.pos[i].x_offset / 64
+	local oy = run.pos[i].y_offset / 64
+	return self:glyph(
+		run.font, run.font_size, glyph_index,
+		ax + px + ox,
+		ay - oy
+	)
+end
+
+--NOTE: clip_left and clip_right are relative to glyph run's origin.
+function rs:paint_glyph_run(cr, run, i, j, ax, ay, clip_left, clip_right)
+	for i = i, j do
+		local glyph, bmpx, bmpy = self:glyph_run_glyph(run, i, ax, ay)
+		--make clip_left and clip_right relative to bitmap's left edge.
+		self:paint_glyph(cr, glyph, bmpx, bmpy,
+			clip_left and clip_left + ax - bmpx,
+			clip_right and clip_right + ax - bmpx)
+	end
+end
+
 --glyph measuring ------------------------------------------------------------
 
 local empty_glyph_metrics = {
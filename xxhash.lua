@@ -18,7 +18,10 @@ uint32_t      XXH32 (const void* input, size_t length, uint32_t seed);
 uint64_t      XXH64 (const void* input, size_t length, uint64_t seed);
 XXH128_hash_t XXH128(const void* input, size_t length, uint64_t seed);
 
+uint64_t      XXH3_64bits_withSeed  (const void* data, size_t len, uint64_t seed);
+uint64_t      XXH3_64bits_withSecret(const void* data, size_t len, const void* secret, size_t secretSize);
 XXH128_hash_t XXH3_128bits_withSecret(const void* data, size_t len, const void* secret, size_t secretSize);
+void XXH3_generateSecret(void* secretBuffer, const void* customSeed, size_t customSeedSize);
 
 typedef enum { XXH_OK=0, XXH_ERROR } XXH_errorcode;
 
@@ -33,13 +36,56 @@ XXH_errorcode XXH3_128bits_reset_withSecret(XXH3_state_t* statePtr, const void*
 
 XXH_errorcode XXH3_128bits_update (XXH3_state_t* statePtr, const void* input, size_t length);
 XXH128_hash_t XXH3_128bits_digest (const XXH3_state_t* statePtr);
+
+// same state as XXH3_state_t, typed differently for a 64bit digest metatype.
+typedef struct XXH3_state64_s XXH3_state64_t;
+XXH3_state64_t* XXH3_createState64(void) asm("XXH3_createState");
+XXH_errorcode XXH3_freeState64(XXH3_state64_t* statePtr) asm("XXH3_freeState");
+XXH_errorcode XXH3_64bits_reset_withSeed(XXH3_state64_t* statePtr, uint64_t seed);
+XXH_errorcode XXH3_64bits_reset_withSecret(XXH3_state64_t* statePtr, const void* secret, size_t secretSize);
+XXH_errorcode XXH3_64bits_update (XXH3_state64_t* statePtr, const void* input, size_t length);
+uint64_t      XXH3_64bits_digest (const XXH3_state64_t* statePtr);
+
+// xxhash_batch.h
+void   XXH3_64bits_batch  (const void* const* bufs, const size_t* lens, size_t n, uint64_t seed, uint64_t* hashes);
+void   XXH3_128bits_batch (const void* const* bufs, const size_t* lens, size_t n, uint64_t seed, XXH128_hash_t* hashes);
+size_t XXH3_64bits_blocks (const void* data, size_t len, size_t blockSize, uint64_t seed, uint64_t* hashes);
+size_t XXH3_128bits_blocks(const void* data, size_t len, size_t blockSize, uint64_t seed, XXH128_hash_t* hashes);
 ]]
 
 M.version = C.XXH_versionNumber
 
 function M.hash32 (data, sz, seed) return C.XXH32 (data, sz or #data, seed or 0) end
 function M.hash64 (data, sz, seed) return C.XXH64 (data, sz or #data, seed or 0) end
-function M.hash128(data, sz, seed) return C.XXH128(data, sz or #data, seed or 0) end
+
+--XXH3 hashes take either a numeric seed or a secret string of at least
+--136 bytes (see xxhash.secret()). shorter secrets are rejected because the
+--one-shot functions don't check the size and would read past the end.
+local SECRET_SIZE_MIN = 136
+
+function M.hash3(data, sz, seed)
+	if type(seed) == 'string' then
+		assert(#seed >= SECRET_SIZE_MIN, 'secret too short')
+		return C.XXH3_64bits_withSecret(data, sz or #data, seed, #seed)
+	end
+	return C.XXH3_64bits_withSeed(data, sz or #data, seed or 0)
+end
+
+function M.hash128(data, sz, seed)
+	if type(seed) == 'string' then
+		assert(#seed >= SECRET_SIZE_MIN, 'secret too short')
+		return C.XXH3_128bits_withSecret(data, sz or #data, seed, #seed)
+	end
+	return C.XXH128(data, sz or #data, seed or 0)
+end
+
+local secret_buf
+
+function M.secret(seed, sz)
+	secret_buf = secret_buf or ffi.new'uint8_t[192]'
+	C.XXH3_generateSecret(secret_buf, seed, sz or #seed)
+	return ffi.string(secret_buf, 192)
+end
 
 local h = {}
 
@@ -58,16 +104,27 @@ end
 
 ffi.metatype('XXH128_hash_t', {__index = h})
 
+--the state only keeps a pointer to the secret so we must anchor it.
+local secrets = setmetatable({}, {__mode = 'k'})
+
 local st = {}
 local st_meta = {__index = st}
 
 function st:free()
+	secrets[self] = nil
 	assert(C.XXH3_freeState(self) == 0)
 end
 st_meta.__gc = st.free
 
 function st:reset(seed)
-	assert(C.XXH3_128bits_reset_withSeed(self, seed or 0) == 0)
+	if type(seed) == 'string' then
+		assert(#seed >= SECRET_SIZE_MIN, 'secret too short')
+		secrets[self] = seed
+		assert(C.XXH3_128bits_reset_withSecret(self, seed, #seed) == 0)
+	else
+		secrets[self] = nil
+		assert(C.XXH3_128bits_reset_withSeed(self, seed or 0) == 0)
+	end
 	return self
 end
 
@@ -88,12 +145,133 @@ end
 
 ffi.metatype('XXH3_state_t', st_meta)
 
+local st64 = {}
+local st64_meta = {__index = st64}
+
+function st64:free()
+	secrets[self] = nil
+	assert(C.XXH3_freeState64(self) == 0)
+end
+st64_meta.__gc = st64.free
+
+function st64:reset(seed)
+	if type(seed) == 'string' then
+		assert(#seed >= SECRET_SIZE_MIN, 'secret too short')
+		secrets[self] = seed
+		assert(C.XXH3_64bits_reset_withSecret(self, seed, #seed) == 0)
+	else
+		secrets[self] = nil
+		assert(C.XXH3_64bits_reset_withSeed(self, seed or 0) == 0)
+	end
+	return self
+end
+
+function st64:update(s, len)
+	assert(C.XXH3_64bits_update(self, s, len or #s) == 0)
+	return self
+end
+
+function st64:digest()
+	return C.XXH3_64bits_digest(self)
+end
+
+function M.hash3_digest(seed)
+	local st = C.XXH3_createState64()
+	assert(st ~= nil)
+	return st:reset(seed)
+end
+
+ffi.metatype('XXH3_state64_t', st64_meta)
+
+--batch hashing: many buffers in one call.
+
+local u64_arr = ffi.typeof'uint64_t[?]'
+local h128_arr = ffi.typeof'XXH128_hash_t[?]'
+local ptr_arr = ffi.typeof'const void*[?]'
+local size_arr = ffi.typeof'size_t[?]'
+
+--hash the consecutive blocks of block_size bytes of a buffer.
+local function blocks(f, arr_ct)
+	return function(data, sz, block_size, seed, out)
+		sz = sz or #data
+		assert(block_size > 0, 'invalid block size')
+		local n = math.ceil(sz / block_size)
+		out = out or arr_ct(n)
+		return out, tonumber(f(data, sz, block_size, seed or 0, out))
+	end
+end
+M.hash3_blocks   = blocks(C.XXH3_64bits_blocks,  u64_arr)
+M.hash128_blocks = blocks(C.XXH3_128bits_blocks, h128_arr)
+
+--hash n independent buffers given as arrays of pointers and sizes or as
+--a list of strings.
+local function batch(f, arr_ct)
+	return function(bufs, lens, n, seed, out)
+		if type(bufs) == 'table' then
+			n = n or #bufs
+			local t = bufs
+			bufs = ptr_arr(n)
+			local tlens = lens
+			lens = size_arr(n)
+			for i = 1, n do
+				local s = t[i]
+				bufs[i-1] = s
+				lens[i-1] = tlens and tlens[i] or #s
+			end
+			--the strings are anchored by the caller's table.
+		end
+		out = out or arr_ct(n)
+		f(bufs, lens, n, seed or 0, out)
+		return out
+	end
+end
+M.hash3_batch   = batch(C.XXH3_64bits_batch,  u64_arr)
+M.hash128_batch = batch(C.XXH3_128bits_batch, h128_arr)
+
 if not ... then
 	local st = M.hash128_digest()
 	st:update('abcd')
 	st:update('1324')
 	assert(st:digest():bin() == M.hash128('abcd1324'):bin())
 	assert(st:digest():hex() == M.hash128('abcd1324'):hex())
+
+	local st = M.hash3_digest(42)
+	st:update('abcd')
+	st:update('1324')
+	assert(st:digest() == M.hash3('abcd1324', nil, 42))
+
+	local secret = M.secret('my seed')
+	local st = M.hash3_digest(secret)
+	st:update('abcd'):update('1324')
+	assert(st:digest() == M.hash3('abcd1324', nil, secret))
+	assert(st:digest() ~= M.hash3('abcd1324'))
+	local st = M.hash128_digest(secret)
+	st:update('abcd'):update('1324')
+	assert(st:digest():bin() == M.hash128('abcd1324', nil, secret):bin())
+
+	local s = ('abcdefghij'):rep(100)
+	local h, n = M.hash3_blocks(s, nil, 64, 7)
+	assert(n == 16)
+	for i = 0, n-1 do
+		assert(h[i] == M.hash3(s:sub(i * 64 + 1, i * 64 + 64), nil, 7))
+	end
+	local h, n = M.hash128_blocks(s, nil, 300)
+	assert(n == 4)
+	assert(h[3]:bin() == M.hash128(s:sub(901)):bin())
+	assert(not pcall(M.hash3, 'abcd', nil, ('x'):rep(135)))
+	assert(not pcall(M.hash128, 'abcd', nil, ('x'):rep(135)))
+	assert(not pcall(M.hash3_digest, ('x'):rep(135)))
+	assert(not pcall(M.hash128_digest, ('x'):rep(135)))
+	assert(M.hash3('abcd', nil, ('x'):rep(136)))
+	assert(not pcall(M.hash3_blocks, s, nil, 0))
+
+	local t = {'a', 'bb', s, ''}
+	local h = M.hash3_batch(t)
+	local h2 = M.hash128_batch(t)
+	for i = 1, #t do
+		assert(h[i-1] == M.hash3(t[i]))
+		assert(h2[i-1]:bin() == M.hash128(t[i]):bin())
+	end
 end
 
 return M
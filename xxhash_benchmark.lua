@@ -0,0 +1,132 @@
+--benchmark for xxhash: GB/s of hashing a large buffer one-shot and in
+--chunks with each hash function, and of hashing many small blocks one call
+--at a time vs in one batch call. If a file is given, it is also hashed
+--through a memory mapping.
+--usage: luajit xxhash_benchmark.lua [size_MB] [block_size] [file]
+local ffi = require'ffi'
+local time = require'time'
+local xxhash = require'xxhash'
+
+if ... == 'xxhash_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local size = (tonumber((...)) or 256) * 1024^2
+local block_size = tonumber((select(2, ...))) or 4096
+local file = select(3, ...)
+
+local buf = ffi.new('uint8_t[?]', size)
+math.randomseed(1234)
+for i = 0, size-1, 4 do
+	ffi.cast('uint32_t*', buf + i)[0] = math.random(0, 2^32-1)
+end
+local str = ffi.string(buf, size)
+
+local function bench(name, size, f)
+	f() --warm up
+	local reps = 0
+	local t0 = time.clock()
+	local dt
+	repeat
+		f()
+		reps = reps + 1
+		dt = time.clock() - t0
+	until dt > 0.5
+	print(string.format('%-32s %7.2f GB/s', name, size * reps / 1024^3 / dt))
+end
+
+print'one-shot:'
+bench('hash32',                 size, function() xxhash.hash32(buf, size) end)
+bench('hash64',                 size, function() xxhash.hash64(buf, size) end)
+bench('hash128',                size, function() xxhash.hash128(buf, size) end)
+bench('hash128 (lua string)',   size, function() xxhash.hash128(str) end)
+bench('hash3',                  size, function() xxhash.hash3(buf, size) end)
+bench('hash3 (seed)',           size, function() xxhash.hash3(buf, size, 42) end)
+local secret = xxhash.secret'benchmark'
+bench('hash3 (secret)',         size, function() xxhash.hash3(buf, size, secret) end)
+
+print'streaming in 1 MB chunks:'
+local chunk = 1024^2
+bench('hash128_digest', size, function()
+	local st = xxhash.hash128_digest()
+	for i = 0, size-1, chunk do
+		st:update(buf + i, chunk)
+	end
+	st:digest()
+end)
+bench('hash3_digest', size, function()
+	local st = xxhash.hash3_digest()
+	for i = 0, size-1, chunk do
+		st:update(buf + i, chunk)
+	end
+	st:digest()
+end)
+
+print(string.format('%d byte blocks:', block_size))
+local n = math.ceil(size / block_size)
+local out64 = ffi.new('uint64_t[?]', n)
+local out128 = ffi.new('XXH128_hash_t[?]', n)
+bench('hash3, one call per block', size, function()
+	for i = 0, n-1 do
+		local o = i * block_size
+		out64[i] = xxhash.hash3(buf + o, math.min(block_size, size - o))
+	end
+end)
+bench('hash3_blocks', size, function()
+	xxhash.hash3_blocks(buf, size, block_size, 0, out64)
+end)
+bench('hash128, one call per block', size, function()
+	for i = 0, n-1 do
+		local o = i * block_size
+		out128[i] = xxhash.hash128(buf + o, math.min(block_size, size - o))
+	end
+end)
+bench('hash128_blocks', size, function()
+	xxhash.hash128_blocks(buf, size, block_size, 0, out128)
+end)
+
+--small independent buffers, eg. keys of a hash table.
+local bufs = ffi.new('const void*[?]', n)
+local lens = ffi.new('size_t[?]', n)
+local small_size = 0
+for i = 0, n-1 do
+	bufs[i] = buf + i * block_size
+	lens[i] = math.random(8, 64)
+	small_size = small_size + tonumber(lens[i])
+end
+print(string.format('%d buffers of 8..64 bytes:', n))
+bench('hash3, one call per buffer', small_size, function()
+	for i = 0, n-1 do
+		out64[i] = xxhash.hash3(bufs[i], lens[i])
+	end
+end)
+bench('hash3_batch', small_size, function()
+	xxhash.hash3_batch(bufs, lens, n, 0, out64)
+end)
+
+--NOTE: mapping the file with mmap() directly because fs.map() is unfinished.
+if file then
+	assert(ffi.os ~= 'Windows', 'mmapped file hashing is not implemented on Windows')
+	ffi.cdef[[
+	int open(const char *pathname, int flags, ...);
+	int close(int fd);
+	void *mmap(void *addr, size_t length, int prot, int flags, int fd, int64_t offset);
+	int munmap(void *addr, size_t length);
+	]]
+	local f = assert(io.open(file, 'rb'))
+	local fsize = f:seek'end'
+	f:close()
+	local fd = ffi.C.open(file, 0) --O_RDONLY
+	assert(fd >= 0)
+	local addr = ffi.C.mmap(nil, fsize, 1, 2, fd, 0) --PROT_READ, MAP_PRIVATE
+	assert(ffi.cast('intptr_t', addr) ~= -1)
+	print(string.format('mmapped file (%.1f MB):', fsize / 1024^2))
+	bench('hash3', fsize, function()
+		xxhash.hash3(addr, fsize)
+	end)
+	bench('hash3_blocks', fsize, function()
+		xxhash.hash3_blocks(addr, fsize, block_size)
+	end)
+	ffi.C.munmap(addr, fsize)
+	ffi.C.close(fd)
+end
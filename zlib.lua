@@ -44,9 +44,9 @@ local function format_windowBits(format, windowBits)
 	return windowBits
 end
 
-local function init_deflate(format, level, method, windowBits, memLevel, strategy)
+local function init_deflate(format, level, windowBits, memLevel, strategy)
 	level = level or C.Z_DEFAULT_COMPRESSION
-	method = method or C.Z_DEFLATED
+	local method = C.Z_DEFLATED
 	windowBits = format_windowBits(format, windowBits or C.Z_MAX_WBITS)
 	memLevel = memLevel or 8
 	strategy = strategy or C.Z_DEFAULT_STRATEGY
@@ -148,6 +148,78 @@ local inflate = inflate_deflate(init_inflate)
 --deflate(read, write[, bufsize][, format][, level][, windowBits][, memLevel][, strategy])
 local deflate = inflate_deflate(init_deflate)
 
+--parallel deflate: same output formats but compressed on multiple threads.
+
+local pformats = {deflate = 0, zlib = 1, gzip = 2}
+
+--pdeflate(read, write[, bufsize][, format][, level][, threads][, block_size][, strategy])
+local function pdeflate(read, write, bufsize, format, level, threads, block_size, strategy)
+	bufsize = bufsize or 16384
+	format = assert(pformats[format or 'zlib'], 'invalid format')
+	level = level or C.Z_DEFAULT_COMPRESSION
+	strategy = strategy or C.Z_DEFAULT_STRATEGY
+	local s = C.pdeflateInit(level, format, strategy, threads or 0, block_size or 0)
+	assert(s ~= nil, 'out of memory')
+	ffi.gc(s, C.pdeflateEnd)
+
+	if type(read) == 'string' then
+		local str = read
+		read = function()
+			local s = str
+			str = nil
+			return s
+		end
+	elseif type(read) == 'table' then
+		local t = read
+		local i = 0
+		read = function()
+			i = i + 1
+			return t[i]
+		end
+	end
+
+	local t
+	local asstring = write == ''
+	if type(write) == 'table' or asstring then
+		t = asstring and {} or write
+		write = function(data, sz)
+			t[#t+1] = ffi.string(data, sz)
+		end
+	end
+
+	local buf = ffi.new('uint8_t[?]', bufsize)
+	local function out(sz)
+		local bound = tonumber(C.pdeflateBound(s, sz))
+		if bound > bufsize then
+			bufsize = bound
+			buf = ffi.new('uint8_t[?]', bufsize)
+		end
+		return buf, bufsize
+	end
+
+	while true do
+		local data, size = read()
+		if not data then break end
+		size = size or #data
+		local buf, bufsize = out(size)
+		local n = tonumber(C.pdeflateWrite(s, data, size, buf, bufsize))
+		if n < 0 then checkz(n) end
+		if n > 0 then write(buf, n) end
+	end
+	local buf, bufsize = out(0)
+	local n = tonumber(C.pdeflateFinish(s, buf, bufsize))
+	if n < 0 then checkz(n) end
+	write(buf, n)
+	ffi.gc(s, nil)
+	C.pdeflateEnd(s)
+
+	if asstring then
+		return table.concat(t)
+	else
+		return t
+	end
+end
+
 --utility functions
 
 local function compress_tobuffer(data, size, level, buf, sz)
@@ -280,6 +352,7 @@ return {
 	version = version,
 	inflate = inflate,
 	deflate = deflate,
+	pdeflate = pdeflate,
 	uncompress_tobuffer = uncompress_tobuffer,
 	uncompress = uncompress,
 	compress_tobuffer = compress_tobuffer,
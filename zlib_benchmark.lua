@@ -0,0 +1,164 @@
+--benchmark for zlib: MB/s and compression ratio of gzip-compressing a
+--log-like text with zlib.deflate() vs zlib.pdeflate() on 1..N threads,
+--then MB/s of crc32/adler32 and of decoding: gzip HTTP bodies, a PNG image
+--with libpng and a zip file with minizip2 (uncompressed MB/s).
+--usage: luajit zlib_benchmark.lua [size_MB] [max_threads] [level]
+local ffi = require'ffi'
+local bit = require'bit'
+local time = require'time'
+local zlib = require'zlib' --load it before libpng and minizip2 link to it
+local libpng = require'libpng'
+local minizip2 = require'minizip2'
+
+if ... == 'zlib_benchmark' then return end --prevent loading as module
+
+io.stdout:setvbuf'no'
+
+local size = (tonumber((...)) or 32) * 1024^2
+local max_threads = tonumber((select(2, ...))) or 4
+local level = tonumber((select(3, ...)))
+
+--make a log-like text.
+math.randomseed(1234)
+local words = {'GET', 'POST', '/index.html', '/api/v1/users', '200', '404',
+	'500', 'Mozilla/5.0', 'curl/7.68', 'ms', 'bytes', 'user', 'session'}
+local t = {}
+local n = 0
+local i = 0
+while n < size do
+	i = i + 1
+	local s = string.format('2021-03-%02d %02d:%02d:%02d.%03d %s %s %d\n',
+		i % 28 + 1, i % 24, i % 60, (i * 7) % 60, i % 1000,
+		words[math.random(#words)], words[math.random(#words)],
+		math.random(1, 100000))
+	t[#t+1] = s
+	n = n + #s
+end
+local text = table.concat(t):sub(1, size)
+t = nil
+
+--feed the input in 1 MB chunks like a file reader would.
+local function chunks()
+	local i = 0
+	return function()
+		if i >= size then return end
+		local n = math.min(1024^2, size - i)
+		local p = ffi.cast('const char*', text) + i
+		i = i + n
+		return p, n
+	end
+end
+
+local function bench(name, deflate, ...)
+	local written = 0
+	local function write(buf, sz) written = written + sz end
+	local t0 = time.clock()
+	deflate(chunks(), write, 65536, 'gzip', level, ...)
+	local dt = time.clock() - t0
+	print(string.format('%-24s %7.1f MB/s  ratio %.4f',
+		name, size / 1024^2 / dt, written / size))
+end
+
+bench('deflate', zlib.deflate)
+local threads = 1
+while threads <= max_threads do
+	bench('pdeflate, '..threads..' thread(s)', zlib.pdeflate, threads)
+	threads = threads * 2
+end
+
+--checksums and decoding ----------------------------------------------------
+
+local function bench_decode(name, size, reps, f)
+	f() --warm up
+	local t0 = time.clock()
+	for i = 1, reps do
+		f()
+	end
+	local dt = time.clock() - t0
+	print(string.format('%-24s %7.1f MB/s', name, size * reps / 1024^2 / dt))
+end
+
+local p = ffi.cast('const char*', text)
+bench_decode('crc32',   size, 4, function() zlib.crc32(p, size) end)
+bench_decode('adler32', size, 4, function() zlib.adler32(p, size) end)
+
+--gzip HTTP bodies: many small html-like responses inflated one by one.
+local bodies = {}
+local body_size = 0
+for i = 1, 2000 do
+	local n = math.random(2, 60) * 1024
+	local o = math.random(0, size - n)
+	local html = '<html><body><pre>'..text:sub(o + 1, o + n)..'</pre></body></html>'
+	bodies[i] = zlib.deflate(html, '', nil, 'gzip')
+	body_size = body_size + #html
+end
+bench_decode('inflate gzip bodies', body_size, 5, function()
+	local function write() end
+	for i = 1, #bodies do
+		zlib.inflate(bodies[i], write, 65536, 'gzip')
+	end
+end)
+
+--PNG decode: a 2048x2048 rgb8 image with smooth gradients and some noise,
+--stored with the Sub filter like most encoders would choose for it.
+local function png_chunk(t, type, data)
+	local n = #data
+	t[#t+1] = string.char(
+		bit.band(bit.rshift(n, 24), 0xff), bit.band(bit.rshift(n, 16), 0xff),
+		bit.band(bit.rshift(n, 8), 0xff), bit.band(n, 0xff))
+	t[#t+1] = type
+	t[#t+1] = data
+	local crc = zlib.crc32(data, #data, zlib.crc32(type))
+	t[#t+1] = string.char(
+		bit.band(bit.rshift(crc, 24), 0xff), bit.band(bit.rshift(crc, 16), 0xff),
+		bit.band(bit.rshift(crc, 8), 0xff), bit.band(crc, 0xff))
+end
+local w, h = 2048, 2048
+local stride = 1 + w * 3
+local raw = ffi.new('uint8_t[?]', stride * h)
+for y = 0, h-1 do
+	local row = raw + y * stride
+	row[0] = 1 --Sub
+	local lr, lg, lb = 0, 0, 0
+	for x = 0, w-1 do
+		local r = bit.band(x / 8 + y / 16 + math.random(0, 3), 0xff)
+		local g = bit.band(y / 8 + math.random(0, 3), 0xff)
+		local b = bit.band((x + y) / 32 + math.random(0, 3), 0xff)
+		row[1 + x * 3 + 0] = bit.band(r - lr, 0xff)
+		row[1 + x * 3 + 1] = bit.band(g - lg, 0xff)
+		row[1 + x * 3 + 2] = bit.band(b - lb, 0xff)
+		lr, lg, lb = r, g, b
+	end
+end
+local t = {'\137PNG\r\n\26\n'}
+png_chunk(t, 'IHDR', string.char(0, 0, 8, 0, 0, 0, 8, 0, 8, 2, 0, 0, 0))
+png_chunk(t, 'IDAT', zlib.compress(raw, stride * h))
+png_chunk(t, 'IEND', '')
+local png = table.concat(t)
+raw = nil
+bench_decode('png decode', w * h * 3, 5, function()
+	libpng.load{string = png, accept = {rgb8 = true}}
+end)
+
+--zip extraction: a zip file with text, json and binary-ish entries.
+local zipfile = os.tmpname()
+local zw = assert(minizip2.open(zipfile, 'w'))
+local zip_size = 0
+for i = 1, 100 do
+	local n = math.random(16, 512) * 1024
+	local o = math.random(0, size - n)
+	local data = i % 3 == 0
+		and text:sub(o + 1, o + n):gsub('[%a ]', function(c) return string.char(math.random(0, 255)) end)
+		or text:sub(o + 1, o + n)
+	assert(zw:add_memfile('file'..i..(i % 3 == 0 and '.bin' or '.log'), data))
+	zip_size = zip_size + n
+end
+assert(zw:close())
+local zr = assert(minizip2.open{file = zipfile, in_memory = true})
+bench_decode('zip extract', zip_size, 5, function()
+	for e in zr:entries() do
+		assert(zr:read'*a')
+	end
+end)
+zr:close()
+os.remove(zipfile)
@@ -164,4 +164,12 @@ unsigned long adler32_combine(      unsigned long, unsigned long, long );
 unsigned long crc32_combine(        unsigned long, unsigned long, long );
 
 const unsigned long* get_crc_table( void );
+
+// pdeflate.h
+typedef struct pdeflate_state_s pdeflate_state;
+pdeflate_state* pdeflateInit(       int level, int format, int strategy, int threads, int block_size );
+void          pdeflateEnd(          pdeflate_state* );
+long          pdeflateBound(        pdeflate_state*, long len );
+long          pdeflateWrite(        pdeflate_state*, const void *in, long len, void *out, long outlen );
+long          pdeflateFinish(       pdeflate_state*, void *out, long outlen );
 ]]
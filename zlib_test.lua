@@ -3,7 +3,7 @@ local glue = require'glue'
 local ffi = require'ffi'
 require'unit'
 
-test(zlib.version():match'^1.2.7', '1.2.7')
+test(zlib.version():match'^1.2.11', '1.2.11')
 test(zlib.uncompress(zlib.compress('aaa'), nil, 1024), 'aaa')
 
 test(glue.tohex(zlib.adler32'The game done changed.'), '587507ba')
@@ -64,3 +64,236 @@ end
 test'gzip'
 test'zlib'
 test'deflate'
+
+--pdeflate output must be the same for any number of threads and inflate
+--back to the input, with the checksums in the trailer combined right.
+local function le32(s, i)
+	local a, b, c, d = s:byte(i, i+3)
+	return a + b * 2^8 + c * 2^16 + d * 2^24
+end
+
+local function be32(s, i)
+	local a, b, c, d = s:byte(i, i+3)
+	return d + c * 2^8 + b * 2^16 + a * 2^24
+end
+
+local function test_pdeflate(format)
+	math.randomseed(1)
+	--compressible text mixed with random bytes which don't compress.
+	local t = {}
+	for i = 1, 300 do
+		t[#t+1] = gen(math.random(1, 500))
+		local r = {}
+		for j = 1, math.random(1, 3000) do
+			r[j] = string.char(math.random(0, 255))
+		end
+		t[#t+1] = table.concat(r)
+	end
+	local src = table.concat(t)
+	--feed the input in chunks of random sizes to cross batch boundaries.
+	local chunks = {}
+	local i = 1
+	while i <= #src do
+		local n = math.random(1, 100000)
+		chunks[#chunks+1] = src:sub(i, i + n - 1)
+		i = i + n
+	end
+	local dst1
+	for _,threads in ipairs{1, 2, 3, 8} do
+		for _,block_size in ipairs{0, 5000} do
+			local dst = zlib.pdeflate(chunks, '', nil, format, nil, threads, block_size)
+			local key = format..' '..block_size
+			if threads == 1 then
+				dst1 = dst1 or {}
+				dst1[key] = dst
+			else
+				assert(dst == dst1[key], key..': output differs with '..threads..' threads')
+			end
+			local write = writer()
+			zlib.inflate(reader(dst), write, nil, format)
+			assert(write() == src)
+			if format == 'gzip' then
+				assert(le32(dst, #dst - 7) == zlib.crc32(src))
+				assert(le32(dst, #dst - 3) == #src % 2^32)
+			elseif format == 'zlib' then
+				assert(be32(dst, #dst - 3) == zlib.adler32(src))
+			end
+		end
+	end
+	--compare with deflate's size to check that the dictionaries are used.
+	local write = writer()
+	zlib.deflate(reader(src), write, nil, format)
+	local size = #write()
+	print(string.format('pdeflate %-7s size: %dK, %.2f%% bigger than deflate',
+		format, #src / 1024, (#dst1[format..' 0'] / size - 1) * 100))
+end
+test_pdeflate'gzip'
+test_pdeflate'zlib'
+test_pdeflate'deflate'
+
+--crc32 and adler32 with SIMD must give the same results as the plain
+--algorithms for any length and alignment, below and above the lengths
+--from which SIMD is used (64 bytes), and across adler32's 5552 byte blocks.
+local crc_table = {}
+for i = 0, 255 do
+	local c = i
+	for _ = 1, 8 do
+		c = bit.band(c, 1) ~= 0 and bit.bxor(bit.rshift(c, 1), 0xedb88320) or bit.rshift(c, 1)
+	end
+	crc_table[i] = c
+end
+
+local function ref_crc32(p, n, crc)
+	crc = bit.bnot(crc or 0)
+	for i = 0, n-1 do
+		crc = bit.bxor(crc_table[bit.band(bit.bxor(crc, p[i]), 0xff)], bit.rshift(crc, 8))
+	end
+	return bit.bnot(crc) % 2^32
+end
+
+local function ref_adler32(p, n, adler)
+	adler = adler or 1
+	local a, b = adler % 65536, math.floor(adler / 65536)
+	for i = 0, n-1 do
+		a = (a + p[i]) % 65521
+		b = (b + a) % 65521
+	end
+	return b * 65536 + a
+end
+
+local function test_checksums()
+	assert(zlib.crc32'123456789' == 0xcbf43926)
+	assert(zlib.adler32'123456789' == 0x091e01de)
+	math.randomseed(1)
+	local size = 100000 + 16
+	local buf = ffi.new('uint8_t[?]', size)
+	local ones = ffi.new('uint8_t[?]', size, 0xff) --max. adler32 sums
+	for i = 0, size-1 do
+		buf[i] = math.random(0, 255)
+	end
+	local function check(p, len)
+		local crc = math.random(0, 2^32-1)
+		local adler = math.random(0, 65520) * 65536 + math.random(0, 65520)
+		assert(zlib.crc32(p, len) == ref_crc32(p, len), len)
+		assert(zlib.crc32(p, len, crc) == ref_crc32(p, len, crc), len)
+		assert(zlib.adler32(p, len) == ref_adler32(p, len), len)
+		assert(zlib.adler32(p, len, adler) == ref_adler32(p, len, adler), len)
+	end
+	for offset = 0, 15 do
+		for len = 0, 300 do
+			check(buf + offset, len)
+			check(ones + offset, len)
+		end
+	end
+	for _,len in ipairs{1000, 5551, 5552, 5553, 3 * 5552 + 17, 65536 + 7, 100000} do
+		for _,offset in ipairs{0, 1, 7} do
+			check(buf + offset, len)
+			check(ones + offset, len)
+		end
+	end
+	print'crc32, adler32 ok'
+end
+test_checksums()
+
+--text with matches at all distances, so that the hash table is slid many
+--times and slid entries are used, and some random bytes.
+local function gen_matches(size)
+	local words = {}
+	for i = 1, 2000 do
+		local t = {}
+		for j = 1, math.random(2, 12) do
+			t[j] = string.char(math.random(97, 122))
+		end
+		words[i] = table.concat(t)
+	end
+	local t, n = {}, 0
+	while n < size do
+		local s = math.random() < .05
+			and string.char(math.random(0, 255), math.random(0, 255))
+			or words[math.random(1, math.random(1, #words))]..' '
+		t[#t+1] = s
+		n = n + #s
+	end
+	return table.concat(t)
+end
+
+--deflate output must be the same as that of stock zlib 1.2.11, which is
+--what these crc32s were computed with (built with -DNO_SIMD).
+local slide_hash_vectors = {
+	--windowBits, memLevel, level, crc32 of the output
+	{9, 1, 1, 0xe39651e8},
+	{9, 1, 6, 0x72416444},
+	{9, 1, 9, 0x72416444},
+	{9, 8, 1, 0x15fb7b49},
+	{9, 8, 6, 0x912521a9},
+	{9, 8, 9, 0x912521a9},
+	{9, 9, 1, 0x1bb2f704},
+	{9, 9, 6, 0xd12b2316},
+	{9, 9, 9, 0xd12b2316},
+	{12, 1, 1, 0x82726039},
+	{12, 1, 6, 0xeab825bf},
+	{12, 1, 9, 0xeab825bf},
+	{12, 8, 1, 0xa7431a25},
+	{12, 8, 6, 0x9b512acb},
+	{12, 8, 9, 0x9b512acb},
+	{12, 9, 1, 0x518ec6b2},
+	{12, 9, 6, 0x39fd17e8},
+	{12, 9, 9, 0x39fd17e8},
+	{15, 1, 1, 0x371d5938},
+	{15, 1, 6, 0xb114b640},
+	{15, 1, 9, 0xef7f6729},
+	{15, 8, 1, 0xac3b76c9},
+	{15, 8, 6, 0x878823be},
+	{15, 8, 9, 0x878823be},
+	{15, 9, 1, 0x657a796b},
+	{15, 9, 6, 0x544da430},
+	{15, 9, 9, 0x544da430},
+}
+
+local function test_slide_hash()
+	math.randomseed(1)
+	local src = gen_matches(300000)
+	for _,v in ipairs(slide_hash_vectors) do
+		local windowBits, memLevel, level, crc = unpack(v)
+		local write = writer()
+		zlib.deflate(reader(src), write, nil, 'deflate', level, windowBits, memLevel)
+		local dst = write()
+		assert(zlib.crc32(dst) == crc, string.format(
+			'windowBits %d, memLevel %d, level %d: output changed', windowBits, memLevel, level))
+		local write = writer()
+		zlib.inflate(reader(dst), write, nil, 'deflate', windowBits)
+		assert(write() == src)
+	end
+	print'slide_hash ok'
+end
+test_slide_hash()
+
+--inflate random streams feeding them in chunks of random sizes, so that
+--inflate_fast() is entered and left at all input and output positions.
+local function test_inflate_random()
+	math.randomseed(1)
+	for i = 1, 40 do
+		local src = gen_matches(math.random(0, 200000))
+		local format = ({'deflate', 'zlib', 'gzip'})[math.random(1, 3)]
+		local level = math.random(0, 9)
+		local windowBits = math.random(9, 15)
+		local memLevel = math.random(1, 9)
+		local strategy = math.random(0, 3)
+		local write = writer()
+		zlib.deflate(reader(src), write, nil, format, level, windowBits, memLevel, strategy)
+		local dst = write()
+		local chunks = {}
+		local j = 1
+		while j <= #dst do
+			local n = math.random(1, math.random(1, 20000))
+			chunks[#chunks+1] = dst:sub(j, j + n - 1)
+			j = j + n
+		end
+		local write = writer()
+		zlib.inflate(chunks, write, math.random(1, 70000), format, windowBits)
+		assert(write() == src, string.format('%s level %d windowBits %d memLevel %d strategy %d',
+			format, level, windowBits, memLevel, strategy))
+	end
+	print'inflate random ok'
+end
+test_inflate_random()